@@ -0,0 +1,7 @@
+ALTER TABLE playlist_items ADD COLUMN position REAL;
+
+UPDATE playlist_items SET position = ROWID;
+
+CREATE INDEX IF NOT EXISTS idx_playlist_items_position ON playlist_items (playlist, position);
+
+UPDATE schema_version SET version=17;
@@ -0,0 +1,14 @@
+CREATE TABLE IF NOT EXISTS smart_playlists_materialized (
+  search TEXT PRIMARY KEY,
+  songs_table TEXT NOT NULL,
+  where_clause TEXT NOT NULL,
+  last_used INTEGER NOT NULL DEFAULT 0
+);
+
+CREATE TABLE IF NOT EXISTS smart_playlists_songs (
+  search TEXT NOT NULL,
+  song_id INTEGER NOT NULL,
+  PRIMARY KEY (search, song_id)
+);
+
+UPDATE schema_version SET version=18;
@@ -4,7 +4,7 @@ CREATE TABLE IF NOT EXISTS schema_version (
 
 DELETE FROM schema_version;
 
-INSERT INTO schema_version (version) VALUES (16);
+INSERT INTO schema_version (version) VALUES (18);
 
 CREATE TABLE IF NOT EXISTS directories (
   path TEXT NOT NULL,
@@ -646,6 +646,7 @@ CREATE TABLE IF NOT EXISTS playlist_items (
   type INTEGER NOT NULL DEFAULT 0,
   collection_id INTEGER,
   playlist_url TEXT,
+  position REAL,
 
   title TEXT,
   album TEXT,
@@ -738,6 +739,19 @@ CREATE TABLE IF NOT EXISTS radio_channels (
   thumbnail_url TEXT
 );
 
+CREATE TABLE IF NOT EXISTS smart_playlists_materialized (
+  search TEXT PRIMARY KEY,
+  songs_table TEXT NOT NULL,
+  where_clause TEXT NOT NULL,
+  last_used INTEGER NOT NULL DEFAULT 0
+);
+
+CREATE TABLE IF NOT EXISTS smart_playlists_songs (
+  search TEXT NOT NULL,
+  song_id INTEGER NOT NULL,
+  PRIMARY KEY (search, song_id)
+);
+
 CREATE INDEX IF NOT EXISTS idx_url ON songs (url);
 
 CREATE INDEX IF NOT EXISTS idx_comp_artist ON songs (compilation_effective, artist);
@@ -750,6 +764,8 @@ CREATE INDEX IF NOT EXISTS idx_album ON songs (album);
 
 CREATE INDEX IF NOT EXISTS idx_title ON songs (title);
 
+CREATE INDEX IF NOT EXISTS idx_playlist_items_position ON playlist_items (playlist, position);
+
 CREATE VIEW IF NOT EXISTS duplicated_songs as select artist dup_artist, album dup_album, title dup_title from songs as inner_songs where artist != '' and album != '' and title != '' and unavailable = 0 group by artist, album , title having count(*) > 1;
 
 CREATE VIRTUAL TABLE IF NOT EXISTS songs_fts USING fts5(
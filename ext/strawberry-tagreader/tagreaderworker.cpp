@@ -34,6 +34,12 @@ void TagReaderWorker::MessageArrived(const spb::tagreader::Message &message) {
 
   spb::tagreader::Message reply;
 
+  if (message.has_read_files_request()) {
+    ReadFiles(message.read_files_request(), reply.mutable_read_files_response());
+    SendReply(message, &reply);
+    return;
+  }
+
   bool success = HandleMessage(message, reply, &tag_reader_);
   if (!success) {
 #if defined(USE_TAGLIB)
@@ -98,3 +104,18 @@ bool TagReaderWorker::HandleMessage(const spb::tagreader::Message &message, spb:
   return false;
 
 }
+
+void TagReaderWorker::ReadFiles(const spb::tagreader::ReadFilesRequest &request, spb::tagreader::ReadFilesResponse *response) {
+
+  for (const std::string &filename_str : request.filenames()) {
+    const QString filename = QString::fromUtf8(filename_str.data(), filename_str.size());
+    spb::tagreader::SongMetadata *metadata = response->add_metadata();
+    if (!tag_reader_.ReadFile(filename, metadata)) {
+#if defined(USE_TAGLIB)
+      metadata->Clear();
+      tag_reader_gme_.ReadFile(filename, metadata);
+#endif
+    }
+  }
+
+}
@@ -48,6 +48,8 @@ class TagReaderWorker : public AbstractMessageHandler<spb::tagreader::Message> {
  private:
   // Handle message using specific TagReaderBase implementation. Returns true on successful message handle.
   bool HandleMessage(const spb::tagreader::Message &message, spb::tagreader::Message &reply, TagReaderBase* reader);
+  // Reads a batch of files, falling back to the other readers for each file that could not be read.
+  void ReadFiles(const spb::tagreader::ReadFilesRequest &request, spb::tagreader::ReadFilesResponse *response);
 
 #if defined(USE_TAGLIB)
   TagReaderTagLib tag_reader_;
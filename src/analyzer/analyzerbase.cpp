@@ -53,6 +53,7 @@
 Analyzer::Base::Base(QWidget *parent, const uint scopeSize)
     : QWidget(parent),
       fht_(new FHT(scopeSize)),
+      spectrum_(SpectrumEngine::Shared()),
       engine_(nullptr),
       lastscope_(512),
       new_frame_(false),
@@ -85,21 +86,16 @@ void Analyzer::Base::ChangeTimeout(const int timeout) {
 
 }
 
-void Analyzer::Base::transform(Scope &scope) {
+void Analyzer::Base::ChangeFFTSize(const int fft_size) {
+  spectrum_->set_fft_size(fft_size);
+}
 
-  QVector<float> aux(fht_->size());
-  if (static_cast<unsigned long int>(aux.size()) >= scope.size()) {
-    std::copy(scope.begin(), scope.end(), aux.begin());
-  }
-  else {
-    std::copy(scope.begin(), scope.begin() + aux.size(), aux.begin());
-  }
+void Analyzer::Base::transform(Scope &scope) {
 
-  fht_->logSpectrum(scope.data(), aux.data());
+  scope.resize(fht_->size() / 2);
+  spectrum_->LogBands(fht_->size(), static_cast<int>(scope.size()), scope.data());
   fht_->scale(scope.data(), 1.0F / 20);
 
-  scope.resize(fht_->size() / 2);  // second half of values are rubbish
-
 }
 
 void Analyzer::Base::paintEvent(QPaintEvent *e) {
@@ -109,14 +105,10 @@ void Analyzer::Base::paintEvent(QPaintEvent *e) {
 
   switch (engine_->state()) {
     case Engine::State::Playing: {
-      const Engine::Scope &thescope = engine_->scope(timeout_);
-      int i = 0;
-
-      // convert to mono here - our built in analyzers need mono, but the engines provide interleaved pcm
-      for (uint x = 0; static_cast<int>(x) < fht_->size(); ++x) {
-        lastscope_[x] = static_cast<float>(thescope[i] + thescope[i + 1]) / (2 * (1U << 15U));
-        i += 2;
-      }
+      // The spectrum engine reads the scope once per frame for all analyzers and converts the interleaved pcm to mono.
+      spectrum_->Update(engine_, timeout_, fht_->size());
+      lastscope_.resize(fht_->size());
+      spectrum_->Samples(fht_->size(), lastscope_.data());
 
       is_playing_ = true;
       transform(lastscope_);
@@ -145,8 +137,8 @@ int Analyzer::Base::resizeExponent(int exp) {
   if (exp < 3) {
     exp = 3;
   }
-  else if (exp > 9) {
-    exp = 9;
+  else if (exp > SpectrumEngine::kMaxExponent) {
+    exp = SpectrumEngine::kMaxExponent;
   }
 
   if (exp != fht_->sizeExp()) {
@@ -159,24 +151,10 @@ int Analyzer::Base::resizeExponent(int exp) {
 
 int Analyzer::Base::resizeForBands(const int bands) {
 
-  int exp = 0;
-  if (bands <= 8) {
-    exp = 4;
-  }
-  else if (bands <= 16) {
-    exp = 5;
-  }
-  else if (bands <= 32) {
-    exp = 6;
-  }
-  else if (bands <= 64) {
-    exp = 7;
-  }
-  else if (bands <= 128) {
-    exp = 8;
-  }
-  else {
-    exp = 9;
+  // Two bins per band, from 2^4 for up to 8 bands to the largest size the spectrum engine supports.
+  int exp = 4;
+  while (exp < SpectrumEngine::kMaxExponent && (1 << (exp - 1)) < bands) {
+    ++exp;
   }
 
   resizeExponent(exp);
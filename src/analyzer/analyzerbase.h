@@ -29,6 +29,7 @@
 #  include <sys/types.h>
 #endif
 
+#include <memory>
 #include <vector>
 
 #include <QtGlobal>
@@ -39,6 +40,7 @@
 #include <QPainter>
 
 #include "analyzer/fht.h"
+#include "analyzer/spectrumengine.h"
 #include "engine/engine_fwd.h"
 #include "engine/enginebase.h"
 
@@ -62,6 +64,8 @@ class Base : public QWidget {
   void set_engine(EngineBase *engine) { engine_ = engine; }
 
   void ChangeTimeout(const int timeout);
+  // Shared by all analyzers, 0 lets every analyzer use its own size.
+  void ChangeFFTSize(const int fft_size);
 
   virtual void framerateChanged() {}
 
@@ -83,6 +87,7 @@ class Base : public QWidget {
  protected:
   QBasicTimer timer_;
   FHT *fht_;
+  std::shared_ptr<SpectrumEngine> spectrum_;
   EngineBase *engine_;
   Scope lastscope_;
 
@@ -50,6 +50,7 @@ using namespace std::chrono_literals;
 
 const char *AnalyzerContainer::kSettingsGroup = "Analyzer";
 const char *AnalyzerContainer::kSettingsFramerate = "framerate";
+const char *AnalyzerContainer::kSettingsFFTSize = "fft_size";
 
 // Framerates
 const int AnalyzerContainer::kLowFramerate = 20;
@@ -60,10 +61,13 @@ const int AnalyzerContainer::kSuperHighFramerate = 60;
 AnalyzerContainer::AnalyzerContainer(QWidget *parent)
     : QWidget(parent),
       current_framerate_(kMediumFramerate),
+      current_fft_size_(0),
       context_menu_(new QMenu(this)),
       context_menu_framerate_(new QMenu(tr("Framerate"), this)),
+      context_menu_fft_size_(new QMenu(tr("FFT size"), this)),
       group_(new QActionGroup(this)),
       group_framerate_(new QActionGroup(this)),
+      group_fft_size_(new QActionGroup(this)),
       double_click_timer_(new QTimer(this)),
       ignore_next_click_(false),
       current_analyzer_(nullptr),
@@ -80,6 +84,14 @@ AnalyzerContainer::AnalyzerContainer(QWidget *parent)
   AddFramerate(tr("Super high (%1 fps)").arg(kSuperHighFramerate), kSuperHighFramerate);
 
   context_menu_->addMenu(context_menu_framerate_);
+
+  // Init FFT size sub-menu
+  AddFFTSize(tr("Automatic"), 0);
+  for (int fft_size = 512; fft_size <= 8192; fft_size *= 2) {
+    AddFFTSize(QString::number(fft_size), fft_size);
+  }
+
+  context_menu_->addMenu(context_menu_fft_size_);
   context_menu_->addSeparator();
 
   AddAnalyzerType<BlockAnalyzer>();
@@ -155,6 +167,7 @@ void AnalyzerContainer::ChangeAnalyzer(const int id) {
   // Even if it is not supposed to happen, I don't want to get a dbz error
   current_framerate_ = current_framerate_ == 0 ? kMediumFramerate : current_framerate_;
   current_analyzer_->ChangeTimeout(1000 / current_framerate_);
+  current_analyzer_->ChangeFFTSize(current_fft_size_);
 
   layout()->addWidget(current_analyzer_);
 
@@ -182,6 +195,7 @@ void AnalyzerContainer::Load() {
   s.beginGroup(kSettingsGroup);
   QString type = s.value("type", "BlockAnalyzer").toString();
   current_framerate_ = s.value(kSettingsFramerate, kMediumFramerate).toInt();
+  current_fft_size_ = s.value(kSettingsFFTSize, 0).toInt();
   s.endGroup();
 
   // Analyzer
@@ -209,6 +223,11 @@ void AnalyzerContainer::Load() {
     }
   }
 
+  // FFT size
+  const int fft_size_index = fft_size_list_.indexOf(current_fft_size_);
+  ChangeFFTSize(fft_size_index == -1 ? 0 : current_fft_size_);
+  group_fft_size_->actions()[fft_size_index == -1 ? 0 : fft_size_index]->setChecked(true);
+
 }
 
 void AnalyzerContainer::SaveFramerate(const int framerate) {
@@ -222,6 +241,20 @@ void AnalyzerContainer::SaveFramerate(const int framerate) {
 
 }
 
+void AnalyzerContainer::ChangeFFTSize(const int fft_size) {
+
+  current_fft_size_ = fft_size;
+  if (current_analyzer_) {
+    current_analyzer_->ChangeFFTSize(fft_size);
+  }
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue(kSettingsFFTSize, current_fft_size_);
+  s.endGroup();
+
+}
+
 void AnalyzerContainer::Save() {
 
   QSettings s;
@@ -240,3 +273,13 @@ void AnalyzerContainer::AddFramerate(const QString &name, const int framerate) {
   QObject::connect(action, &QAction::triggered, this, [this, framerate]() { ChangeFramerate(framerate); } );
 
 }
+
+void AnalyzerContainer::AddFFTSize(const QString &name, const int fft_size) {
+
+  QAction *action = context_menu_fft_size_->addAction(name);
+  group_fft_size_->addAction(action);
+  fft_size_list_ << fft_size;
+  action->setCheckable(true);
+  QObject::connect(action, &QAction::triggered, this, [this, fft_size]() { ChangeFFTSize(fft_size); } );
+
+}
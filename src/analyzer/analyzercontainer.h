@@ -51,6 +51,7 @@ class AnalyzerContainer : public QWidget {
 
   static const char *kSettingsGroup;
   static const char *kSettingsFramerate;
+  static const char *kSettingsFFTSize;
 
  signals:
   void WheelEvent(int delta);
@@ -62,6 +63,7 @@ class AnalyzerContainer : public QWidget {
  private slots:
   void ChangeAnalyzer(const int id);
   void ChangeFramerate(int new_framerate);
+  void ChangeFFTSize(const int fft_size);
   void DisableAnalyzer();
   void ShowPopupMenu();
 
@@ -77,16 +79,21 @@ class AnalyzerContainer : public QWidget {
   template<typename T>
   void AddAnalyzerType();
   void AddFramerate(const QString &name, const int framerate);
+  void AddFFTSize(const QString &name, const int fft_size);
 
  private:
   int current_framerate_;  // fps
+  int current_fft_size_;
   QMenu *context_menu_;
   QMenu *context_menu_framerate_;
+  QMenu *context_menu_fft_size_;
   QActionGroup *group_;
   QActionGroup *group_framerate_;
+  QActionGroup *group_fft_size_;
 
   QList<const QMetaObject*> analyzer_types_;
   QList<int> framerate_list_;
+  QList<int> fft_size_list_;
   QList<QAction*> actions_;
   QAction *disable_action_;
 
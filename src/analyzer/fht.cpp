@@ -20,11 +20,18 @@
    along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "config.h"
+
 #include "fht.h"
 
 #include <algorithm>
 #include <cmath>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define FHT_SSE2
+#  include <emmintrin.h>
+#endif
+
 #include <QVector>
 #include <QtMath>
 
@@ -32,8 +39,10 @@ FHT::FHT(uint n) : num_((n < 3) ? 0 : 1 << n), exp2_((n < 3) ? static_cast<int>(
 
   if (n > 3) {
     buf_vector_.resize(num_);
-    tab_vector_.resize(num_ * 2);
-    makeCasTable();
+    cos_vector_.resize(num_);
+    sin_vector_.resize(num_);
+    bitrev_vector_.resize(num_);
+    makeTables();
   }
 
 }
@@ -44,21 +53,26 @@ int FHT::sizeExp() const { return exp2_; }
 int FHT::size() const { return num_; }
 
 float *FHT::buf_() { return buf_vector_.data(); }
-float *FHT::tab_() { return tab_vector_.data(); }
 int *FHT::log_() { return log_vector_.data(); }
 
-void FHT::makeCasTable(void) {
+void FHT::makeTables() {
 
-  float *costab = tab_();
-  float *sintab = tab_() + num_ / 2 + 1;
-
-  for (int ul = 0; ul < num_; ul++) {
-    double d = M_PI * static_cast<double>(ul) / (static_cast<double>(num_) / 2.0);
-    *costab = *sintab = static_cast<float>(cos(d));
+  for (int i = 0; i < num_; ++i) {
+    int r = 0;
+    for (int b = 0; b < exp2_; ++b) {
+      if (i & (1 << b)) r |= 1 << (exp2_ - 1 - b);
+    }
+    bitrev_vector_[i] = r;
+  }
 
-    costab += 2;
-    sintab += 2;
-    if (sintab > tab_() + num_ * 2) sintab = tab_() + 1;
+  // The stage combining blocks of size m uses the m / 2 values starting at index m / 2.
+  for (int m = 2; m <= num_; m *= 2) {
+    const int half = m / 2;
+    for (int k = 0; k < half; ++k) {
+      const double d = 2.0 * M_PI * static_cast<double>(k) / static_cast<double>(m);
+      cos_vector_[half + k] = static_cast<float>(cos(d));
+      sin_vector_[half + k] = static_cast<float>(sin(d));
+    }
   }
 
 }
@@ -126,7 +140,7 @@ void FHT::power(float *p) {
 
 void FHT::power2(float *p) {
 
-  _transform(p, num_, 0);
+  _transform(p);
 
   *p = static_cast<float>(2 * pow(*p, 2));
   p++;
@@ -146,7 +160,7 @@ void FHT::transform(float *p) {
     transform8(p);
   }
   else {
-    _transform(p, num_, 0);
+    _transform(p);
   }
 
 }
@@ -180,46 +194,54 @@ void FHT::transform8(float *p) {
 
 }
 
-void FHT::_transform(float *p, int n, int k) {
+void FHT::_transform(float *p) {
 
-  if (n == 8) {
-    transform8(p + k);
+  if (num_ == 8) {
+    transform8(p);
     return;
   }
 
-  int i = 0, j = 0, ndiv2 = n / 2;
-  float a = 0.0, *t1 = nullptr, *t2 = nullptr, *t3 = nullptr, *t4 = nullptr, *ptab = nullptr, *pp = nullptr;
-
-  for (i = 0, t1 = buf_(), t2 = buf_() + ndiv2, pp = &p[k]; i < ndiv2; i++)
-    *t1++ = *pp++, *t2++ = *pp++;
-
-  std::copy(buf_(), buf_() + n, p + k);
-
-  _transform(p, ndiv2, k);
-  _transform(p, ndiv2, k + ndiv2);
-
-  j = num_ / ndiv2 - 1;
-  t1 = buf_();
-  t2 = t1 + ndiv2;
-  t3 = p + k + ndiv2;
-  ptab = tab_();
-  pp = p + k;
-
-  a = *ptab++ * *t3++;
-  a += *ptab * *pp;
-  ptab += j;
-
-  *t1++ = *pp + a;
-  *t2++ = *pp++ - a;
-
-  for (i = 1, t4 = p + k + n; i < ndiv2; i++, ptab += j) {
-    a = *ptab++ * *t3++;
-    a += *ptab * *--t4;
+  // Decimation in time: start from the bit reversed input, then combine blocks of size m / 2 into blocks of size m.
+  // Every stage reads from one buffer and writes to the other, so the second operand of a butterfly, which is read backwards, is never overwritten.
+  float *src = buf_();
+  float *dst = p;
+  const int *bitrev = bitrev_vector_.data();
+  for (int i = 0; i < num_; ++i) src[i] = p[bitrev[i]];
+
+  for (int m = 2; m <= num_; m *= 2) {
+    const int half = m / 2;
+    const float *costab = cos_vector_.data() + half;
+    const float *sintab = sin_vector_.data() + half;
+
+    for (int b = 0; b < num_; b += m) {
+      const float *x = src + b;
+      float *y = dst + b;
+
+      y[0] = x[0] + x[half];
+      y[half] = x[0] - x[half];
+
+      int k = 1;
+#ifdef FHT_SSE2
+      for (; k + 4 <= half; k += 4) {
+        const __m128 e = _mm_loadu_ps(x + k);
+        const __m128 o = _mm_loadu_ps(x + half + k);
+        __m128 r = _mm_loadu_ps(x + m - k - 3);
+        r = _mm_shuffle_ps(r, r, _MM_SHUFFLE(0, 1, 2, 3));
+        const __m128 a = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(costab + k), o), _mm_mul_ps(_mm_loadu_ps(sintab + k), r));
+        _mm_storeu_ps(y + k, _mm_add_ps(e, a));
+        _mm_storeu_ps(y + half + k, _mm_sub_ps(e, a));
+      }
+#endif
+      for (; k < half; ++k) {
+        const float a = costab[k] * x[half + k] + sintab[k] * x[m - k];
+        y[k] = x[k] + a;
+        y[half + k] = x[k] - a;
+      }
+    }
 
-    *t1++ = *pp + a;
-    *t2++ = *pp++ - a;
+    std::swap(src, dst);
   }
 
-  std::copy(buf_(), buf_() + n, p + k);
+  if (src != p) std::copy(src, src + num_, p);
 
 }
@@ -38,30 +38,32 @@ class FHT {
   const int exp2_;
 
   QVector<float> buf_vector_;
-  QVector<float> tab_vector_;
+  QVector<float> cos_vector_;
+  QVector<float> sin_vector_;
+  QVector<int> bitrev_vector_;
   QVector<int> log_vector_;
 
   float *buf_();
-  float *tab_();
   int *log_();
 
   /**
-   * Create a table of "cas" (cosine and sine) values.
-   * Has only to be done in the constructor and saves from
-   * calculating the same values over and over while transforming.
+   * Create the bit reversal table and the "cas" (cosine and sine) tables.
+   * Each butterfly stage gets its own contiguous range of values so the
+   * butterflies can be vectorized. Has only to be done in the constructor
+   * and saves from calculating the same values over and over while transforming.
    */
-  void makeCasTable();
+  void makeTables();
 
   /**
-   * Recursive in-place Hartley transform. For internal use only!
+   * Iterative in-place Hartley transform. For internal use only!
    */
-  void _transform(float*, int, int);
+  void _transform(float*);
 
  public:
   /**
   * Prepare transform for data sets with @f$2^n@f$ numbers, whereby @f$n@f$
   * should be at least 3. Values of more than 3 need a trigonometry table.
-  * @see makeCasTable()
+  * @see makeTables()
   */
   explicit FHT(uint);
 
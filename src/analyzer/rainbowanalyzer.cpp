@@ -81,7 +81,7 @@ Rainbow::RainbowAnalyzer::RainbowAnalyzer(const RainbowType rbtype, QWidget *par
 
 }
 
-void Rainbow::RainbowAnalyzer::transform(Scope &s) { fht_->spectrum(s.data()); }
+void Rainbow::RainbowAnalyzer::transform(Scope &s) { spectrum_->Spectrum(fht_->size(), s.data()); }
 
 void Rainbow::RainbowAnalyzer::timerEvent(QTimerEvent *e) {
 
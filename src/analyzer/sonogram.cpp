@@ -81,7 +81,7 @@ void Sonogram::analyze(QPainter &p, const Analyzer::Scope &s, bool new_frame) {
 
 void Sonogram::transform(Analyzer::Scope &scope) {
 
-  fht_->power2(scope.data());
+  spectrum_->Power2(fht_->size(), scope.data());
   fht_->scale(scope.data(), 1.0 / 256);
   scope.resize(fht_->size() / 2);
 
@@ -0,0 +1,243 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <QtGlobal>
+#include <QtMath>
+#include <QPair>
+#include <QElapsedTimer>
+
+#include "engine/enginebase.h"
+#include "analyzer/fht.h"
+#include "spectrumengine.h"
+
+constexpr int SpectrumEngine::kMinExponent = 3;
+constexpr int SpectrumEngine::kMaxExponent = 13;
+constexpr qint64 SpectrumEngine::kMinUpdateIntervalMsec = 5;
+
+namespace {
+
+int ExponentForSize(const int size) {
+
+  int exponent = SpectrumEngine::kMinExponent;
+  while (exponent < SpectrumEngine::kMaxExponent && (1 << exponent) < size) ++exponent;
+  return exponent;
+
+}
+
+}  // namespace
+
+SpectrumEngine::SpectrumEngine()
+    : samples_(static_cast<size_t>(1) << kMaxExponent, 0.0F),
+      serial_(1),
+      last_engine_(nullptr),
+      scope_frames_(0),
+      fft_size_(0) {}
+
+std::shared_ptr<SpectrumEngine> SpectrumEngine::Shared() {
+
+  static std::weak_ptr<SpectrumEngine> shared;
+
+  std::shared_ptr<SpectrumEngine> spectrum_engine = shared.lock();
+  if (!spectrum_engine) {
+    spectrum_engine = std::make_shared<SpectrumEngine>();
+    shared = spectrum_engine;
+  }
+
+  return spectrum_engine;
+
+}
+
+void SpectrumEngine::set_fft_size(const int fft_size) {
+
+  fft_size_ = fft_size <= 0 ? 0 : 1 << ExponentForSize(fft_size);
+
+}
+
+void SpectrumEngine::Update(EngineBase *engine, const int timeout, const int size) {
+
+  if (!engine) return;
+
+  const int frames = 1 << ExponentForSize(AnalysisSize(size));
+  if (engine == last_engine_ && frames <= scope_frames_ && last_update_.isValid() && last_update_.elapsed() < kMinUpdateIntervalMsec) {
+    return;
+  }
+
+  scope_frames_ = qMax(scope_frames_, frames);
+  engine->EnsureScopeSize(static_cast<size_t>(scope_frames_) * 2);
+
+  SetScope(engine->scope(timeout));
+
+  last_engine_ = engine;
+  last_update_.start();
+
+}
+
+void SpectrumEngine::SetScope(const std::vector<int16_t> &scope) {
+
+  // Engines provide interleaved stereo, the analyzers need mono.
+  const size_t scope_frames = qMin(scope.size() / 2, samples_.size());
+  const size_t first = samples_.size() - scope_frames;
+  std::fill(samples_.begin(), samples_.begin() + static_cast<qint64>(first), 0.0F);
+  const int16_t *source = scope.data() + (scope.size() / 2 - scope_frames) * 2;
+  for (size_t i = 0; i < scope_frames; ++i, source += 2) {
+    samples_[first + i] = static_cast<float>(source[0] + source[1]) / (2 * (1U << 15U));
+  }
+
+  ++serial_;
+
+}
+
+void SpectrumEngine::Samples(const int size, float *out) const {
+
+  const size_t count = qMin(static_cast<size_t>(qMax(0, size)), samples_.size());
+  std::copy(samples_.end() - static_cast<qint64>(count), samples_.end(), out);
+
+}
+
+SpectrumEngine::Transform &SpectrumEngine::TransformForSize(const int size) {
+
+  const int exponent = ExponentForSize(size);
+  Transform &transform = transforms_[exponent];
+  if (!transform.fht) {
+    const int n = 1 << exponent;
+    transform.fht = std::make_unique<FHT>(static_cast<uint>(exponent));
+    transform.buffer.resize(static_cast<size_t>(n));
+    transform.hann.resize(static_cast<size_t>(n));
+    for (int i = 0; i < n; ++i) {
+      transform.hann[static_cast<size_t>(i)] = static_cast<float>(0.5 - 0.5 * cos(2.0 * M_PI * static_cast<double>(i) / static_cast<double>(n - 1)));
+    }
+  }
+
+  return transform;
+
+}
+
+const std::vector<float> &SpectrumEngine::CachedPower2(const int size, const Window window) {
+
+  Transform &transform = TransformForSize(size);
+  const int n = transform.fht->size();
+
+  CachedPower &cached = powers_[n * 2 + (window == Window::Hann ? 1 : 0)];
+  if (cached.serial == serial_) return cached.power;
+
+  float *buffer = transform.buffer.data();
+  Samples(n, buffer);
+  if (window == Window::Hann) {
+    const float *hann = transform.hann.data();
+    for (int i = 0; i < n; ++i) buffer[i] *= hann[i];
+  }
+  transform.fht->power2(buffer);
+
+  cached.power.assign(buffer, buffer + n / 2);
+  cached.serial = serial_;
+
+  return cached.power;
+
+}
+
+void SpectrumEngine::Power2(const int size, float *out, const Window window) {
+
+  const int n = 1 << ExponentForSize(size);
+  const std::vector<float> &power = CachedPower2(AnalysisSize(n), window);
+  const size_t bins = static_cast<size_t>(n / 2);
+  if (power.size() == bins) {
+    std::copy(power.begin(), power.end(), out);
+    return;
+  }
+
+  // The power of a k times larger transform is k^2 times larger, and each requested bin covers k of its bins.
+  const size_t k = power.size() / bins;
+  const float scale = 1.0F / static_cast<float>(k * k);
+  for (size_t i = 0; i < bins; ++i) {
+    float sum = 0.0F;
+    for (size_t j = i * k; j < (i + 1) * k; ++j) sum += power[j];
+    out[i] = sum * scale;
+  }
+
+}
+
+void SpectrumEngine::Spectrum(const int size, float *out, const Window window) {
+
+  Power2(size, out, window);
+  const int bins = (1 << ExponentForSize(size)) / 2;
+  for (int i = 0; i < bins; ++i) {
+    out[i] = std::sqrt(out[i] / 2);
+  }
+
+}
+
+const std::vector<SpectrumEngine::Band> &SpectrumEngine::BandsFor(const int size, const int bands) {
+
+  std::vector<Band> &result = bands_[qMakePair(size, bands)];
+  if (!result.empty()) return result;
+
+  // Bins are spaced linearly, so the low bands are narrower than a bin and get interpolated between the two closest bins.
+  const int bins = size / 2;
+  result.resize(static_cast<size_t>(bands));
+  for (int i = 0; i < bands; ++i) {
+    const double low = std::pow(static_cast<double>(bins), static_cast<double>(i) / bands);
+    const double high = std::pow(static_cast<double>(bins), static_cast<double>(i + 1) / bands);
+    Band &band = result[static_cast<size_t>(i)];
+    band.first = qBound(0, static_cast<int>(std::floor(low)), bins - 1);
+    band.last = qBound(0, static_cast<int>(std::ceil(high)) - 1, bins - 1);
+    if (band.last <= band.first) {
+      const double center = (low + high) / 2.0;
+      band.first = qBound(0, static_cast<int>(std::floor(center)), bins - 2);
+      band.last = band.first;
+      band.weight = static_cast<float>(qBound(0.0, center - band.first, 1.0));
+    }
+  }
+
+  return result;
+
+}
+
+void SpectrumEngine::LogBands(const int size, const int bands, float *out, const Window window) {
+
+  if (bands <= 0) return;
+
+  const int n = TransformForSize(AnalysisSize(size)).fht->size();
+  const std::vector<float> &power = CachedPower2(n, window);
+  const std::vector<Band> &band_list = BandsFor(n, bands);
+
+  for (int i = 0; i < bands; ++i) {
+    const Band &band = band_list[static_cast<size_t>(i)];
+    if (band.first == band.last) {
+      const float low = std::sqrt(power[static_cast<size_t>(band.first)] / 2);
+      const float high = std::sqrt(power[static_cast<size_t>(band.first + 1)] / 2);
+      out[i] = low + (high - low) * band.weight;
+    }
+    else {
+      float sum = 0.0F;
+      for (int bin = band.first; bin <= band.last; ++bin) {
+        sum += std::sqrt(power[static_cast<size_t>(bin)] / 2);
+      }
+      out[i] = sum / static_cast<float>(band.last - band.first + 1);
+    }
+  }
+
+}
@@ -0,0 +1,119 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SPECTRUMENGINE_H
+#define SPECTRUMENGINE_H
+
+#include "config.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <QtGlobal>
+#include <QPair>
+#include <QElapsedTimer>
+
+#include "analyzer/fht.h"
+#include "engine/engine_fwd.h"
+
+// Computes spectra of the audio that is playing for the analyzers.
+// The audio window is read from the engine once per frame and every spectrum is computed at most once per window,
+// however many analyzers ask for it. FFT sizes from 2^3 up to 2^13 are supported.
+// The analysis size can be raised above the size an analyzer asks for, the extra bins are then summed into the requested ones.
+class SpectrumEngine {
+ public:
+  explicit SpectrumEngine();
+
+  static const int kMinExponent;
+  static const int kMaxExponent;
+  static const qint64 kMinUpdateIntervalMsec;
+
+  enum class Window {
+    Rectangular,
+    Hann
+  };
+
+  // The instance shared by all analyzers.
+  static std::shared_ptr<SpectrumEngine> Shared();
+
+  // FFT size used for the analysis when it's larger than the size asked for, 0 to always use the size asked for.
+  int fft_size() const { return fft_size_; }
+  void set_fft_size(const int fft_size);
+
+  // Reads a new audio window of at least size frames from the engine, unless it was read very recently.
+  void Update(EngineBase *engine, const int timeout, const int size);
+  quint64 serial() const { return serial_; }
+
+  // Replaces the current window with the end of the given interleaved stereo pcm.
+  void SetScope(const std::vector<int16_t> &scope);
+
+  // Copies the last size mono samples of the current window, scaled to -1.0 .. 1.0.
+  void Samples(const int size, float *out) const;
+
+  // size / 2 values, the same as FHT::power2 and FHT::spectrum would return for the current window.
+  // With a larger FFT size, each value is the power of the bins it covers scaled to the requested size.
+  void Power2(const int size, float *out, const Window window = Window::Rectangular);
+  void Spectrum(const int size, float *out, const Window window = Window::Rectangular);
+
+  // Averages the magnitude spectrum into bands that are spaced logarithmically from the first bin to the Nyquist frequency.
+  void LogBands(const int size, const int bands, float *out, const Window window = Window::Hann);
+
+ private:
+  struct Transform {
+    std::unique_ptr<FHT> fht;
+    std::vector<float> hann;
+    std::vector<float> buffer;
+  };
+
+  struct CachedPower {
+    CachedPower() : serial(0) {}
+    quint64 serial;
+    std::vector<float> power;
+  };
+
+  struct Band {
+    Band() : first(0), last(0), weight(0.0F) {}
+    int first;
+    int last;
+    float weight;
+  };
+
+  Transform &TransformForSize(const int size);
+  const std::vector<float> &CachedPower2(const int size, const Window window);
+  int AnalysisSize(const int size) const { return qMax(size, fft_size_); }
+  const std::vector<Band> &BandsFor(const int size, const int bands);
+
+ private:
+  std::vector<float> samples_;
+  quint64 serial_;
+  EngineBase *last_engine_;
+  QElapsedTimer last_update_;
+  int scope_frames_;
+  int fft_size_;
+
+  std::map<int, Transform> transforms_;
+  std::map<int, CachedPower> powers_;
+  std::map<QPair<int, int>, std::vector<Band>> bands_;
+
+  Q_DISABLE_COPY(SpectrumEngine)
+};
+
+#endif  // SPECTRUMENGINE_H
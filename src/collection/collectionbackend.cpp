@@ -21,6 +21,9 @@
 
 #include "config.h"
 
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <optional>
 
 #include <QtGlobal>
@@ -28,8 +31,11 @@
 #include <QApplication>
 #include <QThread>
 #include <QMutex>
+#include <QList>
 #include <QSet>
 #include <QMap>
+#include <QHash>
+#include <QPair>
 #include <QVector>
 #include <QVariant>
 #include <QByteArray>
@@ -39,6 +45,8 @@
 #include <QFileInfo>
 #include <QDateTime>
 #include <QRegularExpression>
+#include <QRandomGenerator>
+#include <QCryptographicHash>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
@@ -48,6 +56,7 @@
 #include "core/scopedtransaction.h"
 #include "core/song.h"
 #include "core/sqlrow.h"
+#include "utilities/strutils.h"
 #include "smartplaylists/smartplaylistsearch.h"
 
 #include "collectiondirectory.h"
@@ -56,6 +65,12 @@
 #include "collectionquery.h"
 #include "collectiontask.h"
 
+const int CollectionBackend::kBulkInsertMinSongs = 100;
+const int CollectionBackend::kBulkInsertMaxVariables = 999;
+const int CollectionBackend::kSmartPlaylistsMaxSampleMisses = 64;
+const int CollectionBackend::kSmartPlaylistsMaxSampleIds = 10000;
+const qint64 CollectionBackend::kSmartPlaylistsMaterializedMaxAge = 90LL * 24LL * 60LL * 60LL;
+
 CollectionBackend::CollectionBackend(QObject *parent)
     : CollectionBackendInterface(parent),
       db_(nullptr),
@@ -65,6 +80,12 @@ CollectionBackend::CollectionBackend(QObject *parent)
 
   original_thread_ = thread();
 
+  QObject::connect(this, &CollectionBackend::SongsDiscovered, this, &CollectionBackend::SmartPlaylistsUpdateMaterialized);
+  QObject::connect(this, &CollectionBackend::SongsDeleted, this, &CollectionBackend::SmartPlaylistsUpdateMaterialized);
+  QObject::connect(this, &CollectionBackend::SongsStatisticsChanged, this, &CollectionBackend::SmartPlaylistsUpdateMaterialized);
+  QObject::connect(this, &CollectionBackend::SongsRatingChanged, this, &CollectionBackend::SmartPlaylistsUpdateMaterialized);
+  QObject::connect(this, &CollectionBackend::DatabaseReset, this, &CollectionBackend::SmartPlaylistsClearMaterialized);
+
 }
 
 void CollectionBackend::Init(Database *db, TaskManager *task_manager, const Song::Source source, const QString &songs_table, const QString &fts_table, const QString &dirs_table, const QString &subdirs_table) {
@@ -170,7 +191,7 @@ void CollectionBackend::ChangeDirPath(const int id, const QString &old_path, con
   // Do the dirs table
   {
     SqlQuery q(db);
-    q.prepare(QString("UPDATE %1 SET path=:path WHERE ROWID=:id").arg(dirs_table_));
+    q.PrepareCached(QString("UPDATE %1 SET path=:path WHERE ROWID=:id").arg(dirs_table_));
     q.BindValue(":path", new_path);
     q.BindValue(":id", id);
     if (!q.Exec()) {
@@ -187,8 +208,9 @@ void CollectionBackend::ChangeDirPath(const int id, const QString &old_path, con
   // Do the subdirs table
   {
     SqlQuery q(db);
-    q.prepare(QString("UPDATE %1 SET path=:path || substr(path, %2) WHERE directory=:id").arg(subdirs_table_).arg(path_len));
+    q.PrepareCached(QString("UPDATE %1 SET path=:path || substr(path, :substr_start) WHERE directory=:id").arg(subdirs_table_));
     q.BindValue(":path", new_url);
+    q.BindValue(":substr_start", path_len);
     q.BindValue(":id", id);
     if (!q.Exec()) {
       db_->ReportErrors(q);
@@ -199,8 +221,9 @@ void CollectionBackend::ChangeDirPath(const int id, const QString &old_path, con
   // Do the songs table
   {
     SqlQuery q(db);
-    q.prepare(QString("UPDATE %1 SET url=:path || substr(url, %2) WHERE directory=:id").arg(songs_table_).arg(path_len));
+    q.PrepareCached(QString("UPDATE %1 SET url=:path || substr(url, :substr_start) WHERE directory=:id").arg(songs_table_));
     q.BindValue(":path", new_url);
+    q.BindValue(":substr_start", path_len);
     q.BindValue(":id", id);
     if (!q.Exec()) {
       db_->ReportErrors(q);
@@ -208,6 +231,9 @@ void CollectionBackend::ChangeDirPath(const int id, const QString &old_path, con
     }
   }
 
+  // The file paths of all songs in the directory changed.
+  if (!SmartPlaylistsRefreshMaterialized(db, QString("SELECT ROWID FROM %1 WHERE directory = %2").arg(songs_table_).arg(id))) return;
+
   t.Commit();
 
 }
@@ -220,7 +246,7 @@ CollectionDirectoryList CollectionBackend::GetAllDirectories() {
   CollectionDirectoryList ret;
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT ROWID, path FROM %1").arg(dirs_table_));
+  q.PrepareCached(QString("SELECT ROWID, path FROM %1").arg(dirs_table_));
   if (!q.Exec()) {
     db_->ReportErrors(q);
     return ret;
@@ -248,7 +274,7 @@ CollectionSubdirectoryList CollectionBackend::SubdirsInDirectory(const int id) {
 CollectionSubdirectoryList CollectionBackend::SubdirsInDirectory(const int id, QSqlDatabase &db) {
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT path, mtime FROM %1 WHERE directory_id = :dir").arg(subdirs_table_));
+  q.PrepareCached(QString("SELECT path, mtime FROM %1 WHERE directory_id = :dir").arg(subdirs_table_));
   q.BindValue(":dir", id);
   if (!q.Exec()) {
     db_->ReportErrors(q);
@@ -274,7 +300,7 @@ void CollectionBackend::UpdateTotalSongCount() {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT COUNT(*) FROM %1 WHERE unavailable = 0").arg(songs_table_));
+  q.PrepareCached(QString("SELECT COUNT(*) FROM %1 WHERE unavailable = 0").arg(songs_table_));
   if (!q.Exec()) {
     db_->ReportErrors(q);
     return;
@@ -294,7 +320,7 @@ void CollectionBackend::UpdateTotalArtistCount() {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT COUNT(DISTINCT artist) FROM %1 WHERE unavailable = 0").arg(songs_table_));
+  q.PrepareCached(QString("SELECT COUNT(DISTINCT artist) FROM %1 WHERE unavailable = 0").arg(songs_table_));
   if (!q.Exec()) {
     db_->ReportErrors(q);
     return;
@@ -314,7 +340,7 @@ void CollectionBackend::UpdateTotalAlbumCount() {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT COUNT(*) FROM (SELECT DISTINCT effective_albumartist, album FROM %1 WHERE unavailable = 0)").arg(songs_table_));
+  q.PrepareCached(QString("SELECT COUNT(*) FROM (SELECT DISTINCT effective_albumartist, album FROM %1 WHERE unavailable = 0)").arg(songs_table_));
   if (!q.Exec()) {
     db_->ReportErrors(q);
     return;
@@ -337,7 +363,7 @@ void CollectionBackend::AddDirectory(const QString &path) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("INSERT INTO %1 (path, subdirs) VALUES (:path, 1)").arg(dirs_table_));
+  q.PrepareCached(QString("INSERT INTO %1 (path, subdirs) VALUES (:path, 1)").arg(dirs_table_));
   q.BindValue(":path", db_path);
   if (!q.Exec()) {
     db_->ReportErrors(q);
@@ -365,7 +391,7 @@ void CollectionBackend::RemoveDirectory(const CollectionDirectory &dir) {
   // Delete the subdirs that were in this directory
   {
     SqlQuery q(db);
-    q.prepare(QString("DELETE FROM %1 WHERE directory_id = :id").arg(subdirs_table_));
+    q.PrepareCached(QString("DELETE FROM %1 WHERE directory_id = :id").arg(subdirs_table_));
     q.BindValue(":id", dir.id);
     if (!q.Exec()) {
       db_->ReportErrors(q);
@@ -376,7 +402,7 @@ void CollectionBackend::RemoveDirectory(const CollectionDirectory &dir) {
   // Now remove the directory itself
   {
     SqlQuery q(db);
-    q.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(dirs_table_));
+    q.PrepareCached(QString("DELETE FROM %1 WHERE ROWID = :id").arg(dirs_table_));
     q.BindValue(":id", dir.id);
     if (!q.Exec()) {
       db_->ReportErrors(q);
@@ -396,7 +422,7 @@ SongList CollectionBackend::FindSongsInDirectory(const int id) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE directory_id = :directory_id").arg(songs_table_));
+  q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE directory_id = :directory_id").arg(songs_table_));
   q.BindValue(":directory_id", id);
   if (!q.Exec()) {
     db_->ReportErrors(q);
@@ -419,7 +445,7 @@ SongList CollectionBackend::SongsWithMissingFingerprint(const int id) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE directory_id = :directory_id AND unavailable = 0 AND (fingerprint IS NULL OR fingerprint = '')").arg(songs_table_));
+  q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE directory_id = :directory_id AND unavailable = 0 AND (fingerprint IS NULL OR fingerprint = '')").arg(songs_table_));
   q.BindValue(":directory_id", id);
   if (!q.Exec()) {
     db_->ReportErrors(q);
@@ -462,7 +488,7 @@ void CollectionBackend::AddOrUpdateSubdirs(const CollectionSubdirectoryList &sub
     if (subdir.mtime == 0) {
       // Delete the subdirectory
       SqlQuery q(db);
-      q.prepare(QString("DELETE FROM %1 WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
+      q.PrepareCached(QString("DELETE FROM %1 WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
       q.BindValue(":id", subdir.directory_id);
       q.BindValue(":path", subdir.path);
       if (!q.Exec()) {
@@ -475,7 +501,7 @@ void CollectionBackend::AddOrUpdateSubdirs(const CollectionSubdirectoryList &sub
       bool exists = false;
       {
         SqlQuery q(db);
-        q.prepare(QString("SELECT ROWID FROM %1 WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
+        q.PrepareCached(QString("SELECT ROWID FROM %1 WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
         q.BindValue(":id", subdir.directory_id);
         q.BindValue(":path", subdir.path);
         if (!q.Exec()) {
@@ -487,7 +513,7 @@ void CollectionBackend::AddOrUpdateSubdirs(const CollectionSubdirectoryList &sub
 
       if (exists) {
         SqlQuery q(db);
-        q.prepare(QString("UPDATE %1 SET mtime = :mtime WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
+        q.PrepareCached(QString("UPDATE %1 SET mtime = :mtime WHERE directory_id = :id AND path = :path").arg(subdirs_table_));
         q.BindValue(":mtime", subdir.mtime);
         q.BindValue(":id", subdir.directory_id);
         q.BindValue(":path", subdir.path);
@@ -498,7 +524,7 @@ void CollectionBackend::AddOrUpdateSubdirs(const CollectionSubdirectoryList &sub
       }
       else {
         SqlQuery q(db);
-        q.prepare(QString("INSERT INTO %1 (directory_id, path, mtime) VALUES (:id, :path, :mtime)").arg(subdirs_table_));
+        q.PrepareCached(QString("INSERT INTO %1 (directory_id, path, mtime) VALUES (:id, :path, :mtime)").arg(subdirs_table_));
         q.BindValue(":id", subdir.directory_id);
         q.BindValue(":path", subdir.path);
         q.BindValue(":mtime", subdir.mtime);
@@ -520,7 +546,7 @@ SongList CollectionBackend::GetAllSongs() {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1").arg(songs_table_));
+  q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1").arg(songs_table_));
   if (!q.Exec()) {
     db_->ReportErrors(q);
     return SongList();
@@ -545,146 +571,236 @@ void CollectionBackend::AddOrUpdateSongs(const SongList &songs) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  ScopedTransaction transaction(&db);
+  const bool bulk_insert = songs.count() >= kBulkInsertMinSongs;
+
+  ScopedTransaction transaction(&db, bulk_insert);
+
+  // Prepare the statements once and re-use them for all songs.
+  SqlQuery check_dir(db);
+  if (!dirs_table_.isEmpty()) {
+    check_dir.PrepareCached(QString("SELECT ROWID FROM %1 WHERE ROWID = :id").arg(dirs_table_));
+  }
+  SqlQuery update_song(db);
+  update_song.PrepareCached(QString("UPDATE %1 SET " + Song::kUpdateSpec + " WHERE ROWID = :id").arg(songs_table_));
+  SqlQuery update_fts(db);
+  update_fts.PrepareCached(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec + " WHERE ROWID = :id").arg(fts_table_));
+
+  QMap<int, bool> directories;
 
   SongList added_songs;
   SongList deleted_songs;
+  SongList new_songs;
+  // Where the new songs are in added_songs, so they are reported in the order they were given.
+  QList<int> new_songs_index;
+  // The new songs by song ID, they aren't in the database before the loop is done.
+  QHash<QString, int> new_song_ids;
 
   for (const Song &song : songs) {
 
     // Do a sanity check first - make sure the song's directory still exists
     // This is to fix a possible race condition when a directory is removed while CollectionWatcher is scanning it.
     if (!dirs_table_.isEmpty()) {
-      SqlQuery check_dir(db);
-      check_dir.prepare(QString("SELECT ROWID FROM %1 WHERE ROWID = :id").arg(dirs_table_));
-      check_dir.BindValue(":id", song.directory_id());
-      if (!check_dir.Exec()) {
-        db_->ReportErrors(check_dir);
-        return;
+      if (!directories.contains(song.directory_id())) {
+        check_dir.BindValue(":id", song.directory_id());
+        if (!check_dir.Exec()) {
+          db_->ReportErrors(check_dir);
+          return;
+        }
+        directories.insert(song.directory_id(), check_dir.next());
       }
 
-      if (!check_dir.next()) continue;
+      if (!directories.value(song.directory_id())) continue;
 
     }
 
+    Song old_song;
     if (song.id() != -1) {  // This song exists in the DB.
-
       // Get the previous song data first
-      Song old_song(GetSongById(song.id()));
+      old_song = GetSongById(song.id(), db);
       if (!old_song.is_valid()) continue;
-
-      // Update
-      {
-        SqlQuery q(db);
-        q.prepare(QString("UPDATE %1 SET " + Song::kUpdateSpec + " WHERE ROWID = :id").arg(songs_table_));
-        song.BindToQuery(&q);
-        q.BindValue(":id", song.id());
-        if (!q.Exec()) {
-          db_->ReportErrors(q);
-          return;
-        }
+    }
+    else if (!song.song_id().isEmpty()) {  // Song has a unique id, check if the song exists.
+      if (new_song_ids.contains(song.song_id())) {
+        // Added earlier in this call, the later song replaces it before it is inserted.
+        const int i = new_song_ids.value(song.song_id());
+        new_songs[i] = song;
+        added_songs[new_songs_index[i]] = song;
+        continue;
       }
-
-      {
-        SqlQuery q(db);
-        q.prepare(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec + " WHERE ROWID = :id").arg(fts_table_));
-        song.BindToFtsQuery(&q);
-        q.BindValue(":id", song.id());
-        if (!q.Exec()) {
-          db_->ReportErrors(q);
-          return;
-        }
+      old_song = GetSongBySongId(song.song_id(), db);
+      if (!old_song.is_valid() || old_song.id() == -1) {
+        new_song_ids.insert(song.song_id(), static_cast<int>(new_songs.count()));
+        new_songs_index << static_cast<int>(added_songs.count());
+        added_songs << song;
+        new_songs << song;
+        continue;
       }
-
-      deleted_songs << old_song;
+    }
+    else {
+      new_songs_index << static_cast<int>(added_songs.count());
       added_songs << song;
-
+      new_songs << song;
       continue;
+    }
+
+    Song new_song = song;
+    new_song.set_id(old_song.id());
 
+    // Update
+    new_song.BindToQuery(&update_song);
+    update_song.BindValue(":id", new_song.id());
+    if (!update_song.Exec()) {
+      db_->ReportErrors(update_song);
+      return;
     }
-    else if (!song.song_id().isEmpty()) {  // Song has a unique id, check if the song exists.
 
-      // Get the previous song data first
-      Song old_song(GetSongBySongId(song.song_id()));
+    new_song.BindToFtsQuery(&update_fts);
+    update_fts.BindValue(":id", new_song.id());
+    if (!update_fts.Exec()) {
+      db_->ReportErrors(update_fts);
+      return;
+    }
 
-      if (old_song.is_valid() && old_song.id() != -1) {
+    deleted_songs << old_song;
+    added_songs << new_song;
 
-        Song new_song = song;
-        new_song.set_id(old_song.id());
+  }
 
-        // Update
-        {
-          SqlQuery q(db);
-          q.prepare(QString("UPDATE %1 SET " + Song::kUpdateSpec + " WHERE ROWID = :id").arg(songs_table_));
-          new_song.BindToQuery(&q);
-          q.BindValue(":id", new_song.id());
-          if (!q.Exec()) {
-            db_->ReportErrors(q);
-            return;
-          }
-        }
+  // Create new songs
+  QList<int> new_ids;
+  if (!(bulk_insert ? BulkInsertSongs(db, new_songs, &new_ids) : InsertSongs(db, new_songs, &new_ids))) return;
+  for (int i = 0; i < new_ids.count(); ++i) {
+    added_songs[new_songs_index[i]].set_id(new_ids[i]);
+  }
 
-        {
-          SqlQuery q(db);
-          q.prepare(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec + " WHERE ROWID = :id").arg(fts_table_));
-          new_song.BindToFtsQuery(&q);
-          q.BindValue(":id", new_song.id());
-          if (!q.Exec()) {
-            db_->ReportErrors(q);
-            return;
-          }
-        }
+  transaction.Commit();
 
-        deleted_songs << old_song;
-        added_songs << new_song;
+  if (!deleted_songs.isEmpty()) emit SongsDeleted(deleted_songs);
+  if (!added_songs.isEmpty()) emit SongsDiscovered(added_songs);
 
-        continue;
-      }
-    }
+  UpdateTotalSongCountAsync();
+  UpdateTotalArtistCountAsync();
+  UpdateTotalAlbumCountAsync();
 
-    // Create new song
+}
 
-    int id = -1;
-    {  // Insert the row and create a new ID
-      SqlQuery q(db);
-      q.prepare(QString("INSERT INTO %1 (" + Song::kColumnSpec + ") VALUES (" + Song::kBindSpec + ")").arg(songs_table_));
-      song.BindToQuery(&q);
-      if (!q.Exec()) {
-        db_->ReportErrors(q);
-        return;
-      }
-      // Get the new ID
-      id = q.lastInsertId().toInt();
+bool CollectionBackend::InsertSongs(QSqlDatabase &db, const SongList &songs, QList<int> *ids) {
+
+  if (songs.isEmpty()) return true;
+
+  SqlQuery insert_song(db);
+  insert_song.PrepareCached(QString("INSERT INTO %1 (" + Song::kColumnSpec + ") VALUES (" + Song::kBindSpec + ")").arg(songs_table_));
+  SqlQuery insert_fts(db);
+  insert_fts.PrepareCached(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec + ") VALUES (:id, " + Song::kFtsBindSpec + ")").arg(fts_table_));
+
+  for (const Song &song : songs) {
+
+    // Insert the row and create a new ID
+    song.BindToQuery(&insert_song);
+    if (!insert_song.Exec()) {
+      db_->ReportErrors(insert_song);
+      return false;
+    }
+    // Get the new ID
+    const int id = insert_song.lastInsertId().toInt();
+    if (id == -1) return false;
+
+    // Add to the FTS index
+    insert_fts.BindValue(":id", id);
+    song.BindToFtsQuery(&insert_fts);
+    if (!insert_fts.Exec()) {
+      db_->ReportErrors(insert_fts);
+      return false;
     }
 
-    if (id == -1) return;
+    *ids << id;
 
-    {  // Add to the FTS index
-      SqlQuery q(db);
-      q.prepare(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec + ") VALUES (:id, " + Song::kFtsBindSpec + ")").arg(fts_table_));
-      q.BindValue(":id", id);
-      song.BindToFtsQuery(&q);
-      if (!q.Exec()) {
-        db_->ReportErrors(q);
-        return;
+  }
+
+  return true;
+
+}
+
+bool CollectionBackend::BulkInsertSongs(QSqlDatabase &db, const SongList &songs, QList<int> *ids) {
+
+  if (songs.isEmpty()) return true;
+
+  // The row IDs are given explicitly, so they are known without reading them back.
+  // The caller holds the database mutex in a transaction, so nobody else can take them.
+  SqlQuery max_id(db);
+  max_id.PrepareCached(QString("SELECT IFNULL(MAX(ROWID), 0) FROM %1").arg(songs_table_));
+  if (!max_id.Exec() || !max_id.next()) {
+    db_->ReportErrors(max_id);
+    return false;
+  }
+  const qint64 first_id = max_id.value(0).toLongLong() + 1;
+  if (first_id + songs.count() > std::numeric_limits<int>::max()) {
+    // Song IDs are ints, let SQLite find free row IDs.
+    return InsertSongs(db, songs, ids);
+  }
+
+  // Insert as many rows per statement as the SQLite host parameter limit allows.
+  if (!BulkInsert(db, songs_table_, "ROWID, " + Song::kColumnSpec, QStringList() << ":id" << Utilities::Prepend(":", Song::kColumns), songs, static_cast<int>(first_id), [](SqlQuery *q, const Song &song) { song.BindToQuery(q); })) {
+    return false;
+  }
+
+  // Populate the FTS index the same way instead of once per song.
+  if (!BulkInsert(db, fts_table_, "ROWID, " + Song::kFtsColumnSpec, QStringList() << ":id" << Utilities::Prepend(":", Song::kFtsColumns), songs, static_cast<int>(first_id), [](SqlQuery *q, const Song &song) { song.BindToFtsQuery(q); })) {
+    return false;
+  }
+
+  ids->reserve(ids->count() + songs.count());
+  for (int i = 0; i < songs.count(); ++i) {
+    *ids << static_cast<int>(first_id) + i;
+  }
+
+  return true;
+
+}
+
+bool CollectionBackend::BulkInsert(QSqlDatabase &db, const QString &table, const QString &column_spec, const QStringList &placeholders, const SongList &songs, const int first_id, const std::function<void(SqlQuery*, const Song&)> &bind) {
+
+  const int rows_per_query = std::max(1, kBulkInsertMaxVariables / static_cast<int>(placeholders.count()));
+
+  SqlQuery q(db);
+  int prepared_rows = 0;
+
+  for (int i = 0; i < songs.count(); i += rows_per_query) {
+    const int rows = std::min(rows_per_query, static_cast<int>(songs.count()) - i);
+    if (rows != prepared_rows) {
+      QStringList values;
+      values.reserve(rows);
+      for (int row = 0; row < rows; ++row) {
+        QStringList row_placeholders;
+        row_placeholders.reserve(placeholders.count());
+        for (const QString &placeholder : placeholders) {
+          row_placeholders << placeholder + BulkInsertSuffix(row);
+        }
+        values << "(" + row_placeholders.join(", ") + ")";
       }
+      q.PrepareCached(QString("INSERT INTO %1 (" + column_spec + ") VALUES " + values.join(", ")).arg(table));
+      prepared_rows = rows;
     }
 
-    Song song_copy(song);
-    song_copy.set_id(id);
-    added_songs << song_copy;
+    for (int row = 0; row < rows; ++row) {
+      q.SetPlaceholderSuffix(BulkInsertSuffix(row));
+      q.BindValue(":id", first_id + i + row);
+      bind(&q, songs[i + row]);
+    }
+    q.SetPlaceholderSuffix(QString());
 
+    if (!q.Exec()) {
+      db_->ReportErrors(q);
+      return false;
+    }
   }
 
-  transaction.Commit();
-
-  if (!deleted_songs.isEmpty()) emit SongsDeleted(deleted_songs);
-  if (!added_songs.isEmpty()) emit SongsDiscovered(added_songs);
+  return true;
 
-  UpdateTotalSongCountAsync();
-  UpdateTotalArtistCountAsync();
-  UpdateTotalAlbumCountAsync();
+}
 
+QString CollectionBackend::BulkInsertSuffix(const int row) {
+  return QString("_%1_").arg(row);
 }
 
 void CollectionBackend::UpdateSongsBySongIDAsync(const SongMap &new_songs) {
@@ -722,7 +838,7 @@ void CollectionBackend::UpdateSongsBySongID(const SongMap &new_songs) {
 
         {
           SqlQuery q(db);
-          q.prepare(QString("UPDATE %1 SET " + Song::kUpdateSpec + " WHERE ROWID = :id").arg(songs_table_));
+          q.PrepareCached(QString("UPDATE %1 SET " + Song::kUpdateSpec + " WHERE ROWID = :id").arg(songs_table_));
           new_song.BindToQuery(&q);
           q.BindValue(":id", old_song.id());
           if (!q.Exec()) {
@@ -732,7 +848,7 @@ void CollectionBackend::UpdateSongsBySongID(const SongMap &new_songs) {
         }
         {
           SqlQuery q(db);
-          q.prepare(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec + " WHERE ROWID = :id").arg(fts_table_));
+          q.PrepareCached(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec + " WHERE ROWID = :id").arg(fts_table_));
           new_song.BindToFtsQuery(&q);
           q.BindValue(":id", old_song.id());
           if (!q.Exec()) {
@@ -753,7 +869,7 @@ void CollectionBackend::UpdateSongsBySongID(const SongMap &new_songs) {
       int id = -1;
       {
         SqlQuery q(db);
-        q.prepare(QString("INSERT INTO %1 (" + Song::kColumnSpec + ") VALUES (" + Song::kBindSpec + ")").arg(songs_table_));
+        q.PrepareCached(QString("INSERT INTO %1 (" + Song::kColumnSpec + ") VALUES (" + Song::kBindSpec + ")").arg(songs_table_));
         new_song.BindToQuery(&q);
         if (!q.Exec()) {
           db_->ReportErrors(q);
@@ -767,7 +883,7 @@ void CollectionBackend::UpdateSongsBySongID(const SongMap &new_songs) {
 
       {  // Add to the FTS index
         SqlQuery q(db);
-        q.prepare(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec + ") VALUES (:id, " + Song::kFtsBindSpec + ")").arg(fts_table_));
+        q.PrepareCached(QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec + ") VALUES (:id, " + Song::kFtsBindSpec + ")").arg(fts_table_));
         q.BindValue(":id", id);
         new_song.BindToFtsQuery(&q);
         if (!q.Exec()) {
@@ -788,7 +904,7 @@ void CollectionBackend::UpdateSongsBySongID(const SongMap &new_songs) {
     if (!new_songs.contains(old_song.song_id())) {
       {
         SqlQuery q(db);
-        q.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_));
+        q.PrepareCached(QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_));
         q.BindValue(":id", old_song.id());
         if (!q.Exec()) {
           db_->ReportErrors(q);
@@ -797,7 +913,7 @@ void CollectionBackend::UpdateSongsBySongID(const SongMap &new_songs) {
       }
       {
         SqlQuery q(db);
-        q.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(fts_table_));
+        q.PrepareCached(QString("DELETE FROM %1 WHERE ROWID = :id").arg(fts_table_));
         q.BindValue(":id", old_song.id());
         if (!q.Exec()) {
           db_->ReportErrors(q);
@@ -825,7 +941,7 @@ void CollectionBackend::UpdateMTimesOnly(const SongList &songs) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("UPDATE %1 SET mtime = :mtime WHERE ROWID = :id").arg(songs_table_));
+  q.PrepareCached(QString("UPDATE %1 SET mtime = :mtime WHERE ROWID = :id").arg(songs_table_));
 
   ScopedTransaction transaction(&db);
   for (const Song &song : songs) {
@@ -836,6 +952,7 @@ void CollectionBackend::UpdateMTimesOnly(const SongList &songs) {
       return;
     }
   }
+  if (!SmartPlaylistsRefreshMaterialized(db, SongIdList(songs))) return;
   transaction.Commit();
 
 }
@@ -846,9 +963,9 @@ void CollectionBackend::DeleteSongs(const SongList &songs) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery remove(db);
-  remove.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_));
+  remove.PrepareCached(QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_));
   SqlQuery remove_fts(db);
-  remove_fts.prepare(QString("DELETE FROM %1 WHERE ROWID = :id").arg(fts_table_));
+  remove_fts.PrepareCached(QString("DELETE FROM %1 WHERE ROWID = :id").arg(fts_table_));
 
   ScopedTransaction transaction(&db);
   for (const Song &song : songs) {
@@ -880,10 +997,11 @@ void CollectionBackend::MarkSongsUnavailable(const SongList &songs, const bool u
   QSqlDatabase db(db_->Connect());
 
   SqlQuery remove(db);
-  remove.prepare(QString("UPDATE %1 SET unavailable = %2 WHERE ROWID = :id").arg(songs_table_).arg(static_cast<int>(unavailable)));
+  remove.PrepareCached(QString("UPDATE %1 SET unavailable = :unavailable WHERE ROWID = :id").arg(songs_table_));
 
   ScopedTransaction transaction(&db);
   for (const Song &song : songs) {
+    remove.BindBoolValue(":unavailable", unavailable);
     remove.BindValue(":id", song.id());
     if (!remove.Exec()) {
       db_->ReportErrors(remove);
@@ -1125,9 +1243,20 @@ SongList CollectionBackend::GetSongsByForeignId(const QStringList &ids, const QS
 
 Song CollectionBackend::GetSongById(const int id, QSqlDatabase &db) {
 
-  SongList list = GetSongsById(QStringList() << QString::number(id), db);
-  if (list.isEmpty()) return Song();
-  return list.first();
+  // Bind the ID instead of using GetSongsById() so the prepared statement is re-used from the statement cache.
+  SqlQuery q(db);
+  q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE ROWID = :id").arg(songs_table_));
+  q.BindValue(":id", id);
+  if (!q.Exec()) {
+    db_->ReportErrors(q);
+    return Song();
+  }
+
+  if (!q.next()) return Song();
+
+  Song song(source_);
+  song.InitFromQuery(q, true);
+  return song;
 
 }
 
@@ -1158,7 +1287,7 @@ Song CollectionBackend::GetSongByUrl(const QUrl &url, const qint64 beginning) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE (url = :url1 OR url = :url2 OR url = :url3 OR url = :url4) AND beginning = :beginning AND unavailable = 0").arg(songs_table_));
+  q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE (url = :url1 OR url = :url2 OR url = :url3 OR url = :url4) AND beginning = :beginning AND unavailable = 0").arg(songs_table_));
 
   q.BindValue(":url1", url);
   q.BindValue(":url2", url.toString());
@@ -1188,7 +1317,7 @@ SongList CollectionBackend::GetSongsByUrl(const QUrl &url, const bool unavailabl
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE (url = :url1 OR url = :url2 OR url = :url3 OR url = :url4) AND unavailable = :unavailable").arg(songs_table_));
+  q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE (url = :url1 OR url = :url2 OR url = :url3 OR url = :url4) AND unavailable = :unavailable").arg(songs_table_));
 
   q.BindValue(":url1", url);
   q.BindValue(":url2", url.toString());
@@ -1271,7 +1400,7 @@ SongList CollectionBackend::GetSongsByFingerprint(const QString &fingerprint) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE fingerprint = :fingerprint").arg(songs_table_));
+  q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE fingerprint = :fingerprint").arg(songs_table_));
   q.BindValue(":fingerprint", fingerprint);
   if (!q.Exec()) {
     db_->ReportErrors(q);
@@ -1327,7 +1456,7 @@ void CollectionBackend::CompilationsNeedUpdating() {
   // Look for albums that have songs by more than one 'effective album artist' in the same directory
 
   SqlQuery q(db);
-  q.prepare(QString("SELECT effective_albumartist, album, url, compilation_detected FROM %1 WHERE unavailable = 0 ORDER BY album").arg(songs_table_));
+  q.PrepareCached(QString("SELECT effective_albumartist, album, url, compilation_detected FROM %1 WHERE unavailable = 0 ORDER BY album").arg(songs_table_));
   if (!q.Exec()) {
     db_->ReportErrors(q);
     return;
@@ -1394,7 +1523,7 @@ bool CollectionBackend::UpdateCompilations(const QSqlDatabase &db, SongList &del
 
   {  // Get song, so we can tell the model its updated
     SqlQuery q(db);
-    q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE (url = :url1 OR url = :url2 OR url = :url3 OR url = :url4) AND unavailable = 0").arg(songs_table_));
+    q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE (url = :url1 OR url = :url2 OR url = :url3 OR url = :url4) AND unavailable = 0").arg(songs_table_));
     q.BindValue(":url1", url);
     q.BindValue(":url2", url.toString());
     q.BindValue(":url3", url.toString(QUrl::FullyEncoded));
@@ -1416,7 +1545,7 @@ bool CollectionBackend::UpdateCompilations(const QSqlDatabase &db, SongList &del
 
   // Update the song
   SqlQuery q(db);
-  q.prepare(QString("UPDATE %1 SET compilation_detected = :compilation_detected, compilation_effective = ((compilation OR :compilation_detected OR compilation_on) AND NOT compilation_off) + 0 WHERE (url = :url1 OR url = :url2 OR url = :url3 OR url = :url4) AND unavailable = 0").arg(songs_table_));
+  q.PrepareCached(QString("UPDATE %1 SET compilation_detected = :compilation_detected, compilation_effective = ((compilation OR :compilation_detected OR compilation_on) AND NOT compilation_off) + 0 WHERE (url = :url1 OR url = :url2 OR url = :url3 OR url = :url4) AND unavailable = 0").arg(songs_table_));
   q.BindValue(":compilation_detected", static_cast<int>(compilation_detected));
   q.BindValue(":url1", url);
   q.BindValue(":url2", url.toString());
@@ -1580,7 +1709,7 @@ void CollectionBackend::UpdateManualAlbumArt(const QString &effective_albumartis
   sql += " WHERE effective_albumartist = :effective_albumartist AND album = :album AND unavailable = 0";
 
   SqlQuery q(db);
-  q.prepare(sql);
+  q.PrepareCached(sql);
   q.BindValue(":cover", cover_url.isValid() ? cover_url.toString(QUrl::FullyEncoded) : "");
   q.BindValue(":effective_albumartist", effective_albumartist);
   q.BindValue(":album", album);
@@ -1647,7 +1776,7 @@ void CollectionBackend::UpdateAutomaticAlbumArt(const QString &effective_albumar
   sql += " WHERE effective_albumartist = :effective_albumartist AND album = :album AND unavailable = 0";
 
   SqlQuery q(db);
-  q.prepare(sql);
+  q.PrepareCached(sql);
   q.BindValue(":cover", cover_url.isValid() ? cover_url.toString(QUrl::FullyEncoded) : "");
   q.BindValue(":effective_albumartist", effective_albumartist);
   q.BindValue(":album", album);
@@ -1706,7 +1835,7 @@ void CollectionBackend::ForceCompilation(const QString &album, const QList<QStri
     if (!artist.isEmpty()) sql += " AND artist = :artist";
 
     SqlQuery q(db);
-    q.prepare(sql);
+    q.PrepareCached(sql);
     q.BindValue(":compilation_on", on ? 1 : 0);
     q.BindValue(":compilation_off", on ? 0 : 1);
     q.BindValue(":album", album);
@@ -1745,7 +1874,7 @@ void CollectionBackend::IncrementPlayCount(const int id) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("UPDATE %1 SET playcount = playcount + 1, lastplayed = :now WHERE ROWID = :id").arg(songs_table_));
+  q.PrepareCached(QString("UPDATE %1 SET playcount = playcount + 1, lastplayed = :now WHERE ROWID = :id").arg(songs_table_));
   q.BindValue(":now", QDateTime::currentDateTime().toSecsSinceEpoch());
   q.BindValue(":id", id);
   if (!q.Exec()) {
@@ -1768,7 +1897,7 @@ void CollectionBackend::IncrementSkipCount(const int id, const float progress) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("UPDATE %1 SET skipcount = skipcount + 1 WHERE ROWID = :id").arg(songs_table_));
+  q.PrepareCached(QString("UPDATE %1 SET skipcount = skipcount + 1 WHERE ROWID = :id").arg(songs_table_));
   q.BindValue(":id", id);
   if (!q.Exec()) {
     db_->ReportErrors(q);
@@ -1814,7 +1943,7 @@ bool CollectionBackend::ResetPlayStatistics(const QStringList &id_str_list) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare(QString("UPDATE %1 SET playcount = 0, skipcount = 0, lastplayed = -1 WHERE ROWID IN (:ids)").arg(songs_table_));
+  q.PrepareCached(QString("UPDATE %1 SET playcount = 0, skipcount = 0, lastplayed = -1 WHERE ROWID IN (:ids)").arg(songs_table_));
   q.BindValue(":ids", id_str_list.join(","));
   if (!q.Exec()) {
     db_->ReportErrors(q);
@@ -1840,7 +1969,7 @@ void CollectionBackend::DeleteAll() {
 
     {
       SqlQuery q(db);
-      q.prepare("DELETE FROM " + songs_table_);
+      q.PrepareCached("DELETE FROM " + songs_table_);
       if (!q.Exec()) {
         db_->ReportErrors(q);
         return;
@@ -1849,7 +1978,7 @@ void CollectionBackend::DeleteAll() {
 
     {
       SqlQuery q(db);
-      q.prepare("DELETE FROM " + fts_table_);
+      q.PrepareCached("DELETE FROM " + fts_table_);
       if (!q.Exec()) {
         db_->ReportErrors(q);
         return;
@@ -1865,11 +1994,30 @@ void CollectionBackend::DeleteAll() {
 
 SongList CollectionBackend::SmartPlaylistsFindSongs(const SmartPlaylistSearch &search) {
 
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QString materialized_search = search.materialized_ ? SmartPlaylistsMaterialize(search) : QString();
+
+  // Picking a few random songs shouldn't sort the whole collection.
+  if (search.sort_type_ == SmartPlaylistSearch::SortType::Random && search.limit_ > 0 && materialized_search.isEmpty()) {
+    SongList songs;
+    {
+      DatabaseReadLocker l(db_);
+      QSqlDatabase db(l.db());
+      if (SmartPlaylistsSampleSongs(db, search, &songs)) return songs;
+    }
+    // Too few of the ROWIDs are matching songs, pick from the songs kept for the search instead, there are only as many as there are matches.
+    materialized_search = SmartPlaylistsMaterialize(search);
+    if (materialized_search.isEmpty()) {
+      DatabaseReadLocker l(db_);
+      QSqlDatabase db(l.db());
+      if (SmartPlaylistsSampleSongIds(db, search, &songs)) return songs;
+    }
+  }
+
+  DatabaseReadLocker l(db_);
+  QSqlDatabase db(l.db());
 
   // Build the query
-  QString sql = search.ToSql(songs_table());
+  QString sql = search.ToSql(songs_table(), materialized_search);
 
   // Run the query
   SongList ret;
@@ -1890,6 +2038,305 @@ SongList CollectionBackend::SmartPlaylistsFindSongs(const SmartPlaylistSearch &s
 
 }
 
+bool CollectionBackend::SmartPlaylistsSampleRange(QSqlDatabase &db, int *min_id, int *max_id) {
+
+  SqlQuery range_query(db);
+  range_query.PrepareCached(QString("SELECT MIN(ROWID), MAX(ROWID) FROM %1").arg(songs_table_));
+  if (!range_query.Exec()) {
+    db_->ReportErrors(range_query);
+    return false;
+  }
+  if (!range_query.next() || range_query.value(0).isNull()) {
+    *min_id = 0;
+    *max_id = -1;
+    return true;
+  }
+
+  *min_id = range_query.value(0).toInt();
+  *max_id = range_query.value(1).toInt();
+
+  return true;
+
+}
+
+bool CollectionBackend::SmartPlaylistsSampleSongs(QSqlDatabase &db, const SmartPlaylistSearch &search, SongList *songs) {
+
+  int min_id = 0;
+  int max_id = 0;
+  if (!SmartPlaylistsSampleRange(db, &min_id, &max_id)) return false;
+  if (max_id < min_id) return true;
+
+  QSet<int> excluded_ids;
+  excluded_ids.reserve(search.id_not_in_.count() + search.limit_);
+  for (const int id : search.id_not_in_) excluded_ids.insert(id);
+
+  // Probe random ROWIDs and keep the ones that are matching songs not used before.
+  // Every probe is one index lookup, and every matching song is as likely to be picked as with ORDER BY random().
+  SqlQuery query(db);
+  query.prepare(search.ToSampleSql(songs_table_));
+  int misses = 0;
+  while (songs->count() < search.limit_ && misses <= kSmartPlaylistsMaxSampleMisses) {
+    const int id = QRandomGenerator::global()->bounded(min_id, max_id + 1);
+    if (excluded_ids.contains(id)) {
+      ++misses;
+      continue;
+    }
+    query.BindValue(":rowid", id);
+    if (!query.Exec()) {
+      db_->ReportErrors(query);
+      return false;
+    }
+    if (!query.next()) {
+      ++misses;
+      continue;
+    }
+    Song song;
+    song.InitFromQuery(query, true);
+    excluded_ids.insert(id);
+    *songs << song;
+  }
+
+  return songs->count() >= search.limit_;
+
+}
+
+bool CollectionBackend::SmartPlaylistsSampleSongIds(QSqlDatabase &db, const SmartPlaylistSearch &search, SongList *songs) {
+
+  int min_id = 0;
+  int max_id = 0;
+  if (!SmartPlaylistsSampleRange(db, &min_id, &max_id)) return false;
+  if (max_id < min_id) return true;
+
+  QSet<int> picked_ids;
+  picked_ids.reserve(search.limit_);
+  for (const Song &song : *songs) picked_ids.insert(song.id());
+
+  // Read the ROWIDs of a limited number of matching songs, starting from a random ROWID and wrapping around to the first one.
+  // With fewer matching songs than that, all of them are read and every song is as likely to be picked.
+  const int start_id = QRandomGenerator::global()->bounded(min_id, max_id + 1);
+  const QList<QPair<int, int>> ranges = QList<QPair<int, int>>() << qMakePair(start_id, max_id + 1) << qMakePair(min_id, start_id);
+  QList<int> ids;
+  SqlQuery ids_query(db);
+  ids_query.prepare(search.ToSampleIdsSql(songs_table_));
+  for (const QPair<int, int> &range : ranges) {
+    if (ids.count() >= kSmartPlaylistsMaxSampleIds) break;
+    ids_query.BindValue(":min_rowid", range.first);
+    ids_query.BindValue(":max_rowid", range.second);
+    ids_query.BindValue(":limit", kSmartPlaylistsMaxSampleIds - ids.count());
+    if (!ids_query.Exec()) {
+      db_->ReportErrors(ids_query);
+      return false;
+    }
+    while (ids_query.next()) {
+      const int id = ids_query.value(0).toInt();
+      if (!picked_ids.contains(id)) ids << id;
+    }
+  }
+
+  SqlQuery query(db);
+  query.prepare(search.ToSampleSql(songs_table_));
+  while (songs->count() < search.limit_ && !ids.isEmpty()) {
+    const int i = QRandomGenerator::global()->bounded(ids.count());
+    const int id = ids[i];
+    ids[i] = ids.last();
+    ids.removeLast();
+    query.BindValue(":rowid", id);
+    if (!query.Exec()) {
+      db_->ReportErrors(query);
+      return false;
+    }
+    if (!query.next()) continue;
+    Song song;
+    song.InitFromQuery(query, true);
+    *songs << song;
+  }
+
+  return true;
+
+}
+
+QString CollectionBackend::SmartPlaylistsMaterialize(const SmartPlaylistSearch &search) {
+
+  const QString where_clause = search.MaterializedWhereClause();
+  if (where_clause.isEmpty()) return QString();
+
+  // The songs kept only depend on the table and the where clause, smart playlists with the same terms share them.
+  const QString materialized_search = QString::fromLatin1(QCryptographicHash::hash(QString(songs_table_ + "|" + where_clause).toUtf8(), QCryptographicHash::Sha1).toHex());
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  const qint64 now = QDateTime::currentDateTime().toSecsSinceEpoch();
+
+  if (smart_playlists_materialized_.contains(materialized_search)) {
+    // Keep it from being dropped for as long as it is used.
+    SqlQuery q(db);
+    q.PrepareCached("UPDATE smart_playlists_materialized SET last_used = :last_used WHERE search = :search");
+    q.BindValue(":last_used", now);
+    q.BindValue(":search", materialized_search);
+    if (!q.Exec()) {
+      db_->ReportErrors(q);
+      return QString();
+    }
+    if (q.numRowsAffected() > 0) return materialized_search;
+    // Dropped after it was last used, so it has to be filled again.
+    smart_playlists_materialized_.remove(materialized_search);
+  }
+
+  ScopedTransaction transaction(&db);
+
+  // Drop the searches no smart playlist used for a long time, they are still updated with every change.
+  {
+    SqlQuery q(db);
+    q.PrepareCached("DELETE FROM smart_playlists_songs WHERE search IN (SELECT search FROM smart_playlists_materialized WHERE last_used < :last_used)");
+    q.BindValue(":last_used", now - kSmartPlaylistsMaterializedMaxAge);
+    if (!q.Exec()) {
+      db_->ReportErrors(q);
+      return QString();
+    }
+  }
+  {
+    SqlQuery q(db);
+    q.PrepareCached("DELETE FROM smart_playlists_materialized WHERE last_used < :last_used");
+    q.BindValue(":last_used", now - kSmartPlaylistsMaterializedMaxAge);
+    if (!q.Exec()) {
+      db_->ReportErrors(q);
+      return QString();
+    }
+  }
+
+  SqlQuery q(db);
+  q.PrepareCached("UPDATE smart_playlists_materialized SET last_used = :last_used WHERE search = :search");
+  q.BindValue(":last_used", now);
+  q.BindValue(":search", materialized_search);
+  if (!q.Exec()) {
+    db_->ReportErrors(q);
+    return QString();
+  }
+
+  if (q.numRowsAffected() == 0) {
+    SqlQuery insert_search(db);
+    insert_search.PrepareCached("INSERT INTO smart_playlists_materialized (search, songs_table, where_clause, last_used) VALUES (:search, :songs_table, :where_clause, :last_used)");
+    insert_search.BindValue(":search", materialized_search);
+    insert_search.BindValue(":songs_table", songs_table_);
+    insert_search.BindValue(":where_clause", where_clause);
+    insert_search.BindValue(":last_used", now);
+    if (!insert_search.Exec()) {
+      db_->ReportErrors(insert_search);
+      return QString();
+    }
+
+    SqlQuery insert_songs(db);
+    insert_songs.prepare("INSERT INTO smart_playlists_songs (search, song_id) SELECT :search, ROWID FROM " + songs_table_ + " WHERE " + where_clause);
+    insert_songs.BindValue(":search", materialized_search);
+    if (!insert_songs.Exec()) {
+      db_->ReportErrors(insert_songs);
+      return QString();
+    }
+  }
+
+  transaction.Commit();
+
+  smart_playlists_materialized_.insert(materialized_search);
+
+  return materialized_search;
+
+}
+
+QString CollectionBackend::SongIdList(const SongList &songs) {
+
+  QStringList song_ids;
+  song_ids.reserve(songs.count());
+  for (const Song &song : songs) {
+    song_ids << QString::number(song.id());
+  }
+  return song_ids.join(",");
+
+}
+
+void CollectionBackend::SmartPlaylistsUpdateMaterialized(const SongList &songs) {
+
+  if (songs.isEmpty()) return;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  ScopedTransaction transaction(&db);
+  if (!SmartPlaylistsRefreshMaterialized(db, SongIdList(songs))) return;
+  transaction.Commit();
+
+}
+
+bool CollectionBackend::SmartPlaylistsRefreshMaterialized(QSqlDatabase &db, const QString &song_ids) {
+
+  if (song_ids.isEmpty()) return true;
+
+  QList<QPair<QString, QString>> searches;
+  {
+    SqlQuery q(db);
+    q.PrepareCached("SELECT search, where_clause FROM smart_playlists_materialized WHERE songs_table = :songs_table");
+    q.BindValue(":songs_table", songs_table_);
+    if (!q.Exec()) {
+      db_->ReportErrors(q);
+      return false;
+    }
+    while (q.next()) {
+      searches << qMakePair(q.value(0).toString(), q.value(1).toString());
+    }
+  }
+
+  // Check only the changed songs against each search.
+  for (const QPair<QString, QString> &search : searches) {
+    SqlQuery remove(db);
+    remove.prepare("DELETE FROM smart_playlists_songs WHERE search = :search AND song_id IN (" + song_ids + ")");
+    remove.BindValue(":search", search.first);
+    if (!remove.Exec()) {
+      db_->ReportErrors(remove);
+      return false;
+    }
+
+    SqlQuery insert(db);
+    insert.prepare("INSERT INTO smart_playlists_songs (search, song_id) SELECT :search, ROWID FROM " + songs_table_ + " WHERE ROWID IN (" + song_ids + ") AND " + search.second);
+    insert.BindValue(":search", search.first);
+    if (!insert.Exec()) {
+      db_->ReportErrors(insert);
+      return false;
+    }
+  }
+
+  return true;
+
+}
+
+void CollectionBackend::SmartPlaylistsClearMaterialized() {
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  ScopedTransaction transaction(&db);
+
+  SqlQuery remove_songs(db);
+  remove_songs.PrepareCached("DELETE FROM smart_playlists_songs WHERE search IN (SELECT search FROM smart_playlists_materialized WHERE songs_table = :songs_table)");
+  remove_songs.BindValue(":songs_table", songs_table_);
+  if (!remove_songs.Exec()) {
+    db_->ReportErrors(remove_songs);
+    return;
+  }
+
+  SqlQuery remove_searches(db);
+  remove_searches.PrepareCached("DELETE FROM smart_playlists_materialized WHERE songs_table = :songs_table");
+  remove_searches.BindValue(":songs_table", songs_table_);
+  if (!remove_searches.Exec()) {
+    db_->ReportErrors(remove_searches);
+    return;
+  }
+
+  transaction.Commit();
+
+  smart_playlists_materialized_.clear();
+
+}
+
 SongList CollectionBackend::SmartPlaylistsGetAllSongs() {
 
   // Get all the songs!
@@ -1905,10 +2352,10 @@ SongList CollectionBackend::GetSongsBy(const QString &artist, const QString &alb
   SongList songs;
   SqlQuery q(db);
   if (album.isEmpty()) {
-    q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE artist = :artist COLLATE NOCASE AND title = :title COLLATE NOCASE").arg(songs_table_));
+    q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE artist = :artist COLLATE NOCASE AND title = :title COLLATE NOCASE").arg(songs_table_));
   }
   else {
-    q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE artist = :artist COLLATE NOCASE AND album = :album COLLATE NOCASE AND title = :title COLLATE NOCASE").arg(songs_table_));
+    q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE artist = :artist COLLATE NOCASE AND album = :album COLLATE NOCASE AND title = :title COLLATE NOCASE").arg(songs_table_));
   }
   q.BindValue(":artist", artist);
   if (!album.isEmpty()) q.BindValue(":album", album);
@@ -1943,7 +2390,7 @@ void CollectionBackend::UpdateLastPlayed(const QString &artist, const QString &a
       continue;
     }
     SqlQuery q(db);
-    q.prepare(QString("UPDATE %1 SET lastplayed = :lastplayed WHERE ROWID = :id").arg(songs_table_));
+    q.PrepareCached(QString("UPDATE %1 SET lastplayed = :lastplayed WHERE ROWID = :id").arg(songs_table_));
     q.BindValue(":lastplayed", lastplayed);
     q.BindValue(":id", song.id());
     if (!q.Exec()) {
@@ -1969,7 +2416,7 @@ void CollectionBackend::UpdatePlayCount(const QString &artist, const QString &ti
 
   for (const Song &song : songs) {
     SqlQuery q(db);
-    q.prepare(QString("UPDATE %1 SET playcount = :playcount WHERE ROWID = :id").arg(songs_table_));
+    q.PrepareCached(QString("UPDATE %1 SET playcount = :playcount WHERE ROWID = :id").arg(songs_table_));
     q.BindValue(":playcount", playcount);
     q.BindValue(":id", song.id());
     if (!q.Exec()) {
@@ -2032,7 +2479,7 @@ void CollectionBackend::UpdateLastSeen(const int directory_id, const int expire_
     QSqlDatabase db(db_->Connect());
 
     SqlQuery q(db);
-    q.prepare(QString("UPDATE %1 SET lastseen = :lastseen WHERE directory_id = :directory_id AND unavailable = 0").arg(songs_table_));
+    q.PrepareCached(QString("UPDATE %1 SET lastseen = :lastseen WHERE directory_id = :directory_id AND unavailable = 0").arg(songs_table_));
     q.BindValue(":lastseen", QDateTime::currentDateTime().toSecsSinceEpoch());
     q.BindValue(":directory_id", directory_id);
     if (!q.Exec()) {
@@ -2052,7 +2499,7 @@ void CollectionBackend::ExpireSongs(const int directory_id, const int expire_una
     QMutexLocker l(db_->Mutex());
     QSqlDatabase db(db_->Connect());
     SqlQuery q(db);
-    q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE directory_id = :directory_id AND unavailable = 1 AND lastseen > 0 AND lastseen < :time").arg(songs_table_));
+    q.PrepareCached(QString("SELECT ROWID, " + Song::kColumnSpec + " FROM %1 WHERE directory_id = :directory_id AND unavailable = 1 AND lastseen > 0 AND lastseen < :time").arg(songs_table_));
     q.BindValue(":directory_id", directory_id);
     q.BindValue(":time", QDateTime::currentDateTime().toSecsSinceEpoch() - (expire_unavailable_songs_days * 86400));
     if (!q.Exec()) {
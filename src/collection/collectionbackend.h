@@ -24,12 +24,14 @@
 
 #include "config.h"
 
+#include <functional>
 #include <optional>
 
 #include <QtGlobal>
 #include <QObject>
 #include <QFileInfo>
 #include <QList>
+#include <QSet>
 #include <QString>
 #include <QStringList>
 #include <QUrl>
@@ -212,6 +214,9 @@ class CollectionBackend : public CollectionBackendInterface {
 
   SongList SmartPlaylistsGetAllSongs();
   SongList SmartPlaylistsFindSongs(const SmartPlaylistSearch &search);
+  // Keeps the IDs of the songs matching the search in a table, updated only for the songs that change.
+  // Returns the key to read them with, or an empty string if the search can't be materialized.
+  QString SmartPlaylistsMaterialize(const SmartPlaylistSearch &search);
 
   void AddOrUpdateSongsAsync(const SongList &songs);
   void UpdateSongsBySongIDAsync(const SongMap &new_songs);
@@ -294,7 +299,32 @@ class CollectionBackend : public CollectionBackendInterface {
   Song GetSongBySongId(const QString &song_id, QSqlDatabase &db);
   SongList GetSongsBySongId(const QStringList &song_ids, QSqlDatabase &db);
 
+  // Insert the songs and add their new IDs to ids, in the same order.
+  bool InsertSongs(QSqlDatabase &db, const SongList &songs, QList<int> *ids);
+  bool BulkInsertSongs(QSqlDatabase &db, const SongList &songs, QList<int> *ids);
+  bool BulkInsert(QSqlDatabase &db, const QString &table, const QString &column_spec, const QStringList &placeholders, const SongList &songs, const int first_id, const std::function<void(SqlQuery*, const Song&)> &bind);
+  static QString BulkInsertSuffix(const int row);
+
+  bool SmartPlaylistsSampleRange(QSqlDatabase &db, int *min_id, int *max_id);
+  // Returns false if too few of the ROWIDs are matching songs to pick them by probing random ROWIDs.
+  bool SmartPlaylistsSampleSongs(QSqlDatabase &db, const SmartPlaylistSearch &search, SongList *songs);
+  // Picks from the ROWIDs of the matching songs, for searches that can't be materialized.
+  bool SmartPlaylistsSampleSongIds(QSqlDatabase &db, const SmartPlaylistSearch &search, SongList *songs);
+  // Checks the songs again against the materialized searches, song_ids is a comma separated ID list or a query for the IDs.
+  bool SmartPlaylistsRefreshMaterialized(QSqlDatabase &db, const QString &song_ids);
+  static QString SongIdList(const SongList &songs);
+
+ private slots:
+  void SmartPlaylistsUpdateMaterialized(const SongList &songs);
+  void SmartPlaylistsClearMaterialized();
+
  private:
+  static const int kBulkInsertMinSongs;
+  static const int kBulkInsertMaxVariables;
+  static const int kSmartPlaylistsMaxSampleMisses;
+  static const int kSmartPlaylistsMaxSampleIds;
+  static const qint64 kSmartPlaylistsMaterializedMaxAge;
+
   Database *db_;
   TaskManager *task_manager_;
   Song::Source source_;
@@ -304,6 +334,9 @@ class CollectionBackend : public CollectionBackendInterface {
   QString fts_table_;
   QThread *original_thread_;
 
+  // Materialized searches used since startup, protected by the database mutex.
+  QSet<QString> smart_playlists_materialized_;
+
 };
 
 #endif  // COLLECTIONBACKEND_H
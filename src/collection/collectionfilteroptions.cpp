@@ -40,3 +40,21 @@ bool CollectionFilterOptions::Matches(const Song &song) const {
   return true;
 
 }
+
+bool CollectionFilterOptions::Narrows(const CollectionFilterOptions &previous) const {
+
+  if (filter_mode_ != previous.filter_mode_ || max_age_ != previous.max_age_) return false;
+
+  return FilterTextNarrows(previous.filter_text_, filter_text_);
+
+}
+
+bool CollectionFilterOptions::FilterTextNarrows(const QString &previous_filter_text, const QString &filter_text) {
+
+  // Appending to the filter text only extends the last token or adds more tokens, which are all required to match.
+  // A colon can turn a plain token into a column filter though, which matches songs the previous filter didn't.
+  if (!filter_text.startsWith(previous_filter_text)) return false;
+
+  return !filter_text.mid(previous_filter_text.length()).contains(':');
+
+}
@@ -56,6 +56,10 @@ class CollectionFilterOptions {
 
   bool Matches(const Song &song) const;
 
+  // Whether every song matched by these options is also matched by the previous options, so previous results only need to be narrowed down.
+  bool Narrows(const CollectionFilterOptions &previous) const;
+  static bool FilterTextNarrows(const QString &previous_filter_text, const QString &filter_text);
+
  private:
   FilterMode filter_mode_;
   int max_age_;
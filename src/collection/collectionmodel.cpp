@@ -90,10 +90,13 @@ CollectionModel::CollectionModel(CollectionBackend *backend, Application *app, Q
       artist_icon_(IconLoader::Load("folder-sound")),
       album_icon_(IconLoader::Load("cdcase")),
       init_task_id_(-1),
+      filter_update_id_(0),
+      filter_updates_pending_(0),
       use_pretty_covers_(true),
       show_dividers_(true),
       use_disk_cache_(false),
-      use_lazy_loading_(true) {
+      use_lazy_loading_(true),
+      song_index_(std::make_unique<CollectionSongIndex>()) {
 
   root_->lazy_loaded = true;
 
@@ -106,6 +109,7 @@ CollectionModel::CollectionModel(CollectionBackend *backend, Application *app, Q
   cover_loader_options_.scale_output_image_ = true;
   cover_loader_options_.pad_output_image_ = true;
   cover_loader_options_.desired_height_ = kPrettyCoverSize;
+  cover_loader_options_.scaled_image_only_ = true;
 
   if (app_) {
     QObject::connect(app_->album_cover_loader(), &AlbumCoverLoader::AlbumCoverLoaded, this, &CollectionModel::AlbumCoverLoaded);
@@ -125,6 +129,7 @@ CollectionModel::CollectionModel(CollectionBackend *backend, Application *app, Q
 
   QObject::connect(backend_, &CollectionBackend::SongsDiscovered, this, &CollectionModel::SongsDiscovered);
   QObject::connect(backend_, &CollectionBackend::SongsDeleted, this, &CollectionModel::SongsDeleted);
+  QObject::connect(backend_, &CollectionBackend::DatabaseReset, this, [this]() { song_index_->Clear(); });
   QObject::connect(backend_, &CollectionBackend::DatabaseReset, this, &CollectionModel::Reset);
   QObject::connect(backend_, &CollectionBackend::TotalSongCountUpdated, this, &CollectionModel::TotalSongCountUpdatedSlot);
   QObject::connect(backend_, &CollectionBackend::TotalArtistCountUpdated, this, &CollectionModel::TotalArtistCountUpdatedSlot);
@@ -168,6 +173,7 @@ void CollectionModel::ReloadSettings() {
   s.beginGroup(CollectionSettingsPage::kSettingsGroup);
 
   use_disk_cache_ = s.value(CollectionSettingsPage::kSettingsDiskCacheEnable, false).toBool();
+  set_use_song_index(s.value(CollectionSettingsPage::kSettingsSongIndex, false).toBool());
 
   QPixmapCache::setCacheLimit(static_cast<int>(MaximumCacheSize(&s, CollectionSettingsPage::kSettingsCacheSize, CollectionSettingsPage::kSettingsCacheSizeUnit, CollectionSettingsPage::kSettingsCacheSizeDefault) / 1024));
 
@@ -208,6 +214,8 @@ void CollectionModel::Init(const bool async) {
 
 void CollectionModel::SongsDiscovered(const SongList &songs) {
 
+  song_index_->AddOrUpdateSongs(songs);
+
   for (const Song &song : songs) {
 
     // Sanity check to make sure we don't add songs that are outside the user's filter
@@ -268,6 +276,7 @@ void CollectionModel::SongsSlightlyChanged(const SongList &songs) {
 
   // This is called if there was a minor change to the songs that will not normally require the collection to be restructured.
   // We can just update our internal cache of Song objects without worrying about resetting the model.
+  song_index_->UpdateSongs(songs);
   for (const Song &song : songs) {
     if (song_nodes_.contains(song.id())) {
       song_nodes_[song.id()]->metadata = song;
@@ -505,6 +514,8 @@ QString CollectionModel::DividerDisplayText(const GroupBy group_by, const QStrin
 
 void CollectionModel::SongsDeleted(const SongList &songs) {
 
+  song_index_->RemoveSongs(songs);
+
   // Delete the actual song nodes first, keeping track of each parent so we might check to see if they're empty later.
   QSet<CollectionItem*> parents;
   for (const Song &song : songs) {
@@ -825,6 +836,33 @@ bool CollectionModel::HasCompilations(const QSqlDatabase &db, const CollectionFi
 
 }
 
+bool CollectionModel::QuerySongIndex(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options, QueryResult *result) {
+
+  song_index_->EnsureLoaded([this]() { return backend_->GetAllSongs(); });
+
+  bool has_compilations = false;
+  if (query_options.query_have_compilations() && !song_index_->Exists(filter_options, query_options, true, &has_compilations)) {
+    return false;
+  }
+  result->create_va = has_compilations;
+
+  std::optional<bool> compilation;
+  if (result->create_va) {
+    compilation = false;
+  }
+  else if (query_options.compilation_requirement() != CollectionQueryOptions::CompilationRequirement::None) {
+    compilation = query_options.compilation_requirement() == CollectionQueryOptions::CompilationRequirement::On;
+  }
+
+  if (!song_index_->Query(filter_options, query_options, compilation, &result->songs)) {
+    result->create_va = false;
+    return false;
+  }
+
+  return true;
+
+}
+
 CollectionQueryOptions CollectionModel::PrepareQuery(CollectionItem *parent) {
 
   // Information about what we want the children to be
@@ -852,12 +890,27 @@ CollectionQueryOptions CollectionModel::PrepareQuery(CollectionItem *parent) {
 
 CollectionModel::QueryResult CollectionModel::RunQuery(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options) {
 
-  QMutexLocker l(backend_->db()->Mutex());
+  QueryResult result = ExecQuery(filter_options, query_options);
+
+  if (QThread::currentThread() != thread() && QThread::currentThread() != backend_->thread()) {
+    backend_->db()->Close();
+  }
+
+  return result;
+
+}
+
+CollectionModel::QueryResult CollectionModel::ExecQuery(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options) {
 
   QueryResult result;
-  {
+  if (song_index_->enabled()) {
+    result.from_index = QuerySongIndex(filter_options, query_options, &result);
+  }
+
+  if (!result.from_index) {
 
-    QSqlDatabase db(backend_->db()->Connect());
+    DatabaseReadLocker l(backend_->db());
+    QSqlDatabase db(l.db());
     // Add the special Various artists node
     if (query_options.query_have_compilations() && HasCompilations(db, filter_options, query_options)) {
       result.create_va = true;
@@ -887,10 +940,6 @@ CollectionModel::QueryResult CollectionModel::RunQuery(const CollectionFilterOpt
 
   }
 
-  if (QThread::currentThread() != thread() && QThread::currentThread() != backend_->thread()) {
-    backend_->db()->Close();
-  }
-
   return result;
 
 }
@@ -905,6 +954,18 @@ void CollectionModel::PostQuery(CollectionItem *parent, const CollectionModel::Q
     CreateCompilationArtistNode(signal, parent);
   }
 
+  // Results from the song index are already songs
+  for (const Song &song : result.songs) {
+    CollectionItem *item = ItemFromSong(child_group_by, separate_albums_by_grouping_, signal, child_level == 0, parent, song, child_level);
+
+    if (child_group_by == GroupBy::None) {
+      song_nodes_.insert(item->metadata.id(), item);
+    }
+    else {
+      container_nodes_[child_level].insert(item->key, item);
+    }
+  }
+
   // Step through the results
   for (const SqlRow &row : result.rows) {
     // Create the item - it will get inserted into the model here
@@ -971,6 +1032,9 @@ void CollectionModel::ResetAsyncQueryFinished() {
 
 void CollectionModel::BeginReset() {
 
+  // Any filter update still running was made against the old tree.
+  ++filter_update_id_;
+
   beginResetModel();
   delete root_;
   song_nodes_.clear();
@@ -998,6 +1062,245 @@ void CollectionModel::Reset() {
 
 }
 
+void CollectionModel::UpdateFilter(const CollectionFilterOptions &previous_filter_options) {
+
+  // Nothing to update incrementally until the top level has been populated.
+  if (!root_->lazy_loaded || std::any_of(root_->children.begin(), root_->children.end(), [](CollectionItem *item) { return item->type == CollectionItem::Type_LoadingIndicator; })) {
+    ResetAsync();
+    return;
+  }
+
+  FilterUpdate update;
+  update.id = ++filter_update_id_;
+  // The tree only reflects the previous filter when no other update is still running.
+  update.narrowing = filter_updates_pending_ == 0 && filter_options_.Narrows(previous_filter_options);
+  update.filter_options = filter_options_;
+
+  // Collect every populated node, parents before their children.
+  QList<CollectionItem*> items = QList<CollectionItem*>() << root_;
+  for (int i = 0; i < items.count(); ++i) {
+    CollectionItem *item = items[i];
+    FilterUpdateNode node;
+    if (item != root_) {
+      node.level = item->container_level;
+      node.key = item->key;
+      node.compilation_artist_node = IsCompilationArtistNode(item);
+      if (item->parent != root_) {
+        node.parent_level = item->parent->container_level;
+        node.parent_key = item->parent->key;
+      }
+    }
+    node.query_options = PrepareQuery(item);
+    update.nodes << node;
+
+    for (CollectionItem *child : std::as_const(item->children)) {
+      if (child->type == CollectionItem::Type_Container && child->lazy_loaded) {
+        items << child;
+      }
+    }
+  }
+
+  ++filter_updates_pending_;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+  QFuture<CollectionModel::FilterUpdate> future = QtConcurrent::run(&CollectionModel::RunFilterUpdate, this, update);
+#else
+  QFuture<CollectionModel::FilterUpdate> future = QtConcurrent::run(this, &CollectionModel::RunFilterUpdate, update);
+#endif
+  QFutureWatcher<CollectionModel::FilterUpdate> *watcher = new QFutureWatcher<CollectionModel::FilterUpdate>();
+  QObject::connect(watcher, &QFutureWatcher<CollectionModel::FilterUpdate>::finished, this, &CollectionModel::FilterUpdateFinished);
+  watcher->setFuture(future);
+
+}
+
+CollectionModel::FilterUpdate CollectionModel::RunFilterUpdate(FilterUpdate update) {
+
+  for (FilterUpdateNode &node : update.nodes) {
+    node.result = ExecQuery(update.filter_options, node.query_options);
+  }
+
+  if (QThread::currentThread() != thread() && QThread::currentThread() != backend_->thread()) {
+    backend_->db()->Close();
+  }
+
+  return update;
+
+}
+
+void CollectionModel::FilterUpdateFinished() {
+
+  QFutureWatcher<CollectionModel::FilterUpdate> *watcher = static_cast<QFutureWatcher<CollectionModel::FilterUpdate>*>(sender());
+  const FilterUpdate update = watcher->result();
+  watcher->deleteLater();
+
+  --filter_updates_pending_;
+
+  // A newer update or a reset has been started since, so this result is already stale.
+  if (update.id != filter_update_id_) return;
+
+  for (const FilterUpdateNode &node : update.nodes) {
+    CollectionItem *item = FilterUpdateNodeItem(node);
+    // Skip nodes that were removed by an update of their parent, or repopulated since.
+    if (!item || !item->lazy_loaded) continue;
+    UpdateChildren(item, node.result, update.narrowing);
+  }
+
+  RemoveEmptyDividers();
+
+}
+
+CollectionItem *CollectionModel::FilterUpdateNodeItem(const FilterUpdateNode &node) const {
+
+  if (node.level == -1) return root_;
+
+  if (node.compilation_artist_node) {
+    CollectionItem *parent = node.parent_level == -1 ? root_ : container_nodes_[node.parent_level].value(node.parent_key);
+    return parent ? parent->compilation_artist_node_ : nullptr;
+  }
+
+  return container_nodes_[node.level].value(node.key);
+
+}
+
+void CollectionModel::UpdateChildren(CollectionItem *parent, const QueryResult &result, const bool narrowing) {
+
+  const int child_level = parent == root_ ? 0 : parent->container_level + 1;
+  const GroupBy child_group_by = child_level >= 3 ? GroupBy::None : group_by_[child_level];
+
+  // Work out the keys of the new children without touching the model.
+  // Songs are identified by their ID since titles are not unique.
+  CollectionItem scratch(CollectionItem::Type_Container);
+  if (parent != root_) scratch.key = parent->key;
+
+  QStringList row_keys;
+  row_keys.reserve(result.rows.count());
+  for (const SqlRow &row : result.rows) {
+    if (child_group_by == GroupBy::None) {
+      row_keys << row.value(0).toString();
+    }
+    else {
+      row_keys << ItemFromQuery(child_group_by, separate_albums_by_grouping_, false, false, &scratch, row, child_level)->key;
+    }
+  }
+  QStringList song_keys;
+  song_keys.reserve(result.songs.count());
+  for (const Song &song : result.songs) {
+    if (child_group_by == GroupBy::None) {
+      song_keys << QString::number(song.id());
+    }
+    else {
+      song_keys << ItemFromSong(child_group_by, separate_albums_by_grouping_, false, false, &scratch, song, child_level)->key;
+    }
+  }
+
+  QSet<QString> new_keys;
+  for (const QString &key : std::as_const(row_keys)) new_keys << key;
+  for (const QString &key : std::as_const(song_keys)) new_keys << key;
+
+  // Remove the children that no longer match, bottom up so the rows of the remaining ones stay valid.
+  QSet<QString> existing_keys;
+  QList<CollectionItem*> removed_items;
+  for (CollectionItem *child : std::as_const(parent->children)) {
+    if (child->type != CollectionItem::Type_Container && child->type != CollectionItem::Type_Song) continue;
+    if (child == parent->compilation_artist_node_) {
+      if (!result.create_va) removed_items.prepend(child);
+      continue;
+    }
+    const QString key = child->type == CollectionItem::Type_Song ? QString::number(child->metadata.id()) : child->key;
+    if (new_keys.contains(key)) {
+      existing_keys << key;
+    }
+    else {
+      removed_items.prepend(child);
+    }
+  }
+  for (CollectionItem *item : std::as_const(removed_items)) {
+    RemoveItem(item);
+  }
+
+  // A narrowed filter can only have removed children.
+  if (narrowing) return;
+
+  QueryResult added;
+  added.create_va = result.create_va;
+  for (int i = 0; i < result.rows.count(); ++i) {
+    if (!existing_keys.contains(row_keys[i])) added.rows << result.rows[i];
+  }
+  for (int i = 0; i < result.songs.count(); ++i) {
+    if (!existing_keys.contains(song_keys[i])) added.songs << result.songs[i];
+  }
+
+  PostQuery(parent, added, true);
+
+}
+
+void CollectionModel::RemoveItem(CollectionItem *item) {
+
+  UnregisterItem(item);
+
+  CollectionItem *parent = item->parent;
+  if (IsCompilationArtistNode(item)) {
+    parent->compilation_artist_node_ = nullptr;
+  }
+
+  beginRemoveRows(ItemToIndex(parent), item->row, item->row);
+  parent->Delete(item->row);
+  endRemoveRows();
+
+}
+
+void CollectionModel::UnregisterItem(CollectionItem *item) {
+
+  for (CollectionItem *child : std::as_const(item->children)) {
+    UnregisterItem(child);
+  }
+
+  if (item->type == CollectionItem::Type_Song) {
+    if (song_nodes_.value(item->metadata.id()) == item) {
+      song_nodes_.remove(item->metadata.id());
+    }
+  }
+  else if (item->type == CollectionItem::Type_Container && !IsCompilationArtistNode(item) && item->container_level >= 0 && item->container_level < 3) {
+    if (container_nodes_[item->container_level].value(item->key) == item) {
+      container_nodes_[item->container_level].remove(item->key);
+    }
+  }
+
+  for (QMap<quint64, ItemAndCacheKey>::iterator it = pending_art_.begin(); it != pending_art_.end();) {
+    if (it.value().first == item) {
+      pending_cache_keys_.remove(it.value().second);
+      it = pending_art_.erase(it);  // clazy:exclude=strict-iterators
+    }
+    else {
+      ++it;
+    }
+  }
+
+}
+
+void CollectionModel::RemoveEmptyDividers() {
+
+  QSet<QString> divider_keys;
+  for (CollectionItem *item : std::as_const(root_->children)) {
+    if (item->type != CollectionItem::Type_Divider) {
+      divider_keys << DividerKey(group_by_[0], item);
+    }
+  }
+
+  for (QMap<QString, CollectionItem*>::iterator it = divider_nodes_.begin(); it != divider_nodes_.end();) {
+    if (divider_keys.contains(it.key())) {
+      ++it;
+      continue;
+    }
+    const int row = it.value()->row;
+    beginRemoveRows(ItemToIndex(root_), row, row);
+    root_->Delete(row);
+    endRemoveRows();
+    it = divider_nodes_.erase(it);  // clazy:exclude=strict-iterators
+  }
+
+}
+
 void CollectionModel::SetQueryColumnSpec(const GroupBy group_by, const bool separate_albums_by_grouping, CollectionQueryOptions *query_options) {
 
   // Say what group_by of thing we want to get back from the database.
@@ -1864,18 +2167,21 @@ SongList CollectionModel::GetChildSongs(const QModelIndex &idx) const {
 }
 
 void CollectionModel::SetFilterMode(CollectionFilterOptions::FilterMode filter_mode) {
+  const CollectionFilterOptions previous_filter_options = filter_options_;
   filter_options_.set_filter_mode(filter_mode);
-  ResetAsync();
+  UpdateFilter(previous_filter_options);
 }
 
 void CollectionModel::SetFilterAge(const int filter_age) {
+  const CollectionFilterOptions previous_filter_options = filter_options_;
   filter_options_.set_max_age(filter_age);
-  ResetAsync();
+  UpdateFilter(previous_filter_options);
 }
 
 void CollectionModel::SetFilterText(const QString &filter_text) {
+  const CollectionFilterOptions previous_filter_options = filter_options_;
   filter_options_.set_filter_text(filter_text);
-  ResetAsync();
+  UpdateFilter(previous_filter_options);
 }
 
 bool CollectionModel::canFetchMore(const QModelIndex &parent) const {
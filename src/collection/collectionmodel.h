@@ -24,6 +24,7 @@
 
 #include "config.h"
 
+#include <memory>
 #include <optional>
 
 #include <QtGlobal>
@@ -53,6 +54,7 @@
 #include "collectionquery.h"
 #include "collectionqueryoptions.h"
 #include "collectionitem.h"
+#include "collectionsongindex.h"
 #include "covermanager/albumcoverloaderoptions.h"
 
 class QSettings;
@@ -126,10 +128,12 @@ class CollectionModel : public SimpleTreeModel<CollectionItem> {
   };
 
   struct QueryResult {
-    QueryResult() : create_va(false) {}
+    QueryResult() : create_va(false), from_index(false) {}
 
     SqlRowList rows;
+    SongList songs;
     bool create_va;
+    bool from_index;
   };
 
   CollectionBackend *backend() const { return backend_; }
@@ -187,6 +191,13 @@ class CollectionModel : public SimpleTreeModel<CollectionItem> {
 
   void set_use_lazy_loading(const bool value) { use_lazy_loading_ = value; }
 
+  // Whether to build the tree and filter from an in-memory copy of the collection instead of querying the database
+  void set_use_song_index(const bool value) { song_index_->set_enabled(value); }
+  bool use_song_index() const { return song_index_->enabled(); }
+
+  // Whether a background filter update started by SetFilterText is still running
+  bool filter_update_running() const { return filter_updates_pending_ > 0; }
+
   QMap<QString, CollectionItem*> container_nodes(const int i) { return container_nodes_[i]; }
   QList<CollectionItem*> song_nodes() const { return song_nodes_.values(); }
   int divider_nodes_count() const { return divider_nodes_.count(); }
@@ -231,19 +242,54 @@ class CollectionModel : public SimpleTreeModel<CollectionItem> {
   // Called after ResetAsync
   void ResetAsyncQueryFinished();
 
+  // Called after UpdateFilter
+  void FilterUpdateFinished();
+
   void AlbumCoverLoaded(const quint64 id, const AlbumCoverLoaderResult &result);
 
  private:
+  // A populated node in the tree and the result of querying its children with the new filter.
+  // Nodes are identified by key since the tree can change while the update is running.
+  struct FilterUpdateNode {
+    FilterUpdateNode() : level(-1), parent_level(-1), compilation_artist_node(false) {}
+    int level;
+    QString key;
+    int parent_level;
+    QString parent_key;
+    bool compilation_artist_node;
+    CollectionQueryOptions query_options;
+    QueryResult result;
+  };
+
+  struct FilterUpdate {
+    FilterUpdate() : id(0), narrowing(false) {}
+    int id;
+    bool narrowing;
+    CollectionFilterOptions filter_options;
+    QList<FilterUpdateNode> nodes;
+  };
+
   // Provides some optimizations for loading the list of items in the root.
   // This gets called a lot when filtering the playlist, so it's nice to be able to do it in a background thread.
   CollectionQueryOptions PrepareQuery(CollectionItem *parent);
   QueryResult RunQuery(const CollectionFilterOptions &filter_options = CollectionFilterOptions(), const CollectionQueryOptions &query_options = CollectionQueryOptions());
+  QueryResult ExecQuery(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options);
   void PostQuery(CollectionItem *parent, const QueryResult &result, const bool signal);
 
   bool HasCompilations(const QSqlDatabase &db, const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options);
+  bool QuerySongIndex(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options, QueryResult *result);
 
   void BeginReset();
 
+  // Applies a filter change to the populated parts of the tree by inserting and removing rows instead of resetting the model.
+  void UpdateFilter(const CollectionFilterOptions &previous_filter_options);
+  FilterUpdate RunFilterUpdate(FilterUpdate update);
+  CollectionItem *FilterUpdateNodeItem(const FilterUpdateNode &node) const;
+  void UpdateChildren(CollectionItem *parent, const QueryResult &result, const bool narrowing);
+  void RemoveItem(CollectionItem *item);
+  void UnregisterItem(CollectionItem *item);
+  void RemoveEmptyDividers();
+
   // Functions for working with queries and creating items.
   // When the model is reset or when a node is lazy-loaded the Collection constructs a database query to populate the items.
   // Filters are added for each parent item, restricting the songs returned to a particular album or artist for example.
@@ -303,6 +349,8 @@ class CollectionModel : public SimpleTreeModel<CollectionItem> {
   static QNetworkDiskCache *sIconCache;
 
   int init_task_id_;
+  int filter_update_id_;
+  int filter_updates_pending_;
 
   bool use_pretty_covers_;
   bool show_dividers_;
@@ -311,6 +359,8 @@ class CollectionModel : public SimpleTreeModel<CollectionItem> {
 
   AlbumCoverLoaderOptions cover_loader_options_;
 
+  std::unique_ptr<CollectionSongIndex> song_index_;
+
   using ItemAndCacheKey = QPair<CollectionItem*, QString>;
   QMap<quint64, ItemAndCacheKey> pending_art_;
   QSet<QString> pending_cache_keys_;
@@ -34,6 +34,7 @@
 
 #include "core/logging.h"
 #include "core/sqlquery.h"
+#include "core/sqlstatementcache.h"
 #include "core/song.h"
 
 #include "collectionquery.h"
@@ -42,6 +43,7 @@
 
 CollectionQuery::CollectionQuery(const QSqlDatabase &db, const QString &songs_table, const QString &fts_table, const CollectionFilterOptions &filter_options)
     : QSqlQuery(db),
+      db_(db),
       songs_table_(songs_table),
       fts_table_(fts_table),
       include_unavailable_(false),
@@ -187,6 +189,12 @@ QString CollectionQuery::GetInnerQuery() const {
              : QString();
 }
 
+CollectionQuery::~CollectionQuery() {
+
+  SqlStatementCache::ReturnToCache(db_, this, &cache_key_);
+
+}
+
 bool CollectionQuery::Exec() {
 
   QString sql;
@@ -213,7 +221,8 @@ bool CollectionQuery::Exec() {
   sql.replace("%fts_table_noprefix", fts_table_.section('.', -1, -1));
   sql.replace("%fts_table", fts_table_);
 
-  QSqlQuery::prepare(sql);
+  // Re-use the prepared statement if the same query was run on this connection before, the values are bound separately.
+  SqlStatementCache::Prepare(db_, sql, this, &cache_key_);
 
   // Bind values
   for (const QVariant &value : bound_values_) {
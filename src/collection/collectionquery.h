@@ -37,6 +37,7 @@
 class CollectionQuery : public QSqlQuery {
  public:
   explicit CollectionQuery(const QSqlDatabase &db, const QString &songs_table, const QString &fts_table, const CollectionFilterOptions &filter_options = CollectionFilterOptions());
+  ~CollectionQuery();
 
   QVariant Value(const int column) const;
   QVariant value(const int column) const { return Value(column); }
@@ -74,6 +75,8 @@ class CollectionQuery : public QSqlQuery {
   void AddCompilationRequirement(const bool compilation);
 
  private:
+  Q_DISABLE_COPY(CollectionQuery)
+
   QString GetInnerQuery() const;
 
   QSqlDatabase db_;
@@ -89,6 +92,8 @@ class CollectionQuery : public QSqlQuery {
   bool join_with_fts_;
   bool duplicates_only_;
   int limit_;
+
+  QString cache_key_;
 };
 
 #endif  // COLLECTIONQUERY_H
@@ -0,0 +1,255 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <QtGlobal>
+
+#ifndef Q_OS_WIN32
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#endif
+
+#include <QIODevice>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QMutex>
+#include <QHash>
+#include <QSet>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+#include "core/logging.h"
+#include "collectionsnapshot.h"
+
+const quint32 CollectionSnapshot::kMagic = 0x5342534e;
+const quint32 CollectionSnapshot::kVersion = 1;
+
+CollectionSnapshot::CollectionSnapshot(const QString &filename) : filename_(filename) {}
+
+bool CollectionSnapshot::Load() {
+
+  QMutexLocker l(&mutex_);
+
+  entries_.clear();
+  seen_.clear();
+  journal_.clear();
+
+  QFile file(filename_);
+  if (!file.exists()) return false;
+  if (!file.open(QIODevice::ReadOnly)) {
+    qLog(Error) << "Could not open collection snapshot" << filename_ << "for reading:" << file.errorString();
+    return false;
+  }
+
+  QDataStream s(&file);
+  s.setVersion(QDataStream::Qt_5_6);
+
+  quint32 magic = 0;
+  quint32 version = 0;
+  s >> magic >> version;
+  if (magic != kMagic || version != kVersion) {
+    qLog(Debug) << "Ignoring collection snapshot with unknown format" << filename_;
+    file.close();
+    file.remove();
+    return false;
+  }
+
+  quint32 entries_count = 0;
+  s >> entries_count;
+  entries_.reserve(static_cast<int>(entries_count));
+  for (quint32 i = 0; i < entries_count && s.status() == QDataStream::Ok; ++i) {
+    quint64 hash = 0;
+    Entry entry;
+    s >> hash >> entry.mtime >> entry.size >> entry.inode;
+    entries_.insert(hash, entry);
+  }
+
+  quint32 journal_count = 0;
+  s >> journal_count;
+  for (quint32 i = 0; i < journal_count && s.status() == QDataStream::Ok; ++i) {
+    qint32 directory_id = 0;
+    QString path;
+    s >> directory_id >> path;
+    journal_[directory_id] << path;
+  }
+
+  const bool success = s.status() == QDataStream::Ok;
+  if (!success) {
+    qLog(Error) << "Collection snapshot" << filename_ << "is corrupt.";
+    entries_.clear();
+    journal_.clear();
+  }
+
+  // Remove the snapshot now, it is written again on a clean shutdown.
+  file.close();
+  file.remove();
+
+  qLog(Debug) << "Loaded collection snapshot with" << entries_.count() << "directories";
+
+  return success;
+
+}
+
+bool CollectionSnapshot::Save() {
+
+  QMutexLocker l(&mutex_);
+
+  // Drop the directories that are gone or no longer in the collection.
+  // If nothing was scanned since loading, the snapshot is kept as it is.
+  if (!seen_.isEmpty()) {
+    for (QHash<quint64, Entry>::iterator it = entries_.begin(); it != entries_.end();) {
+      if (seen_.contains(it.key())) {
+        ++it;
+      }
+      else {
+        it = entries_.erase(it);
+      }
+    }
+  }
+
+  QFile file(filename_);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qLog(Error) << "Could not open collection snapshot" << filename_ << "for writing:" << file.errorString();
+    return false;
+  }
+
+  QDataStream s(&file);
+  s.setVersion(QDataStream::Qt_5_6);
+
+  s << kMagic << kVersion;
+
+  s << static_cast<quint32>(entries_.count());
+  for (QHash<quint64, Entry>::const_iterator it = entries_.constBegin(); it != entries_.constEnd(); ++it) {
+    s << it.key() << it.value().mtime << it.value().size << it.value().inode;
+  }
+
+  quint32 journal_count = 0;
+  for (const QStringList &paths : journal_) {
+    journal_count += static_cast<quint32>(paths.count());
+  }
+  s << journal_count;
+  for (QMap<int, QStringList>::const_iterator it = journal_.constBegin(); it != journal_.constEnd(); ++it) {
+    for (const QString &path : it.value()) {
+      s << static_cast<qint32>(it.key()) << path;
+    }
+  }
+
+  file.close();
+
+  if (s.status() != QDataStream::Ok) {
+    qLog(Error) << "Failed to write collection snapshot" << filename_;
+    file.remove();
+    return false;
+  }
+
+  qLog(Debug) << "Saved collection snapshot with" << entries_.count() << "directories";
+
+  return true;
+
+}
+
+bool CollectionSnapshot::ChangedSinceScan(const QString &path, const Entry &entry_on_disk) {
+
+  QMutexLocker l(&mutex_);
+  const quint64 hash = PathHash(path);
+  seen_.insert(hash);
+  QHash<quint64, Entry>::const_iterator it = entries_.constFind(hash);
+  if (it == entries_.constEnd()) {
+    entries_.insert(hash, entry_on_disk);
+    return false;
+  }
+
+  return it.value().mtime != entry_on_disk.mtime || it.value().size != entry_on_disk.size || it.value().inode != entry_on_disk.inode;
+
+}
+
+void CollectionSnapshot::Update(const QString &path) {
+
+  Entry entry;
+  if (!Stat(path, &entry)) {
+    Remove(path);
+    return;
+  }
+
+  QMutexLocker l(&mutex_);
+  const quint64 hash = PathHash(path);
+  entries_.insert(hash, entry);
+  seen_.insert(hash);
+
+}
+
+void CollectionSnapshot::Remove(const QString &path) {
+
+  QMutexLocker l(&mutex_);
+  const quint64 hash = PathHash(path);
+  entries_.remove(hash);
+  seen_.remove(hash);
+
+}
+
+void CollectionSnapshot::SetJournal(const QMap<int, QStringList> &journal) {
+
+  QMutexLocker l(&mutex_);
+  journal_ = journal;
+
+}
+
+QStringList CollectionSnapshot::TakeJournal(const int directory_id) {
+
+  QMutexLocker l(&mutex_);
+  return journal_.take(directory_id);
+
+}
+
+quint64 CollectionSnapshot::PathHash(const QString &path) {
+
+  // 64-bit FNV-1a, qHash() is seeded differently for each run.
+  quint64 hash = 14695981039346656037ULL;
+  for (const QChar c : path) {
+    hash ^= c.unicode();
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+
+}
+
+bool CollectionSnapshot::Stat(const QString &path, Entry *entry) {
+
+#ifdef Q_OS_WIN32
+  const QFileInfo fileinfo(path);
+  if (!fileinfo.exists()) return false;
+  entry->mtime = fileinfo.lastModified().toSecsSinceEpoch();
+  entry->size = fileinfo.size();
+  entry->inode = 0;
+#else
+  struct stat st {};
+  if (stat(QFile::encodeName(path).constData(), &st) != 0) return false;
+  entry->mtime = static_cast<qint64>(st.st_mtime);
+  entry->size = static_cast<qint64>(st.st_size);
+  entry->inode = static_cast<quint64>(st.st_ino);
+#endif
+
+  return true;
+
+}
@@ -0,0 +1,78 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COLLECTIONSNAPSHOT_H
+#define COLLECTIONSNAPSHOT_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QHash>
+#include <QSet>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+// Compact on-disk snapshot of the collection subdirectories (path hash -> mtime, size and inode) as they were when last scanned.
+// It also keeps a journal of the subdirectories that changed while the application was running, but were not rescanned yet.
+// The snapshot is only written on a clean shutdown, and removed when loaded, so it is never used after a crash.
+// Entries for directories that were not checked or scanned since the snapshot was loaded are not saved again.
+// All functions can be called from any thread.
+class CollectionSnapshot {
+ public:
+  explicit CollectionSnapshot(const QString &filename);
+
+  struct Entry {
+    Entry() : mtime(0), size(0), inode(0) {}
+    qint64 mtime;
+    qint64 size;
+    quint64 inode;
+  };
+
+  static const quint32 kMagic;
+  static const quint32 kVersion;
+
+  bool Load();
+  bool Save();
+
+  // Returns true if the directory was replaced or changed without a new mtime since it was scanned.
+  // Directories without an entry are recorded as they are on disk.
+  bool ChangedSinceScan(const QString &path, const Entry &entry_on_disk);
+
+  // Records the current state of the directory on disk.
+  void Update(const QString &path);
+  void Remove(const QString &path);
+
+  // Directory ID -> subdirectories changed since the last scan.
+  void SetJournal(const QMap<int, QStringList> &journal);
+  QStringList TakeJournal(const int directory_id);
+
+  static quint64 PathHash(const QString &path);
+  static bool Stat(const QString &path, Entry *entry);
+
+ private:
+  QString filename_;
+  mutable QMutex mutex_;
+  QHash<quint64, Entry> entries_;
+  QSet<quint64> seen_;
+  QMap<int, QStringList> journal_;
+};
+
+#endif  // COLLECTIONSNAPSHOT_H
@@ -0,0 +1,704 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <QtGlobal>
+#include <QList>
+#include <QHash>
+#include <QPair>
+#include <QVariant>
+#include <QString>
+#include <QStringList>
+#include <QChar>
+#include <QDateTime>
+#include <QRegularExpression>
+#include <QMutex>
+#include <QReadWriteLock>
+
+#include "core/logging.h"
+#include "core/song.h"
+#include "collectionfilteroptions.h"
+#include "collectionqueryoptions.h"
+#include "collectionsongindex.h"
+
+namespace {
+
+constexpr int kColumnCount = static_cast<int>(CollectionSongIndex::Column::ColumnCount);
+constexpr int kEmptyString = 0;
+
+int NormalizedInt(const int value) {
+  return value <= 0 ? -1 : value;
+}
+
+}  // namespace
+
+CollectionSongIndex::CollectionSongIndex()
+    : enabled_(false),
+      loaded_(false),
+      loading_(false),
+      duplicate_counts_valid_(false) {
+
+  ClearLocked();
+
+}
+
+void CollectionSongIndex::set_enabled(const bool enabled) {
+
+  if (enabled == enabled_) return;
+
+  enabled_ = enabled;
+  Clear();
+
+}
+
+bool CollectionSongIndex::loaded() const {
+
+  QReadLocker l(&lock_);
+  return loaded_;
+
+}
+
+int CollectionSongIndex::song_count() const {
+
+  QReadLocker l(&lock_);
+  return static_cast<int>(ids_.size());
+
+}
+
+void CollectionSongIndex::EnsureLoaded(const std::function<SongList()> &load_songs) {
+
+  QMutexLocker load_locker(&load_mutex_);
+  {
+    QWriteLocker l(&lock_);
+    if (loaded_) return;
+    loading_ = true;
+  }
+
+  // Load outside the write lock so changes coming from the backend in the meantime are queued instead of blocking the caller.
+  const SongList songs = load_songs();
+
+  QWriteLocker l(&lock_);
+  // The index was cleared while loading, the songs might be stale so leave it for the next call.
+  if (!loading_) return;
+  loading_ = false;
+  ClearLocked();
+  AddOrUpdateSongsLocked(songs);
+  for (const QPair<bool, SongList> &change : std::as_const(pending_changes_)) {
+    if (change.first) {
+      AddOrUpdateSongsLocked(change.second);
+    }
+    else {
+      RemoveSongsLocked(change.second);
+    }
+  }
+  pending_changes_.clear();
+  loaded_ = true;
+
+  qLog(Debug) << "Loaded" << ids_.size() << "songs with" << strings_.count() << "unique strings into the collection index";
+
+}
+
+void CollectionSongIndex::Clear() {
+
+  QWriteLocker l(&lock_);
+  ClearLocked();
+  pending_changes_.clear();
+  loaded_ = false;
+  loading_ = false;
+
+}
+
+void CollectionSongIndex::ClearLocked() {
+
+  strings_.clear();
+  string_ids_.clear();
+  string_tokens_.clear();
+  ids_.clear();
+  songs_.clear();
+  rows_.clear();
+  for (int i = 0; i < kColumnCount; ++i) {
+    columns_[i].clear();
+  }
+  compilation_effective_.clear();
+  ctime_.clear();
+
+  Intern(QString(""));
+
+  InvalidateCachesLocked();
+
+}
+
+void CollectionSongIndex::InvalidateCachesLocked() {
+
+  QMutexLocker l(&cache_mutex_);
+  sorted_permutations_.clear();
+  duplicate_counts_.clear();
+  duplicate_counts_valid_ = false;
+  text_matches_filter_text_.clear();
+  text_matches_.reset();
+
+}
+
+void CollectionSongIndex::AddOrUpdateSongs(const SongList &songs) {
+
+  if (!enabled_) return;
+
+  QWriteLocker l(&lock_);
+  if (!loaded_) {
+    // Nothing to update before the index is loaded, it will read the songs from the database then.
+    if (loading_) pending_changes_ << qMakePair(true, songs);
+    return;
+  }
+  AddOrUpdateSongsLocked(songs);
+
+}
+
+void CollectionSongIndex::RemoveSongs(const SongList &songs) {
+
+  if (!enabled_) return;
+
+  QWriteLocker l(&lock_);
+  if (!loaded_) {
+    // Nothing to update before the index is loaded, it will read the songs from the database then.
+    if (loading_) pending_changes_ << qMakePair(false, songs);
+    return;
+  }
+  RemoveSongsLocked(songs);
+
+}
+
+void CollectionSongIndex::UpdateSongs(const SongList &songs) {
+
+  if (!enabled_) return;
+
+  QWriteLocker l(&lock_);
+  if (!loaded_) {
+    if (loading_) pending_changes_ << qMakePair(true, songs);
+    return;
+  }
+
+  // None of the indexed columns changed, so the caches stay valid.
+  for (const Song &song : songs) {
+    const int row = rows_.value(song.id(), -1);
+    if (row != -1) songs_[row] = song;
+  }
+
+}
+
+int CollectionSongIndex::Intern(const QString &str) {
+
+  QHash<QString, int>::const_iterator it = string_ids_.constFind(str);
+  if (it != string_ids_.constEnd()) return it.value();
+
+  const int id = static_cast<int>(strings_.count());
+  strings_ << str;
+  string_ids_.insert(str, id);
+  string_tokens_.push_back(Tokenize(str));
+
+  return id;
+
+}
+
+void CollectionSongIndex::AddOrUpdateSongsLocked(const SongList &songs) {
+
+  for (const Song &song : songs) {
+    if (song.id() == -1) continue;
+    if (song.is_unavailable()) {
+      if (rows_.contains(song.id())) RemoveRowLocked(rows_.value(song.id()));
+      continue;
+    }
+
+    int row = rows_.value(song.id(), -1);
+    if (row == -1) {
+      row = static_cast<int>(ids_.size());
+      ids_.push_back(song.id());
+      songs_.push_back(Song());
+      rows_.insert(song.id(), row);
+      for (int i = 0; i < kColumnCount; ++i) {
+        columns_[i].push_back(-1);
+      }
+      compilation_effective_.push_back(0);
+      ctime_.push_back(0);
+    }
+
+    // These are normalized the same way Song::BindToQuery stores them, so where clauses built from collection items compare equal.
+    columns_[static_cast<int>(Column::Title)][row] = Intern(song.title());
+    columns_[static_cast<int>(Column::Album)][row] = Intern(song.album());
+    columns_[static_cast<int>(Column::Artist)][row] = Intern(song.artist());
+    columns_[static_cast<int>(Column::AlbumArtist)][row] = Intern(song.albumartist());
+    columns_[static_cast<int>(Column::EffectiveAlbumArtist)][row] = Intern(song.effective_albumartist());
+    columns_[static_cast<int>(Column::AlbumId)][row] = Intern(song.album_id());
+    columns_[static_cast<int>(Column::Grouping)][row] = Intern(song.grouping());
+    columns_[static_cast<int>(Column::Genre)][row] = Intern(song.genre());
+    columns_[static_cast<int>(Column::Composer)][row] = Intern(song.composer());
+    columns_[static_cast<int>(Column::Performer)][row] = Intern(song.performer());
+    columns_[static_cast<int>(Column::Comment)][row] = Intern(song.comment());
+    columns_[static_cast<int>(Column::Year)][row] = NormalizedInt(song.year());
+    columns_[static_cast<int>(Column::OriginalYear)][row] = NormalizedInt(song.originalyear());
+    columns_[static_cast<int>(Column::EffectiveOriginalYear)][row] = NormalizedInt(song.effective_originalyear());
+    columns_[static_cast<int>(Column::Disc)][row] = NormalizedInt(song.disc());
+    columns_[static_cast<int>(Column::FileType)][row] = static_cast<int>(song.filetype());
+    columns_[static_cast<int>(Column::Samplerate)][row] = NormalizedInt(song.samplerate());
+    columns_[static_cast<int>(Column::Bitdepth)][row] = NormalizedInt(song.bitdepth());
+    columns_[static_cast<int>(Column::Bitrate)][row] = NormalizedInt(song.bitrate());
+    compilation_effective_[row] = song.is_compilation() ? 1 : 0;
+    ctime_[row] = song.ctime();
+    songs_[row] = song;
+  }
+
+  InvalidateCachesLocked();
+
+}
+
+void CollectionSongIndex::RemoveSongsLocked(const SongList &songs) {
+
+  for (const Song &song : songs) {
+    if (rows_.contains(song.id())) {
+      RemoveRowLocked(rows_.value(song.id()));
+    }
+  }
+
+  InvalidateCachesLocked();
+
+}
+
+void CollectionSongIndex::RemoveRowLocked(const int row) {
+
+  // Move the last row into the hole to keep the columns packed.
+  const int last_row = static_cast<int>(ids_.size()) - 1;
+  rows_.remove(ids_[row]);
+  if (row != last_row) {
+    ids_[row] = ids_[last_row];
+    songs_[row] = songs_[last_row];
+    rows_[ids_[row]] = row;
+    for (int i = 0; i < kColumnCount; ++i) {
+      columns_[i][row] = columns_[i][last_row];
+    }
+    compilation_effective_[row] = compilation_effective_[last_row];
+    ctime_[row] = ctime_[last_row];
+  }
+
+  ids_.pop_back();
+  songs_.pop_back();
+  for (int i = 0; i < kColumnCount; ++i) {
+    columns_[i].pop_back();
+  }
+  compilation_effective_.pop_back();
+  ctime_.pop_back();
+
+}
+
+QStringList CollectionSongIndex::Tokenize(const QString &text) {
+
+  // Approximates the FTS5 unicode61 tokenizer with remove_diacritics: split on anything that isn't a letter or number, case fold and drop combining marks.
+  QStringList tokens;
+  QString token;
+  const QString decomposed = text.normalized(QString::NormalizationForm_D);
+  for (const QChar c : decomposed) {
+    if (c.category() == QChar::Mark_NonSpacing) continue;
+    if (c.isLetterOrNumber()) {
+      token.append(c.toLower());
+    }
+    else if (!token.isEmpty()) {
+      tokens << token;
+      token.clear();
+    }
+  }
+  if (!token.isEmpty()) tokens << token;
+
+  return tokens;
+
+}
+
+int CollectionSongIndex::ColumnFromName(const QString &name) {
+
+  static const QHash<QString, int> columns = {
+    { "title", static_cast<int>(Column::Title) },
+    { "album", static_cast<int>(Column::Album) },
+    { "artist", static_cast<int>(Column::Artist) },
+    { "albumartist", static_cast<int>(Column::AlbumArtist) },
+    { "effective_albumartist", static_cast<int>(Column::EffectiveAlbumArtist) },
+    { "album_id", static_cast<int>(Column::AlbumId) },
+    { "grouping", static_cast<int>(Column::Grouping) },
+    { "genre", static_cast<int>(Column::Genre) },
+    { "composer", static_cast<int>(Column::Composer) },
+    { "performer", static_cast<int>(Column::Performer) },
+    { "comment", static_cast<int>(Column::Comment) },
+    { "year", static_cast<int>(Column::Year) },
+    { "originalyear", static_cast<int>(Column::OriginalYear) },
+    { "effective_originalyear", static_cast<int>(Column::EffectiveOriginalYear) },
+    { "disc", static_cast<int>(Column::Disc) },
+    { "filetype", static_cast<int>(Column::FileType) },
+    { "samplerate", static_cast<int>(Column::Samplerate) },
+    { "bitdepth", static_cast<int>(Column::Bitdepth) },
+    { "bitrate", static_cast<int>(Column::Bitrate) },
+  };
+
+  return columns.value(name.trimmed().toLower(), -1);
+
+}
+
+int CollectionSongIndex::ColumnFromFtsName(const QString &name) {
+
+  if (!Song::kFtsColumns.contains("fts" + name, Qt::CaseInsensitive)) return -1;
+
+  return ColumnFromName(name);
+
+}
+
+bool CollectionSongIndex::Compile(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options, const std::optional<bool> compilation, CompiledQuery *query) const {
+
+  const QString column_spec = query_options.column_spec();
+  if (column_spec.startsWith("DISTINCT ")) {
+    query->distinct = true;
+    const QStringList column_names = column_spec.mid(9).split(',');
+    for (const QString &column_name : column_names) {
+      const int column = ColumnFromName(column_name);
+      if (column == -1) return false;
+      query->columns << column;
+    }
+    query->columns_key = column_spec;
+  }
+
+  for (const CollectionQueryOptions::Where &where_clause : query_options.where_clauses()) {
+    if (where_clause.op != "=") return false;
+    Where where;
+    where.column = ColumnFromName(where_clause.column);
+    if (where.column == -1) return false;
+    if (IsStringColumn(where.column)) {
+      // Strings that were never interned can't match any row.
+      where.value = string_ids_.value(where_clause.value.toString(), -1);
+      if (where.value == -1) query->no_match = true;
+    }
+    else {
+      where.value = where_clause.value.toInt();
+    }
+    query->where << where;
+  }
+
+  // Mirror the filter text munging in CollectionQuery so both produce the same matches.
+  query->filter_text = filter_options.filter_text();
+  if (!filter_options.filter_text().isEmpty()) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    QStringList tokens(filter_options.filter_text().split(QRegularExpression("\\s+"), Qt::SkipEmptyParts));
+#else
+    QStringList tokens(filter_options.filter_text().split(QRegularExpression("\\s+"), QString::SkipEmptyParts));
+#endif
+    for (QString token : tokens) {
+      token.remove('(');
+      token.remove(')');
+      token.remove('"');
+      token.replace('-', ' ');
+
+      Phrase phrase;
+      if (token.contains(':')) {
+        const int column = ColumnFromFtsName(token.section(':', 0, 0));
+        if (column != -1) {
+          phrase.column = column;
+          token = token.section(':', 1, -1);
+        }
+        token.replace(":", " ");
+      }
+      phrase.tokens = Tokenize(token);
+      if (!phrase.tokens.isEmpty()) query->phrases << phrase;
+    }
+  }
+
+  if (filter_options.max_age() != -1) {
+    query->cutoff = QDateTime::currentDateTime().toSecsSinceEpoch() - filter_options.max_age();
+  }
+
+  query->duplicates_only = filter_options.filter_mode() == CollectionFilterOptions::FilterMode::Duplicates;
+  query->untagged_only = filter_options.filter_mode() == CollectionFilterOptions::FilterMode::Untagged;
+  query->compilation = compilation;
+
+  return true;
+
+}
+
+bool CollectionSongIndex::TokensMatch(const QStringList &tokens, const QStringList &phrase) {
+
+  // A phrase matches a run of consecutive tokens, with the last token being a prefix match.
+  const qint64 phrase_size = phrase.count();
+  for (qint64 i = 0; i + phrase_size <= tokens.count(); ++i) {
+    bool match = true;
+    for (qint64 j = 0; j < phrase_size && match; ++j) {
+      if (j == phrase_size - 1) {
+        match = tokens[i + j].startsWith(phrase[j]);
+      }
+      else {
+        match = tokens[i + j] == phrase[j];
+      }
+    }
+    if (match) return true;
+  }
+
+  return false;
+
+}
+
+bool CollectionSongIndex::PhraseMatches(const Phrase &phrase, const int row) const {
+
+  static const int kFtsColumns[] = {
+    static_cast<int>(Column::Title),
+    static_cast<int>(Column::Album),
+    static_cast<int>(Column::Artist),
+    static_cast<int>(Column::AlbumArtist),
+    static_cast<int>(Column::Composer),
+    static_cast<int>(Column::Performer),
+    static_cast<int>(Column::Grouping),
+    static_cast<int>(Column::Genre),
+    static_cast<int>(Column::Comment),
+  };
+
+  if (phrase.column != -1) {
+    return TokensMatch(string_tokens_[columns_[phrase.column][row]], phrase.tokens);
+  }
+
+  return std::any_of(std::begin(kFtsColumns), std::end(kFtsColumns), [this, &phrase, row](const int column) { return TokensMatch(string_tokens_[columns_[column][row]], phrase.tokens); });
+
+}
+
+bool CollectionSongIndex::IsDuplicate(const int row) const {
+
+  const int artist = columns_[static_cast<int>(Column::Artist)][row];
+  const int album = columns_[static_cast<int>(Column::Album)][row];
+  const int title = columns_[static_cast<int>(Column::Title)][row];
+  if (artist == kEmptyString || album == kEmptyString || title == kEmptyString) return false;
+
+  QMutexLocker l(&cache_mutex_);
+  if (!duplicate_counts_valid_) {
+    duplicate_counts_.clear();
+    for (int i = 0; i < static_cast<int>(ids_.size()); ++i) {
+      ++duplicate_counts_[qMakePair(columns_[static_cast<int>(Column::Artist)][i], qMakePair(columns_[static_cast<int>(Column::Album)][i], columns_[static_cast<int>(Column::Title)][i]))];
+    }
+    duplicate_counts_valid_ = true;
+  }
+
+  return duplicate_counts_.value(qMakePair(artist, qMakePair(album, title)), 0) > 1;
+
+}
+
+bool CollectionSongIndex::RowMatches(const CompiledQuery &query, const int row) const {
+
+  for (const Where &where : query.where) {
+    if (columns_[where.column][row] != where.value) return false;
+  }
+
+  if (query.compilation.has_value() && (compilation_effective_[row] == 1) != query.compilation.value()) return false;
+
+  if (query.cutoff != -1 && ctime_[row] <= query.cutoff) return false;
+
+  if (query.untagged_only && columns_[static_cast<int>(Column::Artist)][row] != kEmptyString && columns_[static_cast<int>(Column::Album)][row] != kEmptyString && columns_[static_cast<int>(Column::Title)][row] != kEmptyString) {
+    return false;
+  }
+
+  if (query.text_matches && !(*query.text_matches)[row]) return false;
+
+  if (query.duplicates_only && !IsDuplicate(row)) return false;
+
+  return true;
+
+}
+
+CollectionSongIndex::TextMatchesPtr CollectionSongIndex::FilterTextMatches(const CompiledQuery &query) const {
+
+  if (query.phrases.isEmpty()) return TextMatchesPtr();
+
+  QMutexLocker l(&cache_mutex_);
+
+  // The same filter text is used for every node in the tree, so keep the matches around.
+  if (text_matches_ && text_matches_filter_text_ == query.filter_text) return text_matches_;
+
+  // When the filter text was extended only the rows matching the previous filter text need to be checked.
+  TextMatchesPtr previous_matches;
+  if (text_matches_ && CollectionFilterOptions::FilterTextNarrows(text_matches_filter_text_, query.filter_text)) {
+    previous_matches = text_matches_;
+  }
+
+  std::shared_ptr<TextMatches> text_matches = std::make_shared<TextMatches>(ids_.size(), false);
+  for (int row = 0; row < static_cast<int>(ids_.size()); ++row) {
+    if (previous_matches && !(*previous_matches)[row]) continue;
+    (*text_matches)[row] = std::all_of(query.phrases.begin(), query.phrases.end(), [this, row](const Phrase &phrase) { return PhraseMatches(phrase, row); });
+  }
+
+  text_matches_filter_text_ = query.filter_text;
+  text_matches_ = text_matches;
+
+  return text_matches;
+
+}
+
+CollectionSongIndex::PermutationPtr CollectionSongIndex::SortedPermutation(const CompiledQuery &query) const {
+
+  QMutexLocker l(&cache_mutex_);
+
+  PermutationPtr permutation = sorted_permutations_.value(query.columns_key);
+  if (permutation) return permutation;
+
+  // Sort the rows on the distinct columns so rows that belong to the same group are adjacent.
+  // The interned string ids are enough here since only equality matters, the model sorts the items itself.
+  std::shared_ptr<Permutation> new_permutation = std::make_shared<Permutation>(ids_.size());
+  for (int i = 0; i < static_cast<int>(new_permutation->size()); ++i) {
+    (*new_permutation)[i] = i;
+  }
+  std::sort(new_permutation->begin(), new_permutation->end(), [this, &query](const int a, const int b) {
+    for (const int column : query.columns) {
+      if (columns_[column][a] != columns_[column][b]) return columns_[column][a] < columns_[column][b];
+    }
+    return a < b;
+  });
+
+  sorted_permutations_.insert(query.columns_key, new_permutation);
+
+  return new_permutation;
+
+}
+
+Song CollectionSongIndex::SongFromRow(const QList<int> &columns, const int row) const {
+
+  Song song;
+  for (const int column : columns) {
+    const int value = columns_[column][row];
+    switch (static_cast<Column>(column)) {
+      case Column::Title:
+        song.set_title(strings_[value]);
+        break;
+      case Column::Album:
+        song.set_album(strings_[value]);
+        break;
+      case Column::Artist:
+        song.set_artist(strings_[value]);
+        break;
+      case Column::AlbumArtist:
+      case Column::EffectiveAlbumArtist:
+        song.set_albumartist(strings_[value]);
+        break;
+      case Column::AlbumId:
+        song.set_album_id(strings_[value]);
+        break;
+      case Column::Grouping:
+        song.set_grouping(strings_[value]);
+        break;
+      case Column::Genre:
+        song.set_genre(strings_[value]);
+        break;
+      case Column::Composer:
+        song.set_composer(strings_[value]);
+        break;
+      case Column::Performer:
+        song.set_performer(strings_[value]);
+        break;
+      case Column::Comment:
+        song.set_comment(strings_[value]);
+        break;
+      case Column::Year:
+        song.set_year(value);
+        break;
+      case Column::OriginalYear:
+      case Column::EffectiveOriginalYear:
+        song.set_originalyear(value);
+        break;
+      case Column::Disc:
+        song.set_disc(value);
+        break;
+      case Column::FileType:
+        song.set_filetype(static_cast<Song::FileType>(value));
+        break;
+      case Column::Samplerate:
+        song.set_samplerate(value);
+        break;
+      case Column::Bitdepth:
+        song.set_bitdepth(value);
+        break;
+      case Column::Bitrate:
+        song.set_bitrate(value);
+        break;
+      case Column::ColumnCount:
+        break;
+    }
+  }
+
+  return song;
+
+}
+
+bool CollectionSongIndex::Query(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options, const std::optional<bool> compilation, SongList *songs) const {
+
+  QReadLocker l(&lock_);
+  if (!loaded_) return false;
+
+  CompiledQuery query;
+  if (!Compile(filter_options, query_options, compilation, &query)) return false;
+  query.text_matches = FilterTextMatches(query);
+  if (query.no_match) return true;
+
+  if (!query.distinct) {
+    for (int row = 0; row < static_cast<int>(ids_.size()); ++row) {
+      if (RowMatches(query, row)) *songs << songs_[row];
+    }
+    return true;
+  }
+
+  const PermutationPtr permutation = SortedPermutation(query);
+  int last_row = -1;
+  for (const int row : *permutation) {
+    if (last_row != -1 && std::all_of(query.columns.begin(), query.columns.end(), [this, row, last_row](const int column) { return columns_[column][row] == columns_[column][last_row]; })) {
+      continue;
+    }
+    if (!RowMatches(query, row)) continue;
+    *songs << SongFromRow(query.columns, row);
+    last_row = row;
+  }
+
+  return true;
+
+}
+
+bool CollectionSongIndex::Exists(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options, const std::optional<bool> compilation, bool *exists) const {
+
+  QReadLocker l(&lock_);
+  if (!loaded_) return false;
+
+  CompiledQuery query;
+  if (!Compile(filter_options, query_options, compilation, &query)) return false;
+  query.text_matches = FilterTextMatches(query);
+
+  *exists = false;
+  if (query.no_match) return true;
+
+  for (int row = 0; row < static_cast<int>(ids_.size()); ++row) {
+    if (RowMatches(query, row)) {
+      *exists = true;
+      break;
+    }
+  }
+
+  return true;
+
+}
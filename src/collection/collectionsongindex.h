@@ -0,0 +1,185 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COLLECTIONSONGINDEX_H
+#define COLLECTIONSONGINDEX_H
+
+#include "config.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <QtGlobal>
+#include <QList>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+#include <QReadWriteLock>
+
+#include "core/song.h"
+
+class CollectionFilterOptions;
+class CollectionQueryOptions;
+
+// In-memory columnar copy of the available songs in a collection, used by CollectionModel to build the tree and to filter without going through SQL.
+// Strings are interned once and stored as integer ids, every column is a packed array indexed by row.
+// The songs are kept next to the columns, so the song items of the tree are built without reading them from the database again.
+// The index answers the same CollectionQueryOptions that CollectionQuery does, and returns false for anything it doesn't understand so the caller can fall back to SQL.
+class CollectionSongIndex {
+ public:
+  explicit CollectionSongIndex();
+
+  enum class Column {
+    Title,
+    Album,
+    Artist,
+    AlbumArtist,
+    EffectiveAlbumArtist,
+    AlbumId,
+    Grouping,
+    Genre,
+    Composer,
+    Performer,
+    Comment,
+    Year,
+    OriginalYear,
+    EffectiveOriginalYear,
+    Disc,
+    FileType,
+    Samplerate,
+    Bitdepth,
+    Bitrate,
+    ColumnCount
+  };
+
+  bool enabled() const { return enabled_; }
+  void set_enabled(const bool enabled);
+
+  bool loaded() const;
+  int song_count() const;
+
+  // Loads the index using the given function unless it's already loaded.
+  // Changes received while loading are queued and applied afterwards, changes received before loading starts are dropped.
+  void EnsureLoaded(const std::function<SongList()> &load_songs);
+  void Clear();
+
+  void AddOrUpdateSongs(const SongList &songs);
+  void RemoveSongs(const SongList &songs);
+  // For changes to songs that don't touch the indexed columns, like play counts and ratings.
+  void UpdateSongs(const SongList &songs);
+
+  // For DISTINCT column specs, songs is filled with one song per distinct value with only those columns set.
+  // Otherwise songs is filled with the matching songs.
+  bool Query(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options, const std::optional<bool> compilation, SongList *songs) const;
+  bool Exists(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options, const std::optional<bool> compilation, bool *exists) const;
+
+  static QStringList Tokenize(const QString &text);
+
+ private:
+  struct Phrase {
+    Phrase() : column(-1) {}
+    int column;
+    QStringList tokens;
+  };
+
+  struct Where {
+    Where() : column(0), value(0) {}
+    int column;
+    int value;
+  };
+
+  using TextMatches = std::vector<bool>;
+  using TextMatchesPtr = std::shared_ptr<const TextMatches>;
+
+  struct CompiledQuery {
+    CompiledQuery() : distinct(false), no_match(false), cutoff(-1), duplicates_only(false), untagged_only(false) {}
+    bool distinct;
+    QList<int> columns;
+    QString columns_key;
+    QList<Where> where;
+    QString filter_text;
+    QList<Phrase> phrases;
+    TextMatchesPtr text_matches;
+    bool no_match;
+    qint64 cutoff;
+    bool duplicates_only;
+    bool untagged_only;
+    std::optional<bool> compilation;
+  };
+
+  using Permutation = std::vector<int>;
+  using PermutationPtr = std::shared_ptr<const Permutation>;
+  using DuplicateKey = QPair<int, QPair<int, int>>;
+
+  static bool IsStringColumn(const int column) { return column <= static_cast<int>(Column::Comment); }
+  static int ColumnFromName(const QString &name);
+  static int ColumnFromFtsName(const QString &name);
+
+  bool Compile(const CollectionFilterOptions &filter_options, const CollectionQueryOptions &query_options, const std::optional<bool> compilation, CompiledQuery *query) const;
+  bool RowMatches(const CompiledQuery &query, const int row) const;
+  bool PhraseMatches(const Phrase &phrase, const int row) const;
+  static bool TokensMatch(const QStringList &tokens, const QStringList &phrase);
+  PermutationPtr SortedPermutation(const CompiledQuery &query) const;
+  TextMatchesPtr FilterTextMatches(const CompiledQuery &query) const;
+  bool IsDuplicate(const int row) const;
+  Song SongFromRow(const QList<int> &columns, const int row) const;
+
+  int Intern(const QString &str);
+  void AddOrUpdateSongsLocked(const SongList &songs);
+  void RemoveSongsLocked(const SongList &songs);
+  void RemoveRowLocked(const int row);
+  void ClearLocked();
+  void InvalidateCachesLocked();
+
+ private:
+  std::atomic<bool> enabled_;
+
+  mutable QReadWriteLock lock_;
+  QMutex load_mutex_;
+  bool loaded_;
+  bool loading_;
+  QList<QPair<bool, SongList>> pending_changes_;
+
+  // Interned strings, id 0 is always the empty string.
+  QStringList strings_;
+  QHash<QString, int> string_ids_;
+  std::vector<QStringList> string_tokens_;
+
+  std::vector<int> ids_;
+  QHash<int, int> rows_;
+  // The songs themselves, for the song items of the tree.
+  std::vector<Song> songs_;
+  std::vector<int> columns_[static_cast<int>(Column::ColumnCount)];
+  std::vector<quint8> compilation_effective_;
+  std::vector<qint64> ctime_;
+
+  mutable QMutex cache_mutex_;
+  mutable QHash<QString, PermutationPtr> sorted_permutations_;
+  mutable QHash<DuplicateKey, int> duplicate_counts_;
+  mutable bool duplicate_counts_valid_;
+  mutable QString text_matches_filter_text_;
+  mutable TextMatchesPtr text_matches_;
+};
+
+#endif  // COLLECTIONSONGINDEX_H
@@ -21,11 +21,18 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <utility>
 #include <chrono>
 
 #include <QObject>
+#include <QCoreApplication>
 #include <QThread>
+#include <QThreadPool>
+#include <QEvent>
+#include <QFuture>
+#include <QtConcurrentRun>
+#include <QMutex>
 #include <QIODevice>
 #include <QDir>
 #include <QDirIterator>
@@ -43,15 +50,18 @@
 #include <QUrl>
 #include <QImage>
 #include <QSettings>
+#include <QStandardPaths>
 
 #include "core/filesystemwatcherinterface.h"
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
 #include "core/taskmanager.h"
 #include "utilities/imageutils.h"
+#include "utilities/threadutils.h"
 #include "utilities/timeconstants.h"
 #include "collectiondirectory.h"
 #include "collectionbackend.h"
+#include "collectionsnapshot.h"
 #include "collectionwatcher.h"
 #include "playlistparsers/cueparser.h"
 #include "settings/collectionsettingspage.h"
@@ -68,6 +78,8 @@ using namespace std::chrono_literals;
 
 QStringList CollectionWatcher::sValidImages = QStringList() << "jpg" << "png" << "gif" << "jpeg";
 
+const int CollectionWatcher::kScanChunksPerThread = 4;
+
 CollectionWatcher::CollectionWatcher(Song::Source source, QObject *parent)
     : QObject(parent),
       source_(source),
@@ -75,6 +87,7 @@ CollectionWatcher::CollectionWatcher(Song::Source source, QObject *parent)
       task_manager_(nullptr),
       fs_watcher_(FileSystemWatcherInterface::Create(this)),
       original_thread_(nullptr),
+      scan_thread_pool_(new QThreadPool(this)),
       scan_on_startup_(true),
       monitor_(true),
       song_tracking_(false),
@@ -93,6 +106,13 @@ CollectionWatcher::CollectionWatcher(Song::Source source, QObject *parent)
 
   original_thread_ = thread();
 
+  scan_thread_pool_->setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+
+  if (source_ == Song::Source::Collection) {
+    snapshot_ = std::make_unique<CollectionSnapshot>(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/collectionsnapshot.dat");
+    snapshot_->Load();
+  }
+
   rescan_timer_->setInterval(2s);
   rescan_timer_->setSingleShot(true);
 
@@ -113,6 +133,12 @@ CollectionWatcher::CollectionWatcher(Song::Source source, QObject *parent)
 
 }
 
+CollectionWatcher::~CollectionWatcher() = default;
+
+void CollectionWatcher::set_scan_thread_count(const int count) {
+  scan_thread_pool_->setMaxThreadCount(std::max(1, count));
+}
+
 void CollectionWatcher::ExitAsync() {
   QMetaObject::invokeMethod(this, "Exit", Qt::QueuedConnection);
 }
@@ -123,6 +149,11 @@ void CollectionWatcher::Exit() {
 
   Stop();
   if (backend_) backend_->Close();
+  if (snapshot_) {
+    // Directories that changed but were not rescanned yet are rescanned on the next startup.
+    snapshot_->SetJournal(rescan_queue_);
+    snapshot_->Save();
+  }
   moveToThread(original_thread_);
   emit ExitFinished();
 
@@ -184,7 +215,9 @@ void CollectionWatcher::ReloadSettings() {
 }
 
 CollectionWatcher::ScanTransaction::ScanTransaction(CollectionWatcher *watcher, const int dir, const bool incremental, const bool ignores_mtime, const bool mark_songs_unavailable)
-    : progress_(0),
+    : parent_(nullptr),
+      task_id_(-1),
+      progress_(0),
       progress_max_(0),
       dir_(dir),
       incremental_(incremental),
@@ -210,8 +243,26 @@ CollectionWatcher::ScanTransaction::ScanTransaction(CollectionWatcher *watcher,
 
 }
 
+CollectionWatcher::ScanTransaction::ScanTransaction(ScanTransaction *parent)
+    : parent_(parent),
+      task_id_(-1),
+      progress_(0),
+      progress_max_(0),
+      dir_(parent->dir_),
+      incremental_(parent->incremental_),
+      ignores_mtime_(parent->ignores_mtime_),
+      mark_songs_unavailable_(parent->mark_songs_unavailable_),
+      expire_unavailable_songs_days_(parent->expire_unavailable_songs_days_),
+      watcher_(parent->watcher_),
+      cached_songs_dirty_(true),
+      cached_songs_missing_fingerprint_dirty_(true),
+      known_subdirs_dirty_(true) {}
+
 CollectionWatcher::ScanTransaction::~ScanTransaction() {
 
+  // Child transactions are merged into their parent, which commits them.
+  if (parent_) return;
+
   // If we're stopping then don't commit the transaction
   if (!watcher_->stop_requested_ && !watcher_->abort_requested_) {
     CommitNewOrUpdatedSongs();
@@ -223,6 +274,12 @@ CollectionWatcher::ScanTransaction::~ScanTransaction() {
 
 void CollectionWatcher::ScanTransaction::AddToProgress(const quint64 n) {
 
+  if (parent_) {
+    parent_->AddToProgress(n);
+    return;
+  }
+
+  QMutexLocker l(&mutex_);
   progress_ += n;
   watcher_->task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
 
@@ -230,6 +287,12 @@ void CollectionWatcher::ScanTransaction::AddToProgress(const quint64 n) {
 
 void CollectionWatcher::ScanTransaction::AddToProgressMax(const quint64 n) {
 
+  if (parent_) {
+    parent_->AddToProgressMax(n);
+    return;
+  }
+
+  QMutexLocker l(&mutex_);
   progress_max_ += n;
   watcher_->task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
 
@@ -295,8 +358,40 @@ void CollectionWatcher::ScanTransaction::CommitNewOrUpdatedSongs() {
 }
 
 
+void CollectionWatcher::ScanTransaction::MergeChild(ScanTransaction *child) {
+
+  deleted_songs << child->deleted_songs;
+  readded_songs << child->readded_songs;
+  new_songs << child->new_songs;
+  touched_songs << child->touched_songs;
+  new_subdirs << child->new_subdirs;
+  touched_subdirs << child->touched_subdirs;
+  deleted_subdirs << child->deleted_subdirs;
+
+  for (const QString &file : std::as_const(child->files_changed_path_)) {
+    if (!files_changed_path_.contains(file)) files_changed_path_ << file;
+  }
+
+  // Songs found with a new path in one part of the scan might have been marked deleted by another part.
+  if (!files_changed_path_.isEmpty()) {
+    for (SongList::iterator it = deleted_songs.begin(); it != deleted_songs.end();) {
+      if (files_changed_path_.contains(it->url().toLocalFile())) {
+        it = deleted_songs.erase(it);
+      }
+      else {
+        ++it;
+      }
+    }
+  }
+
+}
+
 SongList CollectionWatcher::ScanTransaction::FindSongsInSubdirectory(const QString &path) {
 
+  if (parent_) return parent_->FindSongsInSubdirectory(path);
+
+  QMutexLocker l(&mutex_);
+
   if (cached_songs_dirty_) {
     const SongList songs = watcher_->backend_->FindSongsInDirectory(dir_);
     for (const Song &song : songs) {
@@ -315,6 +410,10 @@ SongList CollectionWatcher::ScanTransaction::FindSongsInSubdirectory(const QStri
 
 bool CollectionWatcher::ScanTransaction::HasSongsWithMissingFingerprint(const QString &path) {
 
+  if (parent_) return parent_->HasSongsWithMissingFingerprint(path);
+
+  QMutexLocker l(&mutex_);
+
   if (cached_songs_missing_fingerprint_dirty_) {
     const SongList songs = watcher_->backend_->SongsWithMissingFingerprint(dir_);
     for (const Song &song : songs) {
@@ -330,29 +429,49 @@ bool CollectionWatcher::ScanTransaction::HasSongsWithMissingFingerprint(const QS
 
 void CollectionWatcher::ScanTransaction::SetKnownSubdirs(const CollectionSubdirectoryList &subdirs) {
 
+  if (parent_) {
+    parent_->SetKnownSubdirs(subdirs);
+    return;
+  }
+
+  QMutexLocker l(&mutex_);
+
   known_subdirs_ = subdirs;
   known_subdirs_dirty_ = false;
 
 }
 
-bool CollectionWatcher::ScanTransaction::HasSeenSubdir(const QString &path) {
+void CollectionWatcher::ScanTransaction::UpdateKnownSubdirs() {
 
   if (known_subdirs_dirty_) {
-    SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
+    known_subdirs_ = watcher_->backend_->SubdirsInDirectory(dir_);
+    known_subdirs_dirty_ = false;
   }
 
+}
+
+bool CollectionWatcher::ScanTransaction::HasSeenSubdir(const QString &path) {
+
+  if (parent_) return parent_->HasSeenSubdir(path);
+
+  QMutexLocker l(&mutex_);
+
+  UpdateKnownSubdirs();
+
   return std::any_of(known_subdirs_.begin(), known_subdirs_.end(), [path](const CollectionSubdirectory &subdir) { return subdir.path == path && subdir.mtime != 0; });
 
 }
 
 CollectionSubdirectoryList CollectionWatcher::ScanTransaction::GetImmediateSubdirs(const QString &path) {
 
-  if (known_subdirs_dirty_) {
-    SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
-  }
+  if (parent_) return parent_->GetImmediateSubdirs(path);
+
+  QMutexLocker l(&mutex_);
+
+  UpdateKnownSubdirs();
 
   CollectionSubdirectoryList ret;
-  for (const CollectionSubdirectory &subdir : known_subdirs_) {
+  for (const CollectionSubdirectory &subdir : std::as_const(known_subdirs_)) {
     if (subdir.path.left(subdir.path.lastIndexOf(QDir::separator())) == path && subdir.mtime != 0) {
       ret << subdir;
     }
@@ -364,9 +483,11 @@ CollectionSubdirectoryList CollectionWatcher::ScanTransaction::GetImmediateSubdi
 
 CollectionSubdirectoryList CollectionWatcher::ScanTransaction::GetAllSubdirs() {
 
-  if (known_subdirs_dirty_) {
-    SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
-  }
+  if (parent_) return parent_->GetAllSubdirs();
+
+  QMutexLocker l(&mutex_);
+
+  UpdateKnownSubdirs();
 
   return known_subdirs_;
 
@@ -378,28 +499,35 @@ void CollectionWatcher::AddDirectory(const CollectionDirectory &dir, const Colle
 
   watched_dirs_[dir.id] = dir;
 
+  if (snapshot_) {
+    const QStringList journal = snapshot_->TakeJournal(dir.id);
+    for (const QString &path : journal) {
+      if (!rescan_queue_[dir.id].contains(path)) rescan_queue_[dir.id] << path;
+    }
+    if (!journal.isEmpty() && !rescan_paused_) rescan_timer_->start();
+  }
+
   if (subdirs.isEmpty()) {
     // This is a new directory that we've never seen before. Scan it fully.
     ScanTransaction transaction(this, dir.id, false, false, mark_songs_unavailable_);
-    const quint64 files_count = FilesCountForPath(&transaction, dir.path);
-    transaction.SetKnownSubdirs(subdirs);
-    transaction.AddToProgressMax(files_count);
-    ScanSubdirectory(dir.path, CollectionSubdirectory(), files_count, &transaction);
+    // Split the directory into subtrees which are scanned in parallel.
+    // The subtrees are known to the transaction so they are not scanned again when recursing.
+    const CollectionSubdirectoryList new_subdirs = SplitNewDirectory(dir.path);
+    transaction.SetKnownSubdirs(new_subdirs);
+    ScanSubdirectoriesParallel(QList<ScanRequest>() << ScanRequest(&transaction, new_subdirs));
     last_scan_time_ = QDateTime::currentDateTime().toSecsSinceEpoch();
   }
   else {
     // We can do an incremental scan - looking at the mtimes of each subdirectory and only rescan if the directory has changed.
     ScanTransaction transaction(this, dir.id, true, false, mark_songs_unavailable_);
-    QMap<QString, quint64> subdir_files_count;
-    const quint64 files_count = FilesCountForSubdirs(&transaction, subdirs, subdir_files_count);
     transaction.SetKnownSubdirs(subdirs);
-    transaction.AddToProgressMax(files_count);
-    for (const CollectionSubdirectory &subdir : subdirs) {
-      if (stop_requested_ || abort_requested_) break;
-
-      if (scan_on_startup_) ScanSubdirectory(subdir.path, subdir, subdir_files_count[subdir.path], &transaction);
+    if (scan_on_startup_) ScanSubdirectoriesParallel(QList<ScanRequest>() << ScanRequest(&transaction, subdirs));
 
-      if (monitor_) AddWatch(dir, subdir.path);
+    if (monitor_) {
+      for (const CollectionSubdirectory &subdir : subdirs) {
+        if (stop_requested_ || abort_requested_) break;
+        AddWatch(dir, subdir.path);
+      }
     }
 
     last_scan_time_ = QDateTime::currentDateTime().toSecsSinceEpoch();
@@ -410,6 +538,133 @@ void CollectionWatcher::AddDirectory(const CollectionDirectory &dir, const Colle
 
 }
 
+CollectionSubdirectoryList CollectionWatcher::SplitNewDirectory(const QString &path) {
+
+  const int max_subdirs = scan_thread_pool_->maxThreadCount() * kScanChunksPerThread;
+
+  CollectionSubdirectory root_subdir;
+  root_subdir.directory_id = -1;
+  root_subdir.path = path;
+  root_subdir.mtime = QFileInfo(path).lastModified().toSecsSinceEpoch();
+
+  if (max_subdirs <= 1) return CollectionSubdirectoryList() << root_subdir;
+
+  // Go down two levels at most, deeper subdirectories are found when scanning.
+  QHash<QString, CollectionSubdirectoryList> children;
+  CollectionSubdirectoryList level = CollectionSubdirectoryList() << root_subdir;
+  int subdirs_count = 1;
+  for (int depth = 0; depth < 2 && subdirs_count < max_subdirs && !level.isEmpty(); ++depth) {
+    CollectionSubdirectoryList next_level;
+    for (const CollectionSubdirectory &parent_subdir : std::as_const(level)) {
+      QDirIterator it(parent_subdir.path, QDir::Dirs | QDir::NoDotAndDotDot);
+      while (it.hasNext()) {
+        if (stop_requested_ || abort_requested_) return CollectionSubdirectoryList() << root_subdir;
+        const QString child = it.next();
+        const QFileInfo child_info(child);
+        if (child_info.isSymLink()) continue;
+        CollectionSubdirectory subdir;
+        subdir.directory_id = -1;
+        subdir.path = child;
+        subdir.mtime = child_info.lastModified().toSecsSinceEpoch();
+        children[parent_subdir.path] << subdir;
+        next_level << subdir;
+      }
+    }
+    subdirs_count += static_cast<int>(next_level.count());
+    level = next_level;
+  }
+
+  // Each subdirectory is followed by its own subdirectories, the order a serial scan recursing into them finds them in.
+  CollectionSubdirectoryList subdirs;
+  subdirs.reserve(subdirs_count);
+  CollectionSubdirectoryList stack = CollectionSubdirectoryList() << root_subdir;
+  while (!stack.isEmpty()) {
+    const CollectionSubdirectory subdir = stack.takeLast();
+    subdirs << subdir;
+    const CollectionSubdirectoryList subdir_children = children.value(subdir.path);
+    for (int i = static_cast<int>(subdir_children.count()) - 1; i >= 0; --i) {
+      stack << subdir_children[i];
+    }
+  }
+
+  return subdirs;
+
+}
+
+void CollectionWatcher::ScanSubdirectoriesParallel(const QList<ScanRequest> &requests) {
+
+  const int chunks = scan_thread_pool_->maxThreadCount() * kScanChunksPerThread;
+
+  QList<ScanTransaction*> parents;
+  QList<ScanTransaction*> children;
+  QList<QFuture<void>> futures;
+
+  for (const ScanRequest &request : requests) {
+    const CollectionSubdirectoryList &subdirs = request.subdirs;
+    if (subdirs.isEmpty()) continue;
+    const int chunk_size = std::max(1, static_cast<int>((subdirs.count() + chunks - 1) / chunks));
+    for (int i = 0; i < subdirs.count(); i += chunk_size) {
+      const CollectionSubdirectoryList chunk = subdirs.mid(i, chunk_size);
+      ScanTransaction *child = new ScanTransaction(request.transaction);
+      parents << request.transaction;
+      children << child;
+      futures << QtConcurrent::run(scan_thread_pool_, [this, child, chunk]() { ScanSubdirectoriesJob(child, chunk); });
+    }
+  }
+
+  // Merge in the original order, so the results are committed in the same order as a serial scan.
+  for (int i = 0; i < futures.count(); ++i) {
+    futures[i].waitForFinished();
+    parents[i]->MergeChild(children[i]);
+    delete children[i];
+  }
+
+}
+
+void CollectionWatcher::ScanSubdirectoriesJob(ScanTransaction *t, const CollectionSubdirectoryList &subdirs) {
+
+  QThread::currentThread()->setPriority(QThread::IdlePriority);
+#ifndef Q_OS_WIN32
+  Utilities::SetThreadIOPriority(Utilities::IoPriority::IOPRIO_CLASS_IDLE);
+#endif
+
+  CollectionSubdirectoryList subdirs_to_scan;
+  for (const CollectionSubdirectory &subdir : subdirs) {
+    if (stop_requested_ || abort_requested_) break;
+    if (!SubdirUnchanged(t, subdir)) subdirs_to_scan << subdir;
+  }
+
+  QMap<QString, quint64> subdir_files_count;
+  const quint64 files_count = FilesCountForSubdirs(t, subdirs_to_scan, subdir_files_count);
+  t->AddToProgressMax(files_count);
+
+  for (const CollectionSubdirectory &subdir : subdirs_to_scan) {
+    if (stop_requested_ || abort_requested_) break;
+    // SubdirUnchanged() already compared the mtime.
+    ScanSubdirectory(subdir.path, subdir, subdir_files_count[subdir.path], t, true);
+  }
+
+  // Close the database connection opened by this thread.
+  backend_->Close();
+
+}
+
+bool CollectionWatcher::SubdirUnchanged(ScanTransaction *t, const CollectionSubdirectory &subdir) {
+
+  if (!t->is_incremental() || t->ignores_mtime() || subdir.mtime == 0) return false;
+
+#ifdef HAVE_SONGFINGERPRINTING
+  if (song_tracking_ && t->HasSongsWithMissingFingerprint(subdir.path)) return false;
+#endif
+
+  // A single stat tells if the directory was modified, and the snapshot if it was replaced by one with the same mtime.
+  CollectionSnapshot::Entry entry;
+  if (!CollectionSnapshot::Stat(subdir.path, &entry) || entry.mtime != subdir.mtime) return false;
+
+  return !snapshot_ || !snapshot_->ChangedSinceScan(subdir.path, entry);
+
+}
+
 void CollectionWatcher::ScanSubdirectory(const QString &path, const CollectionSubdirectory &subdir, const quint64 files_count, ScanTransaction *t, const bool force_noincremental) {
 
   QFileInfo path_info(path);
@@ -424,6 +679,9 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const CollectionSu
     }
   }
 
+  // Record the directory as it is before listing it, so changes made during the scan are found next time.
+  if (snapshot_) snapshot_->Update(path);
+
   bool songs_missing_fingerprint = false;
 #ifdef HAVE_SONGFINGERPRINTING
   if (song_tracking_) {
@@ -439,6 +697,7 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const CollectionSu
 
   QMap<QString, QStringList> album_art;
   QStringList files_on_disk;
+  QStringList files_to_check;
   CollectionSubdirectoryList my_new_subdirs;
 
   // If a directory is moved then only its parent gets a changed notification, so we need to look and see if any of our children don't exist anymore.
@@ -480,20 +739,39 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const CollectionSu
         album_art[dir_part] << child;
         t->AddToProgress(1);
       }
-      else if (TagReaderClient::Instance()->IsMediaFileBlocking(child)) {
-        files_on_disk << child;
-      }
       else {
-        t->AddToProgress(1);
+        files_to_check << child;
       }
     }
   }
 
   if (stop_requested_ || abort_requested_) return;
 
+  if (!files_to_check.isEmpty()) {
+    files_on_disk = FilterMediaFiles(files_to_check);
+    t->AddToProgress(static_cast<quint64>(files_to_check.count() - files_on_disk.count()));
+  }
+
+  if (stop_requested_ || abort_requested_) return;
+
   // Ask the database for a list of files in this directory
   SongList songs_in_db = t->FindSongsInSubdirectory(path);
 
+  // Read the tags of all new files at once, instead of waiting for each file in turn.
+  // The CUE mtimes of files which are not in the database are kept for ScanNewFile.
+  QStringList new_files;
+  QHash<QString, quint64> new_files_cue_mtime;
+  for (const QString &file : std::as_const(files_on_disk)) {
+    SongList matching_songs;
+    if (FindSongsByPath(songs_in_db, file, &matching_songs)) continue;
+    const quint64 cue_mtime = GetMtimeForCue(CueParser::FindCueFilename(file));
+    new_files_cue_mtime.insert(file, cue_mtime);
+    if (cue_mtime == 0) {
+      new_files << file;
+    }
+  }
+  const QHash<QString, Song> prefetched_songs = ReadFiles(new_files);
+
   QSet<QString> cues_processed;
 
   // Now compare the list from the database with the list of files on disk
@@ -644,7 +922,7 @@ void CollectionWatcher::ScanSubdirectory(const QString &path, const CollectionSu
       }
       else {  // The song is on disk but not in the DB
 
-        SongList songs = ScanNewFile(file, path, fingerprint, new_cue, &cues_processed);
+        SongList songs = ScanNewFile(file, path, fingerprint, new_cue, new_files_cue_mtime.contains(file) ? new_files_cue_mtime.value(file) : GetMtimeForCue(new_cue), &cues_processed, prefetched_songs);
         if (songs.isEmpty()) {
           t->AddToProgress(1);
           continue;
@@ -782,11 +1060,10 @@ void CollectionWatcher::UpdateNonCueAssociatedSong(const QString &file,
 
 }
 
-SongList CollectionWatcher::ScanNewFile(const QString &file, const QString &path, const QString &fingerprint, const QString &matching_cue, QSet<QString> *cues_processed) {
+SongList CollectionWatcher::ScanNewFile(const QString &file, const QString &path, const QString &fingerprint, const QString &matching_cue, const quint64 matching_cue_mtime, QSet<QString> *cues_processed, const QHash<QString, Song> &prefetched_songs) {
 
   SongList songs;
 
-  quint64 matching_cue_mtime = GetMtimeForCue(matching_cue);
   if (matching_cue_mtime != 0) {  // If it's a CUE - create virtual tracks
 
     // Don't process the same CUE many times
@@ -820,7 +1097,12 @@ SongList CollectionWatcher::ScanNewFile(const QString &file, const QString &path
   }
   else {  // It's a normal media file
     Song song(source_);
-    TagReaderClient::Instance()->ReadFileBlocking(file, &song);
+    if (prefetched_songs.contains(file)) {
+      song = prefetched_songs.value(file);
+    }
+    else {
+      TagReaderClient::Instance()->ReadFileBlocking(file, &song);
+    }
     if (song.is_valid()) {
       song.set_source(source_);
       song.set_fingerprint(fingerprint);
@@ -832,6 +1114,48 @@ SongList CollectionWatcher::ScanNewFile(const QString &file, const QString &path
 
 }
 
+QStringList CollectionWatcher::FilterMediaFiles(const QStringList &files) {
+
+  QList<TagReaderReply*> replies;
+  replies.reserve(files.count());
+  for (const QString &file : files) {
+    replies << TagReaderClient::Instance()->IsMediaFile(file);
+  }
+
+  QStringList media_files;
+  for (int i = 0; i < replies.count(); ++i) {
+    TagReaderReply *reply = replies[i];
+    if (reply->WaitForFinished() && reply->message().is_media_file_response().success()) {
+      media_files << files[i];
+    }
+    // Deleted right away, this also runs on the scan threads, which have no event loop.
+    delete reply;
+  }
+
+  return media_files;
+
+}
+
+QHash<QString, Song> CollectionWatcher::ReadFiles(const QStringList &files) {
+
+  QHash<QString, Song> songs;
+  if (files.isEmpty()) return songs;
+
+  SongList songs_read;
+  songs_read.reserve(files.count());
+  for (int i = 0; i < files.count(); ++i) {
+    songs_read << Song(source_);
+  }
+  TagReaderClient::Instance()->ReadFilesBatchBlocking(files, &songs_read);
+
+  for (int i = 0; i < files.count(); ++i) {
+    songs.insert(files[i], songs_read[i]);
+  }
+
+  return songs;
+
+}
+
 void CollectionWatcher::AddChangedSong(const QString &file, const Song &matching_song, const Song &new_song, ScanTransaction *t) {
 
   bool notify_new = false;
@@ -917,6 +1241,7 @@ void CollectionWatcher::AddWatch(const CollectionDirectory &dir, const QString &
   if (!QFile::exists(path)) return;
 
   QObject::connect(fs_watcher_, &FileSystemWatcherInterface::PathChanged, this, &CollectionWatcher::DirectoryChanged, Qt::UniqueConnection);
+  QObject::connect(fs_watcher_, &FileSystemWatcherInterface::PathMoved, this, &CollectionWatcher::FileMoved, Qt::UniqueConnection);
   fs_watcher_->AddPath(path);
   subdir_mapping_[path] = dir;
 
@@ -1009,6 +1334,36 @@ void CollectionWatcher::DirectoryChanged(const QString &subdir) {
 
 }
 
+void CollectionWatcher::FileMoved(const QString &old_path, const QString &new_path) {
+
+  const QString old_subdir = DirectoryPart(old_path);
+  const QString new_subdir = DirectoryPart(new_path);
+
+  QHash<QString, CollectionDirectory>::const_iterator old_it = subdir_mapping_.constFind(old_subdir);
+  QHash<QString, CollectionDirectory>::const_iterator new_it = subdir_mapping_.constFind(new_subdir);
+  if (old_it == subdir_mapping_.constEnd() || new_it == subdir_mapping_.constEnd()) {
+    DirectoryChanged(old_subdir);
+    DirectoryChanged(new_subdir);
+    return;
+  }
+
+  // Songs from cue sheets reference the audio file from the cue, leave those to a normal rescan.
+  const SongList songs = backend_->GetSongsByUrl(QUrl::fromLocalFile(old_path));
+  if (songs.isEmpty() || std::any_of(songs.begin(), songs.end(), [](const Song &song) { return song.has_cue(); })) {
+    DirectoryChanged(old_subdir);
+    DirectoryChanged(new_subdir);
+    return;
+  }
+
+  qLog(Debug) << "File" << old_path << "moved to" << new_path;
+
+  const QFileInfo new_file(new_path);
+  for (const Song &song : songs) {
+    emit SongPathChanged(song, new_file, new_it->id);
+  }
+
+}
+
 void CollectionWatcher::RescanPathsNow() {
 
   QList<int> dirs = rescan_queue_.keys();
@@ -1146,12 +1501,15 @@ void CollectionWatcher::PerformScan(const bool incremental, const bool ignore_mt
 
   stop_requested_ = false;
 
+  // Create one transaction per directory, all directories are scanned at the same time.
+  QList<ScanTransaction*> transactions;
+  QList<ScanRequest> requests;
   for (const CollectionDirectory &dir : std::as_const(watched_dirs_)) {
 
     if (stop_requested_ || abort_requested_) break;
 
-    ScanTransaction transaction(this, dir.id, incremental, ignore_mtimes, mark_songs_unavailable_);
-    CollectionSubdirectoryList subdirs(transaction.GetAllSubdirs());
+    ScanTransaction *transaction = new ScanTransaction(this, dir.id, incremental, ignore_mtimes, mark_songs_unavailable_);
+    CollectionSubdirectoryList subdirs(transaction->GetAllSubdirs());
 
     if (subdirs.isEmpty()) {
       qLog(Debug) << "Collection directory wasn't in subdir list.";
@@ -1161,17 +1519,16 @@ void CollectionWatcher::PerformScan(const bool incremental, const bool ignore_mt
       subdirs << subdir;
     }
 
-    QMap<QString, quint64> subdir_files_count;
-    quint64 files_count = FilesCountForSubdirs(&transaction, subdirs, subdir_files_count);
-    transaction.AddToProgressMax(files_count);
-
-    for (const CollectionSubdirectory &subdir : subdirs) {
-      if (stop_requested_ || abort_requested_) break;
-      ScanSubdirectory(subdir.path, subdir, subdir_files_count[subdir.path], &transaction);
-    }
+    transactions << transaction;
+    requests << ScanRequest(transaction, subdirs);
 
   }
 
+  ScanSubdirectoriesParallel(requests);
+
+  // Commits the transactions in order.
+  qDeleteAll(transactions);
+
   last_scan_time_ = QDateTime::currentDateTime().toSecsSinceEpoch();
 
   emit CompilationsNeedUpdating();
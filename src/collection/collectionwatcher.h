@@ -24,11 +24,16 @@
 
 #include "config.h"
 
+#include <memory>
+#include <optional>
+
 #include <QtGlobal>
 #include <QObject>
 #include <QHash>
 #include <QMap>
 #include <QMultiMap>
+#include <QMutex>
+#include <QFileInfo>
 #include <QSet>
 #include <QString>
 #include <QStringList>
@@ -38,9 +43,11 @@
 #include "core/song.h"
 
 class QThread;
+class QThreadPool;
 class QTimer;
 
 class CollectionBackend;
+class CollectionSnapshot;
 class FileSystemWatcherInterface;
 class TaskManager;
 class CueParser;
@@ -50,12 +57,18 @@ class CollectionWatcher : public QObject {
 
  public:
   explicit CollectionWatcher(Song::Source source, QObject *parent = nullptr);
+  ~CollectionWatcher() override;
+
+  // Number of chunks the subdirectories are split into for each scan thread, so the threads stay busy when some subtrees are larger than others.
+  static const int kScanChunksPerThread;
 
   Song::Source source() { return source_; }
 
   void set_backend(CollectionBackend *backend) { backend_ = backend; }
   void set_task_manager(TaskManager *task_manager) { task_manager_ = task_manager; }
   void set_device_name(const QString &device_name) { device_name_ = device_name; }
+  // Number of threads scanning the subdirectories, the ideal thread count by default.
+  void set_scan_thread_count(const int count);
 
   void IncrementalScanAsync();
   void FullScanAsync();
@@ -73,6 +86,7 @@ class CollectionWatcher : public QObject {
   void NewOrUpdatedSongs(SongList);
   void SongsMTimeUpdated(SongList);
   void SongsDeleted(SongList);
+  void SongPathChanged(Song song, QFileInfo new_file, std::optional<int> new_collection_directory_id);
   void SongsUnavailable(SongList songs, bool unavailable = true);
   void SongsReadded(SongList songs, bool unavailable = false);
   void SubdirsDiscovered(CollectionSubdirectoryList subdirs);
@@ -98,6 +112,9 @@ class CollectionWatcher : public QObject {
   class ScanTransaction {
    public:
     ScanTransaction(CollectionWatcher *watcher, const int dir, const bool incremental, const bool ignores_mtime, const bool mark_songs_unavailable);
+    // Creates a child transaction used to scan a part of the parent's subdirectories on the scan thread pool.
+    // The child shares the caches and progress of the parent, the results are moved to the parent with MergeChild().
+    explicit ScanTransaction(ScanTransaction *parent);
     ~ScanTransaction();
 
     SongList FindSongsInSubdirectory(const QString &path);
@@ -113,6 +130,9 @@ class CollectionWatcher : public QObject {
     // Emits the signals for new & deleted songs etc and clears the lists. This causes the new stuff to be updated on UI.
     void CommitNewOrUpdatedSongs();
 
+    // Moves the results of a finished child transaction into this transaction.
+    void MergeChild(ScanTransaction *child);
+
     int dir() const { return dir_; }
     bool is_incremental() const { return incremental_; }
     bool ignores_mtime() const { return ignores_mtime_; }
@@ -131,6 +151,14 @@ class CollectionWatcher : public QObject {
     ScanTransaction(const ScanTransaction&) {}
     ScanTransaction &operator=(const ScanTransaction&) { return *this; }
 
+    // Must be called with mutex_ locked.
+    void UpdateKnownSubdirs();
+
+    ScanTransaction *parent_;
+
+    // Protects the caches and progress when child transactions are running.
+    QMutex mutex_;
+
     int task_id_;
     quint64 progress_;
     quint64 progress_max_;
@@ -160,10 +188,19 @@ class CollectionWatcher : public QObject {
     bool known_subdirs_dirty_;
   };
 
+  // A transaction and the subdirectories to scan for it.
+  struct ScanRequest {
+    ScanRequest() : transaction(nullptr) {}
+    ScanRequest(ScanTransaction *_transaction, const CollectionSubdirectoryList &_subdirs) : transaction(_transaction), subdirs(_subdirs) {}
+    ScanTransaction *transaction;
+    CollectionSubdirectoryList subdirs;
+  };
+
  private slots:
   void ReloadSettings();
   void Exit();
   void DirectoryChanged(const QString &subdir);
+  void FileMoved(const QString &old_path, const QString &new_path);
   void IncrementalScanCheck();
   void IncrementalScanNow();
   void FullScanNow();
@@ -185,13 +222,26 @@ class CollectionWatcher : public QObject {
   static quint64 GetMtimeForCue(const QString &cue_path);
   void PerformScan(const bool incremental, const bool ignore_mtimes);
 
+  // Splits the subdirectories of each request into chunks and scans them in parallel on the scan thread pool.
+  // The results are merged back into the transactions in the same order as the subdirectories were given.
+  void ScanSubdirectoriesParallel(const QList<ScanRequest> &requests);
+  void ScanSubdirectoriesJob(ScanTransaction *t, const CollectionSubdirectoryList &subdirs);
+  // Returns true if the subdirectory can be skipped without listing it, because its mtime and the snapshot from the last scan still match.
+  bool SubdirUnchanged(ScanTransaction *t, const CollectionSubdirectory &subdir);
+  // Returns the directory and it's first levels of subdirectories, so a new directory can be scanned in parallel.
+  CollectionSubdirectoryList SplitNewDirectory(const QString &path);
+
+  // Sends the requests for all files to the tagreader at once, so all the workers are kept busy.
+  QStringList FilterMediaFiles(const QStringList &files);
+  QHash<QString, Song> ReadFiles(const QStringList &files);
+
   // Updates the sections of a cue associated and altered (according to mtime) media file during a scan.
   void UpdateCueAssociatedSongs(const QString &file, const QString &path, const QString &fingerprint, const QString &matching_cue, const QUrl &image, const SongList &old_cue_songs, ScanTransaction *t);
   // Updates a single non-cue associated and altered (according to mtime) song during a scan.
   void UpdateNonCueAssociatedSong(const QString &file, const QString &fingerprint, const SongList &matching_songs, const QUrl &image, const bool cue_deleted, ScanTransaction *t);
   // Scans a single media file that's present on the disk but not yet in the collection.
   // It may result in a multiple files added to the collection when the media file has many sections (like a CUE related media file).
-  SongList ScanNewFile(const QString &file, const QString &path, const QString &fingerprint, const QString &matching_cue, QSet<QString> *cues_processed);
+  SongList ScanNewFile(const QString &file, const QString &path, const QString &fingerprint, const QString &matching_cue, const quint64 matching_cue_mtime, QSet<QString> *cues_processed, const QHash<QString, Song> &prefetched_songs = QHash<QString, Song>());
 
   static void AddChangedSong(const QString &file, const Song &matching_song, const Song &new_song, ScanTransaction *t);
 
@@ -208,6 +258,8 @@ class CollectionWatcher : public QObject {
 
   FileSystemWatcherInterface *fs_watcher_;
   QThread *original_thread_;
+  QThreadPool *scan_thread_pool_;
+  std::unique_ptr<CollectionSnapshot> snapshot_;
   QHash<QString, CollectionDirectory> subdir_mapping_;
 
   // A list of words use to try to identify the (likely) best image found in an directory to use as cover artwork.
@@ -21,6 +21,8 @@
 
 #include "config.h"
 
+#include <utility>
+
 #include <sqlite3.h>
 #include <boost/scope_exit.hpp>
 
@@ -37,6 +39,7 @@
 #include <QUrl>
 #include <QSqlDriver>
 #include <QSqlDatabase>
+#include <QSqlQuery>
 #include <QSqlError>
 #include <QStandardPaths>
 
@@ -45,10 +48,11 @@
 #include "database.h"
 #include "application.h"
 #include "sqlquery.h"
+#include "sqlstatementcache.h"
 #include "scopedtransaction.h"
 
 const char *Database::kDatabaseFilename = "strawberry.db";
-const int Database::kSchemaVersion = 16;
+const int Database::kSchemaVersion = 18;
 const int Database::kMinSupportedSchemaVersion = 10;
 const char *Database::kMagicAllSongsTables = "%allsongstables";
 
@@ -64,7 +68,8 @@ Database::Database(Application *app, QObject *parent, const QString &database_na
       injected_database_name_(database_name),
       query_hash_(0),
       startup_schema_version_(-1),
-      original_thread_(nullptr) {
+      original_thread_(nullptr),
+      wal_enabled_(false) {
 
   original_thread_ = thread();
 
@@ -76,7 +81,21 @@ Database::Database(Application *app, QObject *parent, const QString &database_na
   directory_ = QDir::toNativeSeparators(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
 
   QMutexLocker l(&mutex_);
-  Connect();
+  QSqlDatabase db(Connect());
+
+  // WAL lets readers on other connections run while a write transaction is open.
+  // The journal mode is stored in the database file, in-memory databases don't support it.
+  if (db.isOpen() && injected_database_name_ != ":memory:") {
+    SqlQuery q(db);
+    q.prepare("PRAGMA journal_mode = WAL");
+    if (q.Exec() && q.next() && q.value(0).toString().compare("wal", Qt::CaseInsensitive) == 0) {
+      wal_enabled_ = true;
+      QSqlQuery(db).exec("PRAGMA synchronous = NORMAL");
+    }
+    else {
+      qLog(Warning) << "Could not enable WAL journal mode, reads will be serialized with writes.";
+    }
+  }
 
 }
 
@@ -88,6 +107,19 @@ Database::~Database() {
     qLog(Error) << "Connection" << connection_id << "is still open!";
   }
 
+  // The statements can only be finalized by the thread that opened the connection.
+  // Connections of other threads should have been closed already, their caches are left behind with them.
+  const QString connection_id = QString("%1_thread_%2").arg(connection_id_).arg(reinterpret_cast<quint64>(QThread::currentThread()));
+  for (QHash<QString, SqlStatementCache*>::iterator it = statement_caches_.begin(); it != statement_caches_.end();) {
+    if (it.key() == connection_id || it.key() == connection_id + "_readonly") {
+      delete it.value();
+    }
+    else {
+      qLog(Error) << "Statement cache for connection" << it.key() << "is still open!";
+    }
+    it = statement_caches_.erase(it);
+  }
+
 }
 
 void Database::ExitAsync() {
@@ -188,6 +220,67 @@ QSqlDatabase Database::Connect() {
     }
   }
 
+  if (wal_enabled_) {
+    // Commits in WAL mode are safe without syncing, only the checkpoints need to be synced.
+    QSqlQuery(db).exec("PRAGMA synchronous = NORMAL");
+  }
+
+  if (!statement_caches_.contains(connection_id)) {
+    statement_caches_.insert(connection_id, new SqlStatementCache(connection_id));
+  }
+
+  return db;
+
+}
+
+QSqlDatabase Database::ConnectReadOnly() {
+
+  QMutexLocker l(&connect_mutex_);
+
+  const QString connection_id = QString("%1_thread_%2_readonly").arg(connection_id_).arg(reinterpret_cast<quint64>(QThread::currentThread()));
+
+  QSqlDatabase db;
+  if (QSqlDatabase::connectionNames().contains(connection_id)) {
+    db = QSqlDatabase::database(connection_id);
+  }
+  else {
+    db = QSqlDatabase::addDatabase("QSQLITE", connection_id);
+  }
+  if (db.isOpen()) {
+    return db;
+  }
+  db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=30000;QSQLITE_OPEN_READONLY");
+
+  if (injected_database_name_.isNull()) {
+    db.setDatabaseName(directory_ + "/" + kDatabaseFilename);
+  }
+  else {
+    db.setDatabaseName(injected_database_name_);
+  }
+
+  if (!db.open()) {
+    qLog(Error) << "Could not open read-only database connection:" << db.lastError().text();
+    return db;
+  }
+
+  // Attach the external databases, temporary databases only exist on the read-write connections.
+  const QStringList keys = attached_databases_.keys();
+  for (const QString &key : keys) {
+    if (attached_databases_[key].is_temporary_) continue;
+    const QString filename = injected_database_name_.isNull() ? attached_databases_[key].filename_ : injected_database_name_;
+    SqlQuery q(db);
+    q.prepare("ATTACH DATABASE :filename AS :alias");
+    q.BindValue(":filename", filename);
+    q.BindValue(":alias", key);
+    if (!q.Exec()) {
+      qLog(Error) << "Couldn't attach external database" << key << "on read-only connection";
+    }
+  }
+
+  if (!statement_caches_.contains(connection_id)) {
+    statement_caches_.insert(connection_id, new SqlStatementCache(connection_id));
+  }
+
   return db;
 
 }
@@ -198,6 +291,25 @@ void Database::Close() {
 
   const QString connection_id = QString("%1_thread_%2").arg(connection_id_).arg(reinterpret_cast<quint64>(QThread::currentThread()));
 
+  CloseConnection(connection_id);
+  CloseConnection(connection_id + "_readonly");
+
+}
+
+void Database::CloseConnection(const QString &connection_id) {
+
+  // The cached statements have to be finalized before the connection can be closed.
+  if (statement_caches_.contains(connection_id)) {
+    SqlStatementCache *statement_cache = statement_caches_.take(connection_id);
+    const SqlStatementCache::Statistics statistics = statement_cache->statistics();
+    qLog(Debug) << "Statement cache for connection" << connection_id << "had" << statistics.hits << "hits," << statistics.misses << "misses," << statistics.evictions << "evictions and" << statistics.reparsed << "re-prepared statements";
+    closed_statement_cache_statistics_.hits += statistics.hits;
+    closed_statement_cache_statistics_.misses += statistics.misses;
+    closed_statement_cache_statistics_.evictions += statistics.evictions;
+    closed_statement_cache_statistics_.reparsed += statistics.reparsed;
+    delete statement_cache;
+  }
+
   // Try to find an existing connection for this thread
   if (QSqlDatabase::connectionNames().contains(connection_id)) {
     {
@@ -212,6 +324,44 @@ void Database::Close() {
 
 }
 
+SqlStatementCache::Statistics Database::statement_cache_statistics() {
+
+  QMutexLocker l(&connect_mutex_);
+
+  SqlStatementCache::Statistics ret = closed_statement_cache_statistics_;
+  for (SqlStatementCache *statement_cache : std::as_const(statement_caches_)) {
+    const SqlStatementCache::Statistics statistics = statement_cache->statistics();
+    ret.hits += statistics.hits;
+    ret.misses += statistics.misses;
+    ret.evictions += statistics.evictions;
+    ret.reparsed += statistics.reparsed;
+  }
+
+  return ret;
+
+}
+
+DatabaseReadLocker::DatabaseReadLocker(Database *database) : database_(database), locked_(false) {
+
+  if (database_->wal_enabled()) {
+    db_ = database_->ConnectReadOnly();
+    if (db_.isOpen()) return;
+  }
+
+  database_->Mutex()->lock();
+  locked_ = true;
+  db_ = database_->Connect();
+
+}
+
+DatabaseReadLocker::~DatabaseReadLocker() {
+
+  if (locked_) {
+    database_->Mutex()->unlock();
+  }
+
+}
+
 int Database::SchemaVersion(QSqlDatabase *db) {
 
   // Get the database's schema version
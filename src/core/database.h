@@ -30,6 +30,7 @@
 #include <QObject>
 #include <QMutex>
 #include <QMap>
+#include <QHash>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QString>
@@ -39,6 +40,7 @@
 #endif
 
 #include "sqlquery.h"
+#include "sqlstatementcache.h"
 
 class QThread;
 class Application;
@@ -67,9 +69,16 @@ class Database : public QObject {
 
   void ExitAsync();
   QSqlDatabase Connect();
+  // Read-only connection for the current thread, reads through it only see committed data and don't need Mutex().
+  // Only useful when wal_enabled() is true, use DatabaseReadLocker to pick the right connection.
+  QSqlDatabase ConnectReadOnly();
   void Close();
+  bool wal_enabled() const { return wal_enabled_; }
   void ReportErrors(const SqlQuery &query);
 
+  // Prepared statement cache statistics for all connections opened by this database.
+  SqlStatementCache::Statistics statement_cache_statistics();
+
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
   QRecursiveMutex *Mutex() { return &mutex_; }
 #else
@@ -98,6 +107,7 @@ class Database : public QObject {
   void DoBackup();
 
  private:
+  void CloseConnection(const QString &connection_id);
   static int SchemaVersion(QSqlDatabase *db);
   void UpdateMainSchema(QSqlDatabase *db);
 
@@ -133,6 +143,10 @@ class Database : public QObject {
   // Used by tests
   QString injected_database_name_;
 
+  // Connection name -> prepared statements of that connection
+  QHash<QString, SqlStatementCache*> statement_caches_;
+  SqlStatementCache::Statistics closed_statement_cache_statistics_;
+
   uint query_hash_;
   QStringList query_cache_;
 
@@ -141,6 +155,26 @@ class Database : public QObject {
 
   QThread *original_thread_;
 
+  bool wal_enabled_;
+
+};
+
+// Connection for running read queries.
+// When the database is in WAL mode a read-only connection is used without locking Database::Mutex(), so readers don't wait for writers.
+// Otherwise the mutex is locked for the lifetime of the locker and the normal connection is used.
+class DatabaseReadLocker {
+ public:
+  explicit DatabaseReadLocker(Database *database);
+  ~DatabaseReadLocker();
+
+  QSqlDatabase db() const { return db_; }
+
+ private:
+  Q_DISABLE_COPY(DatabaseReadLocker)
+
+  Database *database_;
+  QSqlDatabase db_;
+  bool locked_;
 };
 
 class MemoryDatabase : public Database {
@@ -151,7 +185,7 @@ class MemoryDatabase : public Database {
       : Database(app, parent, ":memory:") {}
   ~MemoryDatabase() override {
     // Make sure Qt doesn't reuse the same database
-    QSqlDatabase::removeDatabase(Connect().connectionName());
+    Close();
   }
 };
 
@@ -34,6 +34,8 @@
 
 #include "filesystemmusicstorage.h"
 
+const int FilesystemMusicStorage::kMaxParallelCopies = 4;
+
 FilesystemMusicStorage::FilesystemMusicStorage(const Song::Source source, const QString &root, const std::optional<int> collection_directory_id) : source_(source), root_(root), collection_directory_id_(collection_directory_id) {}
 
 bool FilesystemMusicStorage::CopyToStorage(const CopyJob &job) {
@@ -88,7 +90,7 @@ bool FilesystemMusicStorage::CopyToStorage(const CopyJob &job) {
       result = false;
     }
     else {
-      result = QFile::copy(src.absoluteFilePath(), dest.absoluteFilePath());
+      result = Utilities::CopyFileFast(src.absoluteFilePath(), dest.absoluteFilePath());
     }
     if ((!cover_dest.exists() || job.overwrite_) && !cover_src.filePath().isEmpty() && !cover_dest.filePath().isEmpty()) {
       QFile::copy(cover_src.absoluteFilePath(), cover_dest.absoluteFilePath());
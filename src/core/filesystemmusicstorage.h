@@ -35,10 +35,13 @@ class FilesystemMusicStorage : public virtual MusicStorage {
  public:
   explicit FilesystemMusicStorage(const Song::Source source, const QString &root, const std::optional<int> collection_directory_id = std::optional<int>());
 
+  static const int kMaxParallelCopies;
+
   Song::Source source() const override { return source_; }
   QString LocalPath() const override { return root_; }
   std::optional<int> collection_directory_id() const override { return collection_directory_id_; }
 
+  int MaxParallelCopies() const override { return kMaxParallelCopies; }
   bool CopyToStorage(const CopyJob &job) override;
   bool DeleteFromStorage(const DeleteJob &job) override;
 
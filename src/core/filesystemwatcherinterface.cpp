@@ -29,6 +29,10 @@
 #  include "macfslistener.h"
 #endif
 
+#ifdef Q_OS_LINUX
+#  include "inotifyfslistener.h"
+#endif
+
 FileSystemWatcherInterface::FileSystemWatcherInterface(QObject *parent)
     : QObject(parent) {}
 
@@ -36,6 +40,8 @@ FileSystemWatcherInterface *FileSystemWatcherInterface::Create(QObject *parent)
 
 #ifdef Q_OS_MACOS
   FileSystemWatcherInterface *ret = new MacFSListener(parent);
+#elif defined(Q_OS_LINUX)
+  FileSystemWatcherInterface *ret = new InotifyFSListener(parent);
 #else
   FileSystemWatcherInterface *ret = new QtFSListener(parent);
 #endif
@@ -41,6 +41,7 @@ class FileSystemWatcherInterface : public QObject {
 
  signals:
   void PathChanged(QString path);
+  void PathMoved(QString old_path, QString new_path);
 };
 
 #endif
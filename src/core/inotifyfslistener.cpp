@@ -0,0 +1,281 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include <QtGlobal>
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QString>
+
+#include "core/logging.h"
+#include "filesystemwatcherinterface.h"
+#include "inotifyfslistener.h"
+
+const int InotifyFSListener::kDebounceIntervalMsec = 500;
+const int InotifyFSListener::kMaxDelayMsec = 5000;
+const int InotifyFSListener::kPollIntervalMsec = 30000;
+
+namespace {
+constexpr quint32 kWatchMask = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+}
+
+InotifyFSListener::InotifyFSListener(QObject *parent)
+    : FileSystemWatcherInterface(parent),
+      fd_(-1),
+      init_error_(0),
+      notifier_(nullptr),
+      debounce_timer_(new QTimer(this)),
+      poll_timer_(new QTimer(this)) {
+
+  debounce_timer_->setSingleShot(true);
+  debounce_timer_->setInterval(kDebounceIntervalMsec);
+  QObject::connect(debounce_timer_, &QTimer::timeout, this, &InotifyFSListener::FlushChanges);
+
+  poll_timer_->setInterval(kPollIntervalMsec);
+  QObject::connect(poll_timer_, &QTimer::timeout, this, &InotifyFSListener::PollPaths);
+
+}
+
+InotifyFSListener::~InotifyFSListener() {
+
+  if (fd_ != -1) {
+    close(fd_);
+  }
+
+}
+
+void InotifyFSListener::Init() {
+
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd_ == -1) {
+    init_error_ = errno;
+    qLog(Error) << "Failed to initialize inotify:" << strerror(init_error_) << "- falling back to polling";
+    return;
+  }
+
+  notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+  QObject::connect(notifier_, &QSocketNotifier::activated, this, &InotifyFSListener::ReadEvents);
+
+}
+
+int InotifyFSListener::AddWatch(const QString &path) {
+
+  // Not initialized, or inotify could not be initialized.
+  if (fd_ == -1) return init_error_ != 0 ? init_error_ : EBADF;
+
+  const int wd = inotify_add_watch(fd_, QFile::encodeName(path).constData(), kWatchMask);
+  if (wd == -1) return errno;
+
+  watches_.insert(wd, path);
+  watch_descriptors_.insert(path, wd);
+
+  return 0;
+
+}
+
+void InotifyFSListener::AddPath(const QString &path) {
+
+  if (watch_descriptors_.contains(path) || polled_paths_.contains(path)) return;
+
+  const int error = AddWatch(path);
+  if (error == 0) return;
+
+  // Without inotify, or when the watch limit is reached, the path is polled instead.
+  if (fd_ == -1 || error == ENOSPC || error == ENOMEM) {
+    if (polled_paths_.isEmpty()) {
+      if (fd_ == -1) {
+        qLog(Warning) << "Inotify is not available, polling" << path << "and any further paths every" << kPollIntervalMsec / 1000 << "seconds";
+      }
+      else {
+        qLog(Warning) << "Inotify watch limit reached, polling" << path << "and any further paths every" << kPollIntervalMsec / 1000 << "seconds";
+      }
+    }
+    polled_paths_.insert(path, PathMTime(path));
+    if (!poll_timer_->isActive()) poll_timer_->start();
+  }
+  else {
+    qLog(Error) << "Failed to add watch for path" << path << strerror(error);
+  }
+
+}
+
+void InotifyFSListener::RemovePath(const QString &path) {
+
+  if (polled_paths_.remove(path) > 0) {
+    if (polled_paths_.isEmpty()) poll_timer_->stop();
+    return;
+  }
+
+  if (!watch_descriptors_.contains(path)) {
+    qLog(Error) << "Failed to remove watch for path" << path;
+    return;
+  }
+
+  const int wd = watch_descriptors_.take(path);
+  watches_.remove(wd);
+  inotify_rm_watch(fd_, wd);
+
+}
+
+void InotifyFSListener::Clear() {
+
+  for (QHash<int, QString>::const_iterator it = watches_.constBegin(); it != watches_.constEnd(); ++it) {
+    inotify_rm_watch(fd_, it.key());
+  }
+  watches_.clear();
+  watch_descriptors_.clear();
+  polled_paths_.clear();
+  poll_timer_->stop();
+
+  pending_changes_.clear();
+  pending_moves_.clear();
+  pending_elapsed_.invalidate();
+  debounce_timer_->stop();
+
+}
+
+void InotifyFSListener::ReadEvents() {
+
+  alignas(struct inotify_event) char buffer[64 * 1024];
+
+  forever {
+    const ssize_t len = read(fd_, buffer, sizeof(buffer));
+    if (len <= 0) break;
+
+    for (char *ptr = buffer; ptr < buffer + len;) {
+      const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        qLog(Warning) << "Inotify event queue overflowed, rescanning all watched paths";
+        for (const QString &path : watches_) {
+          QueueChange(path);
+        }
+        continue;
+      }
+
+      if (!watches_.contains(event->wd)) continue;
+      const QString dir = watches_.value(event->wd);
+
+      if (event->mask & IN_IGNORED) {
+        watches_.remove(event->wd);
+        watch_descriptors_.remove(dir);
+        continue;
+      }
+
+      if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF) || event->len == 0) {
+        QueueChange(dir);
+        continue;
+      }
+
+      const QString path = dir + QLatin1Char('/') + QFile::decodeName(event->name);
+      const bool is_dir = event->mask & IN_ISDIR;
+
+      if (event->mask & IN_MOVED_FROM) {
+        // Hold the source until the matching IN_MOVED_TO arrives, unpaired moves are flushed as changes.
+        pending_moves_.insert(event->cookie, PendingMove { dir, path, is_dir });
+        if (!debounce_timer_->isActive()) debounce_timer_->start();
+        continue;
+      }
+
+      if (event->mask & IN_MOVED_TO && pending_moves_.contains(event->cookie)) {
+        const PendingMove move = pending_moves_.take(event->cookie);
+        if (!is_dir && !move.is_dir) {
+          emit PathMoved(move.path, path);
+          continue;
+        }
+        QueueChange(move.dir);
+      }
+
+      QueueChange(dir);
+    }
+  }
+
+}
+
+void InotifyFSListener::QueueChange(const QString &path) {
+
+  pending_changes_ << path;
+
+  if (!pending_elapsed_.isValid()) pending_elapsed_.start();
+
+  // Keep postponing while events keep coming in, but don't hold changes back for longer than kMaxDelayMsec.
+  if (pending_elapsed_.elapsed() >= kMaxDelayMsec) {
+    debounce_timer_->start(0);
+  }
+  else {
+    debounce_timer_->start(kDebounceIntervalMsec);
+  }
+
+}
+
+void InotifyFSListener::FlushChanges() {
+
+  for (const PendingMove &move : pending_moves_) {
+    pending_changes_ << move.dir;
+  }
+  pending_moves_.clear();
+
+  const QSet<QString> changes = pending_changes_;
+  pending_changes_.clear();
+  pending_elapsed_.invalidate();
+
+  for (const QString &path : changes) {
+    emit PathChanged(path);
+  }
+
+}
+
+void InotifyFSListener::PollPaths() {
+
+  for (QHash<QString, qint64>::iterator it = polled_paths_.begin(); it != polled_paths_.end();) {
+    const QString path = it.key();
+    const qint64 mtime = PathMTime(path);
+    const bool changed = mtime != it.value();
+    if (AddWatch(path) == 0) {
+      // Watches have been freed up since, stop polling this path.
+      it = polled_paths_.erase(it);
+    }
+    else {
+      it.value() = mtime;
+      ++it;
+    }
+    if (changed) QueueChange(path);
+  }
+
+  if (polled_paths_.isEmpty()) poll_timer_->stop();
+
+}
+
+qint64 InotifyFSListener::PathMTime(const QString &path) {
+
+  const QDateTime last_modified = QFileInfo(path).lastModified();
+  return last_modified.isValid() ? last_modified.toMSecsSinceEpoch() : 0;
+
+}
@@ -0,0 +1,92 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INOTIFYFSLISTENER_H
+#define INOTIFYFSLISTENER_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QElapsedTimer>
+
+#include "filesystemwatcherinterface.h"
+
+class QTimer;
+class QSocketNotifier;
+
+// Linux listener reading raw inotify events.
+// Changes are coalesced per directory and emitted after a short debounce interval,
+// renames inside watched directories are paired by cookie and emitted as PathMoved.
+// Paths that can't be watched because the inotify watch limit is reached are polled instead.
+class InotifyFSListener : public FileSystemWatcherInterface {
+  Q_OBJECT
+
+ public:
+  explicit InotifyFSListener(QObject *parent = nullptr);
+  ~InotifyFSListener() override;
+
+  void Init() override;
+  void AddPath(const QString &path) override;
+  void RemovePath(const QString &path) override;
+  void Clear() override;
+
+ protected:
+  // Returns 0 if the path is watched, otherwise the errno of the failed inotify call.
+  virtual int AddWatch(const QString &path);
+
+ private:
+  struct PendingMove {
+    QString dir;
+    QString path;
+    bool is_dir;
+  };
+
+  void QueueChange(const QString &path);
+  static qint64 PathMTime(const QString &path);
+
+ private slots:
+  void ReadEvents();
+  void FlushChanges();
+  void PollPaths();
+
+ private:
+  static const int kDebounceIntervalMsec;
+  static const int kMaxDelayMsec;
+  static const int kPollIntervalMsec;
+
+  int fd_;
+  int init_error_;
+  QSocketNotifier *notifier_;
+  QTimer *debounce_timer_;
+  QTimer *poll_timer_;
+  QElapsedTimer pending_elapsed_;
+
+  QHash<int, QString> watches_;
+  QHash<QString, int> watch_descriptors_;
+  QHash<QString, qint64> polled_paths_;
+
+  QSet<QString> pending_changes_;
+  QHash<quint32, PendingMove> pending_moves_;
+};
+
+#endif  // INOTIFYFSLISTENER_H
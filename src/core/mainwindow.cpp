@@ -2104,14 +2104,7 @@ void MainWindow::EditTracks() {
 
 void MainWindow::EditTagDialogAccepted() {
 
-  for (PlaylistItemPtr item : edit_tag_dialog_->playlist_items()) {
-    item->Reload();
-  }
-
-  // FIXME: This is really lame but we don't know what rows have changed.
-  ui_->playlist->view()->update();
-
-  app_->playlist_manager()->current()->ScheduleSaveAsync();
+  app_->playlist_manager()->current()->ReloadItems(edit_tag_dialog_->playlist_items());
 
 }
 
@@ -2961,14 +2954,9 @@ void MainWindow::AutoCompleteTags() {
 
 void MainWindow::AutoCompleteTagsAccepted() {
 
-  for (PlaylistItemPtr item : autocomplete_tag_items_) {
-    item->Reload();
-  }
+  app_->playlist_manager()->current()->ReloadItems(autocomplete_tag_items_);
   autocomplete_tag_items_.clear();
 
-  // This is really lame but we don't know what rows have changed
-  ui_->playlist->view()->update();
-
 }
 
 void MainWindow::HandleNotificationPreview(const OSDBase::Behaviour type, const QString &line1, const QString &line2) {
@@ -56,6 +56,7 @@
 #include "collection/collectiondirectory.h"
 #include "playlist/playlistitem.h"
 #include "playlist/playlistsequence.h"
+#include "playlist/playlistbackend.h"
 #include "covermanager/albumcoverloaderresult.h"
 #include "covermanager/albumcoverfetcher.h"
 #include "covermanager/coversearchstatistics.h"
@@ -122,6 +123,7 @@ void RegisterMetaTypes() {
   qRegisterMetaType<PlaylistItemPtrList>("PlaylistItemPtrList");
   qRegisterMetaType<PlaylistSequence::RepeatMode>("PlaylistSequence::RepeatMode");
   qRegisterMetaType<PlaylistSequence::ShuffleMode>("PlaylistSequence::ShuffleMode");
+  qRegisterMetaType<PlaylistBackend::Changes>("PlaylistBackend::Changes");
   qRegisterMetaType<AlbumCoverLoaderResult>("AlbumCoverLoaderResult");
   qRegisterMetaType<AlbumCoverLoaderResult::Type>("AlbumCoverLoaderResult::Type");
   qRegisterMetaType<CoverProviderSearchResult>("CoverProviderSearchResult");
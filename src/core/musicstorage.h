@@ -88,6 +88,8 @@ class MusicStorage {
   virtual bool GetSupportedFiletypes(QList<Song::FileType> *ret) { Q_UNUSED(ret); return true; }
 
   virtual bool StartCopy(QList<Song::FileType> *supported_types) { Q_UNUSED(supported_types); return true; }
+  // How many CopyToStorage calls can run at the same time, from different threads.
+  virtual int MaxParallelCopies() const { return 1; }
   virtual bool CopyToStorage(const CopyJob &job) = 0;
   virtual void FinishCopy(bool success) { Q_UNUSED(success); }
 
@@ -21,11 +21,23 @@
 #include "config.h"
 
 #include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QVariant>
+#include <QString>
 
 #include "core/logging.h"
 #include "scopedtransaction.h"
 
-ScopedTransaction::ScopedTransaction(QSqlDatabase *db) : db_(db), pending_(true) {
+ScopedTransaction::ScopedTransaction(QSqlDatabase *db, const bool relaxed_sync) : db_(db), pending_(true), synchronous_(-1) {
+
+  // The synchronous setting can't be changed inside a transaction.
+  if (relaxed_sync) {
+    QSqlQuery q(*db);
+    if (q.exec("PRAGMA synchronous") && q.next()) {
+      synchronous_ = q.value(0).toInt();
+      q.exec("PRAGMA synchronous = OFF");
+    }
+  }
 
   db->transaction();
 
@@ -36,10 +48,21 @@ ScopedTransaction::~ScopedTransaction() {
   if (pending_) {
     qLog(Warning) << "Rolling back transaction";
     db_->rollback();
+    RestoreSynchronous();
   }
 
 }
 
+void ScopedTransaction::RestoreSynchronous() {
+
+  if (synchronous_ == -1) return;
+
+  QSqlQuery q(*db_);
+  q.exec(QString("PRAGMA synchronous = %1").arg(synchronous_));
+  synchronous_ = -1;
+
+}
+
 void ScopedTransaction::Commit() {
 
   if (!pending_) {
@@ -50,4 +73,6 @@ void ScopedTransaction::Commit() {
   db_->commit();
   pending_ = false;
 
+  RestoreSynchronous();
+
 }
@@ -29,16 +29,20 @@ class QSqlDatabase;
 
 // Opens a transaction on a database.
 // Rolls back the transaction if the object goes out of scope before Commit() is called.
+// With relaxed_sync, SQLite doesn't fsync until the transaction is finished, used for bulk imports.
 class ScopedTransaction : boost::noncopyable {
  public:
-  explicit ScopedTransaction(QSqlDatabase *db);
+  explicit ScopedTransaction(QSqlDatabase *db, const bool relaxed_sync = false);
   ~ScopedTransaction();
 
   void Commit();
 
  private:
+  void RestoreSynchronous();
+
   QSqlDatabase *db_;
   bool pending_;
+  int synchronous_;
 };
 
 #endif  // SCOPEDTRANSACTION_H
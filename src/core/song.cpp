@@ -55,6 +55,7 @@
 #include "utilities/coverutils.h"
 #include "utilities/timeconstants.h"
 #include "song.h"
+#include "stringpool.h"
 #include "application.h"
 #include "sqlquery.h"
 #include "mpris_common.h"
@@ -191,8 +192,6 @@ struct Song::Private : public QSharedData {
   QString composer_;
   QString performer_;
   QString grouping_;
-  QString comment_;
-  QString lyrics_;
 
   QString artist_id_;
   QString album_id_;
@@ -235,7 +234,6 @@ struct Song::Private : public QSharedData {
   float rating_;                // Database rating, initial rating read from tag.
 
   QString acoustid_id_;
-  QString acoustid_fingerprint_;
 
   QString musicbrainz_album_artist_id_;
   QString musicbrainz_artist_id_;
@@ -252,6 +250,17 @@ struct Song::Private : public QSharedData {
   bool init_from_file_;         // Whether this song was loaded from a file using taglib.
   bool suspicious_tags_;        // Whether our encoding guesser thinks these tags might be incorrectly encoded.
 
+  // Fields that are large or rarely set, kept out of line and only allocated when one of them is set.
+  struct Extension : public QSharedData {
+    QString comment_;
+    QString lyrics_;
+    QString acoustid_fingerprint_;
+  };
+  QSharedDataPointer<Extension> extension_;
+
+  const Extension &extension() const;
+  Extension *mutable_extension(const QString &value);
+
 };
 
 Song::Private::Private(const Source source)
@@ -295,6 +304,24 @@ Song::Private::Private(const Source source)
 
       {}
 
+const Song::Private::Extension &Song::Private::extension() const {
+
+  static const Extension kEmptyExtension;
+  return extension_ ? *extension_ : kEmptyExtension;
+
+}
+
+Song::Private::Extension *Song::Private::mutable_extension(const QString &value) {
+
+  if (!extension_) {
+    if (value.isEmpty()) return nullptr;
+    extension_ = new Extension;
+  }
+
+  return extension_.data();
+
+}
+
 Song::Song(const Source source) : d(new Private(source)) {}
 Song::Song(const Song &other) = default;
 Song::~Song() = default;
@@ -336,8 +363,8 @@ bool Song::compilation() const { return d->compilation_; }
 const QString &Song::composer() const { return d->composer_; }
 const QString &Song::performer() const { return d->performer_; }
 const QString &Song::grouping() const { return d->grouping_; }
-const QString &Song::comment() const { return d->comment_; }
-const QString &Song::lyrics() const { return d->lyrics_; }
+const QString &Song::comment() const { return d->extension().comment_; }
+const QString &Song::lyrics() const { return d->extension().lyrics_; }
 
 qint64 Song::beginning_nanosec() const { return d->beginning_; }
 qint64 Song::end_nanosec() const { return d->end_; }
@@ -464,7 +491,7 @@ bool Song::has_cue() const { return !d->cue_path_.isEmpty(); }
 float Song::rating() const { return d->rating_; }
 
 const QString &Song::acoustid_id() const { return d->acoustid_id_; }
-const QString &Song::acoustid_fingerprint() const { return d->acoustid_fingerprint_; }
+const QString &Song::acoustid_fingerprint() const { return d->extension().acoustid_fingerprint_; }
 
 const QString &Song::musicbrainz_album_artist_id() const { return d->musicbrainz_album_artist_id_; }
 const QString &Song::musicbrainz_artist_id() const { return d->musicbrainz_artist_id_; }
@@ -532,20 +559,24 @@ QString Song::sortable(const QString &v) {
 }
 
 void Song::set_title(const QString &v) { d->title_sortable_ = sortable(v); d->title_ = v; }
-void Song::set_album(const QString &v) { d->album_sortable_ = sortable(v); d->album_ = v; }
-void Song::set_artist(const QString &v) { d->artist_sortable_ = sortable(v); d->artist_ = v; }
-void Song::set_albumartist(const QString &v) { d->albumartist_sortable_ = sortable(v); d->albumartist_ = v; }
+void Song::set_album(const QString &v) { d->album_sortable_ = StringPool::Intern(sortable(v)); d->album_ = StringPool::Intern(v); }
+void Song::set_artist(const QString &v) { d->artist_sortable_ = StringPool::Intern(sortable(v)); d->artist_ = StringPool::Intern(v); }
+void Song::set_albumartist(const QString &v) { d->albumartist_sortable_ = StringPool::Intern(sortable(v)); d->albumartist_ = StringPool::Intern(v); }
 void Song::set_track(const int v) { d->track_ = v; }
 void Song::set_disc(const int v) { d->disc_ = v; }
 void Song::set_year(const int v) { d->year_ = v; }
 void Song::set_originalyear(const int v) { d->originalyear_ = v; }
-void Song::set_genre(const QString &v) { d->genre_ = v; }
+void Song::set_genre(const QString &v) { d->genre_ = StringPool::Intern(v); }
 void Song::set_compilation(bool v) { d->compilation_ = v; }
-void Song::set_composer(const QString &v) { d->composer_ = v; }
+void Song::set_composer(const QString &v) { d->composer_ = StringPool::Intern(v); }
 void Song::set_performer(const QString &v) { d->performer_ = v; }
 void Song::set_grouping(const QString &v) { d->grouping_ = v; }
-void Song::set_comment(const QString &v) { d->comment_ = v; }
-void Song::set_lyrics(const QString &v) { d->lyrics_ = v; }
+void Song::set_comment(const QString &v) {
+  if (Private::Extension *extension = d->mutable_extension(v)) extension->comment_ = v;
+}
+void Song::set_lyrics(const QString &v) {
+  if (Private::Extension *extension = d->mutable_extension(v)) extension->lyrics_ = v;
+}
 
 void Song::set_beginning_nanosec(const qint64 v) { d->beginning_ = qMax(0LL, v); }
 void Song::set_end_nanosec(const qint64 v) { d->end_ = v; }
@@ -583,18 +614,20 @@ void Song::set_cue_path(const QString &v) { d->cue_path_ = v; }
 void Song::set_rating(const float v) { d->rating_ = v; }
 
 void Song::set_acoustid_id(const QString &v) { d->acoustid_id_ = v; }
-void Song::set_acoustid_fingerprint(const QString &v) { d->acoustid_fingerprint_ = v; }
-
-void Song::set_musicbrainz_album_artist_id(const QString &v) { d->musicbrainz_album_artist_id_ = v; }
-void Song::set_musicbrainz_artist_id(const QString &v) { d->musicbrainz_artist_id_ = v; }
-void Song::set_musicbrainz_original_artist_id(const QString &v) { d->musicbrainz_original_artist_id_ = v; }
-void Song::set_musicbrainz_album_id(const QString &v) { d->musicbrainz_album_id_ = v; }
-void Song::set_musicbrainz_original_album_id(const QString &v) { d->musicbrainz_original_album_id_ = v; }
-void Song::set_musicbrainz_recording_id(const QString &v) { d->musicbrainz_recording_id_ = v; }
-void Song::set_musicbrainz_track_id(const QString &v) { d->musicbrainz_track_id_ = v; }
-void Song::set_musicbrainz_disc_id(const QString &v) { d->musicbrainz_disc_id_ = v; }
-void Song::set_musicbrainz_release_group_id(const QString &v) { d->musicbrainz_release_group_id_ = v; }
-void Song::set_musicbrainz_work_id(const QString &v) { d->musicbrainz_work_id_ = v; }
+void Song::set_acoustid_fingerprint(const QString &v) {
+  if (Private::Extension *extension = d->mutable_extension(v)) extension->acoustid_fingerprint_ = v;
+}
+
+void Song::set_musicbrainz_album_artist_id(const QString &v) { d->musicbrainz_album_artist_id_ = StringPool::Intern(v); }
+void Song::set_musicbrainz_artist_id(const QString &v) { d->musicbrainz_artist_id_ = StringPool::Intern(v); }
+void Song::set_musicbrainz_original_artist_id(const QString &v) { d->musicbrainz_original_artist_id_ = StringPool::Intern(v); }
+void Song::set_musicbrainz_album_id(const QString &v) { d->musicbrainz_album_id_ = StringPool::Intern(v); }
+void Song::set_musicbrainz_original_album_id(const QString &v) { d->musicbrainz_original_album_id_ = StringPool::Intern(v); }
+void Song::set_musicbrainz_recording_id(const QString &v) { d->musicbrainz_recording_id_ = StringPool::Intern(v); }
+void Song::set_musicbrainz_track_id(const QString &v) { d->musicbrainz_track_id_ = StringPool::Intern(v); }
+void Song::set_musicbrainz_disc_id(const QString &v) { d->musicbrainz_disc_id_ = StringPool::Intern(v); }
+void Song::set_musicbrainz_release_group_id(const QString &v) { d->musicbrainz_release_group_id_ = StringPool::Intern(v); }
+void Song::set_musicbrainz_work_id(const QString &v) { d->musicbrainz_work_id_ = StringPool::Intern(v); }
 
 void Song::set_stream_url(const QUrl &v) { d->stream_url_ = v; }
 
@@ -964,13 +997,13 @@ void Song::InitFromProtobuf(const spb::tagreader::SongMetadata &pb) {
   d->disc_ = pb.disc();
   d->year_ = pb.year();
   d->originalyear_ = pb.originalyear();
-  d->genre_ = QString::fromUtf8(pb.genre().data(), pb.genre().size());
+  set_genre(QString::fromUtf8(pb.genre().data(), pb.genre().size()));
   d->compilation_ = pb.compilation();
-  d->composer_ = QString::fromUtf8(pb.composer().data(), pb.composer().size());
+  set_composer(QString::fromUtf8(pb.composer().data(), pb.composer().size()));
   d->performer_ = QString::fromUtf8(pb.performer().data(), pb.performer().size());
   d->grouping_ = QString::fromUtf8(pb.grouping().data(), pb.grouping().size());
-  d->comment_ = QString::fromUtf8(pb.comment().data(), pb.comment().size());
-  d->lyrics_ = QString::fromUtf8(pb.lyrics().data(), pb.lyrics().size());
+  set_comment(QString::fromUtf8(pb.comment().data(), pb.comment().size()));
+  set_lyrics(QString::fromUtf8(pb.lyrics().data(), pb.lyrics().size()));
   set_length_nanosec(static_cast<qint64>(pb.length_nanosec()));
   d->bitrate_ = pb.bitrate();
   d->samplerate_ = pb.samplerate();
@@ -998,18 +1031,18 @@ void Song::InitFromProtobuf(const spb::tagreader::SongMetadata &pb) {
   }
 
   d->acoustid_id_ = QString::fromUtf8(pb.acoustid_id().data(), pb.acoustid_id().size());
-  d->acoustid_fingerprint_ = QString::fromUtf8(pb.acoustid_fingerprint().data(), pb.acoustid_fingerprint().size());
-
-  d->musicbrainz_album_artist_id_ = QString::fromUtf8(pb.musicbrainz_album_artist_id().data(), pb.musicbrainz_album_artist_id().size());
-  d->musicbrainz_artist_id_ = QString::fromUtf8(pb.musicbrainz_artist_id().data(), pb.musicbrainz_artist_id().size());
-  d->musicbrainz_original_artist_id_ = QString::fromUtf8(pb.musicbrainz_original_artist_id().data(), pb.musicbrainz_original_artist_id().size());
-  d->musicbrainz_album_id_ = QString::fromUtf8(pb.musicbrainz_album_id().data(), pb.musicbrainz_album_id().size());
-  d->musicbrainz_original_album_id_ = QString::fromUtf8(pb.musicbrainz_original_album_id().data(), pb.musicbrainz_original_album_id().size());
-  d->musicbrainz_recording_id_ = QString::fromUtf8(pb.musicbrainz_recording_id().data(), pb.musicbrainz_recording_id().size());
-  d->musicbrainz_track_id_ = QString::fromUtf8(pb.musicbrainz_track_id().data(), pb.musicbrainz_track_id().size());
-  d->musicbrainz_disc_id_ = QString::fromUtf8(pb.musicbrainz_disc_id().data(), pb.musicbrainz_disc_id().size());
-  d->musicbrainz_release_group_id_ = QString::fromUtf8(pb.musicbrainz_release_group_id().data(), pb.musicbrainz_release_group_id().size());
-  d->musicbrainz_work_id_ = QString::fromUtf8(pb.musicbrainz_work_id().data(), pb.musicbrainz_work_id().size());
+  set_acoustid_fingerprint(QString::fromUtf8(pb.acoustid_fingerprint().data(), pb.acoustid_fingerprint().size()));
+
+  set_musicbrainz_album_artist_id(QString::fromUtf8(pb.musicbrainz_album_artist_id().data(), pb.musicbrainz_album_artist_id().size()));
+  set_musicbrainz_artist_id(QString::fromUtf8(pb.musicbrainz_artist_id().data(), pb.musicbrainz_artist_id().size()));
+  set_musicbrainz_original_artist_id(QString::fromUtf8(pb.musicbrainz_original_artist_id().data(), pb.musicbrainz_original_artist_id().size()));
+  set_musicbrainz_album_id(QString::fromUtf8(pb.musicbrainz_album_id().data(), pb.musicbrainz_album_id().size()));
+  set_musicbrainz_original_album_id(QString::fromUtf8(pb.musicbrainz_original_album_id().data(), pb.musicbrainz_original_album_id().size()));
+  set_musicbrainz_recording_id(QString::fromUtf8(pb.musicbrainz_recording_id().data(), pb.musicbrainz_recording_id().size()));
+  set_musicbrainz_track_id(QString::fromUtf8(pb.musicbrainz_track_id().data(), pb.musicbrainz_track_id().size()));
+  set_musicbrainz_disc_id(QString::fromUtf8(pb.musicbrainz_disc_id().data(), pb.musicbrainz_disc_id().size()));
+  set_musicbrainz_release_group_id(QString::fromUtf8(pb.musicbrainz_release_group_id().data(), pb.musicbrainz_release_group_id().size()));
+  set_musicbrainz_work_id(QString::fromUtf8(pb.musicbrainz_work_id().data(), pb.musicbrainz_work_id().size()));
 
   d->suspicious_tags_ = pb.suspicious_tags();
 
@@ -1036,8 +1069,8 @@ void Song::ToProtobuf(spb::tagreader::SongMetadata *pb) const {
   pb->set_composer(d->composer_.toStdString());
   pb->set_performer(d->performer_.toStdString());
   pb->set_grouping(d->grouping_.toStdString());
-  pb->set_comment(d->comment_.toStdString());
-  pb->set_lyrics(d->lyrics_.toStdString());
+  pb->set_comment(comment().toStdString());
+  pb->set_lyrics(lyrics().toStdString());
   pb->set_length_nanosec(length_nanosec());
   pb->set_bitrate(d->bitrate_);
   pb->set_samplerate(d->samplerate_);
@@ -1056,7 +1089,7 @@ void Song::ToProtobuf(spb::tagreader::SongMetadata *pb) const {
   pb->set_rating(d->rating_);
 
   pb->set_acoustid_id(d->acoustid_id_.toStdString());
-  pb->set_acoustid_fingerprint(d->acoustid_fingerprint_.toStdString());
+  pb->set_acoustid_fingerprint(acoustid_fingerprint().toStdString());
 
   pb->set_musicbrainz_album_artist_id(d->musicbrainz_album_artist_id_.toStdString());
   pb->set_musicbrainz_artist_id(d->musicbrainz_artist_id_.toStdString());
@@ -1085,13 +1118,13 @@ void Song::InitFromQuery(const SqlRow &q, const bool reliable_metadata) {
   d->disc_ = q.ValueToInt("disc");
   d->year_ = q.ValueToInt("year");
   d->originalyear_ = q.ValueToInt("originalyear");
-  d->genre_ = q.ValueToString("genre");
+  set_genre(q.ValueToString("genre"));
   d->compilation_ = q.value("compilation").toBool();
-  d->composer_ = q.ValueToString("composer");
+  set_composer(q.ValueToString("composer"));
   d->performer_ = q.ValueToString("performer");
   d->grouping_ = q.ValueToString("grouping");
-  d->comment_ = q.ValueToString("comment");
-  d->lyrics_ = q.ValueToString("lyrics");
+  set_comment(q.ValueToString("comment"));
+  set_lyrics(q.ValueToString("lyrics"));
   d->artist_id_ = q.ValueToString("artist_id");
   d->album_id_ = q.ValueToString("album_id");
   d->song_id_ = q.ValueToString("song_id");
@@ -1140,18 +1173,18 @@ void Song::InitFromQuery(const SqlRow &q, const bool reliable_metadata) {
   d->rating_ = q.ValueToFloat("rating");
 
   d->acoustid_id_ = q.ValueToString("acoustid_id");
-  d->acoustid_fingerprint_ = q.ValueToString("acoustid_fingerprint");
-
-  d->musicbrainz_album_artist_id_ = q.ValueToString("musicbrainz_album_artist_id");
-  d->musicbrainz_artist_id_ = q.ValueToString("musicbrainz_artist_id");
-  d->musicbrainz_original_artist_id_ = q.ValueToString("musicbrainz_original_artist_id");
-  d->musicbrainz_album_id_ = q.ValueToString("musicbrainz_album_id");
-  d->musicbrainz_original_album_id_ = q.ValueToString("musicbrainz_original_album_id");
-  d->musicbrainz_recording_id_ = q.ValueToString("musicbrainz_recording_id");
-  d->musicbrainz_track_id_ = q.ValueToString("musicbrainz_track_id");
-  d->musicbrainz_disc_id_ = q.ValueToString("musicbrainz_disc_id");
-  d->musicbrainz_release_group_id_ = q.ValueToString("musicbrainz_release_group_id");
-  d->musicbrainz_work_id_ = q.ValueToString("musicbrainz_work_id");
+  set_acoustid_fingerprint(q.ValueToString("acoustid_fingerprint"));
+
+  set_musicbrainz_album_artist_id(q.ValueToString("musicbrainz_album_artist_id"));
+  set_musicbrainz_artist_id(q.ValueToString("musicbrainz_artist_id"));
+  set_musicbrainz_original_artist_id(q.ValueToString("musicbrainz_original_artist_id"));
+  set_musicbrainz_album_id(q.ValueToString("musicbrainz_album_id"));
+  set_musicbrainz_original_album_id(q.ValueToString("musicbrainz_original_album_id"));
+  set_musicbrainz_recording_id(q.ValueToString("musicbrainz_recording_id"));
+  set_musicbrainz_track_id(q.ValueToString("musicbrainz_track_id"));
+  set_musicbrainz_disc_id(q.ValueToString("musicbrainz_disc_id"));
+  set_musicbrainz_release_group_id(q.ValueToString("musicbrainz_release_group_id"));
+  set_musicbrainz_work_id(q.ValueToString("musicbrainz_work_id"));
 
   d->valid_ = true;
   d->init_from_file_ = reliable_metadata;
@@ -1211,11 +1244,11 @@ void Song::InitFromItdb(Itdb_Track *track, const QString &prefix) {
   d->track_ = track->track_nr;
   d->disc_ = track->cd_nr;
   d->year_ = track->year;
-  d->genre_ = QString::fromUtf8(track->genre);
+  set_genre(QString::fromUtf8(track->genre));
   d->compilation_ = track->compilation == 1;
-  d->composer_ = QString::fromUtf8(track->composer);
+  set_composer(QString::fromUtf8(track->composer));
   d->grouping_ = QString::fromUtf8(track->grouping);
-  d->comment_ = QString::fromUtf8(track->comment);
+  set_comment(QString::fromUtf8(track->comment));
 
   set_length_nanosec(track->tracklen * kNsecPerMsec);
 
@@ -1273,7 +1306,7 @@ void Song::ToItdb(Itdb_Track *track) const {
   track->compilation = d->compilation_;
   track->composer = strdup(d->composer_.toUtf8().constData());
   track->grouping = strdup(d->grouping_.toUtf8().constData());
-  track->comment = strdup(d->comment_.toUtf8().constData());
+  track->comment = strdup(comment().toUtf8().constData());
 
   track->tracklen = static_cast<int>(length_nanosec() / kNsecPerMsec);
 
@@ -1303,8 +1336,8 @@ void Song::InitFromMTP(const LIBMTP_track_t *track, const QString &host) {
   set_title(QString::fromUtf8(track->title));
   set_artist(QString::fromUtf8(track->artist));
   set_album(QString::fromUtf8(track->album));
-  d->genre_ = QString::fromUtf8(track->genre);
-  d->composer_ = QString::fromUtf8(track->composer);
+  set_genre(QString::fromUtf8(track->genre));
+  set_composer(QString::fromUtf8(track->composer));
   d->track_ = track->tracknumber;
 
   d->url_ = QUrl(QString("mtp://%1/%2").arg(host, QString::number(track->item_id)));
@@ -1457,8 +1490,8 @@ void Song::BindToQuery(SqlQuery *query) const {
   query->BindStringValue(":composer", d->composer_);
   query->BindStringValue(":performer", d->performer_);
   query->BindStringValue(":grouping", d->grouping_);
-  query->BindStringValue(":comment", d->comment_);
-  query->BindStringValue(":lyrics", d->lyrics_);
+  query->BindStringValue(":comment", comment());
+  query->BindStringValue(":lyrics", lyrics());
 
   query->BindStringValue(":artist_id", d->artist_id_);
   query->BindStringValue(":album_id", d->album_id_);
@@ -1503,7 +1536,7 @@ void Song::BindToQuery(SqlQuery *query) const {
   query->BindFloatValue(":rating", d->rating_);
 
   query->BindStringValue(":acoustid_id", d->acoustid_id_);
-  query->BindStringValue(":acoustid_fingerprint", d->acoustid_fingerprint_);
+  query->BindStringValue(":acoustid_fingerprint", acoustid_fingerprint());
 
   query->BindStringValue(":musicbrainz_album_artist_id", d->musicbrainz_album_artist_id_);
   query->BindStringValue(":musicbrainz_artist_id", d->musicbrainz_artist_id_);
@@ -1528,7 +1561,7 @@ void Song::BindToFtsQuery(SqlQuery *query) const {
   query->BindValue(":ftsperformer", d->performer_);
   query->BindValue(":ftsgrouping", d->grouping_);
   query->BindValue(":ftsgenre", d->genre_);
-  query->BindValue(":ftscomment", d->comment_);
+  query->BindValue(":ftscomment", comment());
 
 }
 
@@ -1623,8 +1656,8 @@ bool Song::IsMetadataEqual(const Song &other) const {
          d->composer_ == other.d->composer_ &&
          d->performer_ == other.d->performer_ &&
          d->grouping_ == other.d->grouping_ &&
-         d->comment_ == other.d->comment_ &&
-         d->lyrics_ == other.d->lyrics_ &&
+         comment() == other.comment() &&
+         lyrics() == other.lyrics() &&
          d->artist_id_ == other.d->artist_id_ &&
          d->album_id_ == other.d->album_id_ &&
          d->song_id_ == other.d->song_id_ &&
@@ -1658,7 +1691,7 @@ bool Song::IsFingerprintEqual(const Song &other) const {
 
 bool Song::IsAcoustIdEqual(const Song &other) const {
 
-  return d->acoustid_id_ == other.d->acoustid_id_ && d->acoustid_fingerprint_ == other.d->acoustid_fingerprint_;
+  return d->acoustid_id_ == other.d->acoustid_id_ && acoustid_fingerprint() == other.acoustid_fingerprint();
 
 }
 
@@ -23,6 +23,7 @@
 
 #include <memory>
 #include <algorithm>
+#include <utility>
 
 #ifdef HAVE_GSTREAMER
 #  include <gst/gst.h>
@@ -38,7 +39,9 @@
 #include <QFileInfo>
 #include <QSet>
 #include <QTimer>
+#include <QList>
 #include <QString>
+#include <QStringList>
 #include <QUrl>
 #include <QEventLoop>
 
@@ -333,31 +336,58 @@ SongLoader::Result SongLoader::LoadLocalAsync(const QString &filename) {
 
 void SongLoader::LoadMetadataBlocking() {
 
+  // Songs that are not in the collection are read from the files in batches, instead of one file at a time.
+  QList<int> read_indexes;
+  QStringList read_filenames;
   for (int i = 0; i < songs_.size(); i++) {
-    EffectiveSongLoad(&songs_[i]);
+    Song *song = &songs_[i];
+    if (EffectiveSongLoadFromCollection(song)) {
+      read_indexes << i;
+      read_filenames << song->url().toLocalFile();
+    }
+  }
+
+  if (read_filenames.isEmpty()) return;
+
+  SongList songs_read;
+  songs_read.reserve(read_indexes.count());
+  for (const int i : std::as_const(read_indexes)) {
+    songs_read << songs_[i];
+  }
+  TagReaderClient::Instance()->ReadFilesBatchBlocking(read_filenames, &songs_read);
+  for (int i = 0; i < read_indexes.count(); ++i) {
+    songs_[read_indexes[i]] = songs_read[i];
   }
 
 }
 
 void SongLoader::EffectiveSongLoad(Song *song) {
 
-  if (!song || !song->url().isLocalFile()) return;
+  if (song && EffectiveSongLoadFromCollection(song)) {
+    // It's a normal media file
+    QString filename = song->url().toLocalFile();
+    TagReaderClient::Instance()->ReadFileBlocking(filename, song);
+  }
+
+}
+
+bool SongLoader::EffectiveSongLoadFromCollection(Song *song) {
+
+  if (!song->url().isLocalFile()) return false;
 
   if (song->init_from_file() && song->filetype() != Song::FileType::Unknown) {
     // Maybe we loaded the metadata already, for example from a cuesheet.
-    return;
+    return false;
   }
 
   // First, try to get the song from the collection
   Song collection_song = collection_->GetSongByUrl(song->url());
   if (collection_song.is_valid()) {
     *song = collection_song;
+    return false;
   }
-  else {
-    // It's a normal media file
-    QString filename = song->url().toLocalFile();
-    TagReaderClient::Instance()->ReadFileBlocking(filename, song);
-  }
+
+  return true;
 
 }
 
@@ -112,6 +112,8 @@ class SongLoader : public QObject {
   Result LoadLocal(const QString &filename);
   SongLoader::Result LoadLocalAsync(const QString &filename);
   void EffectiveSongLoad(Song *song);
+  // Loads the song from the collection if it's there, returns true if the tags have to be read from the file.
+  bool EffectiveSongLoadFromCollection(Song *song);
   Result LoadLocalPartial(const QString &filename);
   void LoadLocalDirectory(const QString &filename);
   void LoadPlaylist(ParserBase *parser, const QString &filename);
@@ -25,14 +25,29 @@
 #include <QUrl>
 
 #include "sqlquery.h"
+#include "sqlstatementcache.h"
+
+SqlQuery::~SqlQuery() {
+
+  SqlStatementCache::ReturnToCache(db_, this, &cache_key_);
+
+}
+
+bool SqlQuery::PrepareCached(const QString &query) {
+
+  return SqlStatementCache::Prepare(db_, query, this, &cache_key_);
+
+}
 
 void SqlQuery::BindValue(const QString &placeholder, const QVariant &value) {
 
+  const QString name = placeholder_suffix_.isEmpty() ? placeholder : placeholder + placeholder_suffix_;
+
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-  bound_values_.insert(placeholder, value);
+  bound_values_.insert(name, value);
 #endif
 
-  bindValue(placeholder, value);
+  bindValue(name, value);
 
 }
 
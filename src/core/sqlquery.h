@@ -31,7 +31,12 @@
 class SqlQuery : public QSqlQuery {
 
  public:
-  explicit SqlQuery(const QSqlDatabase &db) : QSqlQuery(db) {}
+  explicit SqlQuery(const QSqlDatabase &db) : QSqlQuery(db), db_(db) {}
+  ~SqlQuery();
+
+  // Takes the prepared statement from the statement cache of the connection when there is one.
+  // It's given back to the cache when the query is destroyed or prepared again.
+  bool PrepareCached(const QString &query);
 
   void BindValue(const QString &placeholder, const QVariant &value);
   void BindStringValue(const QString &placeholder, const QString &value);
@@ -43,14 +48,22 @@ class SqlQuery : public QSqlQuery {
   void BindBoolValue(const QString &placeholder, const bool value);
   void BindNotNullIntValue(const QString &placeholder, const int value);
 
+  // Appended to the placeholder names of all following Bind calls, used to bind several rows of a multi-row statement.
+  void SetPlaceholderSuffix(const QString &suffix) { placeholder_suffix_ = suffix; }
+
   bool Exec();
   QString LastQuery() const;
 
  private:
+  Q_DISABLE_COPY(SqlQuery)
+
+  QSqlDatabase db_;
+  QString cache_key_;
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
   QMap<QString, QVariant> bound_values_;
 #endif
   QString last_query_;
+  QString placeholder_suffix_;
 
 };
 
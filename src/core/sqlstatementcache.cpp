@@ -0,0 +1,182 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <utility>
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+#include "sqlstatementcache.h"
+
+const int SqlStatementCache::kDefaultCapacity = 64;
+const int SqlStatementCache::kMaxTrackedStatements = 1024;
+
+QMutex SqlStatementCache::sRegistryMutex;
+QHash<QString, SqlStatementCache*> SqlStatementCache::sRegistry;
+
+SqlStatementCache::SqlStatementCache(const QString &connection_name, const int capacity)
+    : connection_name_(connection_name),
+      capacity_(capacity),
+      hits_(0),
+      misses_(0),
+      evictions_(0),
+      reparsed_(0) {
+
+  QMutexLocker l(&sRegistryMutex);
+  sRegistry.insert(connection_name_, this);
+
+}
+
+SqlStatementCache::~SqlStatementCache() {
+
+  QMutexLocker l(&sRegistryMutex);
+  if (sRegistry.value(connection_name_) == this) {
+    sRegistry.remove(connection_name_);
+  }
+
+}
+
+SqlStatementCache *SqlStatementCache::ForConnection(const QString &connection_name) {
+
+  QMutexLocker l(&sRegistryMutex);
+  return sRegistry.value(connection_name, nullptr);
+
+}
+
+bool SqlStatementCache::Take(const QString &sql, QSqlQuery *query) {
+
+  std::map<QString, QSqlQuery>::iterator it = statements_.find(sql);
+  if (it == statements_.end()) {
+    ++misses_;
+    if (prepared_sql_.contains(sql)) {
+      ++reparsed_;
+    }
+    else {
+      // Queries with literal values in the SQL text are never reused, don't track them forever.
+      if (prepared_sql_.count() >= kMaxTrackedStatements) prepared_sql_.clear();
+      prepared_sql_ << sql;
+    }
+    return false;
+  }
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+  *query = std::move(it->second);
+#else
+  *query = it->second;
+#endif
+  statements_.erase(it);
+  lru_.removeOne(sql);
+  ++hits_;
+
+  return true;
+
+}
+
+void SqlStatementCache::Put(const QString &sql, QSqlQuery query) {
+
+  // Reset the statement so it doesn't keep a read transaction open while it's cached.
+  query.finish();
+
+  // Another query with the same SQL text was returned first.
+  if (statements_.find(sql) != statements_.end()) return;
+
+  while (static_cast<int>(statements_.size()) >= capacity_ && !lru_.isEmpty()) {
+    statements_.erase(lru_.takeFirst());
+    ++evictions_;
+  }
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+  statements_.emplace(sql, std::move(query));
+#else
+  statements_.emplace(sql, query);
+#endif
+  lru_ << sql;
+
+}
+
+void SqlStatementCache::Clear() {
+
+  statements_.clear();
+  lru_.clear();
+
+}
+
+bool SqlStatementCache::Prepare(const QSqlDatabase &db, const QString &sql, QSqlQuery *query, QString *cache_key) {
+
+  if (!cache_key->isEmpty()) {
+    ReturnToCache(db, query, cache_key);
+    // The statement was given to the cache, start over with a new one.
+    *query = QSqlQuery(db);
+  }
+
+  SqlStatementCache *cache = ForConnection(db.connectionName());
+  if (cache && cache->Take(sql, query)) {
+    *cache_key = sql;
+    return true;
+  }
+
+  if (!query->prepare(sql)) return false;
+
+  if (cache) *cache_key = sql;
+
+  return true;
+
+}
+
+void SqlStatementCache::ReturnToCache(const QSqlDatabase &db, QSqlQuery *query, QString *cache_key) {
+
+  if (cache_key->isEmpty()) return;
+
+  const QString sql = *cache_key;
+  cache_key->clear();
+
+  // Don't cache statements that were prepared again with a different query through QSqlQuery directly.
+  if (query->lastQuery() != sql) return;
+
+  SqlStatementCache *cache = ForConnection(db.connectionName());
+  if (!cache) return;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 2, 0)
+  cache->Put(sql, std::move(*query));
+#else
+  // QSqlQuery can't be moved before Qt 6.2, the copy shares the statement, so the query has to let go of it.
+  cache->Put(sql, *query);
+  *query = QSqlQuery(db);
+#endif
+
+}
+
+SqlStatementCache::Statistics SqlStatementCache::statistics() const {
+
+  Statistics statistics;
+  statistics.hits = hits_;
+  statistics.misses = misses_;
+  statistics.evictions = evictions_;
+  statistics.reparsed = reparsed_;
+  return statistics;
+
+}
@@ -0,0 +1,93 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SQLSTATEMENTCACHE_H
+#define SQLSTATEMENTCACHE_H
+
+#include "config.h"
+
+#include <atomic>
+#include <map>
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+// LRU cache of prepared statements for one database connection, keyed by SQL text.
+// A connection is only used by the thread that opened it, so the statements are only touched from that thread.
+// Statements are taken out of the cache while a query uses them and put back when the query is destroyed,
+// so two queries with the same SQL text never share a statement.
+class SqlStatementCache {
+ public:
+  explicit SqlStatementCache(const QString &connection_name, const int capacity = kDefaultCapacity);
+  ~SqlStatementCache();
+
+  struct Statistics {
+    Statistics() : hits(0), misses(0), evictions(0), reparsed(0) {}
+    quint64 hits;
+    quint64 misses;
+    quint64 evictions;
+    // Number of times a statement had to be prepared again after it was evicted or while it was in use.
+    quint64 reparsed;
+  };
+
+  // Returns the cache for the connection, or nullptr if the connection has none.
+  static SqlStatementCache *ForConnection(const QString &connection_name);
+
+  QString connection_name() const { return connection_name_; }
+
+  bool Take(const QString &sql, QSqlQuery *query);
+  void Put(const QString &sql, QSqlQuery query);
+  void Clear();
+
+  // Prepares the query with a statement from the cache of the connection when there is one.
+  // cache_key is the SQL text the statement of the query was taken for, it is given back to the cache first.
+  static bool Prepare(const QSqlDatabase &db, const QString &sql, QSqlQuery *query, QString *cache_key);
+  // Gives the statement of the query back to the cache of the connection, and clears cache_key.
+  static void ReturnToCache(const QSqlDatabase &db, QSqlQuery *query, QString *cache_key);
+
+  Statistics statistics() const;
+
+ private:
+  static const int kDefaultCapacity;
+  static const int kMaxTrackedStatements;
+
+  static QMutex sRegistryMutex;
+  static QHash<QString, SqlStatementCache*> sRegistry;
+
+  const QString connection_name_;
+  const int capacity_;
+
+  // QSqlQuery is not meant to be copied since Qt 6.2, so the statements are moved in and out of the cache there.
+  std::map<QString, QSqlQuery> statements_;
+  QList<QString> lru_;
+  QSet<QString> prepared_sql_;
+
+  std::atomic<quint64> hits_;
+  std::atomic<quint64> misses_;
+  std::atomic<quint64> evictions_;
+  std::atomic<quint64> reparsed_;
+};
+
+#endif  // SQLSTATEMENTCACHE_H
@@ -0,0 +1,102 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+#include "stringpool.h"
+
+namespace {
+
+// Sharded so songs loaded from several threads at once don't contend on a single lock.
+constexpr int kShardCount = 16;
+constexpr qint64 kMinPurgeThreshold = 1024;
+
+struct Shard {
+  Shard() : purge_threshold(kMinPurgeThreshold) {}
+  QMutex mutex;
+  QSet<QString> strings;
+  qint64 purge_threshold;
+};
+
+Shard sShards[kShardCount];
+
+void PurgeShard(Shard &shard) {
+
+  for (QSet<QString>::iterator it = shard.strings.begin(); it != shard.strings.end();) {
+    // Detached means nothing outside the pool holds the string anymore.
+    if (it->isDetached()) {
+      it = shard.strings.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  shard.purge_threshold = std::max(kMinPurgeThreshold, static_cast<qint64>(shard.strings.count()) * 2);
+
+}
+
+}  // namespace
+
+QString StringPool::Intern(const QString &str) {
+
+  if (str.isEmpty()) return str;
+
+  Shard &shard = sShards[qHash(str) % kShardCount];
+  QMutexLocker l(&shard.mutex);
+
+  QSet<QString>::const_iterator it = shard.strings.constFind(str);
+  if (it != shard.strings.constEnd()) return *it;
+
+  if (shard.strings.count() >= shard.purge_threshold) {
+    PurgeShard(shard);
+  }
+  shard.strings.insert(str);
+
+  return str;
+
+}
+
+qint64 StringPool::size() {
+
+  qint64 size = 0;
+  for (Shard &shard : sShards) {
+    QMutexLocker l(&shard.mutex);
+    size += shard.strings.count();
+  }
+
+  return size;
+
+}
+
+void StringPool::Purge() {
+
+  for (Shard &shard : sShards) {
+    QMutexLocker l(&shard.mutex);
+    PurgeShard(shard);
+  }
+
+}
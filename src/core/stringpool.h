@@ -0,0 +1,42 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include "config.h"
+
+#include <QtGlobal>
+#include <QString>
+
+// Process wide pool of strings that repeat across many songs, like artist, album and genre.
+// Interning a string returns a copy sharing the data of an equal string already in the pool, so thousands of songs by the same artist share one allocation.
+// Strings only referenced by the pool are dropped when the pool grows.
+class StringPool {
+ public:
+  static QString Intern(const QString &str);
+
+  static qint64 size();
+  static void Purge();
+
+ private:
+  StringPool() = default;
+};
+
+#endif  // STRINGPOOL_H
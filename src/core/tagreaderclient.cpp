@@ -28,6 +28,7 @@
 #include <QThread>
 #include <QByteArray>
 #include <QString>
+#include <QStringList>
 #include <QImage>
 #include <QSettings>
 
@@ -39,6 +40,8 @@
 #include "settings/collectionsettingspage.h"
 
 const char *TagReaderClient::kWorkerExecutableName = "strawberry-tagreader";
+const int TagReaderClient::kMaxWorkers = 8;
+const int TagReaderClient::kReadFilesBatchSize = 32;
 TagReaderClient *TagReaderClient::sInstance = nullptr;
 
 TagReaderClient::TagReaderClient(QObject *parent) : QObject(parent), worker_pool_(new WorkerPool<HandlerType>(this)) {
@@ -47,6 +50,8 @@ TagReaderClient::TagReaderClient(QObject *parent) : QObject(parent), worker_pool
   original_thread_ = thread();
 
   worker_pool_->SetExecutableName(kWorkerExecutableName);
+  // Use more than one worker, so collection scans can read tags from several files at the same time.
+  worker_pool_->SetWorkerCount(qBound(1, QThread::idealThreadCount() / 2, kMaxWorkers));
   QObject::connect(worker_pool_, &WorkerPool<HandlerType>::WorkerFailedToStart, this, &TagReaderClient::WorkerFailedToStart);
 
 }
@@ -93,6 +98,20 @@ TagReaderReply *TagReaderClient::ReadFile(const QString &filename) {
 
 }
 
+TagReaderReply *TagReaderClient::ReadFilesBatch(const QStringList &filenames) {
+
+  spb::tagreader::Message message;
+  spb::tagreader::ReadFilesRequest *request = message.mutable_read_files_request();
+
+  for (const QString &filename : filenames) {
+    const QByteArray filename_data = filename.toUtf8();
+    request->add_filenames(filename_data.constData(), filename_data.length());
+  }
+
+  return worker_pool_->SendMessageWithReply(&message);
+
+}
+
 TagReaderReply *TagReaderClient::SaveFile(const QString &filename, const Song &metadata, const SaveTags save_tags, const SavePlaycount save_playcount, const SaveRating save_rating, const SaveCoverOptions &save_cover_options) {
 
   spb::tagreader::Message message;
@@ -207,7 +226,7 @@ bool TagReaderClient::IsMediaFileBlocking(const QString &filename) {
   if (reply->WaitForFinished()) {
     ret = reply->message().is_media_file_response().success();
   }
-  reply->deleteLater();
+  delete reply;
 
   return ret;
 
@@ -221,7 +240,35 @@ void TagReaderClient::ReadFileBlocking(const QString &filename, Song *song) {
   if (reply->WaitForFinished()) {
     song->InitFromProtobuf(reply->message().read_file_response().metadata());
   }
-  reply->deleteLater();
+  delete reply;
+
+}
+
+void TagReaderClient::ReadFilesBatchBlocking(const QStringList &filenames, SongList *songs) {
+
+  Q_ASSERT(QThread::currentThread() != thread());
+
+  while (songs->count() < filenames.count()) {
+    songs->append(Song());
+  }
+
+  QList<TagReaderReply*> replies;
+  for (int i = 0; i < filenames.count(); i += kReadFilesBatchSize) {
+    replies << ReadFilesBatch(filenames.mid(i, kReadFilesBatchSize));
+  }
+
+  int i = 0;
+  for (TagReaderReply *reply : replies) {
+    const int batch_count = reply->request_message().read_files_request().filenames_size();
+    if (reply->WaitForFinished()) {
+      const spb::tagreader::ReadFilesResponse &response = reply->message().read_files_response();
+      for (int j = 0; j < response.metadata_size() && j < batch_count; ++j) {
+        (*songs)[i + j].InitFromProtobuf(response.metadata(j));
+      }
+    }
+    delete reply;
+    i += batch_count;
+  }
 
 }
 
@@ -235,7 +282,7 @@ bool TagReaderClient::SaveFileBlocking(const QString &filename, const Song &meta
   if (reply->WaitForFinished()) {
     ret = reply->message().save_file_response().success();
   }
-  reply->deleteLater();
+  delete reply;
 
   return ret;
 
@@ -252,7 +299,7 @@ QByteArray TagReaderClient::LoadEmbeddedArtBlocking(const QString &filename) {
     const std::string &data_str = reply->message().load_embedded_art_response().data();
     ret = QByteArray(data_str.data(), static_cast<qint64>(data_str.size()));
   }
-  reply->deleteLater();
+  delete reply;
 
   return ret;
 
@@ -269,7 +316,7 @@ QImage TagReaderClient::LoadEmbeddedArtAsImageBlocking(const QString &filename)
     const std::string &data_str = reply->message().load_embedded_art_response().data();
     ret.loadFromData(QByteArray(data_str.data(), static_cast<qint64>(data_str.size())));
   }
-  reply->deleteLater();
+  delete reply;
 
   return ret;
 
@@ -285,7 +332,7 @@ bool TagReaderClient::SaveEmbeddedArtBlocking(const QString &filename, const Sav
   if (reply->WaitForFinished()) {
     success = reply->message().save_embedded_art_response().success();
   }
-  reply->deleteLater();
+  delete reply;
 
   return success;
 
@@ -301,7 +348,7 @@ bool TagReaderClient::UpdateSongPlaycountBlocking(const Song &metadata) {
   if (reply->WaitForFinished()) {
     success = reply->message().save_song_playcount_to_file_response().success();
   }
-  reply->deleteLater();
+  delete reply;
 
   return success;
 
@@ -317,7 +364,7 @@ bool TagReaderClient::UpdateSongRatingBlocking(const Song &metadata) {
   if (reply->WaitForFinished()) {
     success = reply->message().save_song_rating_to_file_response().success();
   }
-  reply->deleteLater();
+  delete reply;
 
   return success;
 
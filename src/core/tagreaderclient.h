@@ -27,6 +27,7 @@
 #include <QObject>
 #include <QList>
 #include <QString>
+#include <QStringList>
 #include <QImage>
 
 #include "core/messagehandler.h"
@@ -49,6 +50,8 @@ class TagReaderClient : public QObject {
   using ReplyType = HandlerType::ReplyType;
 
   static const char *kWorkerExecutableName;
+  static const int kMaxWorkers;
+  static const int kReadFilesBatchSize;
 
   void Start();
   void ExitAsync();
@@ -81,6 +84,7 @@ class TagReaderClient : public QObject {
 
   ReplyType *IsMediaFile(const QString &filename);
   ReplyType *ReadFile(const QString &filename);
+  ReplyType *ReadFilesBatch(const QStringList &filenames);
   ReplyType *SaveFile(const QString &filename, const Song &metadata, const SaveTags save_tags = SaveTags::On, const SavePlaycount save_playcount = SavePlaycount::Off, const SaveRating save_rating = SaveRating::Off, const SaveCoverOptions &save_cover_options = SaveCoverOptions());
   ReplyType *LoadEmbeddedArt(const QString &filename);
   ReplyType *SaveEmbeddedArt(const QString &filename, const SaveCoverOptions &save_cover_options);
@@ -90,6 +94,9 @@ class TagReaderClient : public QObject {
   // Convenience functions that call the above functions and wait for a response.
   // These block the calling thread with a semaphore, and must NOT be called from the TagReaderClient's thread.
   void ReadFileBlocking(const QString &filename, Song *song);
+  // Splits the filenames into batches which are all sent at once, so every worker is kept busy.
+  // The song at each index in songs is initialized from the file at the same index, missing songs are appended.
+  void ReadFilesBatchBlocking(const QStringList &filenames, SongList *songs);
   bool SaveFileBlocking(const QString &filename, const Song &metadata, const SaveTags save_tags = SaveTags::On, const SavePlaycount save_playcount = SavePlaycount::Off, const SaveRating save_rating = SaveRating::Off, const SaveCoverOptions &save_cover_options = SaveCoverOptions());
   bool IsMediaFileBlocking(const QString &filename);
   QByteArray LoadEmbeddedArtBlocking(const QString &filename);
@@ -21,25 +21,38 @@
 
 #include "config.h"
 
+#include <memory>
+
 #include <QtGlobal>
 #include <QObject>
 #include <QStandardPaths>
 #include <QDir>
 #include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
 #include <QMutex>
 #include <QBuffer>
 #include <QSet>
 #include <QList>
 #include <QQueue>
+#include <QPair>
 #include <QVariant>
 #include <QByteArray>
 #include <QString>
+#include <QStringList>
 #include <QUrl>
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
 #include <QImage>
+#include <QSize>
 #include <QPainter>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QNetworkDiskCache>
+#include <QNetworkCacheMetaData>
 
 #include "core/networkaccessmanager.h"
 #include "core/song.h"
@@ -51,16 +64,29 @@
 #include "albumcoverloaderresult.h"
 #include "albumcoverimageresult.h"
 
+const int AlbumCoverLoader::kMaxDecodeThreads = 4;
+const qint64 AlbumCoverLoader::kThumbnailCacheSize = 200LL * 1024LL * 1024LL;  // 200MB - enough for 20,000 album covers in the cover manager
+
 AlbumCoverLoader::AlbumCoverLoader(QObject *parent)
     : QObject(parent),
       stop_requested_(false),
       load_image_async_id_(1),
       save_image_async_id_(1),
       network_(new NetworkAccessManager(this)),
+      thread_pool_(new QThreadPool(this)),
+      running_tasks_(0),
+      thumbnail_cache_(new QNetworkDiskCache(this)),
       original_thread_(nullptr) {
 
   original_thread_ = thread();
 
+  network_schemes_ = network_->supportedSchemes();
+
+  thread_pool_->setMaxThreadCount(qBound(1, QThread::idealThreadCount(), kMaxDecodeThreads));
+
+  thumbnail_cache_->setCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/albumcoverthumbnails");
+  thumbnail_cache_->setMaximumCacheSize(kThumbnailCacheSize);
+
 }
 
 void AlbumCoverLoader::ExitAsync() {
@@ -73,6 +99,11 @@ void AlbumCoverLoader::ExitAsync() {
 void AlbumCoverLoader::Exit() {
 
   Q_ASSERT(QThread::currentThread() == thread());
+  thread_pool_->waitForDone();
+
+  const Statistics statistics = this->statistics();
+  qLog(Debug) << "Album cover thumbnail cache hits:" << statistics.thumbnail_cache_hits << "misses:" << statistics.thumbnail_cache_misses << "images decoded:" << statistics.images_decoded << "in" << statistics.decode_msec << "ms";
+
   moveToThread(original_thread_);
   emit ExitFinished();
 
@@ -165,9 +196,17 @@ quint64 AlbumCoverLoader::EnqueueTask(Task &task) {
 
 }
 
+AlbumCoverLoader::Statistics AlbumCoverLoader::statistics() const {
+
+  QMutexLocker l(&mutex_statistics_);
+  return statistics_;
+
+}
+
 void AlbumCoverLoader::ProcessTasks() {
 
-  while (!stop_requested_) {
+  // Tasks stay in the queue until a thread is free, so they can still be cancelled.
+  while (!stop_requested_ && running_tasks_ < thread_pool_->maxThreadCount()) {
     // Get the next task
     Task task;
     {
@@ -176,19 +215,39 @@ void AlbumCoverLoader::ProcessTasks() {
       task = tasks_.dequeue();
     }
 
-    ProcessTask(&task);
+    ++running_tasks_;
+    (void)QtConcurrent::run(thread_pool_, [this, task]() mutable {
+      ProcessTask(&task);
+      QMetaObject::invokeMethod(this, "TaskFinished", Qt::QueuedConnection);
+    });
   }
 
 }
 
+void AlbumCoverLoader::TaskFinished() {
+
+  --running_tasks_;
+  ProcessTasks();
+
+}
+
 void AlbumCoverLoader::ProcessTask(Task *task) {
 
+  QElapsedTimer timer;
+  timer.start();
+
   TryLoadResult result = TryLoadImage(task);
   if (result.started_async) {
     // The image is being loaded from a remote URL, we'll carry on later when it's done
     return;
   }
 
+  if (result.loaded_success && !result.image_scaled.isNull()) {
+    // From the thumbnail cache
+    emit AlbumCoverLoaded(task->id, AlbumCoverLoaderResult(true, result.type, result.album_cover, result.image_scaled, QImage(), task->art_updated));
+    return;
+  }
+
   if (result.loaded_success) {
     result.album_cover.mime_type = Utilities::MimeTypeFromData(result.album_cover.image_data);
     QImage image_scaled;
@@ -199,6 +258,14 @@ void AlbumCoverLoader::ProcessTask(Task *task) {
     if (task->options.get_image_ && task->options.create_thumbnail_) {
       image_thumbnail = ImageUtils::CreateThumbnail(result.album_cover.image, task->options.pad_thumbnail_image_, task->options.thumbnail_size_);
     }
+    {
+      QMutexLocker l(&mutex_statistics_);
+      ++statistics_.images_decoded;
+      statistics_.decode_msec += timer.elapsed();
+    }
+    if (task->thumbnail_cache_url.isValid() && !image_scaled.isNull()) {
+      SaveThumbnail(task->thumbnail_cache_url, image_scaled);
+    }
     emit AlbumCoverLoaded(task->id, AlbumCoverLoaderResult(result.loaded_success, result.type, result.album_cover, image_scaled, image_thumbnail, task->art_updated));
     return;
   }
@@ -260,16 +327,32 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(Task *task) {
       break;
   }
   task->type = type;
+  task->thumbnail_cache_url.clear();
 
   if (!cover_url.isEmpty() && !cover_url.path().isEmpty()) {
     if (cover_url.path() == Song::kManuallyUnsetCover) {
       return TryLoadResult(false, true, AlbumCoverLoaderResult::Type_ManuallyUnset, AlbumCoverImageResult(cover_url, QString(), QByteArray(), task->options.default_output_image_));
     }
-    else if (cover_url.path() == Song::kEmbeddedCover && task->song.url().isLocalFile()) {
+
+    // Repeated loads of local covers are one small read from the thumbnail cache.
+    const QUrl thumbnail_cache_url = ThumbnailCacheUrl(*task, cover_url);
+    if (thumbnail_cache_url.isValid()) {
+      const QImage image_scaled = LoadThumbnail(thumbnail_cache_url);
+      QMutexLocker l(&mutex_statistics_);
+      if (!image_scaled.isNull()) {
+        ++statistics_.thumbnail_cache_hits;
+        return TryLoadResult(false, true, cover_url.path() == Song::kEmbeddedCover ? AlbumCoverLoaderResult::Type_Embedded : type, AlbumCoverImageResult(cover_url), image_scaled);
+      }
+      ++statistics_.thumbnail_cache_misses;
+      task->thumbnail_cache_url = thumbnail_cache_url;
+    }
+
+    if (cover_url.path() == Song::kEmbeddedCover && task->song.url().isLocalFile()) {
       QByteArray image_data = TagReaderClient::Instance()->LoadEmbeddedArtBlocking(task->song.url().toLocalFile());
       if (!image_data.isEmpty()) {
         QImage image;
-        if (!image_data.isEmpty() && task->options.get_image_ && image.loadFromData(image_data)) {
+        if (!image_data.isEmpty() && task->options.get_image_) image = ImageUtils::ReadImage(image_data, DecodeSize(task->options));
+        if (!image.isNull()) {
           return TryLoadResult(false, !image.isNull(), AlbumCoverLoaderResult::Type_Embedded, AlbumCoverImageResult(cover_url, QString(), image_data, image));
         }
         else {
@@ -285,7 +368,8 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(Task *task) {
           QByteArray image_data = file.readAll();
           file.close();
           QImage image;
-          if (!image_data.isEmpty() && task->options.get_image_ && image.loadFromData(image_data)) {
+          if (!image_data.isEmpty() && task->options.get_image_) image = ImageUtils::ReadImage(image_data, DecodeSize(task->options));
+          if (!image.isNull()) {
             return TryLoadResult(false, !image.isNull(), type, AlbumCoverImageResult(cover_url, QString(), image_data, image.isNull() ? task->options.default_output_image_ : image));
           }
           else {
@@ -307,7 +391,8 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(Task *task) {
           QByteArray image_data = file.readAll();
           file.close();
           QImage image;
-          if (!image_data.isEmpty() && task->options.get_image_ && image.loadFromData(image_data)) {
+          if (!image_data.isEmpty() && task->options.get_image_) image = ImageUtils::ReadImage(image_data, DecodeSize(task->options));
+          if (!image.isNull()) {
             return TryLoadResult(false, !image.isNull(), type, AlbumCoverImageResult(cover_url, QString(), image_data, image.isNull() ? task->options.default_output_image_ : image));
           }
           else {
@@ -322,14 +407,13 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(Task *task) {
         qLog(Error) << "Cover file" << cover_url << "does not exist";
       }
     }
-    else if (network_->supportedSchemes().contains(cover_url.scheme())) {  // Remote URL
-      qLog(Debug) << "Loading remote cover from" << cover_url;
-      QNetworkRequest request(cover_url);
-      request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
-      QNetworkReply *reply = network_->get(request);
-      QObject::connect(reply, &QNetworkReply::finished, this, [this, reply, cover_url]() { RemoteFetchFinished(reply, cover_url); });
-
-      remote_tasks_.insert(reply, *task);
+    else if (network_schemes_.contains(cover_url.scheme())) {  // Remote URL
+      // The network access manager belongs to the loader thread.
+      {
+        QMutexLocker l(&mutex_remote_fetch_tasks_);
+        remote_fetch_tasks_.enqueue(qMakePair(*task, cover_url));
+      }
+      QMetaObject::invokeMethod(this, "StartRemoteFetches", Qt::QueuedConnection);
       return TryLoadResult(true, false, type, AlbumCoverImageResult(cover_url));
     }
   }
@@ -338,6 +422,115 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(Task *task) {
 
 }
 
+QSize AlbumCoverLoader::DecodeSize(const AlbumCoverLoaderOptions &options) {
+
+  // When the original image is not needed, it only has to be big enough for the scaled image and thumbnail.
+  if (!options.scaled_image_only_) return QSize();
+
+  QSize size;
+  if (options.scale_output_image_) size = QSize(options.desired_height_, options.desired_height_);
+  if (options.create_thumbnail_) size = size.expandedTo(options.thumbnail_size_);
+
+  return size;
+
+}
+
+QUrl AlbumCoverLoader::ThumbnailCacheUrl(const Task &task, const QUrl &cover_url) {
+
+  const AlbumCoverLoaderOptions &options = task.options;
+  if (!options.scaled_image_only_ || !options.get_image_ || !options.scale_output_image_ || options.create_thumbnail_) {
+    return QUrl();
+  }
+
+  QString filename;
+  if (cover_url.path() == Song::kEmbeddedCover) {
+    if (!task.song.url().isLocalFile()) return QUrl();
+    filename = task.song.url().toLocalFile();
+  }
+  else if (cover_url.isLocalFile()) {
+    filename = cover_url.toLocalFile();
+  }
+  else if (cover_url.scheme().isEmpty()) {
+    filename = cover_url.path();
+  }
+  else {
+    return QUrl();
+  }
+
+  const QFileInfo fileinfo(filename);
+  if (!fileinfo.exists()) return QUrl();
+
+  // Addressed by where the cover comes from, when that last changed and the size it is scaled to.
+  const QString key = cover_url.toString() + "|" + filename + "|" + QString::number(fileinfo.lastModified().toMSecsSinceEpoch()) + "|" + QString::number(options.desired_height_) + "|" + (options.pad_output_image_ ? "pad" : "");
+
+  return QUrl("albumcoverthumbnail:" + QString::fromLatin1(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex()));
+
+}
+
+QImage AlbumCoverLoader::LoadThumbnail(const QUrl &thumbnail_cache_url) {
+
+  QByteArray data;
+  {
+    QMutexLocker l(&mutex_thumbnail_cache_);
+    std::unique_ptr<QIODevice> cache_device(thumbnail_cache_->data(thumbnail_cache_url));
+    if (!cache_device) return QImage();
+    data = cache_device->readAll();
+  }
+
+  QImage image;
+  if (data.isEmpty() || !image.loadFromData(data, "PNG")) return QImage();
+
+  return image;
+
+}
+
+void AlbumCoverLoader::SaveThumbnail(const QUrl &thumbnail_cache_url, const QImage &image) {
+
+  // PNG keeps the transparent padding.
+  QByteArray data;
+  {
+    QBuffer buffer(&data);
+    if (!buffer.open(QIODevice::WriteOnly) || !image.save(&buffer, "PNG")) return;
+    buffer.close();
+  }
+
+  QNetworkCacheMetaData metadata;
+  metadata.setUrl(thumbnail_cache_url);
+
+  QMutexLocker l(&mutex_thumbnail_cache_);
+  QIODevice *cache_device = thumbnail_cache_->prepare(metadata);
+  if (!cache_device) return;
+  if (cache_device->write(data) == data.size()) {
+    thumbnail_cache_->insert(cache_device);
+  }
+  else {
+    thumbnail_cache_->remove(thumbnail_cache_url);
+  }
+
+}
+
+void AlbumCoverLoader::StartRemoteFetches() {
+
+  QQueue<QPair<Task, QUrl>> remote_fetch_tasks;
+  {
+    QMutexLocker l(&mutex_remote_fetch_tasks_);
+    remote_fetch_tasks.swap(remote_fetch_tasks_);
+  }
+
+  while (!remote_fetch_tasks.isEmpty()) {
+    const QPair<Task, QUrl> remote_fetch_task = remote_fetch_tasks.dequeue();
+    const QUrl cover_url = remote_fetch_task.second;
+    qLog(Debug) << "Loading remote cover from" << cover_url;
+    QNetworkRequest request(cover_url);
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+    QNetworkReply *reply = network_->get(request);
+    QObject::connect(reply, &QNetworkReply::finished, this, [this, reply, cover_url]() { RemoteFetchFinished(reply, cover_url); });
+
+    remote_tasks_.insert(reply, remote_fetch_task.first);
+  }
+
+}
+
 void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply *reply, const QUrl &cover_url) {
 
   reply->deleteLater();
@@ -365,8 +558,8 @@ void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply *reply, const QUrl &cov
     // Try to load the image
     QByteArray image_data = reply->readAll();
     QString mime_type = Utilities::MimeTypeFromData(image_data);
-    QImage image;
-    if (image.loadFromData(image_data)) {
+    const QImage image = ImageUtils::ReadImage(image_data, DecodeSize(task.options));
+    if (!image.isNull()) {
       QImage image_scaled;
       QImage image_thumbnail;
       if (task.options.scale_output_image_) image_scaled = ImageUtils::ScaleAndPad(image, task.options.scale_output_image_, task.options.pad_output_image_, task.options.desired_height_);
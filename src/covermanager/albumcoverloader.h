@@ -34,7 +34,10 @@
 #include <QQueue>
 #include <QByteArray>
 #include <QString>
+#include <QStringList>
+#include <QUrl>
 #include <QImage>
+#include <QSize>
 #include <QPixmap>
 
 #include "core/song.h"
@@ -44,7 +47,9 @@
 #include "albumcoverimageresult.h"
 
 class QThread;
+class QThreadPool;
 class QNetworkReply;
+class QNetworkDiskCache;
 class NetworkAccessManager;
 
 class AlbumCoverLoader : public QObject {
@@ -59,6 +64,18 @@ class AlbumCoverLoader : public QObject {
     Automatic
   };
 
+  static const int kMaxDecodeThreads;
+  static const qint64 kThumbnailCacheSize;
+
+  struct Statistics {
+    explicit Statistics() : thumbnail_cache_hits(0), thumbnail_cache_misses(0), images_decoded(0), decode_msec(0) {}
+    quint64 thumbnail_cache_hits;
+    quint64 thumbnail_cache_misses;
+    // Images read, decoded and scaled, and the time that took.
+    quint64 images_decoded;
+    qint64 decode_msec;
+  };
+
   void ExitAsync();
   void Stop() { stop_requested_ = true; }
 
@@ -70,6 +87,8 @@ class AlbumCoverLoader : public QObject {
   void CancelTask(const quint64 id);
   void CancelTasks(const QSet<quint64> &ids);
 
+  Statistics statistics() const;
+
   quint64 SaveEmbeddedCoverAsync(const QString &song_filename, const QString &cover_filename);
   quint64 SaveEmbeddedCoverAsync(const QString &song_filename, const QImage &image);
   quint64 SaveEmbeddedCoverAsync(const QString &song_filename, const QByteArray &image_data);
@@ -85,6 +104,8 @@ class AlbumCoverLoader : public QObject {
  protected slots:
   void Exit();
   void ProcessTasks();
+  void TaskFinished();
+  void StartRemoteFetches();
   void RemoteFetchFinished(QNetworkReply *reply, const QUrl &cover_url);
 
   void SaveEmbeddedCover(const quint64 id, const QString &song_filename, const QString &cover_filename);
@@ -110,23 +131,29 @@ class AlbumCoverLoader : public QObject {
     AlbumCoverLoaderResult::Type type;
     bool art_updated;
     int redirects;
+    // Where the scaled image is saved in the thumbnail cache, if it can be.
+    QUrl thumbnail_cache_url;
   };
 
   struct TryLoadResult {
     explicit TryLoadResult(const bool _started_async = false,
                            const bool _loaded_success = false,
                            const AlbumCoverLoaderResult::Type _type = AlbumCoverLoaderResult::Type_None,
-                           const AlbumCoverImageResult &_album_cover = AlbumCoverImageResult()) :
+                           const AlbumCoverImageResult &_album_cover = AlbumCoverImageResult(),
+                           const QImage &_image_scaled = QImage()) :
                            started_async(_started_async),
                            loaded_success(_loaded_success),
                            type(_type),
-                           album_cover(_album_cover) {}
+                           album_cover(_album_cover),
+                           image_scaled(_image_scaled) {}
 
     bool started_async;
     bool loaded_success;
 
     AlbumCoverLoaderResult::Type type;
     AlbumCoverImageResult album_cover;
+    // Set when the scaled image came from the thumbnail cache.
+    QImage image_scaled;
   };
 
   quint64 EnqueueTask(Task &task);
@@ -134,16 +161,34 @@ class AlbumCoverLoader : public QObject {
   void NextState(Task *task);
   TryLoadResult TryLoadImage(Task *task);
 
+  static QSize DecodeSize(const AlbumCoverLoaderOptions &options);
+  static QUrl ThumbnailCacheUrl(const Task &task, const QUrl &cover_url);
+  QImage LoadThumbnail(const QUrl &thumbnail_cache_url);
+  void SaveThumbnail(const QUrl &thumbnail_cache_url, const QImage &image);
+
   bool stop_requested_;
 
   QMutex mutex_load_image_async_;
   QMutex mutex_save_image_async_;
   QQueue<Task> tasks_;
   QHash<QNetworkReply*, Task> remote_tasks_;
+
+  // Local covers are read, decoded and scaled in the thread pool, remote ones are fetched in the loader thread.
+  QThreadPool *thread_pool_;
+  int running_tasks_;
+  QMutex mutex_remote_fetch_tasks_;
+  QQueue<QPair<Task, QUrl>> remote_fetch_tasks_;
+
+  QMutex mutex_thumbnail_cache_;
+  QNetworkDiskCache *thumbnail_cache_;
+
+  mutable QMutex mutex_statistics_;
+  Statistics statistics_;
   quint64 load_image_async_id_;
   quint64 save_image_async_id_;
 
   NetworkAccessManager *network_;
+  QStringList network_schemes_;
 
   static const int kMaxRedirects = 3;
 
@@ -35,6 +35,7 @@ struct AlbumCoverLoaderOptions {
         pad_output_image_(true),
         create_thumbnail_(false),
         pad_thumbnail_image_(false),
+        scaled_image_only_(false),
         desired_height_(120),
         thumbnail_size_(120, 120) {}
 
@@ -44,6 +45,8 @@ struct AlbumCoverLoaderOptions {
   bool pad_output_image_;
   bool create_thumbnail_;
   bool pad_thumbnail_image_;
+  // Only the scaled image is needed, so local covers can come from the thumbnail cache and images are decoded at a reduced size.
+  bool scaled_image_only_;
   int desired_height_;
   QSize thumbnail_size_;
   QImage default_output_image_;
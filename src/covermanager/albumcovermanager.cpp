@@ -154,6 +154,7 @@ AlbumCoverManager::AlbumCoverManager(Application *app, CollectionBackend *collec
   cover_loader_options_.pad_output_image_ = true;
   cover_loader_options_.desired_height_ = 120;
   cover_loader_options_.create_thumbnail_ = false;
+  cover_loader_options_.scaled_image_only_ = true;
 
   EnableCoversButtons();
 
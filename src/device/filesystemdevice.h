@@ -48,6 +48,9 @@ class FilesystemDevice : public ConnectedDevice, public virtual FilesystemMusicS
 
   Song::Source source() const final { return Song::Source::Device; }
 
+  // Removable drives are often slow flash that gains little from more writers.
+  int MaxParallelCopies() const override { return 2; }
+
   bool Init() override;
   void CloseAsync();
 
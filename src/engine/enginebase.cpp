@@ -71,6 +71,7 @@ Engine::Base::Base(const EngineType type, QObject *parent)
       bs2b_enabled_(false),
       http2_enabled_(true),
       strict_ssl_enabled_(false),
+      preroll_next_enabled_(false),
       about_to_end_emitted_(false) {}
 
 Engine::Base::~Base() = default;
@@ -158,6 +159,7 @@ void Engine::Base::ReloadSettings() {
   }
 
   strict_ssl_enabled_ = s.value("strict_ssl", false).toBool();
+  preroll_next_enabled_ = s.value("preroll_next", false).toBool();
 
   s.endGroup();
 
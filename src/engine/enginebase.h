@@ -80,6 +80,8 @@ class Base : public QObject {
   virtual qint64 length_nanosec() const = 0;
 
   virtual const Scope &scope(const int chunk_length) { Q_UNUSED(chunk_length); return scope_; }
+  // Engines that can fill a larger scope use its size to decide how many samples to return.
+  void EnsureScopeSize(const size_t size) { if (scope_.size() < size) scope_.resize(size); }
 
   // Sets new values for the beginning and end markers of the currently playing song.
   // This doesn't change the state of engine or the stream's current position.
@@ -216,6 +218,7 @@ class Base : public QObject {
   bool bs2b_enabled_;
   bool http2_enabled_;
   bool strict_ssl_enabled_;
+  bool preroll_next_enabled_;
 
  private:
   bool about_to_end_emitted_;
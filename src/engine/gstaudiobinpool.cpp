@@ -0,0 +1,85 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gst/gst.h>
+
+#include <QtGlobal>
+#include <QList>
+#include <QString>
+
+#include "gstaudiobinpool.h"
+
+// Enough for the current, the next and a fading out pipeline.
+constexpr int GstAudioBinPool::kDefaultMaxSize = 3;
+
+GstAudioBinPool::GstAudioBinPool(const int max_size)
+    : max_size_(max_size),
+      hits_(0),
+      misses_(0) {}
+
+GstAudioBinPool::~GstAudioBinPool() {
+  Clear();
+}
+
+bool GstAudioBinPool::Take(const QString &key, GstAudioBin *audiobin) {
+
+  // Newest first, that bin was used most recently.
+  for (int i = static_cast<int>(entries_.count()) - 1; i >= 0; --i) {
+    if (entries_[i].key == key) {
+      *audiobin = entries_.takeAt(i).audiobin;
+      ++hits_;
+      return true;
+    }
+  }
+
+  ++misses_;
+  return false;
+
+}
+
+void GstAudioBinPool::Return(const QString &key, const GstAudioBin &audiobin) {
+
+  if (!audiobin.bin) return;
+
+  if (max_size_ <= 0) {
+    gst_object_unref(audiobin.bin);
+    return;
+  }
+
+  while (entries_.count() >= max_size_) {
+    gst_object_unref(entries_.takeFirst().audiobin.bin);
+  }
+
+  Entry entry;
+  entry.key = key;
+  entry.audiobin = audiobin;
+  entries_ << entry;
+
+}
+
+void GstAudioBinPool::Clear() {
+
+  for (const Entry &entry : entries_) {
+    gst_object_unref(entry.audiobin.bin);
+  }
+  entries_.clear();
+
+}
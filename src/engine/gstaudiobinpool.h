@@ -0,0 +1,84 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef GSTAUDIOBINPOOL_H
+#define GSTAUDIOBINPOOL_H
+
+#include "config.h"
+
+#include <gst/gst.h>
+
+#include <QtGlobal>
+#include <QList>
+#include <QString>
+
+// The audio bin of a GstEnginePipeline with the elements the pipeline needs to control.
+// Elements that are disabled in the configuration the bin was built for are nullptr.
+struct GstAudioBin {
+  GstAudioBin() : bin(nullptr), audiosink(nullptr), audioqueue(nullptr), audioqueueconverter(nullptr), volume_sw(nullptr), volume_fading(nullptr), audiopanorama(nullptr), equalizer(nullptr), equalizer_preamp(nullptr), eventprobe(nullptr) {}
+  GstElement *bin;
+  GstElement *audiosink;
+  GstElement *audioqueue;
+  GstElement *audioqueueconverter;
+  GstElement *volume_sw;
+  GstElement *volume_fading;
+  GstElement *audiopanorama;
+  GstElement *equalizer;
+  GstElement *equalizer_preamp;
+  GstElement *eventprobe;
+};
+
+// Audio bins that were built for earlier pipelines, so the next pipeline with the same output device and effects doesn't have to create and link all the elements again.
+// Bins are returned in NULL state, without a parent, and the pool owns one reference to each of them.
+// Only used from the main thread.
+class GstAudioBinPool {
+ public:
+  explicit GstAudioBinPool(const int max_size = kDefaultMaxSize);
+  ~GstAudioBinPool();
+
+  static const int kDefaultMaxSize;
+
+  // Returns false if there is no bin for the key, otherwise the caller gets the pool's reference to the bin.
+  bool Take(const QString &key, GstAudioBin *audiobin);
+
+  // Takes over a reference to the bin. The oldest bin is dropped when the pool is full.
+  void Return(const QString &key, const GstAudioBin &audiobin);
+
+  void Clear();
+
+  int size() const { return static_cast<int>(entries_.count()); }
+  int hits() const { return hits_; }
+  int misses() const { return misses_; }
+
+ private:
+  struct Entry {
+    QString key;
+    GstAudioBin audiobin;
+  };
+
+  const int max_size_;
+  // Oldest first.
+  QList<Entry> entries_;
+  int hits_;
+  int misses_;
+
+  Q_DISABLE_COPY(GstAudioBinPool)
+};
+
+#endif  // GSTAUDIOBINPOOL_H
@@ -55,7 +55,9 @@
 #include "enginetype.h"
 #include "gstengine.h"
 #include "gstenginepipeline.h"
+#include "gstaudiobinpool.h"
 #include "gstbufferconsumer.h"
+#include "pcmringbuffer.h"
 
 const char *GstEngine::kAutoSink = "autoaudiosink";
 const char *GstEngine::kALSASink = "alsasink";
@@ -77,7 +79,12 @@ GstEngine::GstEngine(TaskManager *task_manager, QObject *parent)
       gst_startup_(nullptr),
       discoverer_(nullptr),
       buffering_task_id_(-1),
-      latest_buffer_(nullptr),
+      preroll_beginning_nanosec_(0),
+      preroll_end_nanosec_(0),
+      preroll_switch_count_(0),
+      preroll_gap_total_nanosec_(0),
+      preroll_gap_max_nanosec_(0),
+      audiobin_pool_(std::make_shared<GstAudioBinPool>()),
       stereo_balancer_enabled_(false),
       stereo_balance_(0.0F),
       equalizer_enabled_(false),
@@ -88,9 +95,6 @@ GstEngine::GstEngine(TaskManager *task_manager, QObject *parent)
       timer_id_(-1),
       is_fading_out_to_pause_(false),
       has_faded_out_(false),
-      scope_chunk_(0),
-      have_new_buffer_(false),
-      scope_chunks_(0),
       discovery_finished_cb_id_(-1),
       discovery_discovered_cb_id_(-1) {
 
@@ -105,13 +109,9 @@ GstEngine::GstEngine(TaskManager *task_manager, QObject *parent)
 GstEngine::~GstEngine() {
 
   EnsureInitialized();
+  ClearPrerolledPipeline();
   current_pipeline_.reset();
 
-  if (latest_buffer_) {
-    gst_buffer_unref(latest_buffer_);
-    latest_buffer_ = nullptr;
-  }
-
   if (discoverer_) {
 
     if (discovery_discovered_cb_id_ != -1) {
@@ -162,7 +162,15 @@ void GstEngine::StartPreloading(const QUrl &stream_url, const QUrl &original_url
 
   // No crossfading, so we can just queue the new URL in the existing pipeline and get gapless playback (hopefully)
   if (current_pipeline_) {
-    current_pipeline_->SetNextUrl(gst_url, original_url, beginning_nanosec, force_stop_at_end ? end_nanosec : 0);
+    ClearPrerolledPipeline();
+    // The next section of the same file keeps playing in the current pipeline, there is nothing to pre-roll.
+    const bool next_section = gst_url == current_pipeline_->stream_url() && beginning_nanosec == end_nanosec_;
+    if (preroll_next_enabled_ && !next_section) {
+      PrerollPipeline(gst_url, original_url, static_cast<quint64>(beginning_nanosec), force_stop_at_end ? end_nanosec : 0);
+    }
+    else {
+      current_pipeline_->SetNextUrl(gst_url, original_url, beginning_nanosec, force_stop_at_end ? end_nanosec : 0);
+    }
     // Add request to discover the stream
     if (discoverer_) {
       if (!gst_discoverer_discover_uri_async(discoverer_, gst_url.constData())) {
@@ -191,7 +199,9 @@ bool GstEngine::Load(const QUrl &stream_url, const QUrl &original_url, Engine::T
     return true;
   }
 
-  std::shared_ptr<GstEnginePipeline> pipeline = CreatePipeline(gst_url, original_url, force_stop_at_end ? end_nanosec : 0);
+  // Use the pre-rolled pipeline if it is for this track, otherwise it's not needed anymore.
+  std::shared_ptr<GstEnginePipeline> pipeline = TakePrerolledPipeline(gst_url, beginning_nanosec, force_stop_at_end ? end_nanosec : 0);
+  if (!pipeline) pipeline = CreatePipeline(gst_url, original_url, force_stop_at_end ? end_nanosec : 0);
   if (!pipeline) return false;
 
   if (crossfade) StartFadeout();
@@ -261,6 +271,8 @@ void GstEngine::Stop(const bool stop_after) {
   original_url_.clear();
   beginning_nanosec_ = end_nanosec_ = 0;
 
+  ClearPrerolledPipeline();
+
   // Check if we started a fade out. If it isn't finished yet and the user pressed stop, we cancel the fader and just stop the playback.
   if (is_fading_out_to_pause_) {
     QObject::disconnect(current_pipeline_.get(), &GstEnginePipeline::FaderFinished, nullptr, nullptr);
@@ -371,23 +383,11 @@ qint64 GstEngine::length_nanosec() const {
 
 const Engine::Scope &GstEngine::scope(const int chunk_length) {
 
-  // The new buffer could have a different size
-  if (have_new_buffer_) {
-    if (latest_buffer_) {
-      scope_chunks_ = ceil((static_cast<double>(GST_BUFFER_DURATION(latest_buffer_) / static_cast<double>(chunk_length * kNsecPerMsec))));
-    }
-
-    // if the buffer is shorter than the chunk length
-    if (scope_chunks_ <= 0) {
-      scope_chunks_ = 1;
-    }
-
-    scope_chunk_ = 0;
-    have_new_buffer_ = false;
-  }
+  Q_UNUSED(chunk_length)
 
-  if (latest_buffer_) {
-    UpdateScope(chunk_length);
+  // Read the samples that are playing now, the last scope is kept if there is nothing new.
+  if (current_pipeline_) {
+    current_pipeline_->pcm_ring_buffer()->ReadWindow(g_get_monotonic_time() * kNsecPerUsec, scope_.data(), scope_.size());
   }
 
   return scope_;
@@ -441,15 +441,8 @@ void GstEngine::ReloadSettings() {
 
   if (output_.isEmpty()) output_ = kAutoSink;
 
-}
-
-void GstEngine::ConsumeBuffer(GstBuffer *buffer, const int pipeline_id, const QString &format) {
-
-  // Schedule this to run in the GUI thread.  The buffer gets added to the queue and unreffed by UpdateScope.
-  if (!QMetaObject::invokeMethod(this, "AddBufferToScope", Q_ARG(GstBuffer*, buffer), Q_ARG(int, pipeline_id), Q_ARG(QString, format))) {
-    qLog(Warning) << "Failed to invoke AddBufferToScope on GstEngine";
-    gst_buffer_unref(buffer);
-  }
+  // Bins built for the old settings won't be used again.
+  audiobin_pool_->Clear();
 
 }
 
@@ -526,7 +519,26 @@ void GstEngine::EndOfStreamReached(const int pipeline_id, const bool has_next_tr
   if (!current_pipeline_.get() || current_pipeline_->id() != pipeline_id)
     return;
 
+  if (!has_next_track && preroll_pipeline_) {
+    // The pre-rolled pipeline was already set to PLAYING from the streaming thread when this one posted EOS, so this just takes it over.
+    current_pipeline_->SetPrerolledNext(nullptr);
+    current_pipeline_ = preroll_pipeline_;
+    preroll_pipeline_.reset();
+    for (GstBufferConsumer *consumer : buffer_consumers_) {
+      current_pipeline_->AddBufferConsumer(consumer);
+    }
+    // The player seeks to the beginning of the new track, where the pipeline already is.
+    if (preroll_beginning_nanosec_ > 0) current_pipeline_->IgnoreNextSeek();
+    SetVolume(volume_);
+    SetStereoBalance(stereo_balance_);
+    SetEqualizerParameters(equalizer_preamp_, equalizer_gains_);
+    current_pipeline_->SetState(GST_STATE_PLAYING);
+    emit TrackEnded();
+    return;
+  }
+
   if (!has_next_track) {
+    ClearPrerolledPipeline();
     current_pipeline_.reset();
     BufferingFinished();
   }
@@ -536,10 +548,21 @@ void GstEngine::EndOfStreamReached(const int pipeline_id, const bool has_next_tr
 
 void GstEngine::HandlePipelineError(const int pipeline_id, const int domain, const int error_code, const QString &message, const QString &debugstr) {
 
+  if (preroll_pipeline_ && preroll_pipeline_->id() == pipeline_id) {
+    // Most likely the output can't open a second stream, let the current pipeline play the next track instead.
+    qLog(Warning) << "Could not pre-roll the next track:" << domain << error_code << message;
+    const QByteArray stream_url = preroll_pipeline_->stream_url();
+    const QUrl original_url = preroll_pipeline_->original_url();
+    ClearPrerolledPipeline();
+    if (current_pipeline_) current_pipeline_->SetNextUrl(stream_url, original_url, static_cast<qint64>(preroll_beginning_nanosec_), preroll_end_nanosec_);
+    return;
+  }
+
   if (!current_pipeline_.get() || current_pipeline_->id() != pipeline_id) return;
 
   qLog(Error) << "GStreamer error:" << domain << error_code << message;
 
+  ClearPrerolledPipeline();
   current_pipeline_.reset();
   BufferingFinished();
   emit StateChanged(Engine::State::Error);
@@ -570,23 +593,6 @@ void GstEngine::NewMetaData(const int pipeline_id, const Engine::SimpleMetaBundl
 
 }
 
-void GstEngine::AddBufferToScope(GstBuffer *buf, const int pipeline_id, const QString &format) {
-
-  if (!current_pipeline_ || current_pipeline_->id() != pipeline_id) {
-    gst_buffer_unref(buf);
-    return;
-  }
-
-  if (latest_buffer_) {
-    gst_buffer_unref(latest_buffer_);
-  }
-
-  buffer_format_ = format;
-  latest_buffer_ = buf;
-  have_new_buffer_ = true;
-
-}
-
 void GstEngine::FadeoutFinished() {
   fadeout_pipeline_.reset();
   emit FadeoutFinishedSignal();
@@ -657,6 +663,21 @@ void GstEngine::PlayDone(const GstStateChangeReturn ret, const quint64 offset_na
 
 }
 
+void GstEngine::PrerolledStarted(const int pipeline_id, const qint64 switch_latency_nanosec, const qint64 gap_nanosec) {
+
+  ++preroll_switch_count_;
+  preroll_gap_total_nanosec_ += gap_nanosec;
+  preroll_gap_max_nanosec_ = qMax(preroll_gap_max_nanosec_, gap_nanosec);
+
+  qLog(Debug) << "Switched to pre-rolled pipeline" << pipeline_id
+              << "switch latency:" << static_cast<double>(switch_latency_nanosec) / kNsecPerMsec << "ms"
+              << "gap:" << static_cast<double>(gap_nanosec) / kNsecPerMsec << "ms"
+              << "average gap:" << static_cast<double>(preroll_gap_total_nanosec_) / preroll_switch_count_ / kNsecPerMsec << "ms"
+              << "max gap:" << static_cast<double>(preroll_gap_max_nanosec_) / kNsecPerMsec << "ms"
+              << "switches:" << preroll_switch_count_;
+
+}
+
 void GstEngine::BufferingStarted() {
 
   if (buffering_task_id_ != -1) {
@@ -804,8 +825,8 @@ std::shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline() {
   ret->set_bs2b_enabled(bs2b_enabled_);
   ret->set_strict_ssl_enabled(strict_ssl_enabled_);
   ret->set_fading_enabled(fadeout_enabled_ || autocrossfade_enabled_ || fadeout_pause_enabled_);
+  ret->set_audiobin_pool(audiobin_pool_);
 
-  ret->AddBufferConsumer(this);
   for (GstBufferConsumer *consumer : buffer_consumers_) {
     ret->AddBufferConsumer(consumer);
   }
@@ -817,6 +838,7 @@ std::shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline() {
   QObject::connect(ret.get(), &GstEnginePipeline::BufferingProgress, this, &GstEngine::BufferingProgress);
   QObject::connect(ret.get(), &GstEnginePipeline::BufferingFinished, this, &GstEngine::BufferingFinished);
   QObject::connect(ret.get(), &GstEnginePipeline::VolumeChanged, this, &EngineBase::UpdateVolume);
+  QObject::connect(ret.get(), &GstEnginePipeline::PrerolledStarted, this, &GstEngine::PrerolledStarted);
 
   return ret;
 
@@ -837,65 +859,60 @@ std::shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline(const QByteArray &g
 
 }
 
-void GstEngine::UpdateScope(const int chunk_length) {
+void GstEngine::PrerollPipeline(const QByteArray &gst_url, const QUrl &original_url, const quint64 beginning_nanosec, const qint64 end_nanosec) {
 
-  using sample_type = Engine::Scope::value_type;
+  std::shared_ptr<GstEnginePipeline> pipeline = CreatePipeline();
+  QString error;
+  if (!pipeline->InitFromUrl(gst_url, original_url, end_nanosec, error)) {
+    qLog(Warning) << "Could not pre-roll" << gst_url << error;
+    current_pipeline_->SetNextUrl(gst_url, original_url, static_cast<qint64>(beginning_nanosec), end_nanosec);
+    return;
+  }
 
-  // Prevent dbz or invalid chunk size
-  if (!GST_CLOCK_TIME_IS_VALID(GST_BUFFER_DURATION(latest_buffer_))) return;
-  if (GST_BUFFER_DURATION(latest_buffer_) == 0) return;
+  // Consumers only get the buffers once the pipeline takes over.
+  pipeline->RemoveAllBufferConsumers();
 
-  GstMapInfo map;
-  gst_buffer_map(latest_buffer_, &map, GST_MAP_READ);
+  pipeline->SetVolume(volume_);
+  pipeline->SetStereoBalance(stereo_balance_);
+  pipeline->SetEqualizerParams(equalizer_preamp_, equalizer_gains_);
 
-  // Determine where to split the buffer
-  int chunk_density = static_cast<int>((map.size * kNsecPerMsec) / GST_BUFFER_DURATION(latest_buffer_));
+  // The seek is done as soon as the pipeline is paused, before the sink prerolls the first buffer of the track.
+  if (beginning_nanosec > 0) pipeline->Seek(static_cast<qint64>(beginning_nanosec));
+  pipeline->SetState(GST_STATE_PAUSED);
 
-  int chunk_size = chunk_length * chunk_density;
+  preroll_pipeline_ = pipeline;
+  preroll_beginning_nanosec_ = beginning_nanosec;
+  preroll_end_nanosec_ = end_nanosec;
 
-  // In case a buffer doesn't arrive in time
-  if (scope_chunk_ >= scope_chunks_) {
-    scope_chunk_ = 0;
-    gst_buffer_unmap(latest_buffer_, &map);
-    return;
-  }
+  current_pipeline_->SetPrerolledNext(pipeline.get());
 
-  const sample_type *source = reinterpret_cast<sample_type*>(map.data);
-  sample_type *dest = scope_.data();
-  source += (chunk_size / sizeof(sample_type)) * scope_chunk_;
+}
 
-  size_t bytes = 0;
+std::shared_ptr<GstEnginePipeline> GstEngine::TakePrerolledPipeline(const QByteArray &gst_url, const quint64 beginning_nanosec, const qint64 end_nanosec) {
 
-  // Make sure we don't go beyond the end of the buffer
-  if (scope_chunk_ == scope_chunks_ - 1) {
-    bytes = qMin(static_cast<Engine::Scope::size_type>(map.size - (chunk_size * scope_chunk_)), scope_.size() * sizeof(sample_type));
+  std::shared_ptr<GstEnginePipeline> pipeline;
+  if (preroll_pipeline_ && preroll_pipeline_->stream_url() == gst_url && preroll_beginning_nanosec_ == beginning_nanosec && preroll_end_nanosec_ == end_nanosec) {
+    pipeline = preroll_pipeline_;
   }
-  else {
-    bytes = qMin(static_cast<Engine::Scope::size_type>(chunk_size), scope_.size() * sizeof(sample_type));
+  ClearPrerolledPipeline();
+
+  if (pipeline) {
+    for (GstBufferConsumer *consumer : buffer_consumers_) {
+      pipeline->AddBufferConsumer(consumer);
+    }
   }
 
-  scope_chunk_++;
+  return pipeline;
 
-  if (buffer_format_.startsWith("S16LE") ||
-      buffer_format_.startsWith("U16LE") ||
-      buffer_format_.startsWith("S24LE") ||
-      buffer_format_.startsWith("S24_32LE") ||
-      buffer_format_.startsWith("S32LE") ||
-      buffer_format_.startsWith("F32LE")
-  ) {
-    memcpy(dest, source, bytes);
-  }
-  else {
-    memset(dest, 0, bytes);
-  }
+}
 
-  gst_buffer_unmap(latest_buffer_, &map);
+void GstEngine::ClearPrerolledPipeline() {
 
-  if (scope_chunk_ == scope_chunks_) {
-    gst_buffer_unref(latest_buffer_);
-    latest_buffer_ = nullptr;
-    buffer_format_.clear();
-  }
+  if (!preroll_pipeline_) return;
+
+  // The current pipeline holds a plain pointer to start it.
+  if (current_pipeline_) current_pipeline_->SetPrerolledNext(nullptr);
+  preroll_pipeline_.reset();
 
 }
 
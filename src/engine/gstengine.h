@@ -48,13 +48,14 @@ class QTimer;
 class QTimerEvent;
 class TaskManager;
 class GstEnginePipeline;
+class GstAudioBinPool;
 
 /**
  * @class GstEngine
  * @short GStreamer engine plugin
  * @author Mark Kretschmann <markey@web.de>
  */
-class GstEngine : public Engine::Base, public GstBufferConsumer {
+class GstEngine : public Engine::Base {
   Q_OBJECT
 
  public:
@@ -90,8 +91,6 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   void SetStartup(GstStartup *gst_startup) { gst_startup_ = gst_startup; }
   void EnsureInitialized() { gst_startup_->EnsureInitialized(); }
 
-  void ConsumeBuffer(GstBuffer *buffer, const int pipeline_id, const QString &format) override;
-
  public slots:
   void ReloadSettings() override;
 
@@ -117,11 +116,11 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   void EndOfStreamReached(const int pipeline_id, const bool has_next_track);
   void HandlePipelineError(const int pipeline_id, const int domain, const int error_code, const QString &message, const QString &debugstr);
   void NewMetaData(const int pipeline_id, const Engine::SimpleMetaBundle &bundle);
-  void AddBufferToScope(GstBuffer *buf, const int pipeline_id, const QString &format);
   void FadeoutFinished();
   void FadeoutPauseFinished();
   void SeekNow();
   void PlayDone(const GstStateChangeReturn ret, const quint64, const int);
+  void PrerolledStarted(const int pipeline_id, const qint64 switch_latency_nanosec, const qint64 gap_nanosec);
 
   void BufferingStarted();
   void BufferingProgress(int percent);
@@ -140,7 +139,9 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   std::shared_ptr<GstEnginePipeline> CreatePipeline();
   std::shared_ptr<GstEnginePipeline> CreatePipeline(const QByteArray &gst_url, const QUrl &original_url, const qint64 end_nanosec);
 
-  void UpdateScope(int chunk_length);
+  void PrerollPipeline(const QByteArray &gst_url, const QUrl &original_url, const quint64 beginning_nanosec, const qint64 end_nanosec);
+  std::shared_ptr<GstEnginePipeline> TakePrerolledPipeline(const QByteArray &gst_url, const quint64 beginning_nanosec, const qint64 end_nanosec);
+  void ClearPrerolledPipeline();
 
   static void StreamDiscovered(GstDiscoverer*, GstDiscovererInfo *info, GError*, gpointer self);
   static void StreamDiscoveryFinished(GstDiscoverer*, gpointer);
@@ -174,9 +175,19 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   std::shared_ptr<GstEnginePipeline> fadeout_pause_pipeline_;
   QUrl preloaded_url_;
 
+  // The next track, pre-rolled in PAUSED state when preroll_next_enabled_ is set.
+  std::shared_ptr<GstEnginePipeline> preroll_pipeline_;
+  quint64 preroll_beginning_nanosec_;
+  qint64 preroll_end_nanosec_;
+
+  // Track changes to a pre-rolled pipeline, logged for debugging.
+  int preroll_switch_count_;
+  qint64 preroll_gap_total_nanosec_;
+  qint64 preroll_gap_max_nanosec_;
+
   QList<GstBufferConsumer*> buffer_consumers_;
 
-  GstBuffer *latest_buffer_;
+  std::shared_ptr<GstAudioBinPool> audiobin_pool_;
 
   bool stereo_balancer_enabled_;
   float stereo_balance_;
@@ -195,11 +206,6 @@ class GstEngine : public Engine::Base, public GstBufferConsumer {
   bool is_fading_out_to_pause_;
   bool has_faded_out_;
 
-  int scope_chunk_;
-  bool have_new_buffer_;
-  int scope_chunks_;
-  QString buffer_format_;
-
   int discovery_finished_cb_id_;
   int discovery_discovered_cb_id_;
 
@@ -22,6 +22,8 @@
 #include "config.h"
 
 #include <memory>
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <cmath>
@@ -40,6 +42,7 @@
 #include <QList>
 #include <QVariant>
 #include <QString>
+#include <QStringList>
 #include <QUrl>
 #include <QTimeLine>
 #include <QEasingCurve>
@@ -54,12 +57,14 @@
 #include "gstengine.h"
 #include "gstenginepipeline.h"
 #include "gstbufferconsumer.h"
+#include "gstaudiobinpool.h"
 
 constexpr int GstEnginePipeline::kGstStateTimeoutNanosecs = 10000000;
 constexpr int GstEnginePipeline::kFaderFudgeMsec = 2000;
 
 constexpr int GstEnginePipeline::kEqBandCount = 10;
 constexpr int GstEnginePipeline::kEqBandFrequencies[] = { 60, 170, 310, 600, 1000, 3000, 6000, 12000, 14000, 16000 };
+constexpr int GstEnginePipeline::kConvertBufferPoolSize = 8;
 
 int GstEnginePipeline::sId = 1;
 
@@ -89,7 +94,20 @@ GstEnginePipeline::GstEnginePipeline(QObject *parent)
       strict_ssl_enabled_(false),
       segment_start_(0),
       segment_start_received_(false),
+      buffer_caps_received_(false),
+      buffer_sample_format_(SampleConverter::Format::Unknown),
+      buffer_channels_(1),
+      buffer_rate_(0),
+      buffer_bytes_per_frame_(0),
+      convert_buffer_index_(0),
+      pcm_ring_buffer_(new PcmRingBuffer),
       end_offset_nanosec_(-1),
+      preroll_next_(nullptr),
+      clip_at_end_offset_(false),
+      end_offset_reached_(false),
+      end_of_stream_pushed_(false),
+      preroll_end_of_stream_nanosec_(0),
+      preroll_switch_latency_nanosec_(0),
       next_beginning_offset_nanosec_(-1),
       next_end_offset_nanosec_(-1),
       ignore_next_seek_(false),
@@ -114,6 +132,8 @@ GstEnginePipeline::GstEnginePipeline(QObject *parent)
       equalizer_(nullptr),
       equalizer_preamp_(nullptr),
       eventprobe_(nullptr),
+      audiobin_from_pool_(false),
+      audiobin_complete_(false),
       upstream_events_probe_cb_id_(0),
       buffer_probe_cb_id_(0),
       playbin_probe_cb_id_(0),
@@ -127,6 +147,9 @@ GstEnginePipeline::GstEnginePipeline(QObject *parent)
   eq_band_gains_.reserve(kEqBandCount);
   for (int i = 0; i < kEqBandCount; ++i) eq_band_gains_ << 0;
 
+  convert_buffers_.reserve(kConvertBufferPoolSize);
+  for (int i = 0; i < kConvertBufferPoolSize; ++i) convert_buffers_ << nullptr;
+
 }
 
 GstEnginePipeline::~GstEnginePipeline() {
@@ -187,6 +210,10 @@ GstEnginePipeline::~GstEnginePipeline() {
 
     gst_element_set_state(pipeline_, GST_STATE_NULL);
 
+    if (audiobin_pool_ && audiobin_ && audiobin_complete_ && pipeline_is_connected_) {
+      ReturnAudioBin();
+    }
+
     gst_object_unref(GST_OBJECT(pipeline_));
 
     pipeline_ = nullptr;
@@ -199,6 +226,11 @@ GstEnginePipeline::~GstEnginePipeline() {
 
   }
 
+  for (GstBuffer *buf : convert_buffers_) {
+    if (buf) gst_buffer_unref(buf);
+  }
+  convert_buffers_.clear();
+
 }
 
 void GstEnginePipeline::set_output_device(const QString &output, const QVariant &device) {
@@ -271,6 +303,10 @@ void GstEnginePipeline::set_fading_enabled(const bool enabled) {
   fading_enabled_ = enabled;
 }
 
+void GstEnginePipeline::set_audiobin_pool(std::shared_ptr<GstAudioBinPool> audiobin_pool) {
+  audiobin_pool_ = audiobin_pool;
+}
+
 GstElement *GstEnginePipeline::CreateElement(const QString &factory_name, const QString &name, GstElement *bin, QString &error) const {
 
   QString unique_name = QString("pipeline") + "-" + QString::number(id_) + "-" + (name.isEmpty() ? factory_name : name);
@@ -322,6 +358,8 @@ bool GstEnginePipeline::InitFromUrl(const QByteArray &stream_url, const QUrl &or
 
   // Set playbin's sink to be our custom audio-sink.
   g_object_set(GST_OBJECT(pipeline_), "audio-sink", audiobin_, nullptr);
+  // A new bin is floating and the playbin sinks it, a bin from the pool comes with a reference that now belongs to the playbin.
+  if (audiobin_from_pool_) gst_object_unref(audiobin_);
 
   gint flags = 0;
   g_object_get(G_OBJECT(pipeline_), "flags", &flags, nullptr);
@@ -342,6 +380,128 @@ bool GstEnginePipeline::InitAudioBin(QString &error) {
 
   gst_segment_init(&last_playbin_segment_, GST_FORMAT_TIME);
 
+  GstAudioBin audiobin;
+  if (audiobin_pool_ && audiobin_pool_->Take(AudioBinKey(), &audiobin)) {
+    audiobin_ = audiobin.bin;
+    audiosink_ = audiobin.audiosink;
+    audioqueue_ = audiobin.audioqueue;
+    audioqueueconverter_ = audiobin.audioqueueconverter;
+    volume_sw_ = audiobin.volume_sw;
+    volume_fading_ = audiobin.volume_fading;
+    audiopanorama_ = audiobin.audiopanorama;
+    equalizer_ = audiobin.equalizer;
+    equalizer_preamp_ = audiobin.equalizer_preamp;
+    eventprobe_ = audiobin.eventprobe;
+    audiobin_from_pool_ = true;
+    // The last pipeline could have faded it out.
+    if (volume_fading_) g_object_set(G_OBJECT(volume_fading_), "volume", 1.0, nullptr);
+    if (audiopanorama_) g_object_set(G_OBJECT(audiopanorama_), "panorama", stereo_balance_, nullptr);
+  }
+  else if (!CreateAudioBin(error)) {
+    return false;
+  }
+
+  audiobin_complete_ = true;
+
+  if (g_object_class_find_property(G_OBJECT_GET_CLASS(audiosink_), "volume")) {
+    qLog(Debug) << output_ << "has volume, enabling volume synchronization.";
+    SetupVolume(audiosink_);
+  }
+
+  // Add a data probe on the src pad of the audioconvert element for our scope.
+  // We do it here because we want pre-equalized and pre-volume samples so that our visualization are not be affected by them.
+  {
+    GstPad *pad = gst_element_get_static_pad(eventprobe_, "src");
+    if (pad) {
+      upstream_events_probe_cb_id_ = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, &UpstreamEventsProbeCallback, this, nullptr);
+      gst_object_unref(pad);
+    }
+  }
+
+  {  // Add probes and handlers.
+    GstPad *pad = gst_element_get_static_pad(audioqueueconverter_, "src");
+    if (pad) {
+      buffer_probe_cb_id_ = gst_pad_add_probe(pad, static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM), BufferProbeCallback, this, nullptr);
+      gst_object_unref(pad);
+    }
+  }
+
+  {
+    GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+    if (bus) {
+      gst_bus_set_sync_handler(bus, BusSyncCallback, this, nullptr);
+      gst_bus_add_watch(bus, BusWatchCallback, this);
+      gst_object_unref(bus);
+    }
+  }
+
+  logged_unsupported_analyzer_format_ = false;
+
+  return true;
+
+}
+
+QString GstEnginePipeline::AudioBinKey() const {
+
+  // Everything that changes which elements are in the bin or how they are set up when they are created.
+  return QStringList() << output_
+                       << device_.toString()
+                       << QString::number(volume_enabled_)
+                       << QString::number(stereo_balancer_enabled_)
+                       << QString::number(eq_enabled_)
+                       << QString::number(fading_enabled_)
+                       << QString::number(rg_enabled_)
+                       << QString::number(rg_mode_)
+                       << QString::number(rg_preamp_)
+                       << QString::number(rg_fallbackgain_)
+                       << QString::number(rg_compression_)
+                       << QString::number(buffer_duration_nanosec_)
+                       << QString::number(buffer_low_watermark_)
+                       << QString::number(buffer_high_watermark_)
+                       << QString::number(channels_enabled_ ? channels_ : 0)
+                       << QString::number(bs2b_enabled_);
+
+}
+
+void GstEnginePipeline::ReturnAudioBin() {
+
+  // Keep the bin alive and take it out of the playbin, which is in NULL state now.
+  gst_object_ref(audiobin_);
+
+  GstPad *pad = gst_element_get_static_pad(audiobin_, "sink");
+  if (pad) {
+    GstPad *peer = gst_pad_get_peer(pad);
+    if (peer) {
+      gst_pad_unlink(peer, pad);
+      gst_object_unref(peer);
+    }
+    gst_object_unref(pad);
+  }
+
+  GstObject *parent = gst_object_get_parent(GST_OBJECT(audiobin_));
+  if (parent) {
+    gst_bin_remove(GST_BIN(parent), audiobin_);
+    gst_object_unref(parent);
+  }
+  g_object_set(G_OBJECT(pipeline_), "audio-sink", nullptr, nullptr);
+
+  GstAudioBin audiobin;
+  audiobin.bin = audiobin_;
+  audiobin.audiosink = audiosink_;
+  audiobin.audioqueue = audioqueue_;
+  audiobin.audioqueueconverter = audioqueueconverter_;
+  audiobin.volume_sw = volume_sw_;
+  audiobin.volume_fading = volume_fading_;
+  audiobin.audiopanorama = audiopanorama_;
+  audiobin.equalizer = equalizer_;
+  audiobin.equalizer_preamp = equalizer_preamp_;
+  audiobin.eventprobe = eventprobe_;
+  audiobin_pool_->Return(AudioBinKey(), audiobin);
+
+}
+
+bool GstEnginePipeline::CreateAudioBin(QString &error) {
+
   // Audio bin
   audiobin_ = gst_bin_new("audiobin");
   if (!audiobin_) return false;
@@ -459,10 +619,7 @@ bool GstEnginePipeline::InitAudioBin(QString &error) {
 
   }
 
-  if (g_object_class_find_property(G_OBJECT_GET_CLASS(audiosink_), "volume")) {
-    qLog(Debug) << output_ << "has volume, enabling volume synchronization.";
-    SetupVolume(audiosink_);
-  }
+  const bool sink_has_volume = g_object_class_find_property(G_OBJECT_GET_CLASS(audiosink_), "volume") != nullptr;
 
   // Create all the other elements
 
@@ -482,7 +639,7 @@ bool GstEnginePipeline::InitAudioBin(QString &error) {
   }
 
   // Create the volume element if it's enabled.
-  if (volume_enabled_ && !volume_) {
+  if (volume_enabled_ && !sink_has_volume) {
     volume_sw_ = CreateElement("volume", "volume_sw", audiobin_, error);
     if (!volume_sw_) {
       return false;
@@ -597,16 +754,6 @@ bool GstEnginePipeline::InitAudioBin(QString &error) {
     }
   }
 
-  // Add a data probe on the src pad of the audioconvert element for our scope.
-  // We do it here because we want pre-equalized and pre-volume samples so that our visualization are not be affected by them.
-  {
-    GstPad *pad = gst_element_get_static_pad(eventprobe_, "src");
-    if (pad) {
-      upstream_events_probe_cb_id_ = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, &UpstreamEventsProbeCallback, this, nullptr);
-      gst_object_unref(pad);
-    }
-  }
-
   // Set the buffer duration.
   // We set this on this queue instead of the playbin because setting it on the playbin only affects network sources.
   // Disable the default buffer and byte limits, so we only buffer based on time.
@@ -708,25 +855,6 @@ bool GstEnginePipeline::InitAudioBin(QString &error) {
     }
   }
 
-  {  // Add probes and handlers.
-    GstPad *pad = gst_element_get_static_pad(audioqueueconverter_, "src");
-    if (pad) {
-      buffer_probe_cb_id_ = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, BufferProbeCallback, this, nullptr);
-      gst_object_unref(pad);
-    }
-  }
-
-  {
-    GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
-    if (bus) {
-      gst_bus_set_sync_handler(bus, BusSyncCallback, this, nullptr);
-      gst_bus_add_watch(bus, BusWatchCallback, this);
-      gst_object_unref(bus);
-    }
-  }
-
-  logged_unsupported_analyzer_format_ = false;
-
   return true;
 
 }
@@ -932,143 +1060,92 @@ GstPadProbeReturn GstEnginePipeline::BufferProbeCallback(GstPad *pad, GstPadProb
 
   GstEnginePipeline *instance = reinterpret_cast<GstEnginePipeline*>(self);
 
-  QString format;
-  int channels = 1;
-  int rate = 0;
+  const GstPadProbeType info_type = GST_PAD_PROBE_INFO_TYPE(info);
 
-  GstCaps *caps = gst_pad_get_current_caps(pad);
-  if (caps) {
-    GstStructure *structure = gst_caps_get_structure(caps, 0);
-    if (structure) {
-      format = QString(gst_structure_get_string(structure, "format"));
-      gst_structure_get_int(structure, "channels", &channels);
-      gst_structure_get_int(structure, "rate", &rate);
+  if (info_type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = gst_pad_probe_info_get_event(info);
+    if (event && GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+      GstCaps *caps = nullptr;
+      gst_event_parse_caps(event, &caps);
+      instance->UpdateBufferCaps(caps);
+    }
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (!(info_type & GST_PAD_PROBE_TYPE_BUFFER)) return GST_PAD_PROBE_OK;
+
+  // The probe can be added after the caps were negotiated, so fall back to querying them once.
+  if (!instance->buffer_caps_received_) {
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (caps) {
+      instance->UpdateBufferCaps(caps);
+      gst_caps_unref(caps);
     }
-    gst_caps_unref(caps);
   }
 
   GstBuffer *buf = gst_pad_probe_info_get_buffer(info);
-  GstBuffer *buf16 = nullptr;
 
   quint64 start_time = GST_BUFFER_TIMESTAMP(buf) - instance->segment_start_;
   quint64 duration = GST_BUFFER_DURATION(buf);
   qint64 end_time = static_cast<qint64>(start_time + duration);
 
-  if (format.startsWith("S16LE")) {
-    instance->logged_unsupported_analyzer_format_ = false;
+  if (instance->clip_at_end_offset_ && instance->end_offset_nanosec_ > 0 && end_time > instance->end_offset_nanosec_) {
+    buf = instance->ClipBufferAtEndOffset(pad, buf, start_time);
+    if (!buf) return GST_PAD_PROBE_DROP;
+    GST_PAD_PROBE_INFO_DATA(info) = buf;
+    end_time = instance->end_offset_nanosec_;
   }
-  else if (format.startsWith("S32LE")) {
 
-    GstMapInfo map_info;
-    gst_buffer_map(buf, &map_info, GST_MAP_READ);
-
-    int32_t *s = reinterpret_cast<int32_t*>(map_info.data);
-    int samples = static_cast<int>((map_info.size / sizeof(int32_t)) / channels);
-    int buf16_size = samples * static_cast<int>(sizeof(int16_t)) * channels;
-    int16_t *d = static_cast<int16_t*>(g_malloc(buf16_size));
-    memset(d, 0, buf16_size);
-    for (int i = 0; i < (samples * channels); ++i) {
-      d[i] = static_cast<int16_t>((s[i] >> 16));
-    }
-    gst_buffer_unmap(buf, &map_info);
-    buf16 = gst_buffer_new_wrapped(d, buf16_size);
-    GST_BUFFER_DURATION(buf16) = GST_FRAMES_TO_CLOCK_TIME(samples * sizeof(int16_t) * channels, rate);
-    buf = buf16;
-
-    instance->logged_unsupported_analyzer_format_ = false;
+  QList<GstBufferConsumer*> consumers;
+  {
+    QMutexLocker l(&instance->buffer_consumers_mutex_);
+    consumers = instance->buffer_consumers_;
   }
 
-  else if (format.startsWith("F32LE")) {
+  const qint64 now_nanosec = g_get_monotonic_time() * kNsecPerUsec;
+  const bool pcm_ring_buffer_active = instance->pcm_ring_buffer_->active(now_nanosec);
 
-    GstMapInfo map_info;
-    gst_buffer_map(buf, &map_info, GST_MAP_READ);
-
-    float *s = reinterpret_cast<float*>(map_info.data);
-    int samples = static_cast<int>((map_info.size / sizeof(float)) / channels);
-    int buf16_size = samples * static_cast<int>(sizeof(int16_t)) * channels;
-    int16_t *d = static_cast<int16_t*>(g_malloc(buf16_size));
-    memset(d, 0, buf16_size);
-    for (int i = 0; i < (samples * channels); ++i) {
-      float sample_float = (s[i] * static_cast<float>(32768.0));
-      d[i] = static_cast<int16_t>(sample_float);
+  if (instance->buffer_sample_format_ == SampleConverter::Format::Unknown && (pcm_ring_buffer_active || !consumers.isEmpty())) {
+    if (!instance->logged_unsupported_analyzer_format_) {
+      instance->logged_unsupported_analyzer_format_ = true;
+      qLog(Error) << "Unsupported audio format for the analyzer" << instance->buffer_format_;
     }
-    gst_buffer_unmap(buf, &map_info);
-    buf16 = gst_buffer_new_wrapped(d, buf16_size);
-    GST_BUFFER_DURATION(buf16) = GST_FRAMES_TO_CLOCK_TIME(samples * sizeof(int16_t) * channels, rate);
-    buf = buf16;
-
-    instance->logged_unsupported_analyzer_format_ = false;
   }
-  else if (format.startsWith("S24LE")) {
-
+  else if (pcm_ring_buffer_active) {
     GstMapInfo map_info;
-    gst_buffer_map(buf, &map_info, GST_MAP_READ);
-
-    int8_t *s24 = reinterpret_cast<int8_t*>(map_info.data);
-    int8_t *s24e = s24 + map_info.size;
-    int samples = static_cast<int>((map_info.size / sizeof(int8_t)) / channels);
-    int buf16_size = samples * static_cast<int>(sizeof(int16_t)) * channels;
-    int16_t *s16 = static_cast<int16_t*>(g_malloc(buf16_size));
-    memset(s16, 0, buf16_size);
-    for (int i = 0; i < (samples * channels); ++i) {
-      s16[i] = *(reinterpret_cast<int16_t*>(s24 + 1));
-      s24 += 3;
-      if (s24 >= s24e) break;
+    if (gst_buffer_map(buf, &map_info, GST_MAP_READ)) {
+      instance->pcm_ring_buffer_->Write(instance->buffer_sample_format_, map_info.data, map_info.size, instance->buffer_channels_, instance->buffer_rate_, now_nanosec);
+      gst_buffer_unmap(buf, &map_info);
     }
-    gst_buffer_unmap(buf, &map_info);
-    buf16 = gst_buffer_new_wrapped(s16, buf16_size);
-    GST_BUFFER_DURATION(buf16) = GST_FRAMES_TO_CLOCK_TIME(samples * sizeof(int16_t) * channels, rate);
-    buf = buf16;
-
     instance->logged_unsupported_analyzer_format_ = false;
   }
-  else if (format.startsWith("S24_32LE")) {
 
-    GstMapInfo map_info;
-    gst_buffer_map(buf, &map_info, GST_MAP_READ);
-
-    int32_t *s32 = reinterpret_cast<int32_t*>(map_info.data);
-    int32_t *s32e = s32 + map_info.size;
-    int32_t *s32p = s32;
-    int samples = static_cast<int>((map_info.size / sizeof(int32_t)) / channels);
-    int buf16_size = samples * static_cast<int>(sizeof(int16_t)) * channels;
-    int16_t *s16 = static_cast<int16_t*>(g_malloc(buf16_size));
-    memset(s16, 0, buf16_size);
-    for (int i = 0; i < (samples * channels); ++i) {
-      int8_t *s24 = reinterpret_cast<int8_t*>(s32p);
-      s16[i] = *(reinterpret_cast<int16_t*>(s24 + 1));
-      ++s32p;
-      if (s32p > s32e) break;
-    }
-    gst_buffer_unmap(buf, &map_info);
-    buf16 = gst_buffer_new_wrapped(s16, buf16_size);
-    GST_BUFFER_DURATION(buf16) = GST_FRAMES_TO_CLOCK_TIME(samples * sizeof(int16_t) * channels, rate);
-    buf = buf16;
+  // Without consumers there is nothing to convert the samples for.
+  if (!consumers.isEmpty()) {
 
-    instance->logged_unsupported_analyzer_format_ = false;
-  }
-  else if (!instance->logged_unsupported_analyzer_format_) {
-    instance->logged_unsupported_analyzer_format_ = true;
-    qLog(Error) << "Unsupported audio format for the analyzer" << format;
-  }
+    GstBuffer *buf16 = nullptr;
 
-  QList<GstBufferConsumer*> consumers;
-  {
-    QMutexLocker l(&instance->buffer_consumers_mutex_);
-    consumers = instance->buffer_consumers_;
-  }
+    if (instance->buffer_sample_format_ != SampleConverter::Format::Unknown) {
+      if (SampleConverter::NeedsConversion(instance->buffer_sample_format_)) {
+        buf16 = instance->ConvertBuffer(buf);
+        if (buf16) buf = buf16;
+      }
+      instance->logged_unsupported_analyzer_format_ = false;
+    }
 
-  for (GstBufferConsumer *consumer : consumers) {
-    gst_buffer_ref(buf);
-    consumer->ConsumeBuffer(buf, instance->id(), format);
-  }
+    for (GstBufferConsumer *consumer : consumers) {
+      gst_buffer_ref(buf);
+      consumer->ConsumeBuffer(buf, instance->id(), instance->buffer_format_);
+    }
+
+    if (buf16) {
+      gst_buffer_unref(buf16);
+    }
 
-  if (buf16) {
-    gst_buffer_unref(buf16);
   }
 
   // Calculate the end time of this buffer so we can stop playback if it's after the end time of this song.
-  if (instance->end_offset_nanosec_ > 0 && end_time > instance->end_offset_nanosec_) {
+  if (!instance->clip_at_end_offset_ && instance->end_offset_nanosec_ > 0 && end_time > instance->end_offset_nanosec_) {
     if (instance->has_next_valid_url() && instance->next_stream_url_ == instance->stream_url_ && instance->next_beginning_offset_nanosec_ == instance->end_offset_nanosec_) {
       // The "next" song is actually the next segment of this file - so cheat and keep on playing, but just tell the Engine we've moved on.
       instance->end_offset_nanosec_ = instance->next_end_offset_nanosec_;
@@ -1091,6 +1168,135 @@ GstPadProbeReturn GstEnginePipeline::BufferProbeCallback(GstPad *pad, GstPadProb
 
 }
 
+void GstEnginePipeline::UpdateBufferCaps(GstCaps *caps) {
+
+  if (!caps) return;
+
+  GstStructure *structure = gst_caps_get_structure(caps, 0);
+  if (!structure) return;
+
+  int channels = 1;
+  int rate = 0;
+  buffer_format_ = QString(gst_structure_get_string(structure, "format"));
+  gst_structure_get_int(structure, "channels", &channels);
+  gst_structure_get_int(structure, "rate", &rate);
+  buffer_sample_format_ = SampleConverter::FormatFromString(buffer_format_);
+  buffer_channels_ = qMax(1, channels);
+  buffer_rate_ = rate;
+
+  GstAudioInfo audio_info;
+  buffer_bytes_per_frame_ = gst_audio_info_from_caps(&audio_info, caps) ? GST_AUDIO_INFO_BPF(&audio_info) : 0;
+  buffer_caps_received_ = true;
+
+}
+
+GstBuffer *GstEnginePipeline::ConvertBuffer(GstBuffer *buf) {
+
+  const int bytes_per_sample = SampleConverter::BytesPerSample(buffer_sample_format_);
+  if (bytes_per_sample <= 0 || buffer_rate_ <= 0) return nullptr;
+
+  GstMapInfo map_info;
+  if (!gst_buffer_map(buf, &map_info, GST_MAP_READ)) return nullptr;
+
+  const gsize samples = map_info.size / static_cast<gsize>(bytes_per_sample);
+  const gsize buf16_size = samples * sizeof(int16_t);
+
+  // Reuse the next buffer in the ring if no consumer holds a reference to it anymore and it is large enough, otherwise replace it.
+  GstBuffer *&pooled = convert_buffers_[convert_buffer_index_];
+  convert_buffer_index_ = (convert_buffer_index_ + 1) % kConvertBufferPoolSize;
+  if (pooled) {
+    gsize maxsize = 0;
+    gst_buffer_get_sizes(pooled, nullptr, &maxsize);
+    if (gst_buffer_is_writable(pooled) && maxsize >= buf16_size) {
+      gst_buffer_set_size(pooled, static_cast<gssize>(buf16_size));
+    }
+    else {
+      gst_buffer_unref(pooled);
+      pooled = nullptr;
+    }
+  }
+  if (!pooled) {
+    pooled = gst_buffer_new_allocate(nullptr, buf16_size, nullptr);
+    if (!pooled) {
+      gst_buffer_unmap(buf, &map_info);
+      return nullptr;
+    }
+  }
+
+  GstMapInfo map_info16;
+  if (!gst_buffer_map(pooled, &map_info16, GST_MAP_WRITE)) {
+    gst_buffer_unmap(buf, &map_info);
+    return nullptr;
+  }
+  SampleConverter::ConvertToS16(buffer_sample_format_, map_info.data, reinterpret_cast<qint16*>(map_info16.data), samples);
+  gst_buffer_unmap(pooled, &map_info16);
+  gst_buffer_unmap(buf, &map_info);
+
+  GST_BUFFER_DURATION(pooled) = GST_FRAMES_TO_CLOCK_TIME(buf16_size, buffer_rate_);
+
+  // The pool keeps its own reference, the caller gets one to pass on to the consumers.
+  return gst_buffer_ref(pooled);
+
+}
+
+GstBuffer *GstEnginePipeline::ClipBufferAtEndOffset(GstPad *pad, GstBuffer *buf, const quint64 start_time) {
+
+  // Everything after the buffer that crosses the end offset is dropped, and the stream is ended so the sink posts EOS once it played the last sample.
+  if (end_offset_reached_.exchange(true)) {
+    if (!end_of_stream_pushed_.exchange(true)) {
+      gst_pad_push_event(pad, gst_event_new_eos());
+    }
+    return nullptr;
+  }
+
+  const gsize buffer_size = gst_buffer_get_size(buf);
+  const gsize size = BufferSizeAtEndOffset(start_time, end_offset_nanosec_, buffer_rate_, buffer_bytes_per_frame_, buffer_size);
+  if (size == 0) {
+    end_of_stream_pushed_ = true;
+    gst_pad_push_event(pad, gst_event_new_eos());
+    return nullptr;
+  }
+
+  if (size < buffer_size) {
+    buf = gst_buffer_make_writable(buf);
+    gst_buffer_resize(buf, 0, static_cast<gssize>(size));
+    GST_BUFFER_DURATION(buf) = gst_util_uint64_scale(size / static_cast<gsize>(buffer_bytes_per_frame_), GST_SECOND, static_cast<guint64>(buffer_rate_));
+  }
+
+  return buf;
+
+}
+
+gsize GstEnginePipeline::BufferSizeAtEndOffset(const quint64 start_time, const qint64 end_offset_nanosec, const int rate, const int bytes_per_frame, const gsize size) {
+
+  const qint64 keep_nanosec = end_offset_nanosec - static_cast<qint64>(start_time);
+  if (keep_nanosec <= 0 || rate <= 0 || bytes_per_frame <= 0) return 0;
+
+  const guint64 frames = gst_util_uint64_scale(static_cast<guint64>(keep_nanosec), static_cast<guint64>(rate), GST_SECOND);
+
+  return std::min(size, static_cast<gsize>(frames) * static_cast<gsize>(bytes_per_frame));
+
+}
+
+void GstEnginePipeline::SetPrerolledNext(GstEnginePipeline *pipeline) {
+
+  QMutexLocker l(&preroll_next_mutex_);
+  preroll_next_ = pipeline;
+  clip_at_end_offset_ = pipeline != nullptr;
+
+}
+
+void GstEnginePipeline::StartPrerolled(const qint64 end_of_stream_nanosec) {
+
+  preroll_switch_latency_nanosec_ = 0;
+  preroll_end_of_stream_nanosec_ = end_of_stream_nanosec;
+
+  // From PAUSED this returns right away, the sink is already waiting with the first buffer.
+  gst_element_set_state(pipeline_, GST_STATE_PLAYING);
+  preroll_switch_latency_nanosec_ = g_get_monotonic_time() * kNsecPerUsec - end_of_stream_nanosec;
+
+}
+
 void GstEnginePipeline::AboutToFinishCallback(GstPlayBin *playbin, gpointer self) {
 
   Q_UNUSED(playbin)
@@ -1113,9 +1319,18 @@ GstBusSyncReply GstEnginePipeline::BusSyncCallback(GstBus *bus, GstMessage *msg,
   GstEnginePipeline *instance = reinterpret_cast<GstEnginePipeline*>(self);
 
   switch (GST_MESSAGE_TYPE(msg)) {
-    case GST_MESSAGE_EOS:
+    case GST_MESSAGE_EOS:{
+      // Start the pre-rolled next pipeline before anything else, this is where the gap is.
+      const qint64 end_of_stream_nanosec = g_get_monotonic_time() * kNsecPerUsec;
+      QMutexLocker l(&instance->preroll_next_mutex_);
+      if (instance->preroll_next_) {
+        instance->preroll_next_->StartPrerolled(end_of_stream_nanosec);
+        instance->preroll_next_ = nullptr;
+      }
+      l.unlock();
       emit instance->EndOfStreamReached(instance->id(), false);
       break;
+    }
 
     case GST_MESSAGE_TAG:
       instance->TagMessageReceived(msg);
@@ -1383,6 +1598,16 @@ void GstEnginePipeline::StateChangedMessageReceived(GstMessage *msg) {
     }
   }
 
+  if (new_state == GST_STATE_PLAYING) {
+    const qint64 end_of_stream_nanosec = preroll_end_of_stream_nanosec_.exchange(0);
+    if (end_of_stream_nanosec > 0) {
+      const qint64 gap_nanosec = g_get_monotonic_time() * kNsecPerUsec - end_of_stream_nanosec;
+      // The state change can complete before gst_element_set_state() returns.
+      const qint64 switch_latency_nanosec = preroll_switch_latency_nanosec_ > 0 ? qMin(preroll_switch_latency_nanosec_.load(), gap_nanosec) : gap_nanosec;
+      emit PrerolledStarted(id(), switch_latency_nanosec, gap_nanosec);
+    }
+  }
+
   if (pipeline_is_initialized_ && new_state != GST_STATE_PAUSED && new_state != GST_STATE_PLAYING) {
     qLog(Debug) << "Pipeline uninitialized: State changed from" << old_state << "to" << new_state;
     pipeline_is_initialized_ = false;
@@ -1481,6 +1706,8 @@ bool GstEnginePipeline::Seek(const qint64 nanosec) {
 
   pending_seek_nanosec_ = -1;
   last_known_position_ns_ = nanosec;
+  end_offset_reached_ = false;
+  end_of_stream_pushed_ = false;
   return gst_element_seek_simple(pipeline_, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH, nanosec);
 
 }
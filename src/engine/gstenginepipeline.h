@@ -25,6 +25,7 @@
 #include "config.h"
 
 #include <memory>
+#include <atomic>
 #include <glib.h>
 #include <glib-object.h>
 #include <glib/gtypes.h>
@@ -44,8 +45,12 @@
 #include <QString>
 #include <QUrl>
 
+#include "sampleconverter.h"
+#include "pcmringbuffer.h"
+
 class QTimerEvent;
 class GstBufferConsumer;
+class GstAudioBinPool;
 
 namespace Engine {
 struct SimpleMetaBundle;
@@ -76,6 +81,7 @@ class GstEnginePipeline : public QObject {
   void set_bs2b_enabled(const bool enabled);
   void set_strict_ssl_enabled(const bool enabled);
   void set_fading_enabled(const bool enabled);
+  void set_audiobin_pool(std::shared_ptr<GstAudioBinPool> audiobin_pool);
 
   // Creates the pipeline, returns false on error
   bool InitFromUrl(const QByteArray &stream_url, const QUrl &original_url, const qint64 end_nanosec, QString &error);
@@ -85,6 +91,10 @@ class GstEnginePipeline : public QObject {
   void RemoveBufferConsumer(GstBufferConsumer *consumer);
   void RemoveAllBufferConsumers();
 
+  // Converted samples for the analyzer, written from the streaming thread while someone reads from it.
+  // Timestamps are in the g_get_monotonic_time() clock, in nanoseconds.
+  PcmRingBuffer *pcm_ring_buffer() const { return pcm_ring_buffer_.get(); }
+
   // Control the music playback
   QFuture<GstStateChangeReturn> SetState(const GstState state);
   Q_INVOKABLE bool Seek(const qint64 nanosec);
@@ -98,6 +108,14 @@ class GstEnginePipeline : public QObject {
   void SetNextUrl(const QByteArray &stream_url, const QUrl &original_url, qint64 beginning_nanosec, qint64 end_nanosec);
   bool has_next_valid_url() const { return !next_stream_url_.isEmpty(); }
 
+  // Alternative to SetNextUrl: the next track is already pre-rolled in another pipeline in PAUSED state.
+  // This pipeline then ends exactly at the end offset and sets the next pipeline to PLAYING from the streaming thread as soon as it reaches the end of the stream.
+  // The next pipeline must be unset before it is deleted.
+  void SetPrerolledNext(GstEnginePipeline *pipeline);
+  // Returns how many bytes of a buffer starting at start_time are played before the end offset, whole frames only.
+  static gsize BufferSizeAtEndOffset(const quint64 start_time, const qint64 end_offset_nanosec, const int rate, const int bytes_per_frame, const gsize size);
+  void IgnoreNextSeek() { ignore_next_seek_ = true; }
+
   void SetSourceDevice(const QString &device) { source_device_ = device; }
 
   // Get information about the music playback
@@ -129,6 +147,8 @@ class GstEnginePipeline : public QObject {
   void Error(int pipeline_id, int domain, int error_code, QString message, QString debug);
 
   void EndOfStreamReached(int pipeline_id, bool has_next_track);
+  // Emitted by a pre-rolled pipeline once it is playing, with the time it took to start it and the time since the previous pipeline played its last sample.
+  void PrerolledStarted(int pipeline_id, qint64 switch_latency_nanosec, qint64 gap_nanosec);
   void MetadataFound(int pipeline_id, const Engine::SimpleMetaBundle &bundle);
 
   void VolumeChanged(uint volume);
@@ -144,11 +164,18 @@ class GstEnginePipeline : public QObject {
  private:
   GstElement *CreateElement(const QString &factory_name, const QString &name, GstElement *bin, QString &error) const;
   bool InitAudioBin(QString &error);
+  bool CreateAudioBin(QString &error);
+  QString AudioBinKey() const;
+  void ReturnAudioBin();
   void SetupVolume(GstElement *element);
 
   // Static callbacks.  The GstEnginePipeline instance is passed in the last argument.
   static GstPadProbeReturn UpstreamEventsProbeCallback(GstPad *pad, GstPadProbeInfo *info, gpointer self);
   static GstPadProbeReturn BufferProbeCallback(GstPad *pad, GstPadProbeInfo *info, gpointer self);
+  void UpdateBufferCaps(GstCaps *caps);
+  GstBuffer *ConvertBuffer(GstBuffer *buf);
+  GstBuffer *ClipBufferAtEndOffset(GstPad *pad, GstBuffer *buf, const quint64 start_time);
+  void StartPrerolled(const qint64 end_of_stream_nanosec);
   static GstPadProbeReturn PlaybinProbeCallback(GstPad *pad, GstPadProbeInfo *info, gpointer self);
   static void ElementAddedCallback(GstBin *bin, GstBin*, GstElement *element, gpointer self);
   static void PadAddedCallback(GstElement *element, GstPad *pad, gpointer self);
@@ -181,6 +208,7 @@ class GstEnginePipeline : public QObject {
   static const int kFaderFudgeMsec;
   static const int kEqBandCount;
   static const int kEqBandFrequencies[];
+  static const int kConvertBufferPoolSize;
 
   // Using == to compare two pipelines is a bad idea, because new ones often get created in the same address as old ones.  This ID will be unique for each pipeline.
   // Threading warning: access to the static ID field isn't protected by a mutex because all pipeline creation is currently done in the main thread.
@@ -238,6 +266,20 @@ class GstEnginePipeline : public QObject {
   qint64 segment_start_;
   bool segment_start_received_;
 
+  // Negotiated caps of the buffer probe pad, updated from CAPS events so the streaming thread doesn't have to query and parse the caps for every buffer.
+  bool buffer_caps_received_;
+  QString buffer_format_;
+  SampleConverter::Format buffer_sample_format_;
+  int buffer_channels_;
+  int buffer_rate_;
+  int buffer_bytes_per_frame_;
+
+  // Preallocated buffers for samples converted to S16LE, a buffer is reused once all consumers have released it.
+  QList<GstBuffer*> convert_buffers_;
+  int convert_buffer_index_;
+
+  std::unique_ptr<PcmRingBuffer> pcm_ring_buffer_;
+
   // The URL that is currently playing, and the URL that is to be preloaded when the current track is close to finishing.
   QByteArray stream_url_;
   QUrl original_url_;
@@ -247,6 +289,17 @@ class GstEnginePipeline : public QObject {
   // If this is > 0 then the pipeline will be forced to stop when playback goes past this position.
   qint64 end_offset_nanosec_;
 
+  // The pre-rolled pipeline to start when this one ends, protected by the mutex because it is started from the streaming thread.
+  QMutex preroll_next_mutex_;
+  GstEnginePipeline *preroll_next_;
+  // Cut the stream at the exact sample of the end offset instead of letting the engine stop it, set while there is a pre-rolled next pipeline.
+  std::atomic<bool> clip_at_end_offset_;
+  std::atomic<bool> end_offset_reached_;
+  std::atomic<bool> end_of_stream_pushed_;
+  // Set on a pre-rolled pipeline when it is started, to measure the switch.
+  std::atomic<qint64> preroll_end_of_stream_nanosec_;
+  std::atomic<qint64> preroll_switch_latency_nanosec_;
+
   // We store the beginning and end for the preloading song too, so we can just carry on without reloading the file if the sections carry on from each other.
   qint64 next_beginning_offset_nanosec_;
   qint64 next_end_offset_nanosec_;
@@ -297,6 +350,11 @@ class GstEnginePipeline : public QObject {
   GstElement *equalizer_preamp_;
   GstElement *eventprobe_;
 
+  // The audio bin is taken from the pool if there is one for this configuration, and returned when the pipeline is deleted.
+  std::shared_ptr<GstAudioBinPool> audiobin_pool_;
+  bool audiobin_from_pool_;
+  bool audiobin_complete_;
+
   gulong upstream_events_probe_cb_id_;
   gulong buffer_probe_cb_id_;
   gulong playbin_probe_cb_id_;
@@ -0,0 +1,163 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+#include <QtGlobal>
+
+#include "utilities/timeconstants.h"
+#include "sampleconverter.h"
+#include "pcmringbuffer.h"
+
+// 2^17 samples is about 1.5 seconds of 44.1 kHz stereo.
+constexpr int PcmRingBuffer::kDefaultCapacityOrder = 17;
+constexpr qint64 PcmRingBuffer::kActiveTimeoutNanosec = 2 * kNsecPerSec;
+
+namespace {
+constexpr int kReadBlockRetries = 8;
+constexpr qint64 kMaxElapsedNanosec = 60 * kNsecPerSec;
+}
+
+PcmRingBuffer::PcmRingBuffer(const int capacity_order)
+    : capacity_(static_cast<size_t>(1) << capacity_order),
+      mask_(capacity_ - 1),
+      samples_(new qint16[capacity_]()),
+      reserve_position_(0),
+      block_sequence_(0),
+      block_start_(0),
+      block_samples_(0),
+      block_time_nanosec_(0),
+      block_channels_(0),
+      block_rate_(0),
+      last_read_nanosec_(std::numeric_limits<qint64>::min()) {}
+
+bool PcmRingBuffer::active(const qint64 time_nanosec) const {
+
+  const qint64 last_read_nanosec = last_read_nanosec_.load(std::memory_order_relaxed);
+  return last_read_nanosec != std::numeric_limits<qint64>::min() && time_nanosec - last_read_nanosec < kActiveTimeoutNanosec;
+
+}
+
+void PcmRingBuffer::Write(const SampleConverter::Format format, const void *data, const size_t bytes, const int channels, const int rate, const qint64 time_nanosec) {
+
+  const int bytes_per_sample = SampleConverter::BytesPerSample(format);
+  if (bytes_per_sample <= 0 || channels <= 0 || rate <= 0) return;
+
+  const quint8 *source = static_cast<const quint8*>(data);
+  size_t samples = bytes / static_cast<size_t>(bytes_per_sample);
+  samples -= samples % static_cast<size_t>(channels);
+  if (samples == 0) return;
+
+  qint64 first_sample_nanosec = time_nanosec;
+  if (samples > capacity_) {
+    // Only the end of the block fits, skip the rest.
+    size_t skip = samples - capacity_;
+    skip += (static_cast<size_t>(channels) - skip % static_cast<size_t>(channels)) % static_cast<size_t>(channels);
+    source += skip * static_cast<size_t>(bytes_per_sample);
+    samples -= skip;
+    first_sample_nanosec += static_cast<qint64>(skip / static_cast<size_t>(channels)) * kNsecPerSec / rate;
+  }
+
+  const quint64 start = block_start_.load(std::memory_order_relaxed) + block_samples_.load(std::memory_order_relaxed);
+
+  // Announce which samples are about to be overwritten before touching them.
+  reserve_position_.store(start + samples, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  const size_t offset = static_cast<size_t>(start & mask_);
+  const size_t first = qMin(samples, capacity_ - offset);
+  SampleConverter::ConvertToS16(format, source, samples_.get() + offset, first);
+  if (first < samples) {
+    SampleConverter::ConvertToS16(format, source + first * static_cast<size_t>(bytes_per_sample), samples_.get(), samples - first);
+  }
+
+  const quint32 sequence = block_sequence_.load(std::memory_order_relaxed);
+  block_sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  block_start_.store(start, std::memory_order_relaxed);
+  block_samples_.store(samples, std::memory_order_relaxed);
+  block_time_nanosec_.store(first_sample_nanosec, std::memory_order_relaxed);
+  block_channels_.store(channels, std::memory_order_relaxed);
+  block_rate_.store(rate, std::memory_order_relaxed);
+  block_sequence_.store(sequence + 2, std::memory_order_release);
+
+}
+
+bool PcmRingBuffer::ReadBlock(Block *block) const {
+
+  for (int i = 0; i < kReadBlockRetries; ++i) {
+    const quint32 sequence = block_sequence_.load(std::memory_order_acquire);
+    if (sequence & 1U) continue;
+    block->start = block_start_.load(std::memory_order_relaxed);
+    block->samples = block_samples_.load(std::memory_order_relaxed);
+    block->time_nanosec = block_time_nanosec_.load(std::memory_order_relaxed);
+    block->channels = block_channels_.load(std::memory_order_relaxed);
+    block->rate = block_rate_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (block_sequence_.load(std::memory_order_relaxed) == sequence) return true;
+  }
+
+  return false;
+
+}
+
+bool PcmRingBuffer::ReadWindow(const qint64 time_nanosec, qint16 *dest, const size_t count, int *channels) {
+
+  last_read_nanosec_.store(time_nanosec, std::memory_order_relaxed);
+
+  if (count == 0 || count > capacity_ / 2) return false;
+
+  Block block;
+  if (!ReadBlock(&block) || block.samples == 0 || block.channels <= 0 || block.rate <= 0) return false;
+
+  // Find the sample that belongs to the given time, relative to the start of the last block.
+  // If the next block is late, the window stops at the last sample written.
+  const quint64 block_end = block.start + block.samples;
+  quint64 end = block.start;
+  if (time_nanosec > block.time_nanosec) {
+    // Anything past the ring capacity ends at the last sample anyway, clamping keeps the multiplication from overflowing.
+    const qint64 elapsed_nanosec = qMin(time_nanosec - block.time_nanosec, kMaxElapsedNanosec);
+    const quint64 frames = static_cast<quint64>(elapsed_nanosec * block.rate / kNsecPerSec);
+    end = qMin(block_end, block.start + frames * static_cast<quint64>(block.channels));
+  }
+  if (end < count) return false;
+  const quint64 start = end - count;
+
+  const size_t offset = static_cast<size_t>(start & mask_);
+  const size_t first = qMin(count, capacity_ - offset);
+  memcpy(dest, samples_.get() + offset, first * sizeof(qint16));
+  if (first < count) {
+    memcpy(dest + first, samples_.get(), (count - first) * sizeof(qint16));
+  }
+
+  // The producer doesn't wait for us, so check that it didn't start overwriting the window while it was copied.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (reserve_position_.load(std::memory_order_relaxed) > start + capacity_) return false;
+
+  if (channels) *channels = block.channels;
+
+  return true;
+
+}
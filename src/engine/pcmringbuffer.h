@@ -0,0 +1,89 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PCMRINGBUFFER_H
+#define PCMRINGBUFFER_H
+
+#include "config.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include <QtGlobal>
+
+#include "sampleconverter.h"
+
+// Lock-free single producer, single consumer ring of interleaved signed 16 bit samples.
+// The producer is the GStreamer streaming thread, it never waits for the consumer and overwrites the oldest samples.
+// The consumer reads the window of samples that belongs to a point in time, and detects when the samples were overwritten while it was copying them.
+// Timestamps can be in any clock as long as the producer and consumer use the same one.
+class PcmRingBuffer {
+ public:
+  explicit PcmRingBuffer(const int capacity_order = kDefaultCapacityOrder);
+
+  static const int kDefaultCapacityOrder;
+  static const qint64 kActiveTimeoutNanosec;
+
+  size_t capacity() const { return capacity_; }
+
+  // Producer: whether a consumer has read from the ring recently, when not there is no need to write to it.
+  bool active(const qint64 time_nanosec) const;
+
+  // Producer: converts the samples in data to S16 and appends them, time_nanosec is the time of the first sample.
+  void Write(const SampleConverter::Format format, const void *data, const size_t bytes, const int channels, const int rate, const qint64 time_nanosec);
+
+  // Consumer: copies the count samples before the given time to dest.
+  // Returns false if nothing has been written yet, if there aren't enough samples or if the samples were overwritten while copying.
+  bool ReadWindow(const qint64 time_nanosec, qint16 *dest, const size_t count, int *channels = nullptr);
+
+ private:
+  struct Block {
+    Block() : start(0), samples(0), time_nanosec(0), channels(0), rate(0) {}
+    quint64 start;
+    quint64 samples;
+    qint64 time_nanosec;
+    int channels;
+    int rate;
+  };
+
+  bool ReadBlock(Block *block) const;
+
+ private:
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<qint16[]> samples_;
+
+  // Position up to which the producer may be writing, stored before the samples are written.
+  std::atomic<quint64> reserve_position_;
+
+  // The last written block, protected by a sequence counter which is odd while the producer updates it.
+  std::atomic<quint32> block_sequence_;
+  std::atomic<quint64> block_start_;
+  std::atomic<quint64> block_samples_;
+  std::atomic<qint64> block_time_nanosec_;
+  std::atomic<int> block_channels_;
+  std::atomic<int> block_rate_;
+
+  std::atomic<qint64> last_read_nanosec_;
+
+  Q_DISABLE_COPY(PcmRingBuffer)
+};
+
+#endif  // PCMRINGBUFFER_H
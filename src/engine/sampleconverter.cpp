@@ -0,0 +1,296 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define SAMPLECONVERTER_SSE2
+#  include <emmintrin.h>
+#endif
+
+#if defined(SAMPLECONVERTER_SSE2) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#  define SAMPLECONVERTER_AVX2
+#  include <immintrin.h>
+#  define SAMPLECONVERTER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include <QtGlobal>
+#include <QString>
+
+#include "sampleconverter.h"
+
+namespace SampleConverter {
+
+namespace {
+
+inline qint16 S32ToS16(const qint32 sample) {
+  return static_cast<qint16>(sample >> 16);
+}
+
+inline qint16 F32ToS16(const float sample) {
+
+  // Clamp the same way the SSE2 kernel does (minps returns the second operand for NaN).
+  float value = sample * 32768.0F;
+  if (!(value < 32767.0F)) value = 32767.0F;
+  if (value < -32768.0F) value = -32768.0F;
+  return static_cast<qint16>(static_cast<qint32>(value));
+
+}
+
+inline qint16 S24_32ToS16(const qint32 sample) {
+  return static_cast<qint16>(static_cast<quint16>(static_cast<quint32>(sample) >> 8));
+}
+
+void ConvertS32Scalar(const qint32 *src, qint16 *dst, const size_t samples) {
+  for (size_t i = 0; i < samples; ++i) dst[i] = S32ToS16(src[i]);
+}
+
+void ConvertF32Scalar(const float *src, qint16 *dst, const size_t samples) {
+  for (size_t i = 0; i < samples; ++i) dst[i] = F32ToS16(src[i]);
+}
+
+void ConvertS24_32Scalar(const qint32 *src, qint16 *dst, const size_t samples) {
+  for (size_t i = 0; i < samples; ++i) dst[i] = S24_32ToS16(src[i]);
+}
+
+// Packed 24 bit samples are left scalar, shuffling 3 byte samples needs SSSE3 and the format is rare after audioconvert.
+void ConvertS24Scalar(const quint8 *src, qint16 *dst, const size_t samples) {
+  for (size_t i = 0; i < samples; ++i, src += 3) {
+    dst[i] = static_cast<qint16>(static_cast<quint16>(src[1] | (src[2] << 8)));
+  }
+}
+
+#ifdef SAMPLECONVERTER_SSE2
+
+void ConvertS32SSE2(const qint32 *src, qint16 *dst, const size_t samples) {
+
+  size_t i = 0;
+  for (; i + 8 <= samples; i += 8) {
+    const __m128i a = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), 16);
+    const __m128i b = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)), 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+  }
+  ConvertS32Scalar(src + i, dst + i, samples - i);
+
+}
+
+void ConvertF32SSE2(const float *src, qint16 *dst, const size_t samples) {
+
+  const __m128 scale = _mm_set1_ps(32768.0F);
+  const __m128 max = _mm_set1_ps(32767.0F);
+  size_t i = 0;
+  for (; i + 8 <= samples; i += 8) {
+    // Values below the int16 range are saturated by packs, values above are clamped before the conversion to avoid the integer indefinite value.
+    const __m128i a = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), max));
+    const __m128i b = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), max));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+  }
+  ConvertF32Scalar(src + i, dst + i, samples - i);
+
+}
+
+void ConvertS24_32SSE2(const qint32 *src, qint16 *dst, const size_t samples) {
+
+  size_t i = 0;
+  for (; i + 8 <= samples; i += 8) {
+    const __m128i a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), 8), 16);
+    const __m128i b = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)), 8), 16);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+  }
+  ConvertS24_32Scalar(src + i, dst + i, samples - i);
+
+}
+
+#endif  // SAMPLECONVERTER_SSE2
+
+#ifdef SAMPLECONVERTER_AVX2
+
+// _mm256_packs_epi32 packs within 128 bit lanes, the permute puts the samples back in order.
+
+SAMPLECONVERTER_TARGET_AVX2 void ConvertS32AVX2(const qint32 *src, qint16 *dst, const size_t samples) {
+
+  size_t i = 0;
+  for (; i + 16 <= samples; i += 16) {
+    const __m256i a = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), 16);
+    const __m256i b = _mm256_srai_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 8)), 16);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+  }
+  ConvertS32SSE2(src + i, dst + i, samples - i);
+
+}
+
+SAMPLECONVERTER_TARGET_AVX2 void ConvertF32AVX2(const float *src, qint16 *dst, const size_t samples) {
+
+  const __m256 scale = _mm256_set1_ps(32768.0F);
+  const __m256 max = _mm256_set1_ps(32767.0F);
+  size_t i = 0;
+  for (; i + 16 <= samples; i += 16) {
+    const __m256i a = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), max));
+    const __m256i b = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), max));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+  }
+  ConvertF32SSE2(src + i, dst + i, samples - i);
+
+}
+
+SAMPLECONVERTER_TARGET_AVX2 void ConvertS24_32AVX2(const qint32 *src, qint16 *dst, const size_t samples) {
+
+  size_t i = 0;
+  for (; i + 16 <= samples; i += 16) {
+    const __m256i a = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), 8), 16);
+    const __m256i b = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 8)), 8), 16);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+  }
+  ConvertS24_32SSE2(src + i, dst + i, samples - i);
+
+}
+
+bool HasAVX2() {
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+
+#endif  // SAMPLECONVERTER_AVX2
+
+}  // namespace
+
+Format FormatFromString(const QString &format) {
+
+  // S24_32LE has to be checked before S24LE, and the startsWith matches the way the analyzer checks the format.
+  if (format.startsWith(QLatin1String("S16LE"))) return Format::S16LE;
+  if (format.startsWith(QLatin1String("S32LE"))) return Format::S32LE;
+  if (format.startsWith(QLatin1String("F32LE"))) return Format::F32LE;
+  if (format.startsWith(QLatin1String("S24_32LE"))) return Format::S24_32LE;
+  if (format.startsWith(QLatin1String("S24LE"))) return Format::S24LE;
+
+  return Format::Unknown;
+
+}
+
+int BytesPerSample(const Format format) {
+
+  switch (format) {
+    case Format::S16LE:
+      return 2;
+    case Format::S24LE:
+      return 3;
+    case Format::S32LE:
+    case Format::F32LE:
+    case Format::S24_32LE:
+      return 4;
+    case Format::Unknown:
+      break;
+  }
+
+  return 0;
+
+}
+
+bool NeedsConversion(const Format format) {
+  return format != Format::Unknown && format != Format::S16LE;
+}
+
+bool SimdAvailable() {
+#ifdef SAMPLECONVERTER_SSE2
+  return true;
+#else
+  return false;
+#endif
+}
+
+void ConvertToS16(const Format format, const void *src, qint16 *dst, const size_t samples, const bool allow_simd) {
+
+#ifndef SAMPLECONVERTER_SSE2
+  Q_UNUSED(allow_simd)
+#endif
+
+  switch (format) {
+    case Format::S16LE:
+      memcpy(dst, src, samples * sizeof(qint16));
+      break;
+
+    case Format::S32LE:{
+      const qint32 *s = static_cast<const qint32*>(src);
+#ifdef SAMPLECONVERTER_SSE2
+      if (allow_simd) {
+#ifdef SAMPLECONVERTER_AVX2
+        if (HasAVX2()) {
+          ConvertS32AVX2(s, dst, samples);
+          break;
+        }
+#endif
+        ConvertS32SSE2(s, dst, samples);
+        break;
+      }
+#endif
+      ConvertS32Scalar(s, dst, samples);
+      break;
+    }
+
+    case Format::F32LE:{
+      const float *s = static_cast<const float*>(src);
+#ifdef SAMPLECONVERTER_SSE2
+      if (allow_simd) {
+#ifdef SAMPLECONVERTER_AVX2
+        if (HasAVX2()) {
+          ConvertF32AVX2(s, dst, samples);
+          break;
+        }
+#endif
+        ConvertF32SSE2(s, dst, samples);
+        break;
+      }
+#endif
+      ConvertF32Scalar(s, dst, samples);
+      break;
+    }
+
+    case Format::S24_32LE:{
+      const qint32 *s = static_cast<const qint32*>(src);
+#ifdef SAMPLECONVERTER_SSE2
+      if (allow_simd) {
+#ifdef SAMPLECONVERTER_AVX2
+        if (HasAVX2()) {
+          ConvertS24_32AVX2(s, dst, samples);
+          break;
+        }
+#endif
+        ConvertS24_32SSE2(s, dst, samples);
+        break;
+      }
+#endif
+      ConvertS24_32Scalar(s, dst, samples);
+      break;
+    }
+
+    case Format::S24LE:
+      ConvertS24Scalar(static_cast<const quint8*>(src), dst, samples);
+      break;
+
+    case Format::Unknown:
+      break;
+  }
+
+}
+
+}  // namespace SampleConverter
@@ -0,0 +1,60 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SAMPLECONVERTER_H
+#define SAMPLECONVERTER_H
+
+#include "config.h"
+
+#include <cstddef>
+
+#include <QtGlobal>
+#include <QString>
+
+// Converts raw interleaved PCM to signed 16 bit samples for the analyzer and other buffer consumers.
+// The kernels use SSE2 and AVX2 when available and fall back to plain loops otherwise.
+namespace SampleConverter {
+
+enum class Format {
+  Unknown,
+  S16LE,
+  S32LE,
+  F32LE,
+  S24LE,
+  S24_32LE
+};
+
+Format FormatFromString(const QString &format);
+
+// Size in bytes of one sample in the given format, or 0 for unknown formats.
+int BytesPerSample(const Format format);
+
+// Whether samples in this format need to be converted before they are passed on.
+bool NeedsConversion(const Format format);
+
+// Whether the vectorized kernels are used on this CPU.
+bool SimdAvailable();
+
+// Converts samples from src to dst, dst must have room for samples 16 bit values.
+// When allow_simd is false the scalar kernels are used, this is only useful for testing.
+void ConvertToS16(const Format format, const void *src, qint16 *dst, const size_t samples, const bool allow_simd = true);
+
+}  // namespace SampleConverter
+
+#endif  // SAMPLECONVERTER_H
@@ -19,7 +19,9 @@
  *
  */
 
+#include <memory>
 #include <functional>
+#include <utility>
 #include <chrono>
 
 #include <QtGlobal>
@@ -27,6 +29,10 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QTimer>
+#include <QThreadPool>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
 #include <QDateTime>
 #include <QList>
 #include <QString>
@@ -48,9 +54,9 @@ using namespace std::chrono_literals;
 
 class OrganizeFormat;
 
-const int Organize::kBatchSize = 10;
 #ifdef HAVE_GSTREAMER
 const int Organize::kTranscodeProgressInterval = 500;
+const int Organize::kMaxTranscodedFilesPerCopyThread = 2;
 #endif
 
 Organize::Organize(TaskManager *task_manager, std::shared_ptr<MusicStorage> destination, const OrganizeFormat &format, const bool copy, const bool overwrite, const bool albumcover, const NewSongInfoList &songs_info, const bool eject_after, const QString &playlist, QObject *parent)
@@ -61,6 +67,7 @@ Organize::Organize(TaskManager *task_manager, std::shared_ptr<MusicStorage> dest
       transcoder_(new Transcoder(this)),
 #endif
       process_files_timer_(new QTimer(this)),
+      copy_thread_pool_(new QThreadPool(this)),
       destination_(destination),
       format_(format),
       copy_(copy),
@@ -69,10 +76,10 @@ Organize::Organize(TaskManager *task_manager, std::shared_ptr<MusicStorage> dest
       eject_after_(eject_after),
       task_count_(songs_info.count()),
       playlist_(playlist),
+      transcoded_files_(0),
       tasks_complete_(0),
       started_(false),
       task_id_(0),
-      current_copy_progress_(0),
       finished_(false) {
 
   original_thread_ = thread();
@@ -83,7 +90,7 @@ Organize::Organize(TaskManager *task_manager, std::shared_ptr<MusicStorage> dest
 
   tasks_pending_.reserve(songs_info.count());
   for (const NewSongInfo &song_info : songs_info) {
-    tasks_pending_ << Task(song_info);
+    tasks_pending_ << Task(song_info, static_cast<int>(tasks_pending_.count()));
   }
 
 }
@@ -129,12 +136,25 @@ void Organize::ProcessSomeFiles() {
       tasks_pending_.clear();
     }
     started_ = true;
+
+    // Moves rename files and remove the directories they leave empty, so they are done one at a time.
+    copy_thread_pool_->setMaxThreadCount(copy_ ? qMax(1, destination_->MaxParallelCopies()) : 1);
+
+#ifdef HAVE_GSTREAMER
+    QueueTranscodes();
+    StartTranscoding();
+#endif
   }
 
   // None left?
   if (tasks_pending_.isEmpty()) {
+    if (!tasks_copying_.isEmpty()) {
+      // CopyFinished will start us off again
+      return;
+    }
+
 #ifdef HAVE_GSTREAMER
-    if (!tasks_transcoding_.isEmpty()) {
+    if (!tasks_transcoding_.isEmpty() || !tasks_to_transcode_.isEmpty()) {
       // Just wait - FileTranscoded will start us off again in a little while
       qLog(Debug) << "Waiting for transcoding jobs";
       transcode_progress_timer_.start(kTranscodeProgressInterval, this);
@@ -143,6 +163,7 @@ void Organize::ProcessSomeFiles() {
 #endif
 
     UpdateProgress();
+    LogStatistics();
 
     destination_->FinishCopy(files_with_errors_.isEmpty());
     if (eject_after_) destination_->Eject();
@@ -161,118 +182,181 @@ void Organize::ProcessSomeFiles() {
     return;
   }
 
-  // We process files in batches so we can be cancelled part-way through.
-  for (int i = 0; i < kBatchSize; ++i) {
-    SetSongProgress(0);
-
-    if (tasks_pending_.isEmpty()) break;
+  // Keep every writer of the destination busy, the rest of the files wait in the queue.
+  while (!tasks_pending_.isEmpty() && tasks_copying_.count() < copy_thread_pool_->maxThreadCount()) {
+    StartCopy(tasks_pending_.takeFirst());
+  }
+  UpdateProgress();
 
-    Task task = tasks_pending_.takeFirst();
-    qLog(Info) << "Processing" << task.song_info_.song_.url().toLocalFile();
+  // Nothing to wait for when all the files left were skipped.
+  if (tasks_copying_.isEmpty() && !process_files_timer_->isActive()) {
+    process_files_timer_->start();
+  }
 
-    // Use a Song instead of a tag reader
-    Song song = task.song_info_.song_;
-    if (!song.is_valid()) continue;
+}
 
 #ifdef HAVE_GSTREAMER
-    // Maybe this file is one that's been transcoded already?
-    if (!task.transcoded_filename_.isEmpty()) {
-      qLog(Debug) << "This file has already been transcoded";
-
-      // Set the new filetype on the song so the formatter gets it right
-      song.set_filetype(task.new_filetype_);
-
-      // Fiddle the filename extension as well to match the new type
-      song.set_url(QUrl::fromLocalFile(Utilities::FiddleFileExtension(song.basefilename(), task.new_extension_)));
-      song.set_basefilename(Utilities::FiddleFileExtension(song.basefilename(), task.new_extension_));
-      task.song_info_.new_filename_ = Utilities::FiddleFileExtension(task.song_info_.new_filename_, task.new_extension_);
+void Organize::QueueTranscodes() {
 
-      // Have to set this to the size of the new file or else funny stuff happens
-      song.set_filesize(QFileInfo(task.transcoded_filename_).size());
+  QVector<Task> tasks_copy;
+  for (Task &task : tasks_pending_) {
+    const Song::FileType dest_type = task.song_info_.song_.is_valid() ? CheckTranscode(task.song_info_.song_.filetype()) : Song::FileType::Unknown;
+    if (dest_type == Song::FileType::Unknown) {
+      tasks_copy << task;
     }
     else {
-      // Figure out if we need to transcode it
-      Song::FileType dest_type = CheckTranscode(song.filetype());
-      if (dest_type != Song::FileType::Unknown) {
-        // Get the preset
-        TranscoderPreset preset = Transcoder::PresetForFileType(dest_type);
-        qLog(Debug) << "Transcoding with" << preset.name_;
-
-        task.transcoded_filename_ = transcoder_->GetFile(task.song_info_.song_.url().toLocalFile(), preset);
-        task.new_extension_ = preset.extension_;
-        task.new_filetype_ = dest_type;
-        tasks_transcoding_[task.song_info_.song_.url().toLocalFile()] = task;
-        qLog(Debug) << "Transcoding to" << task.transcoded_filename_;
-
-        // Start the transcoding - this will happen in the background and FileTranscoded() will get called when it's done.
-        // At that point the task will get re-added to the pending queue with the new filename.
-        transcoder_->AddJob(task.song_info_.song_.url().toLocalFile(), preset, task.transcoded_filename_);
-        transcoder_->Start();
-        continue;
-      }
+      task.new_filetype_ = dest_type;
+      tasks_to_transcode_ << task;
     }
+  }
+  tasks_pending_ = tasks_copy;
+
+  if (!tasks_to_transcode_.isEmpty()) {
+    LogLine(tr("Transcoding %1 files using %2 threads").arg(tasks_to_transcode_.count()).arg(transcoder_->max_threads()));
+  }
+
+}
+
+void Organize::StartTranscoding() {
+
+  // Transcodes run next to the copies instead of waiting for their turn in the queue, but only a few files ahead of them,
+  // so the temporary files don't pile up when the destination is slower than the transcoder.
+  const int max_transcoded_files = kMaxTranscodedFilesPerCopyThread * copy_thread_pool_->maxThreadCount();
+  if (tasks_to_transcode_.isEmpty() || transcoded_files_ >= max_transcoded_files) return;
+
+  while (!tasks_to_transcode_.isEmpty() && transcoded_files_ < max_transcoded_files) {
+    Task task = tasks_to_transcode_.takeFirst();
+
+    // Get the preset
+    TranscoderPreset preset = Transcoder::PresetForFileType(task.new_filetype_);
+    qLog(Debug) << "Transcoding with" << preset.name_;
+
+    task.transcoded_filename_ = transcoder_->GetFile(task.song_info_.song_.url().toLocalFile(), preset);
+    task.new_extension_ = preset.extension_;
+    tasks_transcoding_[task.song_info_.song_.url().toLocalFile()] = task;
+    qLog(Debug) << "Transcoding to" << task.transcoded_filename_;
+
+    // The transcoding happens in the background and FileTranscoded() will get called when it's done.
+    // At that point the task will get re-added to the pending queue with the new filename.
+    transcoder_->AddJob(task.song_info_.song_.url().toLocalFile(), preset, task.transcoded_filename_);
+    transcode_stage_.JobStarted();
+    ++transcoded_files_;
+  }
+
+  // The transcoder runs as many jobs at a time as there are cores.
+  transcoder_->StartJobs();
+
+}
 #endif
 
-    MusicStorage::CopyJob job;
-    job.source_ = task.transcoded_filename_.isEmpty() ? task.song_info_.song_.url().toLocalFile() : task.transcoded_filename_;
-    job.destination_ = task.song_info_.new_filename_;
-    job.metadata_ = song;
-    job.overwrite_ = overwrite_;
-    job.albumcover_ = albumcover_;
-    job.remove_original_ = !copy_;
-    job.playlist_ = playlist_;
-
-    if (task.song_info_.song_.art_manual_is_valid() && !task.song_info_.song_.has_manually_unset_cover()) {
-      if (task.song_info_.song_.art_manual().isLocalFile() && QFile::exists(task.song_info_.song_.art_manual().toLocalFile())) {
-        job.cover_source_ = task.song_info_.song_.art_manual().toLocalFile();
-      }
-      else if (task.song_info_.song_.art_manual().scheme().isEmpty() && QFile::exists(task.song_info_.song_.art_manual().path())) {
-        job.cover_source_ = task.song_info_.song_.art_manual().path();
-      }
+void Organize::StartCopy(Task task) {
+
+  qLog(Info) << "Processing" << task.song_info_.song_.url().toLocalFile();
+
+  // Use a Song instead of a tag reader
+  Song song = task.song_info_.song_;
+  if (!song.is_valid()) return;
+
+#ifdef HAVE_GSTREAMER
+  // Maybe this file is one that's been transcoded already?
+  if (!task.transcoded_filename_.isEmpty()) {
+    qLog(Debug) << "This file has already been transcoded";
+
+    // Set the new filetype on the song so the formatter gets it right
+    song.set_filetype(task.new_filetype_);
+
+    // Fiddle the filename extension as well to match the new type
+    song.set_url(QUrl::fromLocalFile(Utilities::FiddleFileExtension(song.basefilename(), task.new_extension_)));
+    song.set_basefilename(Utilities::FiddleFileExtension(song.basefilename(), task.new_extension_));
+    task.song_info_.new_filename_ = Utilities::FiddleFileExtension(task.song_info_.new_filename_, task.new_extension_);
+
+    // Have to set this to the size of the new file or else funny stuff happens
+    song.set_filesize(QFileInfo(task.transcoded_filename_).size());
+  }
+#endif
+
+  MusicStorage::CopyJob job;
+  job.source_ = task.transcoded_filename_.isEmpty() ? task.song_info_.song_.url().toLocalFile() : task.transcoded_filename_;
+  job.destination_ = task.song_info_.new_filename_;
+  job.metadata_ = song;
+  job.overwrite_ = overwrite_;
+  job.albumcover_ = albumcover_;
+  job.remove_original_ = !copy_;
+  job.playlist_ = playlist_;
+
+  if (task.song_info_.song_.art_manual_is_valid() && !task.song_info_.song_.has_manually_unset_cover()) {
+    if (task.song_info_.song_.art_manual().isLocalFile() && QFile::exists(task.song_info_.song_.art_manual().toLocalFile())) {
+      job.cover_source_ = task.song_info_.song_.art_manual().toLocalFile();
     }
-    else if (task.song_info_.song_.art_automatic_is_valid() && !task.song_info_.song_.has_embedded_cover()) {
-      if (task.song_info_.song_.art_automatic().isLocalFile() && QFile::exists(task.song_info_.song_.art_automatic().toLocalFile())) {
-        job.cover_source_ = task.song_info_.song_.art_automatic().toLocalFile();
-      }
-      else if (task.song_info_.song_.art_automatic().scheme().isEmpty() && QFile::exists(task.song_info_.song_.art_automatic().path())) {
-        job.cover_source_ = task.song_info_.song_.art_automatic().path();
-      }
+    else if (task.song_info_.song_.art_manual().scheme().isEmpty() && QFile::exists(task.song_info_.song_.art_manual().path())) {
+      job.cover_source_ = task.song_info_.song_.art_manual().path();
     }
-    else if (destination_->source() == Song::Source::Device) {
-      job.cover_image_ = TagReaderClient::Instance()->LoadEmbeddedArtAsImageBlocking(task.song_info_.song_.url().toLocalFile());
+  }
+  else if (task.song_info_.song_.art_automatic_is_valid() && !task.song_info_.song_.has_embedded_cover()) {
+    if (task.song_info_.song_.art_automatic().isLocalFile() && QFile::exists(task.song_info_.song_.art_automatic().toLocalFile())) {
+      job.cover_source_ = task.song_info_.song_.art_automatic().toLocalFile();
     }
-
-    if (!job.cover_source_.isEmpty()) {
-      job.cover_dest_ = QFileInfo(job.destination_).path() + "/" + QFileInfo(job.cover_source_).fileName();
+    else if (task.song_info_.song_.art_automatic().scheme().isEmpty() && QFile::exists(task.song_info_.song_.art_automatic().path())) {
+      job.cover_source_ = task.song_info_.song_.art_automatic().path();
     }
+  }
+  else if (destination_->source() == Song::Source::Device) {
+    job.cover_image_ = TagReaderClient::Instance()->LoadEmbeddedArtAsImageBlocking(task.song_info_.song_.url().toLocalFile());
+  }
 
-    job.progress_ = std::bind(&Organize::SetSongProgress, this, std::placeholders::_1, !task.transcoded_filename_.isEmpty());
+  if (!job.cover_source_.isEmpty()) {
+    job.cover_dest_ = QFileInfo(job.destination_).path() + "/" + QFileInfo(job.cover_source_).fileName();
+  }
 
-    if (destination_->CopyToStorage(job)) {
-      if (job.remove_original_ && (destination_->source() == Song::Source::Collection || destination_->source() == Song::Source::Device)) {
-        // Notify other aspects of system that song has been invalidated
-        QString root = destination_->LocalPath();
-        QFileInfo new_file = QFileInfo(root + "/" + task.song_info_.new_filename_);
-        emit SongPathChanged(song, new_file, destination_->collection_directory_id());
-      }
-    }
-    else {
-      files_with_errors_ << task.song_info_.song_.basefilename();
-    }
+  // Called from the copying thread.
+  const int task_id = task.id_;
+  const bool transcoded = !task.transcoded_filename_.isEmpty();
+  job.progress_ = [this, task_id, transcoded](const float progress) {
+    QMetaObject::invokeMethod(this, "SetSongProgress", Qt::QueuedConnection, Q_ARG(int, task_id), Q_ARG(float, progress), Q_ARG(bool, transcoded));
+  };
 
-    // Clean up the temporary transcoded file
-    if (!task.transcoded_filename_.isEmpty()) {
-      QFile::remove(task.transcoded_filename_);
-    }
+  tasks_copying_[task_id] = transcoded ? 50 : 0;
+  copy_stage_.JobStarted();
+
+  QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>();
+  QObject::connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, task, song]() {
+    CopyFinished(task, song, watcher->result());
+    watcher->deleteLater();
+  });
+  std::shared_ptr<MusicStorage> destination = destination_;
+  watcher->setFuture(QtConcurrent::run(copy_thread_pool_, [destination, job]() { return destination->CopyToStorage(job); }));
 
-    tasks_complete_++;
+}
+
+void Organize::CopyFinished(const Task &task, const Song &song, const bool success) {
+
+  tasks_copying_.remove(task.id_);
+  copy_stage_.JobFinished(success ? song.filesize() : 0);
+
+  if (success) {
+    if (!copy_ && (destination_->source() == Song::Source::Collection || destination_->source() == Song::Source::Device)) {
+      // Notify other aspects of system that song has been invalidated
+      QString root = destination_->LocalPath();
+      QFileInfo new_file = QFileInfo(root + "/" + task.song_info_.new_filename_);
+      emit SongPathChanged(song, new_file, destination_->collection_directory_id());
+    }
+  }
+  else {
+    files_with_errors_ << task.song_info_.song_.basefilename();
   }
-  SetSongProgress(0);
 
-  if (!process_files_timer_->isActive()) {
-    process_files_timer_->start();
+  // Clean up the temporary transcoded file
+  if (!task.transcoded_filename_.isEmpty()) {
+    QFile::remove(task.transcoded_filename_);
+#ifdef HAVE_GSTREAMER
+    --transcoded_files_;
+    StartTranscoding();
+#endif
   }
 
+  tasks_complete_++;
+
+  ProcessSomeFiles();
 
 }
 
@@ -305,10 +389,12 @@ Song::FileType Organize::CheckTranscode(Song::FileType original_type) const {
 }
 #endif
 
-void Organize::SetSongProgress(float progress, bool transcoded) {
+void Organize::SetSongProgress(const int task_id, const float progress, const bool transcoded) {
+
+  if (!tasks_copying_.contains(task_id)) return;
 
   const int max = transcoded ? 50 : 100;
-  current_copy_progress_ = (transcoded ? 50 : 0) + qBound(0, static_cast<int>(progress * static_cast<float>(max)), max - 1);
+  tasks_copying_[task_id] = (transcoded ? 50 : 0) + qBound(0, static_cast<int>(progress * static_cast<float>(max)), max - 1);
   UpdateProgress();
 
 }
@@ -341,8 +427,10 @@ void Organize::UpdateProgress() {
   }
 #endif
 
-  // Add the progress of the track that's currently copying
-  progress += current_copy_progress_;
+  // Add the progress of the tracks that are currently copying
+  for (const int copy_progress : std::as_const(tasks_copying_)) {
+    progress += copy_progress;
+  }
 
   task_manager_->SetTaskProgress(task_id_, progress, total);
 
@@ -356,8 +444,13 @@ void Organize::FileTranscoded(const QString &input, const QString &output, bool
   transcode_progress_timer_.stop();
 
   Task task = tasks_transcoding_.take(input);
+  transcode_stage_.JobFinished(success ? task.song_info_.song_.filesize() : 0);
   if (!success) {
     files_with_errors_ << input;
+#ifdef HAVE_GSTREAMER
+    --transcoded_files_;
+    StartTranscoding();
+#endif
   }
   else {
     tasks_pending_ << task;
@@ -387,3 +480,35 @@ void Organize::LogLine(const QString &message) {
   log_.append(QString("%1: %2").arg(date, message));
 
 }
+
+void Organize::Stage::JobStarted() {
+
+  if (running_++ == 0) timer_.start();
+
+}
+
+void Organize::Stage::JobFinished(const qint64 bytes) {
+
+  bytes_ += bytes;
+  if (--running_ == 0) msec_ += timer_.elapsed();
+
+}
+
+qint64 Organize::Stage::BytesPerSecond() const {
+
+  return msec_ > 0 ? bytes_ * 1000 / msec_ : 0;
+
+}
+
+void Organize::LogStatistics() {
+
+  if (transcode_stage_.bytes_ > 0) {
+    qLog(Info) << "Transcoded" << transcode_stage_.bytes_ << "bytes in" << transcode_stage_.msec_ << "ms," << transcode_stage_.BytesPerSecond() << "bytes/sec";
+    LogLine(tr("Transcoded %1 at %2/s").arg(Utilities::PrettySize(static_cast<quint64>(transcode_stage_.bytes_)), Utilities::PrettySize(static_cast<quint64>(transcode_stage_.BytesPerSecond()))));
+  }
+  if (copy_stage_.bytes_ > 0) {
+    qLog(Info) << "Copied" << copy_stage_.bytes_ << "bytes in" << copy_stage_.msec_ << "ms using" << copy_thread_pool_->maxThreadCount() << "threads," << copy_stage_.BytesPerSecond() << "bytes/sec";
+    LogLine(tr("Copied %1 at %2/s").arg(Utilities::PrettySize(static_cast<quint64>(copy_stage_.bytes_)), Utilities::PrettySize(static_cast<quint64>(copy_stage_.BytesPerSecond()))));
+  }
+
+}
@@ -29,6 +29,7 @@
 
 #include <QObject>
 #include <QBasicTimer>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QSet>
 #include <QList>
@@ -41,6 +42,7 @@
 #include "organizeformat.h"
 
 class QThread;
+class QThreadPool;
 class QTimer;
 class QTimerEvent;
 
@@ -66,9 +68,9 @@ class Organize : public QObject {
   explicit Organize(TaskManager *task_manager, std::shared_ptr<MusicStorage> destination, const OrganizeFormat &format, const bool copy, const bool overwrite, const bool albumcover, const NewSongInfoList &songs, const bool eject_after, const QString &playlist = QString(), QObject *parent = nullptr);
   ~Organize() override;
 
-  static const int kBatchSize;
 #ifdef HAVE_GSTREAMER
   static const int kTranscodeProgressInterval;
+  static const int kMaxTranscodedFilesPerCopyThread;
 #endif
 
   void Start();
@@ -85,20 +87,16 @@ class Organize : public QObject {
   void ProcessSomeFiles();
   void FileTranscoded(const QString &input, const QString &output, bool success);
   void LogLine(const QString &message);
-
- private:
-  void SetSongProgress(float progress, bool transcoded = false);
-  void UpdateProgress();
-#ifdef HAVE_GSTREAMER
-  Song::FileType CheckTranscode(Song::FileType original_type) const;
-#endif
+  void SetSongProgress(const int task_id, const float progress, const bool transcoded = false);
 
  private:
   struct Task {
-    explicit Task(const NewSongInfo &song_info = NewSongInfo())
-        : song_info_(song_info),
+    explicit Task(const NewSongInfo &song_info = NewSongInfo(), const int id = 0)
+        : id_(id),
+          song_info_(song_info),
           transcode_progress_(0.0) {}
 
+    int id_;
     NewSongInfo song_info_;
     float transcode_progress_;
     QString transcoded_filename_;
@@ -106,6 +104,29 @@ class Organize : public QObject {
     Song::FileType new_filetype_;
   };
 
+  // The bytes that went through one stage of the pipeline, and how long it had work to do.
+  struct Stage {
+    explicit Stage() : running_(0), bytes_(0), msec_(0) {}
+    void JobStarted();
+    void JobFinished(const qint64 bytes);
+    qint64 BytesPerSecond() const;
+
+    int running_;
+    qint64 bytes_;
+    qint64 msec_;
+    QElapsedTimer timer_;
+  };
+
+  void UpdateProgress();
+#ifdef HAVE_GSTREAMER
+  Song::FileType CheckTranscode(Song::FileType original_type) const;
+  void QueueTranscodes();
+  void StartTranscoding();
+#endif
+  void StartCopy(Task task);
+  void CopyFinished(const Task &task, const Song &song, const bool success);
+  void LogStatistics();
+
   QThread *thread_;
   QThread *original_thread_;
   TaskManager *task_manager_;
@@ -113,6 +134,7 @@ class Organize : public QObject {
   Transcoder *transcoder_;
 #endif
   QTimer *process_files_timer_;
+  QThreadPool *copy_thread_pool_;
   std::shared_ptr<MusicStorage> destination_;
   QList<Song::FileType> supported_filetypes_;
 
@@ -126,15 +148,22 @@ class Organize : public QObject {
 
   QBasicTimer transcode_progress_timer_;
   QVector<Task> tasks_pending_;
+  QVector<Task> tasks_to_transcode_;
   QMap<QString, Task> tasks_transcoding_;
+  // Files being transcoded or transcoded and not copied yet, each one is a temporary file until its copy finishes.
+  int transcoded_files_;
+  // Progress of the files being copied by task ID.
+  QMap<int, int> tasks_copying_;
   int tasks_complete_;
 
   bool started_;
 
   int task_id_;
-  int current_copy_progress_;
   bool finished_;
 
+  Stage transcode_stage_;
+  Stage copy_stage_;
+
   QStringList files_with_errors_;
   QStringList log_;
 };
@@ -29,6 +29,7 @@
 #include <unordered_map>
 #include <random>
 #include <chrono>
+#include <vector>
 
 #include <QObject>
 #include <QCoreApplication>
@@ -75,6 +76,7 @@
 #include "playlistsequence.h"
 #include "playlistbackend.h"
 #include "playlistfilter.h"
+#include "playlistsorter.h"
 #include "playlistitemmimedata.h"
 #include "playlistundocommands.h"
 #include "songloaderinserter.h"
@@ -107,6 +109,10 @@ const char *Playlist::kSettingsGroup = "Playlist";
 
 const int Playlist::kUndoStackSize = 20;
 const int Playlist::kUndoItemLimit = 500;
+const int Playlist::kSortInBackgroundMinItems = 10000;
+// Enough to fill the view, the rest is loaded in the background.
+const int Playlist::kRestoreFirstPageSize = 1000;
+const int Playlist::kRestorePageSize = 5000;
 
 const qint64 Playlist::kMinScrobblePointNsecs = 31LL * kNsecPerSec;
 const qint64 Playlist::kMaxScrobblePointNsecs = 240LL * kNsecPerSec;
@@ -130,12 +136,17 @@ Playlist::Playlist(PlaylistBackend *backend, TaskManager *task_manager, Collecti
       undo_stack_(new QUndoStack(this)),
       special_type_(special_type),
       cancel_restore_(false),
+      restoring_(false),
+      save_after_restore_(false),
+      restored_rows_(0),
       scrobbled_(false),
       scrobble_point_(-1),
       editing_(-1),
       auto_sort_(false),
       sort_column_(Column_Title),
-      sort_order_(Qt::AscendingOrder) {
+      sort_order_(Qt::AscendingOrder),
+      sort_serial_(0),
+      rows_by_url_dirty_(true) {
 
   undo_stack_->setUndoLimit(kUndoStackSize);
 
@@ -155,6 +166,9 @@ Playlist::Playlist(PlaylistBackend *backend, TaskManager *task_manager, Collecti
   QObject::connect(queue_, &Queue::layoutChanged, this, &Playlist::QueueLayoutChanged);
 
   QObject::connect(timer_save_, &QTimer::timeout, this, &Playlist::Save);
+  if (backend_) {
+    QObject::connect(backend_, &PlaylistBackend::SavePlaylistFailed, this, &Playlist::SavePlaylistFailed);
+  }
 
   column_alignments_ = PlaylistView::DefaultColumnAlignment();
 
@@ -402,6 +416,8 @@ bool Playlist::setData(const QModelIndex &idx, const QVariant &value, int role)
   }
   else if (song.is_radio()) {
     item->SetMetadata(song);
+    changes_.ItemChanged(item);
+    rows_by_url_dirty_ = true;
     ScheduleSave();
   }
 
@@ -446,6 +462,7 @@ void Playlist::ItemReloadComplete(const QPersistentModelIndex &idx, const Song &
   if (idx.isValid()) {
     PlaylistItemPtr item = item_at(idx.row());
     if (item) {
+      changes_.ItemChanged(item);
       if (idx.row() == current_row()) {
         const bool minor = old_metadata.title() == item->Metadata().title() &&
                            old_metadata.albumartist() == item->Metadata().albumartist() &&
@@ -643,6 +660,7 @@ void Playlist::set_current_row(const int i, const AutoScroll autoscroll, const b
     PlaylistItemPtr next_item = item_at(nextrow);
     if (next_item) {
       next_item->ClearTemporaryMetadata();
+      rows_by_url_dirty_ = true;
       emit dataChanged(index(nextrow, 0), index(nextrow, ColumnCount - 1));
     }
   }
@@ -925,6 +943,7 @@ void Playlist::MoveItemsWithoutUndo(const QList<int> &source_rows, int pos) {
     moved_items[i - start]->RemoveForegroundColor(kDynamicHistoryPriority);
     items_.insert(i, moved_items[i - start]);
   }
+  rows_by_url_dirty_ = true;
 
   // Update persistent indexes
   for (const QModelIndex &pidx : persistentIndexList()) {
@@ -978,6 +997,7 @@ void Playlist::MoveItemsWithoutUndo(int start, const QList<int> &dest_rows) {
     items_.insert(dest_row, moved_items[offset]);
     offset++;
   }
+  rows_by_url_dirty_ = true;
 
   // Update persistent indexes
   for (const QModelIndex &pidx : persistentIndexList()) {
@@ -1075,10 +1095,15 @@ void Playlist::InsertItemsWithoutUndo(const PlaylistItemPtrList &items, const in
   const int start = pos == -1 ? static_cast<int>(items_.count()) : pos;
   const int end = start + static_cast<int>(items.count()) - 1;
 
+  // Appended items only add rows to the URL index, anything else moves the rows after it.
+  const bool append = start == items_.count();
+  if (!append) rows_by_url_dirty_ = true;
+
   beginInsertRows(QModelIndex(), start, end);
   for (int i = start; i <= end; ++i) {
     PlaylistItemPtr item = items[i - start];
     items_.insert(i, item);
+    if (append && !rows_by_url_dirty_) rows_by_url_.insert(item->Metadata().url(), i);
     virtual_items_ << static_cast<int>(virtual_items_.count());
 
     if (item->source() == Song::Source::Collection) {
@@ -1184,61 +1209,117 @@ void Playlist::UpdateItems(SongList songs) {
 
   qLog(Debug) << "Updating playlist with new tracks' info";
 
-  // We first convert our songs list into a linked list (a 'real' list), because removals are faster with QLinkedList.
-  // Next, we walk through the list of playlist's items then the list of songs
-  // we want to update: if an item corresponds to the song (we rely on URL for this), we update the item with the new metadata,
-  // then we remove song from our list because we will not need to check it again.
-  // And we also update undo actions.
+  // Each song updates the first item with the same URL that wasn't updated yet, we find those through the URL index.
+  // The undo actions are updated afterwards, all at once.
 
-  for (int i = 0; i < items_.size(); i++) {
-    // Update current items list
-    QMutableListIterator<Song> it(songs);
-    while (it.hasNext()) {
-      const Song &song = it.next();
-      const PlaylistItemPtr &item = items_[i];
-      if (item->Metadata().url() == song.url() && (item->Metadata().filetype() == Song::FileType::Unknown || item->Metadata().filetype() == Song::FileType::Stream || item->Metadata().filetype() == Song::FileType::CDDA || !item->Metadata().init_from_file())) {
-        PlaylistItemPtr new_item;
-        if (song.url().isLocalFile()) {
-          if (song.is_collection_song()) {
-            new_item = std::make_shared<CollectionPlaylistItem>(song);
-            if (collection_items_by_id_.contains(song.id(), item)) collection_items_by_id_.remove(song.id(), item);
-            collection_items_by_id_.insert(song.id(), new_item);
-          }
-          else {
-            new_item = std::make_shared<SongPlaylistItem>(song);
-          }
+  QSet<int> updated_rows;
+  QHash<const PlaylistItem*, PlaylistItemPtr> new_items;
+  for (const Song &song : songs) {
+    for (const int row : RowsForUrl(song.url())) {
+      const PlaylistItemPtr &item = items_[row];
+      if (updated_rows.contains(row) || !(item->Metadata().filetype() == Song::FileType::Unknown || item->Metadata().filetype() == Song::FileType::Stream || item->Metadata().filetype() == Song::FileType::CDDA || !item->Metadata().init_from_file())) {
+        continue;
+      }
+      PlaylistItemPtr new_item;
+      if (song.url().isLocalFile()) {
+        if (song.is_collection_song()) {
+          new_item = std::make_shared<CollectionPlaylistItem>(song);
+          if (collection_items_by_id_.contains(song.id(), item)) collection_items_by_id_.remove(song.id(), item);
+          collection_items_by_id_.insert(song.id(), new_item);
         }
         else {
-          if (song.is_radio()) {
-            new_item = std::make_shared<RadioPlaylistItem>(song);
-          }
-          else {
-            new_item = std::make_shared<InternetPlaylistItem>(song);
-          }
+          new_item = std::make_shared<SongPlaylistItem>(song);
+        }
+      }
+      else {
+        if (song.is_radio()) {
+          new_item = std::make_shared<RadioPlaylistItem>(song);
         }
-        items_[i] = new_item;
-        emit dataChanged(index(i, 0), index(i, ColumnCount - 1));
-        // Also update undo actions
-        for (int y = 0; y < undo_stack_->count(); y++) {
-          QUndoCommand *undo_action = const_cast<QUndoCommand*>(undo_stack_->command(i));
-          PlaylistUndoCommands::InsertItems *undo_action_insert = dynamic_cast<PlaylistUndoCommands::InsertItems*>(undo_action);
-          if (undo_action_insert) {
-            bool found_and_updated = undo_action_insert->UpdateItem(new_item);
-            if (found_and_updated) break;
-          }
+        else {
+          new_item = std::make_shared<InternetPlaylistItem>(song);
         }
-        it.remove();
-        break;
+      }
+      new_items.insert(item.get(), new_item);
+      items_[row] = new_item;
+      updated_rows << row;
+      break;
+    }
+  }
+
+  if (!new_items.isEmpty()) {
+    // Also update undo actions
+    for (int i = 0; i < undo_stack_->count(); ++i) {
+      PlaylistUndoCommands::InsertItems *undo_action_insert = dynamic_cast<PlaylistUndoCommands::InsertItems*>(const_cast<QUndoCommand*>(undo_stack_->command(i)));
+      if (undo_action_insert) {
+        undo_action_insert->UpdateItems(new_items);
       }
     }
   }
 
+  EmitRowsChanged(updated_rows.values());
+
   emit PlaylistChanged();
 
   ScheduleSave();
 
 }
 
+QList<int> Playlist::RowsForUrl(const QUrl &url) {
+
+  if (rows_by_url_dirty_) {
+    rows_by_url_.clear();
+    rows_by_url_.reserve(static_cast<int>(items_.count()));
+    for (int row = 0; row < items_.count(); ++row) {
+      rows_by_url_.insert(items_[row]->Metadata().url(), row);
+    }
+    rows_by_url_dirty_ = false;
+  }
+
+  QList<int> rows = rows_by_url_.values(url);
+  std::sort(rows.begin(), rows.end());
+
+  return rows;
+
+}
+
+QList<int> Playlist::RowsForItem(const PlaylistItemPtr &item) {
+
+  QList<int> rows;
+  for (const int row : RowsForUrl(item->Metadata().url())) {
+    if (items_[row] == item) rows << row;
+  }
+
+  if (rows.isEmpty()) {
+    // The URL of the item changed after the index was built.
+    for (int row = 0; row < items_.count(); ++row) {
+      if (items_[row] == item) rows << row;
+    }
+    if (!rows.isEmpty()) rows_by_url_dirty_ = true;
+  }
+
+  return rows;
+
+}
+
+void Playlist::EmitRowsChanged(QList<int> rows) {
+
+  if (rows.isEmpty()) return;
+
+  // One signal for each range of neighbouring rows.
+  std::sort(rows.begin(), rows.end());
+  int first = rows.first();
+  int last = first;
+  for (const int row : std::as_const(rows)) {
+    if (row > last + 1) {
+      emit dataChanged(index(first, 0), index(last, ColumnCount - 1));
+      first = row;
+    }
+    last = row;
+  }
+  emit dataChanged(index(first, 0), index(last, ColumnCount - 1));
+
+}
+
 QMimeData *Playlist::mimeData(const QModelIndexList &indexes) const {
 
   if (indexes.isEmpty()) return nullptr;
@@ -1414,28 +1495,40 @@ void Playlist::sort(int column, Qt::SortOrder order) {
 
   if (ignore_sorting_) return;
 
-  PlaylistItemPtrList new_items(items_);
-  PlaylistItemPtrList::iterator begin = new_items.begin();
+  int begin = 0;
+  if (dynamic_playlist_ && current_item_index_.isValid()) {
+    begin = current_item_index_.row() + 1;
+  }
 
-  if (dynamic_playlist_ && current_item_index_.isValid())
-    begin += current_item_index_.row() + 1;
+  const quint64 serial = ++sort_serial_;
+  std::shared_ptr<PlaylistSorter> sorter = std::make_shared<PlaylistSorter>(items_, begin, column, order);
 
-  if (column == Column_Album) {
-    // When sorting by album, also take into account discs and tracks.
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Track, order, std::placeholders::_1, std::placeholders::_2));
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Disc, order, std::placeholders::_1, std::placeholders::_2));
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Album, order, std::placeholders::_1, std::placeholders::_2));
-  }
-  else if (column == Column_Filename) {
-    // When sorting by full paths we also expect a hierarchical order. This returns a breath-first ordering of paths.
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, Column_Filename, order, std::placeholders::_1, std::placeholders::_2));
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::ComparePathDepths, order, std::placeholders::_1, std::placeholders::_2));
-  }
-  else {
-    std::stable_sort(begin, new_items.end(), std::bind(&Playlist::CompareItems, column, order, std::placeholders::_1, std::placeholders::_2));
+  if (items_.count() - begin < kSortInBackgroundMinItems) {
+    ApplySort(*sorter, sorter->Sort());
+    return;
   }
 
-  undo_stack_->push(new PlaylistUndoCommands::SortItems(this, column, order, new_items));
+  // Large playlists are sorted in the background, the items are only reordered if nothing changed in the meantime.
+  const PlaylistItemPtrList items = items_;
+  QFuture<std::vector<int>> future = QtConcurrent::run([sorter]() { return sorter->Sort(); });
+  QFutureWatcher<std::vector<int>> *watcher = new QFutureWatcher<std::vector<int>>(this);
+  QObject::connect(watcher, &QFutureWatcher<std::vector<int>>::finished, this, [this, watcher, sorter, items, serial]() {
+    const std::vector<int> sorted = watcher->result();
+    watcher->deleteLater();
+    if (serial != sort_serial_) return;
+    if (items_ != items) {
+      sort(sorter->column(), sorter->order());
+      return;
+    }
+    ApplySort(*sorter, sorted);
+  });
+  watcher->setFuture(future);
+
+}
+
+void Playlist::ApplySort(const PlaylistSorter &sorter, const std::vector<int> &sorted) {
+
+  undo_stack_->push(new PlaylistUndoCommands::SortItems(this, sorter.column(), sorter.order(), sorter.Apply(items_, sorted)));
 
   ReshuffleIndices();
 
@@ -1447,6 +1540,7 @@ void Playlist::ReOrderWithoutUndo(const PlaylistItemPtrList &new_items) {
 
   PlaylistItemPtrList old_items = items_;
   items_ = new_items;
+  rows_by_url_dirty_ = true;
 
   QHash<const PlaylistItem*, int> new_rows;
   for (int i = 0; i < new_items.length(); ++i) {
@@ -1499,6 +1593,11 @@ void Playlist::ScheduleSave() {
 
   if (!backend_ || is_loading_) return;
 
+  if (restoring_) {
+    save_after_restore_ = true;
+    return;
+  }
+
   timer_save_->start();
 
 }
@@ -1507,7 +1606,24 @@ void Playlist::Save() {
 
   if (!backend_ || is_loading_) return;
 
-  backend_->SavePlaylistAsync(id_, items_, last_played_row(), dynamic_playlist_);
+  if (restoring_) {
+    save_after_restore_ = true;
+    return;
+  }
+
+  PlaylistBackend *backend = backend_;
+  const PlaylistBackend::Changes changes = changes_.Take(items_, [backend](const int count) { return backend->AllocateItemIds(count); });
+  backend_->SavePlaylistAsync(id_, changes, last_played_row(), dynamic_playlist_);
+
+}
+
+void Playlist::SavePlaylistFailed(const int playlist) {
+
+  if (playlist != id_) return;
+
+  // Write all items again on the next save.
+  changes_.Invalidate();
+  ScheduleSave();
 
 }
 
@@ -1518,28 +1634,57 @@ void Playlist::Restore() {
   items_.clear();
   virtual_items_.clear();
   collection_items_by_id_.clear();
+  rows_by_url_dirty_ = true;
 
   cancel_restore_ = false;
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-  QFuture<PlaylistItemPtrList> future = QtConcurrent::run(&PlaylistBackend::GetPlaylistItems, backend_, id_);
-#else
-  QFuture<PlaylistItemPtrList> future = QtConcurrent::run(backend_, &PlaylistBackend::GetPlaylistItems, id_);
-#endif
+  restoring_ = true;
+  save_after_restore_ = false;
+  restored_items_.clear();
+  restored_saved_items_.clear();
+  last_restored_item_index_ = QPersistentModelIndex();
+  restored_rows_ = 0;
+
+  RestorePage(PlaylistBackend::SavedItem(), kRestoreFirstPageSize);
+
+}
+
+void Playlist::RestorePage(const PlaylistBackend::SavedItem &after, const int limit) {
+
+  PlaylistBackend *backend = backend_;
+  const int id = id_;
+  std::shared_ptr<PlaylistBackend::SavedItemList> saved_items = std::make_shared<PlaylistBackend::SavedItemList>();
+  QFuture<PlaylistItemPtrList> future = QtConcurrent::run([backend, id, saved_items, after, limit]() { return backend->GetPlaylistItems(id, saved_items.get(), after, limit); });
   QFutureWatcher<PlaylistItemPtrList> *watcher = new QFutureWatcher<PlaylistItemPtrList>();
-  QObject::connect(watcher, &QFutureWatcher<PlaylistItemPtrList>::finished, this, &Playlist::ItemsLoaded);
+  QObject::connect(watcher, &QFutureWatcher<PlaylistItemPtrList>::finished, this, [this, watcher, saved_items, limit]() {
+    ItemsLoaded(watcher->result(), *saved_items, limit);
+    watcher->deleteLater();
+  });
   watcher->setFuture(future);
 
 }
 
-void Playlist::ItemsLoaded() {
+void Playlist::ItemsLoaded(PlaylistItemPtrList items, const PlaylistBackend::SavedItemList &saved_items, const int limit) {
 
-  QFutureWatcher<PlaylistItemPtrList> *watcher = static_cast<QFutureWatcher<PlaylistItemPtrList>*>(sender());
-  PlaylistItemPtrList items = watcher->result();
-  watcher->deleteLater();
+  if (cancel_restore_) {
+    // The playlist was replaced, so save all of it.
+    restoring_ = false;
+    restored_items_.clear();
+    restored_saved_items_.clear();
+    last_restored_item_index_ = QPersistentModelIndex();
+    if (save_after_restore_) ScheduleSave();
+    return;
+  }
+
+  // A short page is the last one.
+  const bool last_page = items.count() < limit || saved_items.count() != items.count();
+  const PlaylistBackend::SavedItem last_saved_item = saved_items.isEmpty() ? PlaylistBackend::SavedItem() : saved_items.last();
 
-  if (cancel_restore_) return;
+  // The items are saved like this, even the ones that are left out below.
+  restored_items_ << items;
+  restored_saved_items_ << saved_items;
 
   // Backend returns empty elements for collection items which it couldn't match (because they got deleted); we don't need those
+  // They are removed from the database with the next save.
   QMutableListIterator<PlaylistItemPtr> it(items);
   while (it.hasNext()) {
     PlaylistItemPtr item = it.next();
@@ -1549,9 +1694,39 @@ void Playlist::ItemsLoaded() {
     }
   }
 
-  is_loading_ = true;
-  InsertItems(items, 0);
-  is_loading_ = false;
+  // Restored items are not undoable, and items added while restoring stay after them.
+  int pos = -1;
+  if (last_restored_item_index_.isValid()) {
+    pos = last_restored_item_index_.row() + 1;
+  }
+  else if (restored_rows_ == 0) {
+    pos = 0;
+  }
+  if (!items.isEmpty()) {
+    const int start = pos == -1 ? static_cast<int>(items_.count()) : pos;
+    is_loading_ = true;
+    InsertItemsWithoutUndo(items, start);
+    is_loading_ = false;
+    last_restored_item_index_ = QPersistentModelIndex(index(start + static_cast<int>(items.count()) - 1, 0));
+    restored_rows_ += static_cast<int>(items.count());
+  }
+
+  if (last_page) {
+    RestoreDone();
+  }
+  else {
+    RestorePage(last_saved_item, kRestorePageSize);
+  }
+
+}
+
+void Playlist::RestoreDone() {
+
+  restoring_ = false;
+  changes_.Restored(restored_items_, restored_saved_items_);
+  restored_items_.clear();
+  restored_saved_items_.clear();
+  last_restored_item_index_ = QPersistentModelIndex();
 
   PlaylistBackend::Playlist p = backend_->GetPlaylist(id_);
 
@@ -1592,6 +1767,8 @@ void Playlist::ItemsLoaded() {
 
   emit PlaylistLoaded();
 
+  if (save_after_restore_) ScheduleSave();
+
 }
 
 static bool DescendingIntLessThan(int a, int b) { return a > b; }
@@ -1674,6 +1851,8 @@ PlaylistItemPtrList Playlist::RemoveItemsWithoutUndo(const int row, const int co
   }
   beginRemoveRows(QModelIndex(), row, row + count - 1);
 
+  rows_by_url_dirty_ = true;
+
   // Remove items
   PlaylistItemPtrList ret;
   ret.reserve(count);
@@ -1746,6 +1925,7 @@ void Playlist::SetStreamMetadata(const QUrl &url, const Song &song, const bool m
 
   bool update_scrobble_point = song.length_nanosec() != current_item_metadata().length_nanosec();
   current_item()->SetTemporaryMetadata(song);
+  rows_by_url_dirty_ = true;
   if (update_scrobble_point) UpdateScrobblePoint();
   InformOfCurrentSongChange(AutoScroll::Never, minor);
 
@@ -1756,6 +1936,7 @@ void Playlist::ClearStreamMetadata() {
   if (!current_item()) return;
 
   current_item()->ClearTemporaryMetadata();
+  rows_by_url_dirty_ = true;
   UpdateScrobblePoint();
 
   emit dataChanged(index(current_item_index_.row(), 0), index(current_item_index_.row(), ColumnCount - 1));
@@ -1887,6 +2068,16 @@ void Playlist::ReloadItemsBlocking(const QList<int> &rows) {
 
 }
 
+void Playlist::ReloadItems(const PlaylistItemPtrList &items) {
+
+  for (const PlaylistItemPtr &item : items) {
+    item->Reload();
+  }
+  ItemsChanged(items);
+  ScheduleSave();
+
+}
+
 void Playlist::AddSongInsertVetoListener(SongInsertVetoListener *listener) {
   veto_listeners_.append(listener);
   QObject::connect(listener, &SongInsertVetoListener::destroyed, this, &Playlist::SongInsertVetoListenerDestroyed);
@@ -2103,11 +2294,19 @@ void Playlist::ItemChanged(const int row) {
 
 void Playlist::ItemChanged(PlaylistItemPtr item) {
 
-  for (int row = 0; row < items_.count(); ++row) {
-    if (items_[row] == item) {
-      ItemChanged(row);
-    }
+  changes_.ItemChanged(item);
+  EmitRowsChanged(RowsForItem(item));
+
+}
+
+void Playlist::ItemsChanged(const PlaylistItemPtrList &items) {
+
+  QList<int> rows;
+  for (const PlaylistItemPtr &item : items) {
+    changes_.ItemChanged(item);
+    rows << RowsForItem(item);
   }
+  EmitRowsChanged(rows);
 
 }
 
@@ -2134,13 +2333,19 @@ void Playlist::InformOfCurrentSongChange(const AutoScroll autoscroll, const bool
 void Playlist::InvalidateDeletedSongs() {
 
   QList<int> invalidated_rows;
+  // Playlists can have the same file many times, check it only once.
+  QHash<QUrl, bool> exists_by_url;
 
   for (int row = 0; row < items_.count(); ++row) {
     PlaylistItemPtr item = items_[row];
     Song song = item->Metadata();
 
     if (song.url().isLocalFile()) {
-      bool exists = QFile::exists(song.url().toLocalFile());
+      QHash<QUrl, bool>::const_iterator it = exists_by_url.constFind(song.url());
+      if (it == exists_by_url.constEnd()) {
+        it = exists_by_url.insert(song.url(), QFile::exists(song.url().toLocalFile()));
+      }
+      const bool exists = it.value();
 
       if (!exists && !item->HasForegroundColor(kInvalidSongPriority)) {
         // gray out the song if it's not there
@@ -2324,6 +2529,7 @@ void Playlist::AlbumCoverLoaded(const Song &song, const AlbumCoverLoaderResult &
     if (item && item->Metadata() == song && (!item->Metadata().art_manual_is_valid() || (result.type == AlbumCoverLoaderResult::Type_ManuallyUnset && !item->Metadata().has_manually_unset_cover()))) {
       qLog(Debug) << "Updating art manual for local song" << song.title() << song.album() << song.title() << "to" << result.album_cover.cover_url << "in playlist.";
       item->SetArtManual(result.album_cover.cover_url);
+      changes_.ItemChanged(item);
       ScheduleSaveAsync();
     }
   }
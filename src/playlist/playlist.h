@@ -24,6 +24,8 @@
 
 #include "config.h"
 
+#include <vector>
+
 #include <QtGlobal>
 #include <QObject>
 #include <QAbstractItemModel>
@@ -33,6 +35,7 @@
 #include <QList>
 #include <QMap>
 #include <QMultiMap>
+#include <QMultiHash>
 #include <QMetaType>
 #include <QVariant>
 #include <QString>
@@ -46,6 +49,7 @@
 #include "covermanager/albumcoverloaderresult.h"
 #include "playlistitem.h"
 #include "playlistsequence.h"
+#include "playlistchanges.h"
 #include "smartplaylists/playlistgenerator_fwd.h"
 
 class QMimeData;
@@ -55,6 +59,7 @@ class QTimer;
 class CollectionBackend;
 class PlaylistBackend;
 class PlaylistFilter;
+class PlaylistSorter;
 class Queue;
 class TaskManager;
 class InternetService;
@@ -162,6 +167,9 @@ class Playlist : public QAbstractListModel {
 
   static const int kUndoStackSize;
   static const int kUndoItemLimit;
+  static const int kSortInBackgroundMinItems;
+  static const int kRestoreFirstPageSize;
+  static const int kRestorePageSize;
 
   static const qint64 kMinScrobblePointNsecs;
   static const qint64 kMaxScrobblePointNsecs;
@@ -253,6 +261,8 @@ class Playlist : public QAbstractListModel {
   void StopAfter(const int row);
   void ReloadItems(const QList<int> &rows);
   void ReloadItemsBlocking(const QList<int> &rows);
+  // Reloads the metadata of items whose tags were edited, and saves them.
+  void ReloadItems(const PlaylistItemPtrList &items);
   void InformOfCurrentSongChange(const AutoScroll autoscroll, const bool minor);
 
   // Registers an object which will get notifications when new songs are about to be inserted into this playlist.
@@ -283,6 +293,8 @@ class Playlist : public QAbstractListModel {
 
   void ItemChanged(PlaylistItemPtr item);
   void ItemChanged(const int row);
+  // Emits one dataChanged for each range of neighbouring rows, instead of one for every item.
+  void ItemsChanged(const PlaylistItemPtrList &items);
 
   // Changes rating of a song to the given value asynchronously
   void RateSong(const QModelIndex &idx, const float rating);
@@ -372,10 +384,21 @@ class Playlist : public QAbstractListModel {
   void QueueLayoutChanged();
   void SongSaveComplete(TagReaderReply *reply, const QPersistentModelIndex &idx, const Song &old_metadata);
   void ItemReloadComplete(const QPersistentModelIndex &idx, const Song &old_metadata, const bool metadata_edit);
-  void ItemsLoaded();
   void SongInsertVetoListenerDestroyed();
   void ScheduleSave();
   void Save();
+  void SavePlaylistFailed(const int playlist);
+
+ private:
+  void ApplySort(const PlaylistSorter &sorter, const std::vector<int> &sorted);
+  void RestorePage(const PlaylistBackend::SavedItem &after, const int limit);
+  void ItemsLoaded(PlaylistItemPtrList items, const PlaylistBackend::SavedItemList &saved_items, const int limit);
+  void RestoreDone();
+
+  // Rows of the items with the URL, in ascending order.
+  QList<int> RowsForUrl(const QUrl &url);
+  QList<int> RowsForItem(const PlaylistItemPtr &item);
+  void EmitRowsChanged(QList<int> rows);
 
  private:
   bool is_loading_;
@@ -424,6 +447,15 @@ class Playlist : public QAbstractListModel {
   // Cancel async restore if songs are already replaced
   bool cancel_restore_;
 
+  // The items are restored in pages, saving waits until all of them are in.
+  bool restoring_;
+  bool save_after_restore_;
+  PlaylistItemPtrList restored_items_;
+  PlaylistBackend::SavedItemList restored_saved_items_;
+  // The last restored item, the next page goes after it.
+  QPersistentModelIndex last_restored_item_index_;
+  int restored_rows_;
+
   bool scrobbled_;
   qint64 scrobble_point_;
 
@@ -434,6 +466,15 @@ class Playlist : public QAbstractListModel {
   bool auto_sort_;
   int sort_column_;
   Qt::SortOrder sort_order_;
+  // Incremented for every sort, so the result of a background sort that was replaced by a newer one is dropped.
+  quint64 sort_serial_;
+
+  // What is saved in the database, so only the changes are saved.
+  PlaylistChanges changes_;
+
+  // Rows of the items by URL for fast lookups, rebuilt on the next lookup after rows were inserted, removed or moved.
+  QMultiHash<QUrl, int> rows_by_url_;
+  bool rows_by_url_dirty_;
 
 };
 
@@ -32,6 +32,7 @@
 #include <QFile>
 #include <QByteArray>
 #include <QList>
+#include <QPair>
 #include <QString>
 #include <QStringList>
 #include <QUrl>
@@ -56,8 +57,9 @@ const int PlaylistBackend::kSongTableJoins = 2;
 PlaylistBackend::PlaylistBackend(Application *app, QObject *parent)
     : QObject(parent),
       app_(app),
-      db_(app_->database()),
-      original_thread_(nullptr) {
+      db_(app_ ? app_->database() : nullptr),
+      original_thread_(nullptr),
+      next_item_id_(-1) {
 
   original_thread_ = thread();
 
@@ -117,7 +119,7 @@ PlaylistBackend::PlaylistList PlaylistBackend::GetPlaylists(const GetPlaylistsFl
   }
 
   SqlQuery q(db);
-  q.prepare("SELECT ROWID, name, last_played, special_type, ui_path, is_favorite, dynamic_playlist_type, dynamic_playlist_data, dynamic_playlist_backend FROM playlists " + condition + " ORDER BY ui_order");
+  q.PrepareCached("SELECT ROWID, name, last_played, special_type, ui_path, is_favorite, dynamic_playlist_type, dynamic_playlist_data, dynamic_playlist_backend FROM playlists " + condition + " ORDER BY ui_order");
   if (!q.Exec()) {
     db_->ReportErrors(q);
     return ret;
@@ -147,7 +149,7 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(const int id) {
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare("SELECT ROWID, name, last_played, special_type, ui_path, is_favorite, dynamic_playlist_type, dynamic_playlist_data, dynamic_playlist_backend FROM playlists WHERE ROWID=:id");
+  q.PrepareCached("SELECT ROWID, name, last_played, special_type, ui_path, is_favorite, dynamic_playlist_type, dynamic_playlist_data, dynamic_playlist_backend FROM playlists WHERE ROWID=:id");
 
   q.BindValue(":id", id);
   if (!q.Exec()) {
@@ -172,7 +174,7 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(const int id) {
 
 }
 
-PlaylistItemPtrList PlaylistBackend::GetPlaylistItems(const int playlist) {
+PlaylistItemPtrList PlaylistBackend::GetPlaylistItems(const int playlist, SavedItemList *saved_items, const SavedItem &after, const int limit) {
 
   PlaylistItemPtrList playlistitems;
 
@@ -181,21 +183,41 @@ PlaylistItemPtrList PlaylistBackend::GetPlaylistItems(const int playlist) {
     QMutexLocker l(db_->Mutex());
     QSqlDatabase db(db_->Connect());
 
-    QString query = "SELECT songs.ROWID, " + Song::JoinSpec("songs") + ", p.ROWID, " + Song::JoinSpec("p") + ", p.type FROM playlist_items AS p LEFT JOIN songs ON p.collection_id = songs.ROWID WHERE p.playlist = :playlist";
+    // Every playlist is restored before it's saved, so the ROWIDs for new items are known before the first save.
+    if (after.id == -1) InitItemIds(db);
+
+    QString query = "SELECT songs.ROWID, " + Song::JoinSpec("songs") + ", p.ROWID, " + Song::JoinSpec("p") + ", p.type, p.position FROM playlist_items AS p LEFT JOIN songs ON p.collection_id = songs.ROWID WHERE p.playlist = :playlist";
+    // Seek from the last item of the previous page through the position index, instead of skipping over all of them with OFFSET.
+    if (after.id != -1) query += " AND (p.position, p.ROWID) > (:position, :id)";
+    query += " ORDER BY p.position, p.ROWID";
+    if (limit != -1) query += " LIMIT :limit";
     SqlQuery q(db);
     // Forward iterations only may be faster
     q.setForwardOnly(true);
-    q.prepare(query);
+    q.PrepareCached(query);
     q.BindValue(":playlist", playlist);
+    if (after.id != -1) {
+      q.BindValue(":position", after.position);
+      q.BindValue(":id", after.id);
+    }
+    if (limit != -1) q.BindValue(":limit", limit);
     if (!q.Exec()) {
       db_->ReportErrors(q);
       return PlaylistItemPtrList();
     }
 
+    // The ROWID of the playlist item comes after the first song table, the position after the type.
+    const int id_column = static_cast<int>(Song::kColumns.count()) + 1;
+    const int position_column = static_cast<int>(Song::kColumns.count() + 1) * kSongTableJoins + 1;
+
     // it's probable that we'll have a few songs associated with the same CUE, so we're caching results of parsing CUEs
     std::shared_ptr<NewSongFromQueryState> state_ptr = std::make_shared<NewSongFromQueryState>();
     while (q.next()) {
-      playlistitems << NewPlaylistItemFromQuery(SqlRow(q), state_ptr);
+      SqlRow row(q);
+      playlistitems << NewPlaylistItemFromQuery(row, state_ptr);
+      if (saved_items) {
+        *saved_items << SavedItem(row.value(id_column).toLongLong(), row.value(position_column).toDouble());
+      }
     }
 
   }
@@ -216,11 +238,11 @@ SongList PlaylistBackend::GetPlaylistSongs(const int playlist) {
     QMutexLocker l(db_->Mutex());
     QSqlDatabase db(db_->Connect());
 
-    QString query = "SELECT songs.ROWID, " + Song::JoinSpec("songs") + ", p.ROWID, " + Song::JoinSpec("p") + ", p.type FROM playlist_items AS p LEFT JOIN songs ON p.collection_id = songs.ROWID WHERE p.playlist = :playlist";
+    QString query = "SELECT songs.ROWID, " + Song::JoinSpec("songs") + ", p.ROWID, " + Song::JoinSpec("p") + ", p.type FROM playlist_items AS p LEFT JOIN songs ON p.collection_id = songs.ROWID WHERE p.playlist = :playlist ORDER BY p.position, p.ROWID";
     SqlQuery q(db);
     // Forward iterations only may be faster
     q.setForwardOnly(true);
-    q.prepare(query);
+    q.PrepareCached(query);
     q.BindValue(":playlist", playlist);
     if (!q.Exec()) {
       db_->ReportErrors(q);
@@ -272,12 +294,12 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(PlaylistItemPtr item, std::share
   // We need collection to run a CueParser; also, this method applies only to file-type PlaylistItems
   if (item->source() != Song::Source::LocalFile) return item;
 
-  CueParser cue_parser(app_->collection_backend());
-
   Song song = item->Metadata();
   // We're only interested in .cue songs here
   if (!song.has_cue()) return item;
 
+  CueParser cue_parser(app_->collection_backend());
+
   QString cue_path = song.cue_path();
   // If .cue was deleted - reload the song
   if (!QFile::exists(cue_path)) {
@@ -316,49 +338,126 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(PlaylistItemPtr item, std::share
 
 }
 
-void PlaylistBackend::SavePlaylistAsync(int playlist, const PlaylistItemPtrList &items, int last_played, PlaylistGeneratorPtr dynamic) {
+void PlaylistBackend::SavePlaylistAsync(const int playlist, const Changes &changes, const int last_played, PlaylistGeneratorPtr dynamic) {
+
+  QMetaObject::invokeMethod(this, "SavePlaylist", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(PlaylistBackend::Changes, changes), Q_ARG(int, last_played), Q_ARG(PlaylistGeneratorPtr, dynamic));
+
+}
+
+void PlaylistBackend::InitItemIds(QSqlDatabase &db) {
 
-  QMetaObject::invokeMethod(this, "SavePlaylist", Qt::QueuedConnection, Q_ARG(int, playlist), Q_ARG(PlaylistItemPtrList, items), Q_ARG(int, last_played), Q_ARG(PlaylistGeneratorPtr, dynamic));
+  QMutexLocker l(&item_id_mutex_);
+  if (next_item_id_ >= 0) return;
+
+  SqlQuery q(db);
+  q.PrepareCached("SELECT MAX(ROWID) FROM playlist_items");
+  if (!q.Exec()) {
+    db_->ReportErrors(q);
+    return;
+  }
+  next_item_id_ = q.next() ? q.value(0).toLongLong() + 1 : 1;
 
 }
 
-void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemPtrList &items, int last_played, PlaylistGeneratorPtr dynamic) {
+qint64 PlaylistBackend::AllocateItemIds(const int count) {
+
+  QMutexLocker l(&item_id_mutex_);
+
+  if (next_item_id_ < 0) {
+    qLog(Error) << "Playlist item ROWIDs requested before any playlist was restored";
+    return -1;
+  }
+
+  const qint64 first_id = next_item_id_;
+  next_item_id_ += count;
+
+  return first_id;
+
+}
+
+void PlaylistBackend::SavePlaylist(const int playlist, const Changes &changes, const int last_played, PlaylistGeneratorPtr dynamic) {
 
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  qLog(Debug) << "Saving playlist" << playlist;
+  qLog(Debug) << "Saving playlist" << playlist << "-" << changes.inserted.count() << "inserted," << changes.removed.count() << "removed," << changes.moved.count() << "moved and" << changes.updated.count() << "updated items";
 
   ScopedTransaction transaction(&db);
 
-  // Clear the existing items in the playlist
-  {
+  // Only the changed rows are written, every statement is prepared once and executed for all rows.
+
+  if (changes.replace_all) {
     SqlQuery q(db);
-    q.prepare("DELETE FROM playlist_items WHERE playlist = :playlist");
+    q.PrepareCached("DELETE FROM playlist_items WHERE playlist = :playlist");
     q.BindValue(":playlist", playlist);
     if (!q.Exec()) {
       db_->ReportErrors(q);
+      emit SavePlaylistFailed(playlist);
       return;
     }
   }
 
-  // Save the new ones
-  for (PlaylistItemPtr item : items) {  // clazy:exclude=range-loop-reference
+  if (!changes.removed.isEmpty()) {
     SqlQuery q(db);
-    q.prepare("INSERT INTO playlist_items (playlist, type, collection_id, " + Song::kColumnSpec + ") VALUES (:playlist, :type, :collection_id, " + Song::kBindSpec + ")");
-    q.BindValue(":playlist", playlist);
-    item->BindToQuery(&q);
+    q.PrepareCached("DELETE FROM playlist_items WHERE ROWID = :id");
+    for (const qint64 id : changes.removed) {
+      q.BindValue(":id", id);
+      if (!q.Exec()) {
+        db_->ReportErrors(q);
+        emit SavePlaylistFailed(playlist);
+        return;
+      }
+    }
+  }
 
-    if (!q.Exec()) {
-      db_->ReportErrors(q);
-      return;
+  if (!changes.moved.isEmpty()) {
+    SqlQuery q(db);
+    q.PrepareCached("UPDATE playlist_items SET position = :position WHERE ROWID = :id");
+    for (const SavedItem &saved_item : changes.moved) {
+      q.BindValue(":position", saved_item.position);
+      q.BindValue(":id", saved_item.id);
+      if (!q.Exec()) {
+        db_->ReportErrors(q);
+        emit SavePlaylistFailed(playlist);
+        return;
+      }
+    }
+  }
+
+  if (!changes.updated.isEmpty()) {
+    SqlQuery q(db);
+    q.PrepareCached("UPDATE playlist_items SET type = :type, collection_id = :collection_id, " + Song::kUpdateSpec + " WHERE ROWID = :id");
+    for (const QPair<qint64, PlaylistItemPtr> &updated : changes.updated) {
+      updated.second->BindToQuery(&q);
+      q.BindValue(":id", updated.first);
+      if (!q.Exec()) {
+        db_->ReportErrors(q);
+        emit SavePlaylistFailed(playlist);
+        return;
+      }
+    }
+  }
+
+  if (!changes.inserted.isEmpty()) {
+    SqlQuery q(db);
+    q.PrepareCached("INSERT INTO playlist_items (ROWID, playlist, position, type, collection_id, " + Song::kColumnSpec + ") VALUES (:id, :playlist, :position, :type, :collection_id, " + Song::kBindSpec + ")");
+    for (const QPair<SavedItem, PlaylistItemPtr> &inserted : changes.inserted) {
+      q.BindValue(":id", inserted.first.id);
+      q.BindValue(":playlist", playlist);
+      q.BindValue(":position", inserted.first.position);
+      inserted.second->BindToQuery(&q);
+      if (!q.Exec()) {
+        db_->ReportErrors(q);
+        emit SavePlaylistFailed(playlist);
+        return;
+      }
     }
   }
 
   // Update the last played track number
   {
     SqlQuery q(db);
-    q.prepare("UPDATE playlists SET last_played=:last_played, dynamic_playlist_type=:dynamic_type, dynamic_playlist_data=:dynamic_data, dynamic_playlist_backend=:dynamic_backend WHERE ROWID=:playlist");
+    q.PrepareCached("UPDATE playlists SET last_played=:last_played, dynamic_playlist_type=:dynamic_type, dynamic_playlist_data=:dynamic_data, dynamic_playlist_backend=:dynamic_backend WHERE ROWID=:playlist");
     q.BindValue(":last_played", last_played);
     if (dynamic) {
       q.BindValue(":dynamic_type", static_cast<int>(dynamic->type()));
@@ -373,6 +472,7 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemPtrList &item
     q.BindValue(":playlist", playlist);
     if (!q.Exec()) {
       db_->ReportErrors(q);
+      emit SavePlaylistFailed(playlist);
       return;
     }
   }
@@ -387,7 +487,7 @@ int PlaylistBackend::CreatePlaylist(const QString &name, const QString &special_
   QSqlDatabase db(db_->Connect());
 
   SqlQuery q(db);
-  q.prepare("INSERT INTO playlists (name, special_type) VALUES (:name, :special_type)");
+  q.PrepareCached("INSERT INTO playlists (name, special_type) VALUES (:name, :special_type)");
   q.BindValue(":name", name);
   q.BindValue(":special_type", special_type);
   if (!q.Exec()) {
@@ -408,7 +508,7 @@ void PlaylistBackend::RemovePlaylist(int id) {
 
   {
     SqlQuery q(db);
-    q.prepare("DELETE FROM playlists WHERE ROWID=:id");
+    q.PrepareCached("DELETE FROM playlists WHERE ROWID=:id");
     q.BindValue(":id", id);
     if (!q.Exec()) {
       db_->ReportErrors(q);
@@ -418,7 +518,7 @@ void PlaylistBackend::RemovePlaylist(int id) {
 
   {
     SqlQuery q(db);
-    q.prepare("DELETE FROM playlist_items WHERE playlist=:id");
+    q.PrepareCached("DELETE FROM playlist_items WHERE playlist=:id");
     q.BindValue(":id", id);
     if (!q.Exec()) {
       db_->ReportErrors(q);
@@ -435,7 +535,7 @@ void PlaylistBackend::RenamePlaylist(const int id, const QString &new_name) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
   SqlQuery q(db);
-  q.prepare("UPDATE playlists SET name=:name WHERE ROWID=:id");
+  q.PrepareCached("UPDATE playlists SET name=:name WHERE ROWID=:id");
   q.BindValue(":name", new_name);
   q.BindValue(":id", id);
 
@@ -450,7 +550,7 @@ void PlaylistBackend::FavoritePlaylist(const int id, const bool is_favorite) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
   SqlQuery q(db);
-  q.prepare("UPDATE playlists SET is_favorite=:is_favorite WHERE ROWID=:id");
+  q.PrepareCached("UPDATE playlists SET is_favorite=:is_favorite WHERE ROWID=:id");
   q.BindValue(":is_favorite", is_favorite ? 1 : 0);
   q.BindValue(":id", id);
 
@@ -467,13 +567,13 @@ void PlaylistBackend::SetPlaylistOrder(const QList<int> &ids) {
   ScopedTransaction transaction(&db);
 
   SqlQuery q(db);
-  q.prepare("UPDATE playlists SET ui_order=-1");
+  q.PrepareCached("UPDATE playlists SET ui_order=-1");
   if (!q.Exec()) {
     db_->ReportErrors(q);
     return;
   }
 
-  q.prepare("UPDATE playlists SET ui_order=:index WHERE ROWID=:id");
+  q.PrepareCached("UPDATE playlists SET ui_order=:index WHERE ROWID=:id");
   for (int i = 0; i < ids.count(); ++i) {
     q.BindValue(":index", i);
     q.BindValue(":id", ids[i]);
@@ -492,7 +592,7 @@ void PlaylistBackend::SetPlaylistUiPath(const int id, const QString &path) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
   SqlQuery q(db);
-  q.prepare("UPDATE playlists SET ui_path=:path WHERE ROWID=:id");
+  q.PrepareCached("UPDATE playlists SET ui_path=:path WHERE ROWID=:id");
 
   ScopedTransaction transaction(&db);
 
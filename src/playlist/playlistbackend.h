@@ -30,6 +30,7 @@
 #include <QMutex>
 #include <QHash>
 #include <QList>
+#include <QPair>
 #include <QSet>
 #include <QString>
 #include <QSqlQuery>
@@ -65,6 +66,25 @@ class PlaylistBackend : public QObject {
   };
   using PlaylistList = QList<Playlist>;
 
+  // A playlist item as it's saved in playlist_items, the items of a playlist are sorted by position.
+  struct SavedItem {
+    SavedItem(const qint64 _id = -1, const double _position = 0) : id(_id), position(_position) {}
+    qint64 id;
+    double position;
+  };
+  using SavedItemList = QList<SavedItem>;
+
+  // The changes to a playlist since it was last saved, see PlaylistChanges.
+  struct Changes {
+    Changes() : replace_all(false) {}
+    // Removes all saved items of the playlist first, the inserted items are all there is.
+    bool replace_all;
+    QList<qint64> removed;
+    QList<QPair<SavedItem, PlaylistItemPtr>> inserted;
+    SavedItemList moved;
+    QList<QPair<qint64, PlaylistItemPtr>> updated;
+  };
+
   static const int kSongTableJoins;
 
   void Close();
@@ -75,26 +95,35 @@ class PlaylistBackend : public QObject {
   PlaylistList GetAllFavoritePlaylists();
   PlaylistBackend::Playlist GetPlaylist(const int id);
 
-  PlaylistItemPtrList GetPlaylistItems(const int playlist);
+  // Also returns the saved items in saved_items, in the same order as the items.
+  // With a limit, returns at most that many items saved after the given item, so a playlist can be restored in pages.
+  PlaylistItemPtrList GetPlaylistItems(const int playlist, SavedItemList *saved_items = nullptr, const SavedItem &after = SavedItem(), const int limit = -1);
   SongList GetPlaylistSongs(const int playlist);
 
   void SetPlaylistOrder(const QList<int> &ids);
   void SetPlaylistUiPath(const int id, const QString &path);
 
   int CreatePlaylist(const QString &name, const QString &special_type);
-  void SavePlaylistAsync(const int playlist, const PlaylistItemPtrList &items, const int last_played, PlaylistGeneratorPtr dynamic);
+  void SavePlaylistAsync(const int playlist, const PlaylistBackend::Changes &changes, const int last_played, PlaylistGeneratorPtr dynamic);
+  // Reserves count consecutive ROWIDs for new playlist_items rows, returns the first one.
+  // Doesn't touch the database, the first ROWID is read when the first playlist is restored.
+  qint64 AllocateItemIds(const int count);
   void RenamePlaylist(const int id, const QString &new_name);
   void FavoritePlaylist(const int id, bool is_favorite);
   void RemovePlaylist(const int id);
 
   Application *app() const { return app_; }
+  // Uses another database than the application's, for the tests.
+  void set_database(Database *db) { db_ = db; }
 
  public slots:
   void Exit();
-  void SavePlaylist(const int playlist, const PlaylistItemPtrList &items, const int last_played, PlaylistGeneratorPtr dynamic);
+  void SavePlaylist(const int playlist, const PlaylistBackend::Changes &changes, const int last_played, PlaylistGeneratorPtr dynamic);
 
  signals:
   void ExitFinished();
+  // The database no longer matches what the playlist thinks is saved.
+  void SavePlaylistFailed(const int playlist);
 
  private:
   struct NewSongFromQueryState {
@@ -112,10 +141,16 @@ class PlaylistBackend : public QObject {
     GetPlaylists_All = GetPlaylists_OpenInUi | GetPlaylists_Favorite
   };
   PlaylistList GetPlaylists(const GetPlaylistsFlags flags);
+  void InitItemIds(QSqlDatabase &db);
 
   Application *app_;
   Database *db_;
   QThread *original_thread_;
+
+  QMutex item_id_mutex_;
+  qint64 next_item_id_;
 };
 
+Q_DECLARE_METATYPE(PlaylistBackend::Changes)
+
 #endif  // PLAYLISTBACKEND_H
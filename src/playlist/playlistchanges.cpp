@@ -0,0 +1,248 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+
+#include "playlistitem.h"
+#include "playlistbackend.h"
+#include "playlistchanges.h"
+
+constexpr double PlaylistChanges::kMinPositionGap = 1e-6;
+
+namespace {
+
+// Returns which of the values are part of the longest strictly increasing sequence, values of -1 are skipped.
+std::vector<bool> LongestIncreasingSequence(const std::vector<int> &values) {
+
+  std::vector<bool> result(values.size(), false);
+
+  // tails[i] is the index of the smallest value ending an increasing sequence of length i + 1.
+  std::vector<int> tails;
+  std::vector<int> previous(values.size(), -1);
+  for (int i = 0; i < static_cast<int>(values.size()); ++i) {
+    const int value = values[static_cast<size_t>(i)];
+    if (value == -1) continue;
+    std::vector<int>::iterator it = std::lower_bound(tails.begin(), tails.end(), value, [&values](const int index, const int v) { return values[static_cast<size_t>(index)] < v; });
+    if (it != tails.begin()) previous[static_cast<size_t>(i)] = *(it - 1);
+    if (it == tails.end()) {
+      tails.push_back(i);
+    }
+    else {
+      *it = i;
+    }
+  }
+
+  for (int i = tails.empty() ? -1 : tails.back(); i != -1; i = previous[static_cast<size_t>(i)]) {
+    result[static_cast<size_t>(i)] = true;
+  }
+
+  return result;
+
+}
+
+}  // namespace
+
+PlaylistChanges::PlaylistChanges() : valid_(false), taken_(false) {}
+
+void PlaylistChanges::Restored(const PlaylistItemPtrList &items, const PlaylistBackend::SavedItemList &saved_items) {
+
+  // If the playlist was saved before the restore finished, the saved items are gone already.
+  if (taken_ || items.count() != saved_items.count()) {
+    Invalidate();
+    return;
+  }
+
+  saved_.clear();
+  saved_.reserve(items.count());
+  for (int i = 0; i < items.count(); ++i) {
+    saved_ << Saved(items[i], saved_items[i]);
+  }
+  valid_ = true;
+
+}
+
+void PlaylistChanges::ItemChanged(const PlaylistItemPtr &item) {
+
+  QMutexLocker l(&mutex_changed_items_);
+  changed_items_.insert(item.get());
+
+}
+
+void PlaylistChanges::Invalidate() {
+
+  valid_ = false;
+
+}
+
+bool PlaylistChanges::Unchanged(const PlaylistItemPtrList &items) const {
+
+  if (items.count() != saved_.count()) return false;
+
+  for (int i = 0; i < items.count(); ++i) {
+    if (items[i] != saved_[i].item) return false;
+  }
+
+  return true;
+
+}
+
+PlaylistBackend::Changes PlaylistChanges::Take(const PlaylistItemPtrList &items, const AllocateIdsFunction &allocate_ids) {
+
+  QSet<const PlaylistItem*> changed_items;
+  {
+    QMutexLocker l(&mutex_changed_items_);
+    changed_items.swap(changed_items_);
+  }
+
+  taken_ = true;
+
+  PlaylistBackend::Changes changes;
+
+  if (!valid_) {
+    changes.replace_all = true;
+    saved_.clear();
+  }
+  else if (Unchanged(items)) {
+    // Only metadata changed, this is what happens most of the time.
+    for (const Saved &saved : std::as_const(saved_)) {
+      if (changed_items.contains(saved.item.get())) {
+        changes.updated << qMakePair(saved.saved_item.id, saved.item);
+      }
+    }
+    return changes;
+  }
+
+  // Match the items with the saved ones in order, the same item can be in the playlist more than once.
+  QHash<const PlaylistItem*, QList<int>> saved_indexes;
+  for (int i = 0; i < saved_.count(); ++i) {
+    saved_indexes[saved_[i].item.get()] << i;
+  }
+  const int count = static_cast<int>(items.count());
+  std::vector<int> matched(static_cast<size_t>(count), -1);
+  std::vector<bool> saved_matched(static_cast<size_t>(saved_.count()), false);
+  int new_items = 0;
+  for (int row = 0; row < count; ++row) {
+    QHash<const PlaylistItem*, QList<int>>::iterator it = saved_indexes.find(items[row].get());
+    if (it == saved_indexes.end() || it.value().isEmpty()) {
+      ++new_items;
+      continue;
+    }
+    const int saved_index = it.value().takeFirst();
+    matched[static_cast<size_t>(row)] = saved_index;
+    saved_matched[static_cast<size_t>(saved_index)] = true;
+  }
+
+  qint64 next_id = 0;
+  if (new_items > 0) {
+    next_id = allocate_ids(new_items);
+    if (next_id < 0) {
+      // Try again with all items on the next save.
+      Invalidate();
+      return PlaylistBackend::Changes();
+    }
+  }
+
+  for (int i = 0; i < saved_.count(); ++i) {
+    if (!saved_matched[static_cast<size_t>(i)]) changes.removed << saved_[i].saved_item.id;
+  }
+
+  // The saved items are sorted by position, so the longest sequence of items still in saved order keeps its positions.
+  // Everything else gets a new position between them.
+  const std::vector<bool> keep = LongestIncreasingSequence(matched);
+  std::vector<double> positions(static_cast<size_t>(count));
+  bool renumber = false;
+  for (int row = 0; row < count && !renumber;) {
+    if (keep[static_cast<size_t>(row)]) {
+      positions[static_cast<size_t>(row)] = saved_[matched[static_cast<size_t>(row)]].saved_item.position;
+      ++row;
+      continue;
+    }
+    int end = row;
+    while (end < count && !keep[static_cast<size_t>(end)]) ++end;
+    const int n = end - row;
+    const bool has_low = row > 0;
+    const bool has_high = end < count;
+    const double low = has_low ? positions[static_cast<size_t>(row - 1)] : 0.0;
+    const double high = has_high ? saved_[matched[static_cast<size_t>(end)]].saved_item.position : 0.0;
+    for (int i = 0; i < n; ++i) {
+      double &position = positions[static_cast<size_t>(row + i)];
+      if (has_low && has_high) {
+        const double step = (high - low) / (n + 1);
+        if (step < kMinPositionGap) {
+          renumber = true;
+          break;
+        }
+        position = low + step * (i + 1);
+      }
+      else if (has_high) {
+        position = high - (n - i);
+      }
+      else if (has_low) {
+        position = low + (i + 1);
+      }
+      else {
+        position = i + 1;
+      }
+    }
+    row = end;
+  }
+  if (renumber) {
+    for (int row = 0; row < count; ++row) positions[static_cast<size_t>(row)] = row + 1;
+  }
+
+  QList<Saved> saved;
+  saved.reserve(count);
+  for (int row = 0; row < count; ++row) {
+    const PlaylistItemPtr &item = items[row];
+    const double position = positions[static_cast<size_t>(row)];
+    const int saved_index = matched[static_cast<size_t>(row)];
+    if (saved_index == -1) {
+      const PlaylistBackend::SavedItem saved_item(next_id++, position);
+      changes.inserted << qMakePair(saved_item, item);
+      saved << Saved(item, saved_item);
+    }
+    else {
+      const qint64 id = saved_[saved_index].saved_item.id;
+      if (saved_[saved_index].saved_item.position != position) {
+        changes.moved << PlaylistBackend::SavedItem(id, position);
+      }
+      if (changed_items.contains(item.get())) {
+        changes.updated << qMakePair(id, item);
+      }
+      saved << Saved(item, PlaylistBackend::SavedItem(id, position));
+    }
+  }
+
+  saved_ = saved;
+  valid_ = true;
+
+  return changes;
+
+}
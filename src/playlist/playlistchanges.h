@@ -0,0 +1,82 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PLAYLISTCHANGES_H
+#define PLAYLISTCHANGES_H
+
+#include "config.h"
+
+#include <functional>
+
+#include <QtGlobal>
+#include <QMutex>
+#include <QList>
+#include <QSet>
+
+#include "playlistitem.h"
+#include "playlistbackend.h"
+
+// Remembers which ROWID and position every item of a playlist has in the database, so a save only writes the items
+// that were inserted, removed, moved or changed since the last one, whatever did it: the undo commands, sorting,
+// dynamic playlists or metadata updates.
+// Moved and inserted items get a position between their neighbours, so the rows around them stay untouched.
+// When there is no room left between two positions, the whole playlist is renumbered once.
+class PlaylistChanges {
+ public:
+  explicit PlaylistChanges();
+
+  // Closest two positions can get before the playlist is renumbered.
+  static const double kMinPositionGap;
+
+  using AllocateIdsFunction = std::function<qint64(const int count)>;
+
+  // The items were restored from the database, saved_items has the ROWID and position of each of them.
+  void Restored(const PlaylistItemPtrList &items, const PlaylistBackend::SavedItemList &saved_items);
+
+  // The metadata of the item changed, so it has to be saved again. Can be called from any thread.
+  void ItemChanged(const PlaylistItemPtr &item);
+
+  // The database doesn't match what was saved anymore, the next save replaces all items.
+  void Invalidate();
+  bool valid() const { return valid_; }
+
+  // Returns what has to be saved for the playlist to have these items, and takes them as saved.
+  // The ROWIDs of new rows are reserved through allocate_ids.
+  PlaylistBackend::Changes Take(const PlaylistItemPtrList &items, const AllocateIdsFunction &allocate_ids);
+
+ private:
+  struct Saved {
+    Saved(const PlaylistItemPtr &_item = PlaylistItemPtr(), const PlaylistBackend::SavedItem &_saved_item = PlaylistBackend::SavedItem()) : item(_item), saved_item(_saved_item) {}
+    PlaylistItemPtr item;
+    PlaylistBackend::SavedItem saved_item;
+  };
+
+  bool Unchanged(const PlaylistItemPtrList &items) const;
+
+ private:
+  // In playlist order, so the positions are increasing.
+  QList<Saved> saved_;
+  bool valid_;
+  bool taken_;
+
+  QMutex mutex_changed_items_;
+  QSet<const PlaylistItem*> changed_items_;
+};
+
+#endif  // PLAYLISTCHANGES_H
@@ -21,7 +21,14 @@
 
 #include "config.h"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <QtGlobal>
 #include <QObject>
+#include <QtConcurrentMap>
+#include <QThread>
 #include <QString>
 #include <QAbstractItemModel>
 #include <QSortFilterProxyModel>
@@ -30,10 +37,26 @@
 #include "playlistfilter.h"
 #include "playlistfilterparser.h"
 
+constexpr int PlaylistFilter::kMinRowsPerThread = 8192;
+
+namespace {
+
+struct Range {
+  Range(const int _first = 0, const int _last = 0) : first(_first), last(_last) {}
+  int first;
+  int last;
+};
+
+}  // namespace
+
 PlaylistFilter::PlaylistFilter(QObject *parent)
     : QSortFilterProxyModel(parent),
       filter_tree_(new NopFilter),
-      query_hash_(0) {
+      query_hash_(0),
+      row_count_(0),
+      rows_valid_(false),
+      rows_changed_(false),
+      accepted_rows_valid_(false) {
 
   setDynamicSortFilter(true);
 
@@ -66,6 +89,13 @@ PlaylistFilter::PlaylistFilter(QObject *parent)
                      << Playlist::Column_Bitdepth
                      << Playlist::Column_Bitrate;
 
+  for (const int column : std::as_const(column_names_)) {
+    if (!filter_columns_.contains(column)) filter_columns_ << column;
+  }
+  std::sort(filter_columns_.begin(), filter_columns_.end());
+
+  program_.reset(new FilterProgram(filter_tree_.data(), filter_columns_));
+
 }
 
 PlaylistFilter::~PlaylistFilter() = default;
@@ -75,6 +105,119 @@ void PlaylistFilter::sort(int column, Qt::SortOrder order) {
   sourceModel()->sort(column, order);
 }
 
+void PlaylistFilter::setSourceModel(QAbstractItemModel *source_model) {
+
+  if (sourceModel()) {
+    QObject::disconnect(sourceModel(), &QAbstractItemModel::rowsInserted, this, &PlaylistFilter::SourceRowsChanged);
+    QObject::disconnect(sourceModel(), &QAbstractItemModel::rowsRemoved, this, &PlaylistFilter::SourceRowsChanged);
+    QObject::disconnect(sourceModel(), &QAbstractItemModel::rowsMoved, this, &PlaylistFilter::SourceRowsChanged);
+    QObject::disconnect(sourceModel(), &QAbstractItemModel::layoutChanged, this, &PlaylistFilter::SourceRowsChanged);
+    QObject::disconnect(sourceModel(), &QAbstractItemModel::modelReset, this, &PlaylistFilter::SourceRowsChanged);
+    QObject::disconnect(sourceModel(), &QAbstractItemModel::dataChanged, this, &PlaylistFilter::SourceDataChanged);
+  }
+
+  // Connected before QSortFilterProxyModel, so the search keys are marked as changed before it filters the rows again.
+  if (source_model) {
+    QObject::connect(source_model, &QAbstractItemModel::rowsInserted, this, &PlaylistFilter::SourceRowsChanged);
+    QObject::connect(source_model, &QAbstractItemModel::rowsRemoved, this, &PlaylistFilter::SourceRowsChanged);
+    QObject::connect(source_model, &QAbstractItemModel::rowsMoved, this, &PlaylistFilter::SourceRowsChanged);
+    QObject::connect(source_model, &QAbstractItemModel::layoutChanged, this, &PlaylistFilter::SourceRowsChanged);
+    QObject::connect(source_model, &QAbstractItemModel::modelReset, this, &PlaylistFilter::SourceRowsChanged);
+    QObject::connect(source_model, &QAbstractItemModel::dataChanged, this, &PlaylistFilter::SourceDataChanged);
+  }
+
+  SourceRowsChanged();
+
+  QSortFilterProxyModel::setSourceModel(source_model);
+
+}
+
+void PlaylistFilter::SourceRowsChanged() {
+
+  rows_valid_ = false;
+  accepted_rows_valid_ = false;
+
+}
+
+void PlaylistFilter::SourceDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right) {
+
+  if (!rows_valid_) return;
+
+  for (int row = qMax(0, top_left.row()); row <= bottom_right.row() && row < row_count_; ++row) {
+    changed_rows_[static_cast<size_t>(row)] = true;
+    rows_changed_ = true;
+  }
+
+}
+
+void PlaylistFilter::UpdateRows() {
+
+  QAbstractItemModel *model = sourceModel();
+  if (!model) return;
+
+  const int columns = static_cast<int>(filter_columns_.count());
+
+  if (!rows_valid_) {
+    row_count_ = model->rowCount();
+    row_text_.assign(static_cast<size_t>(row_count_) * static_cast<size_t>(columns), QString());
+    row_numbers_.assign(static_cast<size_t>(row_count_) * static_cast<size_t>(columns), 0);
+    changed_rows_.assign(static_cast<size_t>(row_count_), true);
+    rows_changed_ = true;
+    rows_valid_ = true;
+  }
+
+  if (!rows_changed_) return;
+
+  // Same as the filter tree gets them from the model.
+  for (int row = 0; row < row_count_; ++row) {
+    if (!changed_rows_[static_cast<size_t>(row)]) continue;
+    const size_t first = static_cast<size_t>(row) * static_cast<size_t>(columns);
+    for (int i = 0; i < columns; ++i) {
+      const int column = filter_columns_[i];
+      QString &text = row_text_[first + static_cast<size_t>(i)];
+      text = model->index(row, column).data().toString().toLower();
+      row_numbers_[first + static_cast<size_t>(i)] = numerical_columns_.contains(column) ? FilterProgram::ColumnNumber(column, text) : 0;
+    }
+    changed_rows_[static_cast<size_t>(row)] = false;
+  }
+  rows_changed_ = false;
+
+  // The rows that changed have to be filtered again.
+  accepted_rows_valid_ = false;
+
+}
+
+void PlaylistFilter::FilterRows(const bool narrow) {
+
+  accepted_rows_.resize(static_cast<size_t>(row_count_), 1);
+  if (row_count_ == 0) {
+    accepted_rows_valid_ = true;
+    return;
+  }
+
+  const int threads = qBound(1, row_count_ / kMinRowsPerThread, qMax(1, QThread::idealThreadCount()));
+  std::vector<Range> ranges;
+  ranges.reserve(static_cast<size_t>(threads));
+  for (int i = 0; i < threads; ++i) {
+    ranges.emplace_back(static_cast<int>(static_cast<qint64>(row_count_) * i / threads), static_cast<int>(static_cast<qint64>(row_count_) * (i + 1) / threads));
+  }
+
+  const size_t columns = static_cast<size_t>(filter_columns_.count());
+  const FilterProgram *program = program_.data();
+  QtConcurrent::blockingMap(ranges, [this, narrow, columns, program](const Range &range) {
+    for (int row = range.first; row < range.last; ++row) {
+      char &accepted = accepted_rows_[static_cast<size_t>(row)];
+      // A narrower query only has to look at the rows the previous one accepted.
+      if (narrow && !accepted) continue;
+      const size_t first = static_cast<size_t>(row) * columns;
+      accepted = program->Matches(FilterRow(&row_text_[first], &row_numbers_[first])) ? 1 : 0;
+    }
+  });
+
+  accepted_rows_valid_ = true;
+
+}
+
 bool PlaylistFilter::filterAcceptsRow(int row, const QModelIndex &parent) const {
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
@@ -85,11 +228,19 @@ bool PlaylistFilter::filterAcceptsRow(int row, const QModelIndex &parent) const
   if (hash != query_hash_) {
     // Parse the query
     FilterParser p(filter_text_, column_names_, numerical_columns_);
+    program_.reset();
     filter_tree_.reset(p.parse());
+    program_.reset(new FilterProgram(filter_tree_.data(), filter_columns_));
+    accepted_rows_valid_ = false;
 
     query_hash_ = hash;
   }
 
+  // Filtered already, unless the row changed since.
+  if (accepted_rows_valid_ && !parent.isValid() && row >= 0 && row < row_count_ && !changed_rows_[static_cast<size_t>(row)]) {
+    return accepted_rows_[static_cast<size_t>(row)] != 0;
+  }
+
   // Test the row
   return filter_tree_->accept(row, parent, sourceModel());
 
@@ -98,6 +249,21 @@ bool PlaylistFilter::filterAcceptsRow(int row, const QModelIndex &parent) const
 void PlaylistFilter::SetFilterText(const QString &filter_text) {
 
   filter_text_ = filter_text;
+
+  // Parse and compile the query, and filter all rows at once before the proxy model asks for them one by one.
+  UpdateRows();
+
+  FilterParser p(filter_text_, column_names_, numerical_columns_);
+  FilterTree *filter_tree = p.parse();
+  FilterProgram *program = new FilterProgram(filter_tree, filter_columns_);
+  const bool narrow = accepted_rows_valid_ && program->Narrows(*program_);
+
+  program_.reset(program);
+  filter_tree_.reset(filter_tree);
+  query_hash_ = qHash(filter_text_);
+
+  if (rows_valid_) FilterRows(narrow);
+
   setFilterFixedString(filter_text);
 
 }
@@ -24,15 +24,21 @@
 
 #include "config.h"
 
+#include <vector>
+
 #include <QtGlobal>
 #include <QObject>
+#include <QList>
 #include <QMap>
 #include <QSet>
 #include <QScopedPointer>
 #include <QString>
 #include <QSortFilterProxyModel>
 
+class QAbstractItemModel;
+class QModelIndex;
 class FilterTree;
+class FilterProgram;
 
 class PlaylistFilter : public QSortFilterProxyModel {
   Q_OBJECT
@@ -41,9 +47,14 @@ class PlaylistFilter : public QSortFilterProxyModel {
   explicit PlaylistFilter(QObject *parent = nullptr);
   ~PlaylistFilter() override;
 
+  static const int kMinRowsPerThread;
+
   // QAbstractItemModel
   void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
 
+  // QAbstractProxyModel
+  void setSourceModel(QAbstractItemModel *source_model) override;
+
   // QSortFilterProxyModel
   // public so Playlist::NextVirtualIndex and friends can get at it
   bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
@@ -52,9 +63,18 @@ class PlaylistFilter : public QSortFilterProxyModel {
 
   QString filter_text() const { return filter_text_; }
 
+ private:
+  void UpdateRows();
+  void FilterRows(const bool narrow);
+
+ private slots:
+  void SourceRowsChanged();
+  void SourceDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right);
+
  private:
   // Mutable because they're modified from filterAcceptsRow() const
   mutable QScopedPointer<FilterTree> filter_tree_;
+  mutable QScopedPointer<FilterProgram> program_;
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
   mutable size_t query_hash_;
 #else
@@ -64,6 +84,22 @@ class PlaylistFilter : public QSortFilterProxyModel {
   QMap<QString, int> column_names_;
   QSet<int> numerical_columns_;
   QString filter_text_;
+
+  // The columns that can be searched, the search keys of the rows have them in this order.
+  QList<int> filter_columns_;
+
+  // Search keys of the source rows, rows_valid_ is unset when rows were inserted, removed or moved.
+  int row_count_;
+  bool rows_valid_;
+  std::vector<QString> row_text_;
+  std::vector<int> row_numbers_;
+  std::vector<bool> changed_rows_;
+  bool rows_changed_;
+
+  // Whether each source row is accepted by the program, so filterAcceptsRow() doesn't have to go through the model.
+  // Not a std::vector<bool>, the rows are filtered by several threads.
+  std::vector<char> accepted_rows_;
+  mutable bool accepted_rows_valid_;
 };
 
 #endif  // PLAYLISTFILTER_H
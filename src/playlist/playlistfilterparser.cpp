@@ -40,6 +40,11 @@ class SearchTermComparator {
   SearchTermComparator() = default;
   virtual ~SearchTermComparator() = default;
   virtual bool Matches(const QString &element) const = 0;
+  // Numerical comparators compare the number of the column instead of the text.
+  virtual bool numerical() const { return false; }
+  virtual bool MatchesNumber(const int number) const { Q_UNUSED(number); return false; }
+  // Returns true if this comparator only matches elements the other one matches too.
+  virtual bool Narrows(const SearchTermComparator &other) const { Q_UNUSED(other); return false; }
  private:
   Q_DISABLE_COPY(SearchTermComparator)
 };
@@ -51,6 +56,10 @@ class DefaultComparator : public SearchTermComparator {
   bool Matches(const QString &element) const override {
     return element.contains(search_term_);
   }
+  bool Narrows(const SearchTermComparator &other) const override {
+    const DefaultComparator *default_comparator = dynamic_cast<const DefaultComparator*>(&other);
+    return default_comparator && search_term_.contains(default_comparator->search_term_);
+  }
  private:
   QString search_term_;
 
@@ -123,6 +132,10 @@ class GtComparator : public SearchTermComparator {
   bool Matches(const QString &element) const override {
     return element.toInt() > search_term_;
   }
+  bool numerical() const override { return true; }
+  bool MatchesNumber(const int number) const override {
+    return number > search_term_;
+  }
  private:
   int search_term_;
 };
@@ -133,6 +146,10 @@ class GeComparator : public SearchTermComparator {
   bool Matches(const QString &element) const override {
     return element.toInt() >= search_term_;
   }
+  bool numerical() const override { return true; }
+  bool MatchesNumber(const int number) const override {
+    return number >= search_term_;
+  }
  private:
   int search_term_;
 };
@@ -143,6 +160,10 @@ class LtComparator : public SearchTermComparator {
   bool Matches(const QString &element) const override {
     return element.toInt() < search_term_;
   }
+  bool numerical() const override { return true; }
+  bool MatchesNumber(const int number) const override {
+    return number < search_term_;
+  }
  private:
   int search_term_;
 };
@@ -153,6 +174,10 @@ class LeComparator : public SearchTermComparator {
   bool Matches(const QString &element) const override {
     return element.toInt() <= search_term_;
   }
+  bool numerical() const override { return true; }
+  bool MatchesNumber(const int number) const override {
+    return number <= search_term_;
+  }
  private:
   int search_term_;
 };
@@ -172,6 +197,9 @@ class DropTailComparatorDecorator : public SearchTermComparator {
       return cmp_->Matches(element);
     }
   }
+  // The number of the length column is in seconds already, see FilterProgram::ColumnNumber().
+  bool numerical() const override { return cmp_->numerical(); }
+  bool MatchesNumber(const int number) const override { return cmp_->MatchesNumber(number); }
  private:
   QScopedPointer<SearchTermComparator> cmp_;
 };
@@ -198,6 +226,7 @@ class FilterTerm : public FilterTree {
     }
     return false;
   }
+  void compile(FilterProgram *program) const override { program->AddTerm(-1, cmp_.data()); }
   FilterType type() override { return FilterType::Term; }
  private:
   QScopedPointer<SearchTermComparator> cmp_;
@@ -213,6 +242,7 @@ class FilterColumnTerm : public FilterTree {
     QModelIndex idx(model->index(row, col, parent));
     return cmp_->Matches(idx.data().toString().toLower());
   }
+  void compile(FilterProgram *program) const override { program->AddTerm(static_cast<int>(program->columns().indexOf(col)), cmp_.data()); }
   FilterType type() override { return FilterType::Column; }
  private:
   int col;
@@ -226,6 +256,11 @@ class NotFilter : public FilterTree {
   bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const override {
     return !child_->accept(row, parent, model);
   }
+  void compile(FilterProgram *program) const override {
+    const int instruction = program->Begin(FilterProgram::Op::Not);
+    child_->compile(program);
+    program->End(instruction);
+  }
   FilterType type() override { return FilterType::Not; }
  private:
   QScopedPointer<const FilterTree> child_;
@@ -238,6 +273,11 @@ class OrFilter : public FilterTree {
   bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const override {
     return std::any_of(children_.begin(), children_.end(), [row, parent, model](FilterTree *child) { return child->accept(row, parent, model); });
   }
+  void compile(FilterProgram *program) const override {
+    const int instruction = program->Begin(FilterProgram::Op::Or);
+    for (FilterTree *child : children_) child->compile(program);
+    program->End(instruction);
+  }
   FilterType type() override { return FilterType::Or; }
  private:
   QList<FilterTree*> children_;
@@ -250,11 +290,136 @@ class AndFilter : public FilterTree {
   bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const override {
     return !std::any_of(children_.begin(), children_.end(), [row, parent, model](FilterTree *child) { return !child->accept(row, parent, model); });
   }
+  void compile(FilterProgram *program) const override {
+    const int instruction = program->Begin(FilterProgram::Op::And);
+    for (FilterTree *child : children_) child->compile(program);
+    program->End(instruction);
+  }
   FilterType type() override { return FilterType::And; }
  private:
   QList<FilterTree*> children_;
 };
 
+void NopFilter::compile(FilterProgram *program) const {
+  program->End(program->Begin(FilterProgram::Op::True));
+}
+
+FilterProgram::FilterProgram(const FilterTree *tree, const QList<int> &columns) : columns_(columns) {
+  tree->compile(this);
+}
+
+int FilterProgram::ColumnNumber(const int column, const QString &text) {
+
+  // Like the DropTailComparatorDecorator
+  if (column == Playlist::Column_Length && text.length() > 9) {
+    return text.left(text.length() - 9).toInt();
+  }
+
+  return text.toInt();
+
+}
+
+int FilterProgram::Begin(const Op op) {
+
+  instructions_.emplace_back(op);
+  return static_cast<int>(instructions_.size()) - 1;
+
+}
+
+void FilterProgram::End(const int instruction) {
+  instructions_[static_cast<size_t>(instruction)].end = static_cast<int>(instructions_.size());
+}
+
+void FilterProgram::AddTerm(const int column, const SearchTermComparator *comparator) {
+
+  instructions_.emplace_back(Op::Term, column, comparator);
+  instructions_.back().end = static_cast<int>(instructions_.size());
+
+}
+
+bool FilterProgram::Matches(const FilterRow &row) const {
+
+  return instructions_.empty() || Evaluate(0, row);
+
+}
+
+bool FilterProgram::Evaluate(const int i, const FilterRow &row) const {
+
+  const Instruction &instruction = instructions_[static_cast<size_t>(i)];
+  switch (instruction.op) {
+    case Op::True:
+      return true;
+    case Op::Term:
+      if (instruction.column == -1) {
+        for (int column = 0; column < columns_.count(); ++column) {
+          if (instruction.comparator->Matches(row.text[column])) return true;
+        }
+        return false;
+      }
+      if (instruction.comparator->numerical()) {
+        return instruction.comparator->MatchesNumber(row.numbers[instruction.column]);
+      }
+      return instruction.comparator->Matches(row.text[instruction.column]);
+    case Op::Not:
+      return !Evaluate(i + 1, row);
+    case Op::Or:
+      for (int operand = i + 1; operand < instruction.end; operand = instructions_[static_cast<size_t>(operand)].end) {
+        if (Evaluate(operand, row)) return true;
+      }
+      return false;
+    case Op::And:
+      for (int operand = i + 1; operand < instruction.end; operand = instructions_[static_cast<size_t>(operand)].end) {
+        if (!Evaluate(operand, row)) return false;
+      }
+      return true;
+  }
+
+  return false;
+
+}
+
+bool FilterProgram::Terms(QList<const Instruction*> *terms) const {
+
+  // The parser always makes an or-group of and-groups, there are only search terms when there is one and-group.
+  if (instructions_.size() < 2 || instructions_[0].op != Op::Or || instructions_[1].op != Op::And || instructions_[1].end != instructions_[0].end) {
+    return false;
+  }
+
+  for (size_t i = 2; i < instructions_.size(); ++i) {
+    if (instructions_[i].op != Op::Term) return false;
+    *terms << &instructions_[i];
+  }
+
+  return true;
+
+}
+
+bool FilterProgram::Narrows(const FilterProgram &previous) const {
+
+  if (columns_ != previous.columns_) return false;
+
+  // Everything was accepted before.
+  if (previous.instructions_.empty() || (previous.instructions_.size() == 1 && previous.instructions_[0].op == Op::True)) {
+    return true;
+  }
+
+  QList<const Instruction*> terms;
+  QList<const Instruction*> previous_terms;
+  if (!Terms(&terms) || !previous.Terms(&previous_terms) || terms.count() < previous_terms.count()) {
+    return false;
+  }
+
+  // Every term narrows the one it was typed from, the additional terms narrow it further.
+  for (int i = 0; i < previous_terms.count(); ++i) {
+    if (terms[i]->column != previous_terms[i]->column || !terms[i]->comparator->Narrows(*previous_terms[i]->comparator)) {
+      return false;
+    }
+  }
+
+  return true;
+
+}
+
 FilterParser::FilterParser(const QString &filter, const QMap<QString, int> &columns, const QSet<int> &numerical_cols) : iter_{}, end_{}, filterstring_(filter), columns_(columns), numerical_columns_(numerical_cols) {}
 
 FilterTree *FilterParser::parse() {
@@ -23,12 +23,17 @@
 
 #include "config.h"
 
+#include <vector>
+
+#include <QList>
 #include <QSet>
 #include <QMap>
 #include <QString>
 
 class QAbstractItemModel;
 class QModelIndex;
+class SearchTermComparator;
+class FilterProgram;
 
 // Structure for filter parse tree
 class FilterTree {
@@ -36,6 +41,7 @@ class FilterTree {
   FilterTree() = default;
   virtual ~FilterTree() {}
   virtual bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const = 0;
+  virtual void compile(FilterProgram *program) const = 0;
   enum class FilterType {
     Nop = 0,
     Or,
@@ -53,9 +59,67 @@ class FilterTree {
 class NopFilter : public FilterTree {
  public:
   bool accept(int row, const QModelIndex &parent, const QAbstractItemModel *const model) const override { Q_UNUSED(row); Q_UNUSED(parent); Q_UNUSED(model); return true; }
+  void compile(FilterProgram *program) const override;
   FilterType type() override { return FilterType::Nop; }
 };
 
+// The search keys of one playlist row: the lowercased text of every filter column, the way the filter tree gets it
+// from the model, and the number of the column for the numerical comparisons. In the order of the program's columns.
+struct FilterRow {
+  FilterRow(const QString *_text = nullptr, const int *_numbers = nullptr) : text(_text), numbers(_numbers) {}
+  const QString *text;
+  const int *numbers;
+};
+
+// A filter tree flattened into a list of instructions, so it can be run over the search keys of the rows without
+// going through the model. Every instruction is followed by its operands and knows where they end.
+// The comparators still belong to the tree, which has to outlive the program.
+class FilterProgram {
+ public:
+  explicit FilterProgram(const FilterTree *tree, const QList<int> &columns);
+
+  enum class Op {
+    True,
+    Or,
+    And,
+    Not,
+    Term
+  };
+
+  // Returns the number a numerical comparison compares for the text of the column.
+  static int ColumnNumber(const int column, const QString &text);
+
+  const QList<int> &columns() const { return columns_; }
+
+  bool Matches(const FilterRow &row) const;
+
+  // Returns true if this program only accepts rows the previous one accepted too, so only those have to be filtered again.
+  // This is the case when more is typed to a query made of search terms only.
+  bool Narrows(const FilterProgram &previous) const;
+
+  // Used by FilterTree::compile()
+  int Begin(const Op op);
+  void End(const int instruction);
+  void AddTerm(const int column, const SearchTermComparator *comparator);
+
+ private:
+  struct Instruction {
+    explicit Instruction(const Op _op = Op::True, const int _column = -1, const SearchTermComparator *_comparator = nullptr) : op(_op), end(-1), column(_column), comparator(_comparator) {}
+    Op op;
+    int end;
+    // Index into the columns, -1 for all of them.
+    int column;
+    const SearchTermComparator *comparator;
+  };
+
+  bool Evaluate(const int instruction, const FilterRow &row) const;
+  bool Terms(QList<const Instruction*> *terms) const;
+
+ private:
+  QList<int> columns_;
+  std::vector<Instruction> instructions_;
+};
+
 
 // A utility class to parse search filter strings into a decision tree
 // that can decide whether a playlist entry matches the filter.
@@ -469,16 +469,18 @@ void PlaylistManager::SongsDiscovered(const SongList &songs) {
 
   // Some songs might've changed in the collection, let's update any playlist items we have that match those songs
 
-  for (const Song &song : songs) {
-    for (const Data &data : std::as_const(playlists_)) {
+  for (const Data &data : std::as_const(playlists_)) {
+    PlaylistItemPtrList changed_items;
+    for (const Song &song : songs) {
       PlaylistItemPtrList items = data.p->collection_items_by_id(song.id());
       for (PlaylistItemPtr item : items) {
         if (item->Metadata().directory_id() != song.directory_id()) continue;
         item->SetMetadata(song);
         if (item->HasTemporaryMetadata()) item->UpdateTemporaryMetadata(song);
-        data.p->ItemChanged(item);
+        changed_items << item;
       }
     }
+    if (!changed_items.isEmpty()) data.p->ItemsChanged(changed_items);
   }
 
 }
@@ -0,0 +1,275 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <QtGlobal>
+#include <QtConcurrentMap>
+#include <QThread>
+#include <QString>
+#include <QUrl>
+#include <QCollator>
+#include <QCollatorSortKey>
+
+#include "core/song.h"
+#include "playlist.h"
+#include "playlistitem.h"
+#include "playlistsorter.h"
+
+constexpr int PlaylistSorter::kMinItemsPerThread = 4096;
+
+namespace {
+
+// Not a playlist column, the number of directories in the path of the file.
+constexpr int kColumnPathDepth = -1;
+
+bool IsCollatedColumn(const int column) {
+
+  switch (column) {
+    case Playlist::Column_Title:
+    case Playlist::Column_Artist:
+    case Playlist::Column_Album:
+    case Playlist::Column_Genre:
+    case Playlist::Column_AlbumArtist:
+    case Playlist::Column_Composer:
+    case Playlist::Column_Performer:
+    case Playlist::Column_Grouping:
+    case Playlist::Column_Filename:
+    case Playlist::Column_Comment:
+      return true;
+    default:
+      return false;
+  }
+
+}
+
+QString StringValue(const int column, const PlaylistItemPtr &item) {
+
+  switch (column) {
+    case Playlist::Column_Title:        return item->Metadata().title_sortable();
+    case Playlist::Column_Artist:       return item->Metadata().artist_sortable();
+    case Playlist::Column_Album:        return item->Metadata().album_sortable();
+    case Playlist::Column_Genre:        return item->Metadata().genre();
+    case Playlist::Column_AlbumArtist:  return item->Metadata().playlist_albumartist_sortable();
+    case Playlist::Column_Composer:     return item->Metadata().composer();
+    case Playlist::Column_Performer:    return item->Metadata().performer();
+    case Playlist::Column_Grouping:     return item->Metadata().grouping();
+    case Playlist::Column_Filename:     return item->Url().path();
+    case Playlist::Column_BaseFilename: return item->Metadata().basefilename();
+    case Playlist::Column_Comment:      return item->Metadata().comment();
+    default:                            return QString();
+  }
+
+}
+
+double NumberValue(const int column, const PlaylistItemPtr &item) {
+
+  switch (column) {
+    case Playlist::Column_Length:       return static_cast<double>(item->Metadata().length_nanosec());
+    case Playlist::Column_Track:        return item->Metadata().track();
+    case Playlist::Column_Disc:         return item->Metadata().disc();
+    case Playlist::Column_Year:         return item->Metadata().year();
+    case Playlist::Column_OriginalYear: return item->Metadata().originalyear();
+    case Playlist::Column_PlayCount:    return item->Metadata().playcount();
+    case Playlist::Column_SkipCount:    return item->Metadata().skipcount();
+    case Playlist::Column_LastPlayed:   return static_cast<double>(item->Metadata().lastplayed());
+    case Playlist::Column_Bitrate:      return item->Metadata().bitrate();
+    case Playlist::Column_Samplerate:   return item->Metadata().samplerate();
+    case Playlist::Column_Bitdepth:     return item->Metadata().bitdepth();
+    case Playlist::Column_Filesize:     return static_cast<double>(item->Metadata().filesize());
+    case Playlist::Column_Filetype:     return static_cast<int>(item->Metadata().filetype());
+    case Playlist::Column_DateModified: return static_cast<double>(item->Metadata().mtime());
+    case Playlist::Column_DateCreated:  return static_cast<double>(item->Metadata().ctime());
+    case Playlist::Column_Source:       return static_cast<int>(item->Metadata().source());
+    case Playlist::Column_Rating:       return item->Metadata().rating();
+    case Playlist::Column_HasCUE:       return item->Metadata().has_cue() ? 1 : 0;
+    case kColumnPathDepth:              return static_cast<double>(item->Url().path().count('/'));
+    default:                            return 0;
+  }
+
+}
+
+template<typename T>
+int Compare(const T &a, const T &b) {
+  return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+struct Range {
+  Range(const int _first = 0, const int _last = 0) : first(_first), last(_last) {}
+  int first;
+  int last;
+  // Collation keys of the items in the range, for every collated key.
+  std::vector<std::vector<QCollatorSortKey>> collation_keys;
+};
+
+struct Merge {
+  Merge(const int _first = 0, const int _middle = 0, const int _last = 0) : first(_first), middle(_middle), last(_last) {}
+  int first;
+  int middle;
+  int last;
+};
+
+}  // namespace
+
+PlaylistSorter::PlaylistSorter(const PlaylistItemPtrList &items, const int begin, const int column, const Qt::SortOrder order)
+    : begin_(qBound(0, begin, static_cast<int>(items.count()))),
+      count_(static_cast<int>(items.count()) - begin_),
+      column_(column),
+      order_(order) {
+
+  if (column == Playlist::Column_Album) {
+    // When sorting by album, also take into account discs and tracks.
+    AddKey(items, Playlist::Column_Album);
+    AddKey(items, Playlist::Column_Disc);
+    AddKey(items, Playlist::Column_Track);
+  }
+  else if (column == Playlist::Column_Filename) {
+    // When sorting by full paths we also expect a hierarchical order. This returns a breath-first ordering of paths.
+    AddKey(items, kColumnPathDepth);
+    AddKey(items, Playlist::Column_Filename);
+  }
+  else {
+    AddKey(items, column);
+  }
+
+}
+
+void PlaylistSorter::AddKey(const PlaylistItemPtrList &items, const int column) {
+
+  Key key(IsCollatedColumn(column) ? KeyType::Collated : (column == Playlist::Column_BaseFilename ? KeyType::String : KeyType::Number));
+
+  if (key.type == KeyType::Number) {
+    key.numbers.reserve(static_cast<size_t>(count_));
+    for (int i = begin_; i < items.count(); ++i) key.numbers.push_back(NumberValue(column, items[i]));
+  }
+  else {
+    key.strings.reserve(static_cast<size_t>(count_));
+    for (int i = begin_; i < items.count(); ++i) key.strings.push_back(StringValue(column, items[i]));
+  }
+
+  keys_.push_back(std::move(key));
+
+}
+
+std::vector<int> PlaylistSorter::Sort() const {
+
+  std::vector<int> sorted(static_cast<size_t>(count_));
+  std::iota(sorted.begin(), sorted.end(), 0);
+  if (count_ < 2) return sorted;
+
+  // Split the items in one range per thread.
+  const int threads = qBound(1, count_ / kMinItemsPerThread, qMax(1, QThread::idealThreadCount()));
+  std::vector<Range> ranges;
+  ranges.reserve(static_cast<size_t>(threads));
+  for (int i = 0; i < threads; ++i) {
+    ranges.emplace_back(static_cast<int>(static_cast<qint64>(count_) * i / threads), static_cast<int>(static_cast<qint64>(count_) * (i + 1) / threads));
+  }
+
+  // Build the collation keys, every thread with its own collator.
+  QtConcurrent::blockingMap(ranges, [this](Range &range) {
+    QCollator collator;
+    range.collation_keys.resize(keys_.size());
+    for (size_t k = 0; k < keys_.size(); ++k) {
+      if (keys_[k].type != KeyType::Collated) continue;
+      std::vector<QCollatorSortKey> &collation_keys = range.collation_keys[k];
+      collation_keys.reserve(static_cast<size_t>(range.last - range.first));
+      for (int i = range.first; i < range.last; ++i) {
+        collation_keys.push_back(collator.sortKey(keys_[k].strings[static_cast<size_t>(i)].toLower()));
+      }
+    }
+  });
+
+  std::vector<std::vector<QCollatorSortKey>> collation_keys(keys_.size());
+  for (size_t k = 0; k < keys_.size(); ++k) {
+    if (keys_[k].type != KeyType::Collated) continue;
+    collation_keys[k].reserve(static_cast<size_t>(count_));
+    for (Range &range : ranges) {
+      std::move(range.collation_keys[k].begin(), range.collation_keys[k].end(), std::back_inserter(collation_keys[k]));
+      range.collation_keys[k].clear();
+    }
+  }
+
+  const bool descending = order_ == Qt::DescendingOrder;
+  auto less = [this, &collation_keys, descending](const int a, const int b) {
+    for (size_t k = 0; k < keys_.size(); ++k) {
+      int result = 0;
+      switch (keys_[k].type) {
+        case KeyType::Collated:
+          result = collation_keys[k][static_cast<size_t>(a)].compare(collation_keys[k][static_cast<size_t>(b)]);
+          break;
+        case KeyType::String:
+          result = Compare(keys_[k].strings[static_cast<size_t>(a)], keys_[k].strings[static_cast<size_t>(b)]);
+          break;
+        case KeyType::Number:
+          result = Compare(keys_[k].numbers[static_cast<size_t>(a)], keys_[k].numbers[static_cast<size_t>(b)]);
+          break;
+      }
+      if (result != 0) return descending ? result > 0 : result < 0;
+    }
+    return false;
+  };
+
+  QtConcurrent::blockingMap(ranges, [&sorted, &less](Range &range) {
+    std::stable_sort(sorted.begin() + range.first, sorted.begin() + range.last, less);
+  });
+
+  // Merge neighbouring ranges until one is left. std::merge takes from the first range on ties, so the result stays stable.
+  std::vector<int> buffer(sorted.size());
+  std::vector<int> bounds;
+  bounds.reserve(ranges.size() + 1);
+  for (const Range &range : ranges) bounds.push_back(range.first);
+  bounds.push_back(count_);
+  while (bounds.size() > 2) {
+    std::vector<Merge> merges;
+    std::vector<int> merged_bounds;
+    for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+      const int last = i + 2 < bounds.size() ? bounds[i + 2] : bounds[i + 1];
+      merges.emplace_back(bounds[i], bounds[i + 1], last);
+      merged_bounds.push_back(bounds[i]);
+    }
+    merged_bounds.push_back(count_);
+    QtConcurrent::blockingMap(merges, [&sorted, &buffer, &less](Merge &merge) {
+      std::merge(sorted.begin() + merge.first, sorted.begin() + merge.middle, sorted.begin() + merge.middle, sorted.begin() + merge.last, buffer.begin() + merge.first, less);
+    });
+    sorted.swap(buffer);
+    bounds.swap(merged_bounds);
+  }
+
+  return sorted;
+
+}
+
+PlaylistItemPtrList PlaylistSorter::Apply(const PlaylistItemPtrList &items, const std::vector<int> &order) const {
+
+  if (items.count() != begin_ + count_ || order.size() != static_cast<size_t>(count_)) return items;
+
+  PlaylistItemPtrList new_items;
+  new_items.reserve(items.count());
+  for (int i = 0; i < begin_; ++i) new_items << items[i];
+  for (const int i : order) new_items << items[begin_ + i];
+
+  return new_items;
+
+}
@@ -0,0 +1,76 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PLAYLISTSORTER_H
+#define PLAYLISTSORTER_H
+
+#include "config.h"
+
+#include <vector>
+
+#include <QtGlobal>
+#include <QString>
+
+#include "playlistitem.h"
+
+// Sorts playlist items in the same order as Playlist::CompareItems, but compares every string only once per item:
+// The constructor copies the values the column needs from the items, Sort() turns them into collation keys and
+// sorts the item indexes with a stable sort that is split over all cores.
+// Only the constructor touches the items, so Sort() can run in any thread while the playlist keeps changing.
+class PlaylistSorter {
+ public:
+  explicit PlaylistSorter(const PlaylistItemPtrList &items, const int begin, const int column, const Qt::SortOrder order);
+
+  static const int kMinItemsPerThread;
+
+  // Indexes of the items from begin in sorted order.
+  std::vector<int> Sort() const;
+
+  // Applies the order returned by Sort(), the items before begin stay where they are.
+  PlaylistItemPtrList Apply(const PlaylistItemPtrList &items, const std::vector<int> &order) const;
+
+  int begin() const { return begin_; }
+  int column() const { return column_; }
+  Qt::SortOrder order() const { return order_; }
+
+ private:
+  enum class KeyType {
+    Collated,
+    String,
+    Number
+  };
+
+  struct Key {
+    explicit Key(const KeyType _type = KeyType::Number) : type(_type) {}
+    KeyType type;
+    std::vector<QString> strings;
+    std::vector<double> numbers;
+  };
+
+  void AddKey(const PlaylistItemPtrList &items, const int column);
+
+ private:
+  int begin_;
+  int count_;
+  int column_;
+  Qt::SortOrder order_;
+  std::vector<Key> keys_;
+};
+
+#endif  // PLAYLISTSORTER_H
@@ -22,6 +22,7 @@
 
 #include <QtGlobal>
 #include <QList>
+#include <QHash>
 #include <QUndoStack>
 
 #include "playlist.h"
@@ -52,15 +53,11 @@ void InsertItems::undo() {
   playlist_->RemoveItemsWithoutUndo(start, static_cast<int>(items_.count()));
 }
 
-bool InsertItems::UpdateItem(const PlaylistItemPtr &updated_item) {
+void InsertItems::UpdateItems(const QHash<const PlaylistItem*, PlaylistItemPtr> &new_items) {
   for (int i = 0; i < items_.size(); i++) {
-    PlaylistItemPtr item = items_[i];
-    if (item->Metadata().url() == updated_item->Metadata().url()) {
-      items_[i] = updated_item;
-      return true;
-    }
+    PlaylistItemPtr new_item = new_items.value(items_[i].get());
+    if (new_item) items_[i] = new_item;
   }
-  return false;
 }
 
 
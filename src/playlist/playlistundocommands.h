@@ -25,6 +25,7 @@
 
 #include <QCoreApplication>
 #include <QList>
+#include <QHash>
 #include <QUndoStack>
 
 #include "playlistitem.h"
@@ -54,9 +55,8 @@ namespace PlaylistUndoCommands {
     void undo() override;
     void redo() override;
     // When load is async, items have already been pushed, so we need to update them.
-    // This function try to find the equivalent item, and replace it with the new (completely loaded) one.
-    // Return true if the was found (and updated), false otherwise
-    bool UpdateItem(const PlaylistItemPtr &updated_item);
+    // Replaces the items that are keys in new_items with the new (completely loaded) ones.
+    void UpdateItems(const QHash<const PlaylistItem*, PlaylistItemPtr> &new_items);
 
    private:
     PlaylistItemPtrList items_;
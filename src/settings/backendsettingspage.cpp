@@ -162,6 +162,7 @@ void BackendSettingsPage::Load() {
 
   ui_->checkbox_http2->setChecked(s.value("http2", false).toBool());
   ui_->checkbox_strict_ssl->setChecked(s.value("strict_ssl", false).toBool());
+  ui_->checkbox_preroll_next->setChecked(s.value("preroll_next", false).toBool());
 
   ui_->spinbox_bufferduration->setValue(s.value("bufferduration", kDefaultBufferDuration).toInt());
   ui_->spinbox_low_watermark->setValue(s.value("bufferlowwatermark", kDefaultBufferLowWatermark).toDouble());
@@ -475,6 +476,7 @@ void BackendSettingsPage::Save() {
 
   s.setValue("http2", ui_->checkbox_http2->isChecked());
   s.setValue("strict_ssl", ui_->checkbox_strict_ssl->isChecked());
+  s.setValue("preroll_next", ui_->checkbox_preroll_next->isChecked());
 
   s.setValue("bufferduration", ui_->spinbox_bufferduration->value());
   s.setValue("bufferlowwatermark", ui_->spinbox_low_watermark->value());
@@ -61,6 +61,7 @@ const char *CollectionSettingsPage::kSettingsCacheSizeUnit = "cache_size_unit";
 const char *CollectionSettingsPage::kSettingsDiskCacheEnable = "disk_cache_enable";
 const char *CollectionSettingsPage::kSettingsDiskCacheSize = "disk_cache_size";
 const char *CollectionSettingsPage::kSettingsDiskCacheSizeUnit = "disk_cache_size_unit";
+const char *CollectionSettingsPage::kSettingsSongIndex = "song_index";
 const int CollectionSettingsPage::kSettingsCacheSizeDefault = 160;
 const int CollectionSettingsPage::kSettingsDiskCacheSizeDefault = 360;
 
@@ -180,6 +181,7 @@ void CollectionSettingsPage::Load() {
   ui_->auto_open->setChecked(s.value("auto_open", true).toBool());
   ui_->pretty_covers->setChecked(s.value("pretty_covers", true).toBool());
   ui_->show_dividers->setChecked(s.value("show_dividers", true).toBool());
+  ui_->checkbox_song_index->setChecked(s.value(kSettingsSongIndex, false).toBool());
   ui_->startup_scan->setChecked(s.value("startup_scan", true).toBool());
   ui_->monitor->setChecked(s.value("monitor", true).toBool());
   ui_->song_tracking->setChecked(s.value("song_tracking", false).toBool());
@@ -254,6 +256,7 @@ void CollectionSettingsPage::Save() {
   s.setValue("auto_open", ui_->auto_open->isChecked());
   s.setValue("pretty_covers", ui_->pretty_covers->isChecked());
   s.setValue("show_dividers", ui_->show_dividers->isChecked());
+  s.setValue(kSettingsSongIndex, ui_->checkbox_song_index->isChecked());
   s.setValue("startup_scan", ui_->startup_scan->isChecked());
   s.setValue("monitor", ui_->monitor->isChecked());
   s.setValue("song_tracking", ui_->song_tracking->isChecked());
@@ -47,6 +47,7 @@ class CollectionSettingsPage : public SettingsPage {
   static const char *kSettingsDiskCacheEnable;
   static const char *kSettingsDiskCacheSize;
   static const char *kSettingsDiskCacheSizeUnit;
+  static const char *kSettingsSongIndex;
   static const int kSettingsCacheSizeDefault;
   static const int kSettingsDiskCacheSizeDefault;
 
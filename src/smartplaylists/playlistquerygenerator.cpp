@@ -28,12 +28,13 @@
 #include "playlistquerygenerator.h"
 #include "collection/collectionbackend.h"
 
-PlaylistQueryGenerator::PlaylistQueryGenerator(QObject *parent) : PlaylistGenerator(parent), dynamic_(false), current_pos_(0) {}
+PlaylistQueryGenerator::PlaylistQueryGenerator(QObject *parent) : PlaylistGenerator(parent), dynamic_(false), materialized_(false), current_pos_(0) {}
 
 PlaylistQueryGenerator::PlaylistQueryGenerator(const QString &name, const SmartPlaylistSearch &search, const bool dynamic, QObject *parent)
     : PlaylistGenerator(parent),
       search_(search),
       dynamic_(dynamic),
+      materialized_(false),
       current_pos_(0) {
 
   set_name(name);
@@ -44,6 +45,7 @@ void PlaylistQueryGenerator::Load(const SmartPlaylistSearch &search) {
 
   search_ = search;
   dynamic_ = false;
+  materialized_ = false;
   current_pos_ = 0;
 
 }
@@ -53,6 +55,9 @@ void PlaylistQueryGenerator::Load(const QByteArray &data) {
   QDataStream s(data);
   s >> search_;
   s >> dynamic_;
+  // Not saved by older versions.
+  materialized_ = false;
+  if (!s.atEnd()) s >> materialized_;
 
 }
 
@@ -62,6 +67,7 @@ QByteArray PlaylistQueryGenerator::Save() const {
   QDataStream s(&ret, QIODevice::WriteOnly);
   s << search_;
   s << dynamic_;
+  s << materialized_;
 
   return ret;
 
@@ -79,6 +85,7 @@ PlaylistItemPtrList PlaylistQueryGenerator::GenerateMore(const int count) {
 
   SmartPlaylistSearch search_copy = search_;
   search_copy.id_not_in_ = previous_ids_;
+  search_copy.materialized_ = materialized_;
   if (count > 0) {
     search_copy.limit_ = count;
   }
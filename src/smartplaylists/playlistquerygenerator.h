@@ -48,12 +48,17 @@ class PlaylistQueryGenerator : public PlaylistGenerator {
   bool is_dynamic() const override { return dynamic_; }
   void set_dynamic(bool dynamic) override { dynamic_ = dynamic; }
 
+  // Read the songs from a table kept up to date by the collection backend instead of searching the collection.
+  bool is_materialized() const { return materialized_; }
+  void set_materialized(const bool materialized) { materialized_ = materialized; }
+
   SmartPlaylistSearch search() const { return search_; }
   int GetDynamicFuture() override { return search_.limit_; }
 
  private:
   SmartPlaylistSearch search_;
   bool dynamic_;
+  bool materialized_;
 
   QList<int> previous_ids_;
   int current_pos_;
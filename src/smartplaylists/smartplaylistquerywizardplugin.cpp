@@ -202,12 +202,15 @@ void SmartPlaylistQueryWizardPlugin::SetGenerator(PlaylistGeneratorPtr g) {
     sort_ui_->limit_value->setValue(search.limit_);
   }
 
+  sort_ui_->materialize->setChecked(gen->is_materialized());
+
 }
 
 PlaylistGeneratorPtr SmartPlaylistQueryWizardPlugin::CreateGenerator() const {
 
   std::shared_ptr<PlaylistQueryGenerator> gen = std::make_shared<PlaylistQueryGenerator>();
   gen->Load(MakeSearch());
+  gen->set_materialized(sort_ui_->materialize->isChecked());
 
   return std::static_pointer_cast<PlaylistGenerator>(gen);
 
@@ -28,7 +28,7 @@
 
 #include "smartplaylistsearch.h"
 
-SmartPlaylistSearch::SmartPlaylistSearch() : search_type_(SearchType::And), sort_type_(SortType::Random), sort_field_(SmartPlaylistSearchTerm::Field::Title), limit_(-1), first_item_(0) { Reset(); }
+SmartPlaylistSearch::SmartPlaylistSearch() : search_type_(SearchType::And), sort_type_(SortType::Random), sort_field_(SmartPlaylistSearchTerm::Field::Title), limit_(-1), first_item_(0), materialized_(false) { Reset(); }
 
 SmartPlaylistSearch::SmartPlaylistSearch(const SearchType type, const TermList &terms, const SortType sort_type, const SmartPlaylistSearchTerm::Field sort_field, const int limit)
     : search_type_(type),
@@ -36,7 +36,8 @@ SmartPlaylistSearch::SmartPlaylistSearch(const SearchType type, const TermList &
       sort_type_(sort_type),
       sort_field_(sort_field),
       limit_(limit),
-      first_item_(0) {}
+      first_item_(0),
+      materialized_(false) {}
 
 void SmartPlaylistSearch::Reset() {
 
@@ -46,12 +47,11 @@ void SmartPlaylistSearch::Reset() {
   sort_field_ = SmartPlaylistSearchTerm::Field::Title;
   limit_ = -1;
   first_item_ = 0;
+  materialized_ = false;
 
 }
 
-QString SmartPlaylistSearch::ToSql(const QString &songs_table) const {
-
-  QString sql = "SELECT ROWID," + Song::kColumnSpec + " FROM " + songs_table;
+QStringList SmartPlaylistSearch::WhereClauses(const bool exclude_ids) const {
 
   // Add search terms
   QStringList where_clauses;
@@ -67,7 +67,7 @@ QString SmartPlaylistSearch::ToSql(const QString &songs_table) const {
   }
 
   // Restrict the IDs of songs if we're making a dynamic playlist
-  if (!id_not_in_.isEmpty()) {
+  if (exclude_ids && !id_not_in_.isEmpty()) {
     QString numbers;
     for (int id : id_not_in_) {
       numbers += (numbers.isEmpty() ? "" : ",") + QString::number(id);
@@ -79,6 +79,18 @@ QString SmartPlaylistSearch::ToSql(const QString &songs_table) const {
   // but are still kept in the database in case the directory containing them has just been unmounted.
   where_clauses << "unavailable = 0";
 
+  return where_clauses;
+
+}
+
+QString SmartPlaylistSearch::ToSql(const QString &songs_table, const QString &materialized_search) const {
+
+  QString sql = "SELECT ROWID," + Song::kColumnSpec + " FROM " + songs_table;
+
+  QStringList where_clauses = WhereClauses(true);
+  if (!materialized_search.isEmpty()) {
+    where_clauses.prepend("ROWID IN (SELECT song_id FROM smart_playlists_songs WHERE search = '" + materialized_search + "')");
+  }
   if (!where_clauses.isEmpty()) {
     sql += " WHERE " + where_clauses.join(" AND ");
   }
@@ -104,6 +116,39 @@ QString SmartPlaylistSearch::ToSql(const QString &songs_table) const {
 
 }
 
+QString SmartPlaylistSearch::ToSampleSql(const QString &songs_table) const {
+
+  // One ROWID index lookup, however big the table is.
+  return "SELECT ROWID," + Song::kColumnSpec + " FROM " + songs_table + " WHERE ROWID = :rowid AND " + WhereClauses(false).join(" AND ");
+
+}
+
+QString SmartPlaylistSearch::ToSampleIdsSql(const QString &songs_table) const {
+
+  return "SELECT ROWID FROM " + songs_table + " WHERE ROWID >= :min_rowid AND ROWID < :max_rowid AND " + WhereClauses(true).join(" AND ") + " ORDER BY ROWID LIMIT :limit";
+
+}
+
+QString SmartPlaylistSearch::MaterializedWhereClause() const {
+
+  if (search_type_ == SearchType::All) return QString();
+
+  QStringList term_where_clauses;
+  term_where_clauses.reserve(terms_.count());
+  for (const SmartPlaylistSearchTerm &term : terms_) {
+    // Songs start matching these just because time passes, leave them to the query reading the songs.
+    if (term.operator_ == SmartPlaylistSearchTerm::Operator::NumericDateNot || term.operator_ == SmartPlaylistSearchTerm::Operator::RelativeDate) {
+      if (search_type_ == SearchType::Or) return QString();
+      continue;
+    }
+    term_where_clauses << term.ToSql();
+  }
+  if (term_where_clauses.isEmpty()) return QString();
+
+  return "(" + term_where_clauses.join(search_type_ == SearchType::And ? " AND " : " OR ") + ") AND unavailable = 0";
+
+}
+
 bool SmartPlaylistSearch::is_valid() const {
 
   if (search_type_ == SearchType::All) return true;
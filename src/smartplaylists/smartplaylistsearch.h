@@ -25,6 +25,7 @@
 
 #include <QList>
 #include <QString>
+#include <QStringList>
 #include <QDataStream>
 
 #include "playlistgenerator.h"
@@ -65,9 +66,22 @@ class SmartPlaylistSearch {
   // Not persisted, used to alter the behaviour of the query
   QList<int> id_not_in_;
   int first_item_;
+  // Read the songs from the materialized search, see CollectionBackend::SmartPlaylistsMaterialize.
+  bool materialized_;
 
   void Reset();
-  QString ToSql(const QString &songs_table) const;
+  // With materialized_search, only the songs kept for that search are read.
+  QString ToSql(const QString &songs_table, const QString &materialized_search = QString()) const;
+  // Reads the song with ROWID :rowid if it matches, ignoring the sort order and id_not_in_, used to pick random songs.
+  QString ToSampleSql(const QString &songs_table) const;
+  // Reads the ROWIDs of at most :limit matching songs from ROWID :min_rowid up to :max_rowid, ignoring the sort order.
+  QString ToSampleIdsSql(const QString &songs_table) const;
+  // Matches at least the songs the search matches for as long as they don't change, so it can be kept in a table
+  // that is only updated for changed songs. Empty when that table wouldn't be smaller than the songs table.
+  QString MaterializedWhereClause() const;
+
+ private:
+  QStringList WhereClauses(const bool exclude_ids) const;
 
 };
 
@@ -335,6 +335,12 @@ void Transcoder::Start() {
 
   emit LogLine(tr("Transcoding %1 files using %2 threads").arg(queued_jobs_.count()).arg(max_threads()));
 
+  StartJobs();
+
+}
+
+void Transcoder::StartJobs() {
+
   forever {
     StartJobStatus status = MaybeStartNextJob();
     if (status == StartJobStatus::AllThreadsBusy || status == StartJobStatus::NoMoreJobs) break;
@@ -72,6 +72,8 @@ class Transcoder : public QObject {
 
  public slots:
   void Start();
+  // Starts jobs added after Start() without logging them again.
+  void StartJobs();
   void Cancel();
 
  signals:
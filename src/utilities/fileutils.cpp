@@ -22,11 +22,17 @@
 
 #include <QtGlobal>
 
+#ifdef Q_OS_LINUX
+#  include <unistd.h>
+#  include <sys/sendfile.h>
+#endif
+
 #include <QByteArray>
 #include <QString>
 #include <QIODevice>
 #include <QDir>
 #include <QFile>
+#include <QFileDevice>
 
 #include "core/logging.h"
 
@@ -34,6 +40,8 @@
 
 namespace Utilities {
 
+static const qint64 kCopyBufferSize = 1024 * 1024;
+
 QByteArray ReadDataFromFile(const QString &filename) {
 
   QFile file(filename);
@@ -80,6 +88,94 @@ bool Copy(QIODevice *source, QIODevice *destination) {
 
 }
 
+#ifdef Q_OS_LINUX
+namespace {
+
+// Returns false if nothing could be copied this way, so the caller can try something else.
+bool CopyFileInKernel(const int source_fd, const int destination_fd, const qint64 size) {
+
+  qint64 copied = 0;
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+  // Copies between files on the same filesystem, or clones the extents where the filesystem supports it.
+  while (copied < size) {
+    const ssize_t result = ::copy_file_range(source_fd, nullptr, destination_fd, nullptr, static_cast<size_t>(size - copied), 0);
+    if (result <= 0) break;
+    copied += result;
+  }
+  if (copied == size) return true;
+#endif
+
+  // Works across filesystems since Linux 2.6.33, both calls move the file offsets so it carries on where the other stopped.
+  while (copied < size) {
+    const ssize_t result = ::sendfile(destination_fd, source_fd, nullptr, static_cast<size_t>(size - copied));
+    if (result <= 0) break;
+    copied += result;
+  }
+
+  return copied == size;
+
+}
+
+}  // namespace
+#endif
+
+bool CopyFileFast(const QString &source, const QString &destination) {
+
+  if (QFile::exists(destination)) return false;
+
+  QFile source_file(source);
+  if (!source_file.open(QIODevice::ReadOnly)) {
+    qLog(Error) << "Failed to open file" << source << "for reading:" << source_file.errorString();
+    return false;
+  }
+
+  QFile destination_file(destination);
+  if (!destination_file.open(QIODevice::WriteOnly)) {
+    qLog(Error) << "Failed to open file" << destination << "for writing:" << destination_file.errorString();
+    return false;
+  }
+
+  bool success = false;
+#ifdef Q_OS_LINUX
+  if (source_file.size() > 0) {
+    success = CopyFileInKernel(source_file.handle(), destination_file.handle(), source_file.size());
+    if (!success) {
+      // Start over in userspace.
+      source_file.seek(0);
+      destination_file.resize(0);
+      destination_file.seek(0);
+    }
+  }
+#endif
+
+  if (!success) {
+    success = true;
+    std::unique_ptr<char[]> buffer(new char[kCopyBufferSize]);
+    while (!source_file.atEnd()) {
+      const qint64 bytes_read = source_file.read(buffer.get(), kCopyBufferSize);
+      if (bytes_read < 0 || destination_file.write(buffer.get(), bytes_read) != bytes_read) {
+        success = false;
+        break;
+      }
+    }
+  }
+
+  if (success) {
+    destination_file.setPermissions(source_file.permissions());
+    success = destination_file.flush();
+  }
+  destination_file.close();
+
+  if (!success) {
+    qLog(Error) << "Failed to copy" << source << "to" << destination << destination_file.errorString();
+    destination_file.remove();
+  }
+
+  return success;
+
+}
+
 bool CopyRecursive(const QString &source, const QString &destination) {
 
   // Make the destination directory
@@ -29,6 +29,8 @@ namespace Utilities {
 
 QByteArray ReadDataFromFile(const QString &filename);
 bool Copy(QIODevice *source, QIODevice *destination);
+// Copies a file that doesn't exist yet, letting the kernel move the data without reading it into userspace where it can.
+bool CopyFileFast(const QString &source, const QString &destination);
 bool CopyRecursive(const QString &source, const QString &destination);
 bool RemoveRecursive(const QString &path);
 
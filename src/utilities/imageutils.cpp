@@ -25,6 +25,7 @@
 #include <QBuffer>
 #include <QImage>
 #include <QImageReader>
+#include <QImageIOHandler>
 #include <QPixmap>
 #include <QPainter>
 #include <QSize>
@@ -138,6 +139,47 @@ QByteArray ImageUtils::FileToJpegData(const QString &filename) {
 
 }
 
+QSize ImageUtils::DecodeSize(const QSize &image_size, const QSize &min_size) {
+
+  if (image_size.isEmpty() || min_size.isEmpty()) return image_size;
+
+  // Scale by the smaller of the two factors to fit in min_size, rounding up so it still fills it.
+  const qint64 width = image_size.width();
+  const qint64 height = image_size.height();
+  if (static_cast<qint64>(min_size.width()) * height <= static_cast<qint64>(min_size.height()) * width) {
+    if (min_size.width() >= width) return image_size;
+    return QSize(min_size.width(), static_cast<int>(qMax(1LL, (height * min_size.width() + width - 1) / width)));
+  }
+  else {
+    if (min_size.height() >= height) return image_size;
+    return QSize(static_cast<int>(qMax(1LL, (width * min_size.height() + height - 1) / height)), min_size.height());
+  }
+
+}
+
+QImage ImageUtils::ReadImage(const QByteArray &image_data, const QSize &min_size) {
+
+  if (image_data.isEmpty()) return QImage();
+
+  QBuffer buffer;
+  buffer.setData(image_data);
+  if (!buffer.open(QIODevice::ReadOnly)) return QImage();
+
+  QImageReader reader(&buffer);
+  if (min_size.isValid() && reader.supportsOption(QImageIOHandler::ScaledSize)) {
+    // The JPEG reader decodes at 1/2, 1/4 or 1/8 of the size without the full image in memory, then scales the rest of the way.
+    const QSize image_size = reader.size();
+    const QSize decode_size = DecodeSize(image_size, min_size);
+    if (decode_size != image_size) reader.setScaledSize(decode_size);
+  }
+
+  QImage image;
+  if (!reader.read(&image)) return QImage();
+
+  return image;
+
+}
+
 QImage ImageUtils::ScaleAndPad(const QImage &image, const bool scale, const bool pad, const int desired_height, const qreal device_pixel_ratio) {
 
   if (image.isNull()) return image;
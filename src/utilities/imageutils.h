@@ -25,6 +25,7 @@
 #include <QString>
 #include <QStringList>
 #include <QUrl>
+#include <QSize>
 #include <QImage>
 #include <QPixmap>
 
@@ -40,6 +41,9 @@ class ImageUtils {
   static QByteArrayList ImageFormatsForMimeType(const QByteArray &mimetype);
   static QByteArray SaveImageToJpegData(const QImage &image = QImage());
   static QByteArray FileToJpegData(const QString &filename);
+  // Decodes the image at the smallest size that still fills min_size when scaled to fit in it, JPEG images are scaled while decoding.
+  static QImage ReadImage(const QByteArray &image_data, const QSize &min_size = QSize());
+  static QSize DecodeSize(const QSize &image_size, const QSize &min_size);
   static QPixmap TryLoadPixmap(const QUrl &automatic, const QUrl &manual, const QUrl &url = QUrl());
   static QImage ScaleAndPad(const QImage &image, const bool scale, const bool pad, const int desired_height, const qreal device_pixel_ratio = 1.0f);
   static QImage CreateThumbnail(const QImage &image, const bool pad, const QSize size);
@@ -0,0 +1,197 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QObject>
+#include <QMap>
+#include <QString>
+#include <QUrl>
+#include <QFile>
+#include <QFileDevice>
+#include <QDateTime>
+#include <QImage>
+#include <QColor>
+#include <QSize>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QNetworkDiskCache>
+
+#include "core/song.h"
+#include "covermanager/albumcoverloader.h"
+#include "covermanager/albumcoverloaderoptions.h"
+#include "covermanager/albumcoverloaderresult.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+// Exposes the thumbnail cache key and lets the cache live in a temporary directory.
+class TestAlbumCoverLoader : public AlbumCoverLoader {
+ public:
+  explicit TestAlbumCoverLoader(const QString &cache_directory) {
+    thumbnail_cache_->setCacheDirectory(cache_directory);
+  }
+
+  static QUrl CacheUrl(const AlbumCoverLoaderOptions &options, const QUrl &cover_url) {
+    Task task;
+    task.options = options;
+    return ThumbnailCacheUrl(task, cover_url);
+  }
+};
+
+class AlbumCoverLoaderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.isValid());
+    loader_ = new TestAlbumCoverLoader(temp_dir_.filePath("cache"));
+    QObject::connect(loader_, &AlbumCoverLoader::AlbumCoverLoaded, &context_, [this](const quint64 id, const AlbumCoverLoaderResult &result) { results_.insert(id, result); }, Qt::QueuedConnection);
+
+    cover_url_ = QUrl::fromLocalFile(temp_dir_.filePath("cover.png"));
+    ASSERT_TRUE(WriteCover(Qt::red));
+
+    options_.scaled_image_only_ = true;
+    options_.desired_height_ = 50;
+  }
+
+  void TearDown() override {
+    loader_->ExitAsync();
+    QTest::qWait(10);
+    delete loader_;
+  }
+
+  bool WriteCover(const QColor &color) {
+    QImage image(200, 100, QImage::Format_RGB32);
+    image.fill(color);
+    return image.save(cover_url_.toLocalFile(), "PNG");
+  }
+
+  AlbumCoverLoaderResult Load(const AlbumCoverLoaderOptions &options) {
+    const quint64 id = loader_->LoadImageAsync(options, QUrl(), cover_url_);
+    for (int i = 0; i < 500 && !results_.contains(id); ++i) {
+      QTest::qWait(10);
+    }
+    return results_.take(id);
+  }
+
+  QTemporaryDir temp_dir_;
+  QObject context_;
+  TestAlbumCoverLoader *loader_;
+  QMap<quint64, AlbumCoverLoaderResult> results_;
+  QUrl cover_url_;
+  AlbumCoverLoaderOptions options_;
+};
+
+TEST_F(AlbumCoverLoaderTest, ThumbnailCacheKey) {
+
+  const QUrl cache_url = TestAlbumCoverLoader::CacheUrl(options_, cover_url_);
+  ASSERT_TRUE(cache_url.isValid());
+  EXPECT_EQ(cache_url, TestAlbumCoverLoader::CacheUrl(options_, cover_url_));
+
+  // A different size or padding is a different thumbnail.
+  AlbumCoverLoaderOptions options = options_;
+  options.desired_height_ = 100;
+  EXPECT_NE(cache_url, TestAlbumCoverLoader::CacheUrl(options, cover_url_));
+  options = options_;
+  options.pad_output_image_ = !options.pad_output_image_;
+  EXPECT_NE(cache_url, TestAlbumCoverLoader::CacheUrl(options, cover_url_));
+
+  // Another cover file is a different thumbnail.
+  ASSERT_TRUE(QFile::copy(cover_url_.toLocalFile(), temp_dir_.filePath("folder.png")));
+  EXPECT_NE(cache_url, TestAlbumCoverLoader::CacheUrl(options_, QUrl::fromLocalFile(temp_dir_.filePath("folder.png"))));
+
+  // So is the same file after it changed.
+  QFile file(cover_url_.toLocalFile());
+  ASSERT_TRUE(file.open(QIODevice::ReadWrite));
+  ASSERT_TRUE(file.setFileTime(QDateTime::currentDateTime().addSecs(60), QFileDevice::FileModificationTime));
+  file.close();
+  EXPECT_NE(cache_url, TestAlbumCoverLoader::CacheUrl(options_, cover_url_));
+
+  // Only scaled images of local files are cached.
+  options = options_;
+  options.scaled_image_only_ = false;
+  EXPECT_FALSE(TestAlbumCoverLoader::CacheUrl(options, cover_url_).isValid());
+  options = options_;
+  options.create_thumbnail_ = true;
+  EXPECT_FALSE(TestAlbumCoverLoader::CacheUrl(options, cover_url_).isValid());
+  EXPECT_FALSE(TestAlbumCoverLoader::CacheUrl(options_, QUrl::fromLocalFile(temp_dir_.filePath("missing.png"))).isValid());
+  EXPECT_FALSE(TestAlbumCoverLoader::CacheUrl(options_, QUrl("https://www.strawberrymusicplayer.org/cover.png")).isValid());
+
+}
+
+TEST_F(AlbumCoverLoaderTest, ThumbnailCacheHitsAndMisses) {
+
+  const AlbumCoverLoaderResult first = Load(options_);
+  ASSERT_TRUE(first.success);
+  ASSERT_EQ(QSize(50, 50), first.image_scaled.size());
+  AlbumCoverLoader::Statistics statistics = loader_->statistics();
+  EXPECT_EQ(0U, statistics.thumbnail_cache_hits);
+  EXPECT_EQ(1U, statistics.thumbnail_cache_misses);
+  EXPECT_EQ(1U, statistics.images_decoded);
+
+  // The second load is the cached thumbnail, without decoding the cover again.
+  const AlbumCoverLoaderResult second = Load(options_);
+  ASSERT_TRUE(second.success);
+  EXPECT_EQ(first.image_scaled.convertToFormat(QImage::Format_ARGB32), second.image_scaled.convertToFormat(QImage::Format_ARGB32));
+  statistics = loader_->statistics();
+  EXPECT_EQ(1U, statistics.thumbnail_cache_hits);
+  EXPECT_EQ(1U, statistics.thumbnail_cache_misses);
+  EXPECT_EQ(1U, statistics.images_decoded);
+
+  // Another size misses.
+  AlbumCoverLoaderOptions options = options_;
+  options.desired_height_ = 30;
+  EXPECT_EQ(QSize(30, 30), Load(options).image_scaled.size());
+  statistics = loader_->statistics();
+  EXPECT_EQ(1U, statistics.thumbnail_cache_hits);
+  EXPECT_EQ(2U, statistics.thumbnail_cache_misses);
+  EXPECT_EQ(2U, statistics.images_decoded);
+
+  // A changed cover misses and is decoded again.
+  ASSERT_TRUE(WriteCover(Qt::blue));
+  QFile file(cover_url_.toLocalFile());
+  ASSERT_TRUE(file.open(QIODevice::ReadWrite));
+  ASSERT_TRUE(file.setFileTime(QDateTime::currentDateTime().addSecs(60), QFileDevice::FileModificationTime));
+  file.close();
+  const AlbumCoverLoaderResult changed = Load(options_);
+  ASSERT_TRUE(changed.success);
+  EXPECT_EQ(QColor(Qt::blue).rgb(), changed.image_scaled.pixel(25, 25));
+  statistics = loader_->statistics();
+  EXPECT_EQ(1U, statistics.thumbnail_cache_hits);
+  EXPECT_EQ(3U, statistics.thumbnail_cache_misses);
+  EXPECT_EQ(3U, statistics.images_decoded);
+
+  // A new loader with the same cache directory finds the saved thumbnails.
+  TestAlbumCoverLoader loader(temp_dir_.filePath("cache"));
+  AlbumCoverLoaderResult result;
+  QObject::connect(&loader, &AlbumCoverLoader::AlbumCoverLoaded, &context_, [&result](const quint64, const AlbumCoverLoaderResult &loaded) { result = loaded; }, Qt::QueuedConnection);
+  loader.LoadImageAsync(options_, QUrl(), cover_url_);
+  for (int i = 0; i < 500 && !result.success; ++i) {
+    QTest::qWait(10);
+  }
+  ASSERT_TRUE(result.success);
+  EXPECT_EQ(1U, loader.statistics().thumbnail_cache_hits);
+  EXPECT_EQ(0U, loader.statistics().images_decoded);
+  loader.ExitAsync();
+  QTest::qWait(10);
+
+}
+
+}  // namespace
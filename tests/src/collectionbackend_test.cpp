@@ -20,22 +20,41 @@
  */
 
 #include <memory>
+#include <algorithm>
+#include <atomic>
 
 #include <gtest/gtest.h>
 
 #include <QFileInfo>
 #include <QSignalSpy>
 #include <QThread>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QtConcurrentRun>
+#include <QTemporaryDir>
+#include <QSemaphore>
+#include <QMutexLocker>
+#include <QSqlDatabase>
+#include <QSet>
+#include <QHash>
+#include <QDate>
+#include <QTime>
+#include <QDateTime>
 #include <QtDebug>
 
 #include "test_utils.h"
 
 #include "core/song.h"
 #include "core/database.h"
+#include "core/scopedtransaction.h"
+#include "core/sqlquery.h"
+#include "core/sqlstatementcache.h"
 #include "core/logging.h"
 #include "utilities/timeconstants.h"
 #include "collection/collectionbackend.h"
 #include "collection/collection.h"
+#include "smartplaylists/smartplaylistsearch.h"
+#include "smartplaylists/smartplaylistsearchterm.h"
 
 // clazy:excludeall=non-pod-global-static,returning-void-expression
 
@@ -241,6 +260,26 @@ TEST_F(SingleSong, GetSongById) {
 
 }
 
+TEST_F(SingleSong, StatementCache) {
+
+  AddDummySong();
+  if (HasFatalFailure()) return;
+
+  backend_->GetSongById(1);
+  const SqlStatementCache::Statistics before = database_->statement_cache_statistics();
+
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(song_.title(), backend_->GetSongById(1).title());
+  }
+
+  // Repeated lookups use the statement prepared by the first one.
+  const SqlStatementCache::Statistics after = database_->statement_cache_statistics();
+  EXPECT_EQ(before.misses, after.misses);
+  EXPECT_EQ(before.hits + 10, after.hits);
+  EXPECT_EQ(0ULL, after.reparsed);
+
+}
+
 TEST_F(SingleSong, FindSongsInDirectory) {
 
   AddDummySong();
@@ -609,4 +648,442 @@ TEST_F(UpdateSongsBySongID, UpdateSongsBySongID) {
 
 }
 
+TEST_F(CollectionBackendTest, BulkInsertSongs) {
+
+  static const int kSongCount = 20000;
+
+  // Add a directory - this will get ID 1
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  songs.reserve(kSongCount);
+  for (int i = 0; i < kSongCount; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/song%1.flac").arg(i)));
+    song.set_title(QString("Title %1").arg(i));
+    song.set_artist(QString("Artist %1").arg(i % 100));
+    song.set_album(QString("Album %1").arg(i % 1000));
+    songs << song;
+  }
+
+  QSignalSpy added_spy(backend_.get(), &CollectionBackend::SongsDiscovered);
+
+  QElapsedTimer timer;
+  timer.start();
+  backend_->AddOrUpdateSongs(songs);
+  const qint64 elapsed = std::max(1LL, static_cast<long long>(timer.elapsed()));
+  qLog(Info) << "Inserted" << kSongCount << "songs in" << elapsed << "ms," << kSongCount * 1000LL / elapsed << "songs/sec";
+
+  ASSERT_EQ(1, added_spy.count());
+  const SongList added_songs = added_spy[0][0].value<SongList>();
+  ASSERT_EQ(kSongCount, added_songs.count());
+
+  // The IDs reported for the multi-row inserts must match the rows in the database.
+  for (const int i : QList<int>() << 0 << kSongCount / 2 << kSongCount - 1) {
+    const Song song = backend_->GetSongById(added_songs[i].id());
+    EXPECT_EQ(songs[i].url(), song.url());
+    EXPECT_EQ(songs[i].title(), song.title());
+  }
+
+  // The FTS index is populated for all songs.
+  QSqlDatabase db(database_->Connect());
+  SqlQuery q(db);
+  q.prepare(QString("SELECT COUNT(*) FROM %1 WHERE %1 MATCH :match").arg(SCollection::kFtsTable));
+  q.BindValue(":match", "ftsartist:\"Artist 42\"");
+  ASSERT_TRUE(q.Exec());
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(kSongCount / 100, q.value(0).toInt());
+
+}
+
+TEST_F(CollectionBackendTest, AddSongsWithSameSongId) {
+
+  backend_->AddDirectory("/tmp");
+
+  // Once with single inserts and once with the bulk insert.
+  for (const int count : QList<int>() << 2 << 200) {
+    SongList songs;
+    for (int i = 0; i < count; ++i) {
+      Song song = MakeDummySong(1);
+      song.set_url(QUrl::fromLocalFile(QString("/tmp/%1/song%2.flac").arg(count).arg(i)));
+      song.set_title(QString("Title %1").arg(i));
+      song.set_song_id(QString("songid-%1-%2").arg(count).arg(i == count - 1 ? 0 : i));
+      songs << song;
+    }
+
+    QSignalSpy added_spy(backend_.get(), &CollectionBackend::SongsDiscovered);
+    backend_->AddOrUpdateSongs(songs);
+
+    // The last song has the song ID of the first, so it updates it instead of adding another row.
+    ASSERT_EQ(1, added_spy.count());
+    EXPECT_EQ(count - 1, added_spy[0][0].value<SongList>().count());
+    const Song song = backend_->GetSongBySongId(QString("songid-%1-0").arg(count));
+    ASSERT_TRUE(song.is_valid());
+    EXPECT_EQ(QString("Title %1").arg(count - 1), song.title());
+  }
+
+  EXPECT_EQ(1 + 199, backend_->GetAllSongs().count());
+
+}
+
+TEST_F(CollectionBackendTest, BulkInsertSongsKeepsOrder) {
+
+  backend_->AddDirectory("/tmp");
+
+  SongList existing_songs;
+  for (int i = 0; i < 10; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/existing%1.flac").arg(i)));
+    existing_songs << song;
+  }
+  QSignalSpy existing_spy(backend_.get(), &CollectionBackend::SongsDiscovered);
+  backend_->AddOrUpdateSongs(existing_songs);
+  ASSERT_EQ(1, existing_spy.count());
+  existing_songs = existing_spy[0][0].value<SongList>();
+
+  // New songs with updates of the existing ones in between, enough for the bulk insert.
+  SongList songs;
+  for (int i = 0; i < 200; ++i) {
+    if (i % 20 == 0) {
+      Song song = existing_songs[i / 20];
+      song.set_title(QString("Updated %1").arg(i));
+      songs << song;
+    }
+    else {
+      Song song = MakeDummySong(1);
+      song.set_url(QUrl::fromLocalFile(QString("/tmp/song%1.flac").arg(i)));
+      song.set_title(QString("Title %1").arg(i));
+      songs << song;
+    }
+  }
+
+  QSignalSpy added_spy(backend_.get(), &CollectionBackend::SongsDiscovered);
+  backend_->AddOrUpdateSongs(songs);
+
+  ASSERT_EQ(1, added_spy.count());
+  const SongList added_songs = added_spy[0][0].value<SongList>();
+  ASSERT_EQ(songs.count(), added_songs.count());
+  QSet<int> ids;
+  for (int i = 0; i < songs.count(); ++i) {
+    EXPECT_EQ(songs[i].url(), added_songs[i].url());
+    const Song song = backend_->GetSongById(added_songs[i].id());
+    EXPECT_EQ(songs[i].url(), song.url());
+    EXPECT_EQ(songs[i].title(), song.title());
+    ids.insert(added_songs[i].id());
+  }
+  EXPECT_EQ(songs.count(), ids.count());
+
+}
+
+TEST_F(CollectionBackendTest, SmartPlaylistsRandomSample) {
+
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (int i = 0; i < 1000; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/song%1.flac").arg(i)));
+    song.set_title(QString("Title %1").arg(i));
+    song.set_artist(i % 10 == 0 ? "Wanted" : "Other");
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+
+  SmartPlaylistSearch search(SmartPlaylistSearch::SearchType::And, SmartPlaylistSearch::TermList() << SmartPlaylistSearchTerm(SmartPlaylistSearchTerm::Field::Artist, SmartPlaylistSearchTerm::Operator::Equals, "Wanted"), SmartPlaylistSearch::SortType::Random, SmartPlaylistSearchTerm::Field::Title, 20);
+
+  // Like a dynamic playlist, every batch leaves out the songs picked before.
+  QSet<int> ids;
+  for (int i = 0; i < 5; ++i) {
+    const SongList found = backend_->SmartPlaylistsFindSongs(search);
+    ASSERT_EQ(20, found.count());
+    for (const Song &song : found) {
+      EXPECT_EQ("Wanted", song.artist());
+      EXPECT_FALSE(ids.contains(song.id()));
+      ids.insert(song.id());
+      search.id_not_in_ << song.id();
+    }
+  }
+
+  // All 100 matching songs are used now.
+  EXPECT_TRUE(backend_->SmartPlaylistsFindSongs(search).isEmpty());
+
+}
+
+TEST_F(CollectionBackendTest, SmartPlaylistsRandomSampleIsUniform) {
+
+  backend_->AddDirectory("/tmp");
+
+  // The matching songs follow long runs of songs that don't match.
+  SongList songs;
+  for (int i = 0; i < 1000; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/song%1.flac").arg(i)));
+    song.set_title(QString("Title %1").arg(i));
+    song.set_artist(i >= 200 ? "Wanted" : "Other");
+    song.set_album(i >= 500 && i < 520 ? "Cluster" : "Other");
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+
+  auto count_picks = [this](const SmartPlaylistSearchTerm::Field field, const QString &value) {
+    const SmartPlaylistSearch search(SmartPlaylistSearch::SearchType::And, SmartPlaylistSearch::TermList() << SmartPlaylistSearchTerm(field, SmartPlaylistSearchTerm::Operator::Equals, value), SmartPlaylistSearch::SortType::Random, SmartPlaylistSearchTerm::Field::Title, 5);
+    QHash<QString, int> picks;
+    for (int i = 0; i < 400; ++i) {
+      const SongList found = backend_->SmartPlaylistsFindSongs(search);
+      EXPECT_EQ(5, found.count());
+      for (const Song &song : found) ++picks[song.title()];
+    }
+    return picks;
+  };
+
+  // Most ROWIDs match, the songs are picked by probing. 2000 picks of 800 songs, 250 for each 80 songs.
+  QHash<QString, int> picks = count_picks(SmartPlaylistSearchTerm::Field::Artist, "Wanted");
+  EXPECT_LT(picks.value("Title 200"), 15);
+  for (int first = 200; first < 1000; first += 80) {
+    int count = 0;
+    for (int i = first; i < first + 80; ++i) count += picks.value(QString("Title %1").arg(i));
+    EXPECT_GT(count, 175) << "Titles " << first << " to " << first + 79;
+    EXPECT_LT(count, 325) << "Titles " << first << " to " << first + 79;
+  }
+
+  // Few ROWIDs match, the songs are picked from the materialized search. 2000 picks of 20 songs, 100 for each.
+  picks = count_picks(SmartPlaylistSearchTerm::Field::Album, "Cluster");
+  EXPECT_EQ(20, picks.count());
+  for (int i = 500; i < 520; ++i) {
+    EXPECT_GT(picks.value(QString("Title %1").arg(i)), 50) << "Title " << i;
+    EXPECT_LT(picks.value(QString("Title %1").arg(i)), 150) << "Title " << i;
+  }
+  {
+    QSqlDatabase db(database_->Connect());
+    SqlQuery q(db);
+    q.prepare("SELECT COUNT(*) FROM smart_playlists_songs");
+    ASSERT_TRUE(q.Exec());
+    ASSERT_TRUE(q.next());
+    EXPECT_EQ(20, q.value(0).toInt());
+  }
+
+  // Searches that can't be materialized pick from the ROWIDs of the matching songs. 2000 picks of 20 songs, 100 for each.
+  SmartPlaylistSearch search(SmartPlaylistSearch::SearchType::All, SmartPlaylistSearch::TermList(), SmartPlaylistSearch::SortType::Random, SmartPlaylistSearchTerm::Field::Title, 5);
+  for (int id = 1; id <= 1000; ++id) {
+    if (id <= 300 || id > 320) search.id_not_in_ << id;
+  }
+  picks.clear();
+  for (int i = 0; i < 400; ++i) {
+    const SongList found = backend_->SmartPlaylistsFindSongs(search);
+    EXPECT_EQ(5, found.count());
+    for (const Song &song : found) {
+      EXPECT_GT(song.id(), 300);
+      EXPECT_LE(song.id(), 320);
+      ++picks[song.title()];
+    }
+  }
+  EXPECT_EQ(20, picks.count());
+  for (const int count : std::as_const(picks)) {
+    EXPECT_GT(count, 50);
+    EXPECT_LT(count, 150);
+  }
+
+}
+
+TEST_F(CollectionBackendTest, SmartPlaylistsMaterialized) {
+
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (int i = 0; i < 100; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/song%1.flac").arg(i)));
+    song.set_title(QString("Title %1").arg(i));
+    song.set_playcount(i % 10);
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+
+  SmartPlaylistSearch search(SmartPlaylistSearch::SearchType::And, SmartPlaylistSearch::TermList() << SmartPlaylistSearchTerm(SmartPlaylistSearchTerm::Field::PlayCount, SmartPlaylistSearchTerm::Operator::GreaterThan, 7), SmartPlaylistSearch::SortType::FieldAsc, SmartPlaylistSearchTerm::Field::Title, -1);
+  search.materialized_ = true;
+
+  auto MaterializedCount = [this]() {
+    QSqlDatabase db(database_->Connect());
+    SqlQuery q(db);
+    q.prepare("SELECT COUNT(*) FROM smart_playlists_songs");
+    EXPECT_TRUE(q.Exec());
+    EXPECT_TRUE(q.next());
+    return q.value(0).toInt();
+  };
+
+  SongList found = backend_->SmartPlaylistsFindSongs(search);
+  EXPECT_EQ(20, found.count());
+  EXPECT_EQ(20, MaterializedCount());
+
+  // Songs are added and removed as their play counts change.
+  const Song first = backend_->GetSongById(1);
+  ASSERT_EQ(0, first.playcount());
+  for (int i = 0; i < 8; ++i) backend_->IncrementPlayCount(first.id());
+  backend_->ResetPlayStatistics(found[0].id());
+  found = backend_->SmartPlaylistsFindSongs(search);
+  EXPECT_EQ(20, found.count());
+  EXPECT_EQ(20, MaterializedCount());
+  EXPECT_TRUE(std::any_of(found.begin(), found.end(), [first](const Song &song) { return song.id() == first.id(); }));
+
+  // Deleted songs are gone.
+  backend_->DeleteSongs(SongList() << first);
+  EXPECT_EQ(19, backend_->SmartPlaylistsFindSongs(search).count());
+  EXPECT_EQ(19, MaterializedCount());
+
+  // Without materializing, the result is the same.
+  search.materialized_ = false;
+  EXPECT_EQ(19, backend_->SmartPlaylistsFindSongs(search).count());
+
+}
+
+TEST_F(CollectionBackendTest, SmartPlaylistsMaterializedPathsAndMTimes) {
+
+  backend_->AddDirectory("/tmp");
+
+  SongList songs;
+  for (int i = 0; i < 10; ++i) {
+    Song song = MakeDummySong(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/song%1.flac").arg(i)));
+    song.set_title(QString("Title %1").arg(i));
+    songs << song;
+  }
+  backend_->AddOrUpdateSongs(songs);
+  songs = backend_->GetAllSongs();
+  ASSERT_EQ(10, songs.count());
+
+  SmartPlaylistSearch path_search(SmartPlaylistSearch::SearchType::And, SmartPlaylistSearch::TermList() << SmartPlaylistSearchTerm(SmartPlaylistSearchTerm::Field::Filepath, SmartPlaylistSearchTerm::Operator::StartsWith, "/moved"), SmartPlaylistSearch::SortType::FieldAsc, SmartPlaylistSearchTerm::Field::Title, -1);
+  path_search.materialized_ = true;
+  const qint64 date = QDateTime(QDate(2020, 1, 1), QTime(0, 0)).toSecsSinceEpoch();
+  SmartPlaylistSearch mtime_search(SmartPlaylistSearch::SearchType::And, SmartPlaylistSearch::TermList() << SmartPlaylistSearchTerm(SmartPlaylistSearchTerm::Field::DateModified, SmartPlaylistSearchTerm::Operator::GreaterThan, date), SmartPlaylistSearch::SortType::FieldAsc, SmartPlaylistSearchTerm::Field::Title, -1);
+  mtime_search.materialized_ = true;
+
+  EXPECT_TRUE(backend_->SmartPlaylistsFindSongs(path_search).isEmpty());
+  EXPECT_TRUE(backend_->SmartPlaylistsFindSongs(mtime_search).isEmpty());
+
+  // Only the modification times of these songs change.
+  SongList touched_songs = songs.mid(0, 3);
+  for (Song &song : touched_songs) song.set_mtime(date + 24 * 60 * 60);
+  backend_->UpdateMTimesOnly(touched_songs);
+  EXPECT_EQ(3, backend_->SmartPlaylistsFindSongs(mtime_search).count());
+
+  // The songs move with their directory.
+  backend_->ChangeDirPath(1, "/tmp", "/moved");
+  EXPECT_EQ(10, backend_->SmartPlaylistsFindSongs(path_search).count());
+
+}
+
+TEST_F(CollectionBackendTest, SmartPlaylistsMaterializedStaysWhileUsed) {
+
+  backend_->AddDirectory("/tmp");
+
+  Song song = MakeDummySong(1);
+  song.set_url(QUrl::fromLocalFile("/tmp/song.flac"));
+  song.set_title("Title");
+  backend_->AddOrUpdateSongs(SongList() << song);
+
+  SmartPlaylistSearch search(SmartPlaylistSearch::SearchType::And, SmartPlaylistSearch::TermList() << SmartPlaylistSearchTerm(SmartPlaylistSearchTerm::Field::Title, SmartPlaylistSearchTerm::Operator::Equals, "Title"), SmartPlaylistSearch::SortType::FieldAsc, SmartPlaylistSearchTerm::Field::Title, -1);
+  search.materialized_ = true;
+  ASSERT_EQ(1, backend_->SmartPlaylistsFindSongs(search).count());
+
+  QSqlDatabase db(database_->Connect());
+  SqlQuery q(db);
+
+  // Every use counts, not just the first one since startup.
+  ASSERT_TRUE(q.exec("UPDATE smart_playlists_materialized SET last_used = 0"));
+  ASSERT_EQ(1, backend_->SmartPlaylistsFindSongs(search).count());
+  ASSERT_TRUE(q.exec("SELECT last_used FROM smart_playlists_materialized"));
+  ASSERT_TRUE(q.next());
+  EXPECT_GT(q.value(0).toLongLong(), 0);
+
+  // A search dropped meanwhile is filled again.
+  ASSERT_TRUE(q.exec("DELETE FROM smart_playlists_songs"));
+  ASSERT_TRUE(q.exec("DELETE FROM smart_playlists_materialized"));
+  EXPECT_EQ(1, backend_->SmartPlaylistsFindSongs(search).count());
+
+}
+
+TEST(CollectionBackendWALTest, ReadersNotBlockedByWriter) {
+
+  static const int kSongCount = 1000;
+
+  QTemporaryDir temp_dir;
+  ASSERT_TRUE(temp_dir.isValid());
+
+  std::unique_ptr<Database> database = std::make_unique<Database>(nullptr, nullptr, temp_dir.filePath("strawberry.db"));
+  ASSERT_TRUE(database->wal_enabled());
+
+  CollectionBackend backend;
+  backend.Init(database.get(), nullptr, Song::Source::Collection, SCollection::kSongsTable, SCollection::kFtsTable, SCollection::kDirsTable, SCollection::kSubdirsTable);
+  backend.AddDirectory("/tmp");
+
+  SongList songs;
+  songs.reserve(kSongCount);
+  for (int i = 0; i < kSongCount; ++i) {
+    Song song;
+    song.set_directory_id(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/song%1.flac").arg(i)));
+    song.set_title(QString("Title %1").arg(i));
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    songs << song;
+  }
+  backend.AddOrUpdateSongs(songs);
+
+  const QString count_changed = QString("SELECT COUNT(*) FROM %1 WHERE title = 'Changed'").arg(SCollection::kSongsTable);
+
+  // The writer holds the database mutex and an open write transaction until the read is done.
+  QSemaphore in_transaction;
+  QSemaphore read_finished;
+  QSemaphore read_done;
+  QFuture<void> writer = QtConcurrent::run([&database, &in_transaction, &read_done]() {
+    {
+      QMutexLocker l(database->Mutex());
+      QSqlDatabase db(database->Connect());
+      ScopedTransaction transaction(&db);
+      SqlQuery q(db);
+      q.prepare(QString("UPDATE %1 SET title = 'Changed'").arg(SCollection::kSongsTable));
+      EXPECT_TRUE(q.Exec());
+      in_transaction.release();
+      // Don't wait forever if the reader is stuck behind the writer.
+      read_done.tryAcquire(1, 30000);
+      transaction.Commit();
+    }
+    database->Close();
+  });
+  ASSERT_TRUE(in_transaction.tryAcquire(1, 30000));
+
+  std::atomic<int> changed_while_writing(-1);
+  QFuture<void> reader = QtConcurrent::run([&database, &count_changed, &changed_while_writing, &read_finished]() {
+    {
+      DatabaseReadLocker l(database.get());
+      SqlQuery q(l.db());
+      q.prepare(count_changed);
+      if (q.Exec() && q.next()) changed_while_writing = q.value(0).toInt();
+    }
+    database->Close();
+    read_finished.release();
+  });
+
+  // The read completes while the write transaction is still open, and doesn't see its changes.
+  const bool read_completed = read_finished.tryAcquire(1, 10000);
+  read_done.release();
+  writer.waitForFinished();
+  reader.waitForFinished();
+  EXPECT_TRUE(read_completed);
+  EXPECT_EQ(0, changed_while_writing);
+
+  {
+    DatabaseReadLocker l(database.get());
+    SqlQuery q(l.db());
+    q.prepare(count_changed);
+    ASSERT_TRUE(q.Exec());
+    ASSERT_TRUE(q.next());
+    EXPECT_EQ(kSongCount, q.value(0).toInt());
+  }
+
+  database->Close();
+
+}
+
 } // namespace
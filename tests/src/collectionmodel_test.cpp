@@ -20,14 +20,18 @@
  */
 
 #include <memory>
+#include <optional>
 
 #include <gtest/gtest.h>
 
 #include <QMap>
 #include <QString>
+#include <QStringList>
 #include <QUrl>
 #include <QThread>
 #include <QSignalSpy>
+#include <QTest>
+#include <QTemporaryDir>
 #include <QSortFilterProxyModel>
 #include <QtDebug>
 
@@ -38,6 +42,9 @@
 #include "collection/collectionmodel.h"
 #include "collection/collectionbackend.h"
 #include "collection/collection.h"
+#include "collection/collectionfilteroptions.h"
+#include "collection/collectionqueryoptions.h"
+#include "collection/collectionsongindex.h"
 
 // clazy:excludeall=non-pod-global-static,returning-void-expression
 
@@ -346,6 +353,180 @@ TEST_F(CollectionModelTest, RemoveEmptyArtists) {
 
 }
 
+TEST_F(CollectionModelTest, SongIndexMatchesDatabase) {
+
+  Song compilation_song;
+  compilation_song.Init("Title", "Artist", "Compilation", 123);
+  compilation_song.set_compilation(true);
+  compilation_song.set_url(QUrl("file:///tmp/compilation"));
+  AddSong(compilation_song);
+  AddSong("Title 1", "Artist 1", "Album 1", 123);
+  AddSong("Title 2", "Artist 1", "Album 2", 123);
+  AddSong("Title 3", "Artist 2", "Album 1", 123);
+
+  std::unique_ptr<CollectionModel> index_model = std::make_unique<CollectionModel>(backend_.get(), nullptr);
+  index_model->set_use_song_index(true);
+
+  model_->Init(false);
+  index_model->Init(false);
+
+  // The rows are not sorted, so compare them by key.
+  auto root_rows = [](CollectionModel *model) {
+    QMap<QString, int> rows;
+    for (int i = 0; i < model->rowCount(QModelIndex()); ++i) {
+      const QModelIndex idx = model->index(i, 0, QModelIndex());
+      rows.insert(idx.data(CollectionModel::Role_Key).toString() + "|" + idx.data().toString(), model->GetChildSongs(idx).count());
+    }
+    return rows;
+  };
+
+  ASSERT_EQ(model_->rowCount(QModelIndex()), index_model->rowCount(QModelIndex()));
+  EXPECT_EQ(root_rows(model_.get()), root_rows(index_model.get()));
+
+  // Changes from the backend should be picked up by the index.
+  AddSong("Title 4", "Artist 3", "Album 3", 123);
+  index_model->Reset();
+  model_->Reset();
+  EXPECT_EQ(root_rows(model_.get()), root_rows(index_model.get()));
+
+}
+
+TEST_F(CollectionModelTest, SongIndexFilterText) {
+
+  CollectionSongIndex index;
+  index.set_enabled(true);
+
+  SongList songs;
+  Song song1;
+  song1.Init("Sunday Bloody Sunday", "U2", "War", 123);
+  song1.set_id(1);
+  song1.set_genre("Rock");
+  songs << song1;
+  Song song2;
+  song2.Init("Bohemian Rhapsody", "Queen", "A Night at the Opera", 123);
+  song2.set_id(2);
+  song2.set_genre("Rock");
+  songs << song2;
+  Song song3;
+  song3.Init("Café del Mar", "Energy 52", "Café del Mar", 123);
+  song3.set_id(3);
+  song3.set_genre("Trance");
+  songs << song3;
+
+  // Changes before the index is loaded are dropped, the loaded songs replace them.
+  Song song4;
+  song4.Init("Unloaded", "Unloaded", "Unloaded", 123);
+  song4.set_id(4);
+  index.AddOrUpdateSongs(SongList() << song4);
+
+  index.EnsureLoaded([songs]() { return songs; });
+  ASSERT_EQ(index.song_count(), 3);
+
+  auto query = [&index](const QString &filter_text) {
+    CollectionFilterOptions filter_options;
+    filter_options.set_filter_text(filter_text);
+    CollectionQueryOptions query_options;
+    query_options.set_column_spec("%songs_table.ROWID, " + Song::kColumnSpec);
+    SongList found;
+    EXPECT_TRUE(index.Query(filter_options, query_options, std::optional<bool>(), &found));
+    return found;
+  };
+
+  EXPECT_EQ(query("rock").count(), 2);
+  EXPECT_EQ(query("bloody sun").count(), 1);
+  // The whole song comes from the index, not just its ID.
+  ASSERT_EQ(query("bloody sun").count(), 1);
+  EXPECT_EQ(query("bloody sun")[0].id(), 1);
+  EXPECT_EQ(query("bloody sun")[0].title(), "Sunday Bloody Sunday");
+  EXPECT_EQ(query("artist:queen").count(), 1);
+  EXPECT_EQ(query("title:queen").count(), 0);
+  EXPECT_EQ(query("cafe").count(), 1);
+  EXPECT_EQ(query("night-at").count(), 1);
+  EXPECT_EQ(query("night-opera").count(), 0);
+
+  // Play counts change without touching the indexed columns.
+  Song played_song1 = song1;
+  played_song1.set_playcount(5);
+  index.UpdateSongs(SongList() << played_song1);
+  EXPECT_EQ(query("bloody sun")[0].playcount(), 5);
+
+  index.RemoveSongs(SongList() << song1);
+  EXPECT_EQ(query("rock").count(), 1);
+
+  CollectionFilterOptions filter_options;
+  CollectionQueryOptions query_options;
+  query_options.set_column_spec("DISTINCT genre");
+  SongList containers;
+  ASSERT_TRUE(index.Query(filter_options, query_options, std::optional<bool>(), &containers));
+  EXPECT_EQ(containers.count(), 2);
+  EXPECT_TRUE(containers[0].title().isEmpty());
+
+}
+
+TEST(CollectionModelFilterTest, FilterTextUpdatesRows) {
+
+  // Filter updates run in a background thread, which can't see an in-memory database.
+  QTemporaryDir temp_dir;
+  ASSERT_TRUE(temp_dir.isValid());
+
+  std::unique_ptr<Database> database = std::make_unique<Database>(nullptr, nullptr, temp_dir.filePath("strawberry.db"));
+  CollectionBackend backend;
+  backend.Init(database.get(), nullptr, Song::Source::Collection, SCollection::kSongsTable, SCollection::kFtsTable, SCollection::kDirsTable, SCollection::kSubdirsTable);
+  backend.AddDirectory("/tmp");
+
+  SongList songs;
+  const QStringList artists = QStringList() << "Artist 1" << "Artist 2" << "Foo";
+  for (int i = 0; i < artists.count(); ++i) {
+    Song song;
+    song.Init("Title", artists[i], "Album", 123);
+    song.set_directory_id(1);
+    song.set_url(QUrl::fromLocalFile(QString("/tmp/song%1.flac").arg(i)));
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    songs << song;
+  }
+  backend.AddOrUpdateSongs(songs);
+
+  CollectionModel model(&backend, nullptr);
+  model.Init(false);
+  // Two dividers and three artists.
+  ASSERT_EQ(5, model.rowCount(QModelIndex()));
+
+  QSignalSpy reset_spy(&model, &CollectionModel::modelReset);
+  QSignalSpy removed_spy(&model, &CollectionModel::rowsRemoved);
+  QSignalSpy inserted_spy(&model, &CollectionModel::rowsInserted);
+
+  auto wait_for_filter = [&model]() {
+    for (int i = 0; i < 1000 && model.filter_update_running(); ++i) {
+      QTest::qWait(10);
+    }
+    return !model.filter_update_running();
+  };
+
+  model.SetFilterText("fo");
+  ASSERT_TRUE(wait_for_filter());
+  EXPECT_EQ(2, model.rowCount(QModelIndex()));
+  EXPECT_LT(0, removed_spy.count());
+  EXPECT_EQ(0, inserted_spy.count());
+
+  // Narrowing the filter keeps the matching rows.
+  removed_spy.clear();
+  model.SetFilterText("foo");
+  ASSERT_TRUE(wait_for_filter());
+  EXPECT_EQ(0, removed_spy.count());
+  EXPECT_EQ(0, inserted_spy.count());
+  EXPECT_EQ(2, model.rowCount(QModelIndex()));
+
+  model.SetFilterText("");
+  ASSERT_TRUE(wait_for_filter());
+  EXPECT_EQ(5, model.rowCount(QModelIndex()));
+  EXPECT_LT(0, inserted_spy.count());
+
+  EXPECT_EQ(0, reset_spy.count());
+
+}
+
 // Test to check that the container nodes are created identical and unique all through the model with all possible collection groupings.
 // model1 - Nodes are created from a complete reset done through lazy-loading.
 // model2 - Initial container nodes are created in SongsDiscovered.
@@ -0,0 +1,175 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "collection/collectionsnapshot.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+class CollectionSnapshotTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.isValid());
+    filename_ = temp_dir_.filePath("collectionsnapshot.dat");
+    ASSERT_TRUE(QDir(temp_dir_.path()).mkdir("a"));
+    ASSERT_TRUE(QDir(temp_dir_.path()).mkdir("b"));
+    path_a_ = temp_dir_.filePath("a");
+    path_b_ = temp_dir_.filePath("b");
+  }
+
+  static CollectionSnapshot::Entry OnDisk(const QString &path) {
+    CollectionSnapshot::Entry entry;
+    EXPECT_TRUE(CollectionSnapshot::Stat(path, &entry));
+    return entry;
+  }
+
+  QTemporaryDir temp_dir_;
+  QString filename_;
+  QString path_a_;
+  QString path_b_;
+};
+
+TEST_F(CollectionSnapshotTest, SaveAndLoad) {
+
+  {
+    CollectionSnapshot snapshot(filename_);
+    EXPECT_FALSE(snapshot.Load());
+    snapshot.Update(path_a_);
+    snapshot.Update(path_b_);
+    QMap<int, QStringList> journal;
+    journal[1] << path_a_ << path_b_;
+    journal[2] << path_b_;
+    snapshot.SetJournal(journal);
+    ASSERT_TRUE(snapshot.Save());
+  }
+
+  CollectionSnapshot snapshot(filename_);
+  ASSERT_TRUE(snapshot.Load());
+
+  // The snapshot is removed when loaded, so it is not used after a crash.
+  EXPECT_FALSE(QFile::exists(filename_));
+
+  EXPECT_EQ(QStringList() << path_a_ << path_b_, snapshot.TakeJournal(1));
+  EXPECT_EQ(QStringList() << path_b_, snapshot.TakeJournal(2));
+  EXPECT_TRUE(snapshot.TakeJournal(1).isEmpty());
+  EXPECT_TRUE(snapshot.TakeJournal(3).isEmpty());
+
+  // The loaded entries match the directories on disk.
+  EXPECT_FALSE(snapshot.ChangedSinceScan(path_a_, OnDisk(path_a_)));
+  EXPECT_FALSE(snapshot.ChangedSinceScan(path_b_, OnDisk(path_b_)));
+
+}
+
+TEST_F(CollectionSnapshotTest, LoadIgnoresUnknownFormat) {
+
+  QFile file(filename_);
+  ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+  ASSERT_GT(file.write("not a snapshot"), 0);
+  file.close();
+
+  CollectionSnapshot snapshot(filename_);
+  EXPECT_FALSE(snapshot.Load());
+  EXPECT_FALSE(QFile::exists(filename_));
+
+}
+
+TEST_F(CollectionSnapshotTest, ChangedSinceScan) {
+
+  CollectionSnapshot snapshot(filename_);
+  snapshot.Update(path_a_);
+
+  const CollectionSnapshot::Entry entry = OnDisk(path_a_);
+  EXPECT_FALSE(snapshot.ChangedSinceScan(path_a_, entry));
+
+  CollectionSnapshot::Entry changed = entry;
+  changed.mtime = entry.mtime + 1;
+  EXPECT_TRUE(snapshot.ChangedSinceScan(path_a_, changed));
+
+  changed = entry;
+  changed.size = entry.size + 1;
+  EXPECT_TRUE(snapshot.ChangedSinceScan(path_a_, changed));
+
+  // A directory replaced by another one with the same mtime.
+  changed = entry;
+  changed.inode = entry.inode + 1;
+  EXPECT_TRUE(snapshot.ChangedSinceScan(path_a_, changed));
+
+  // Unknown directories are recorded as they are on disk.
+  changed = OnDisk(path_b_);
+  EXPECT_FALSE(snapshot.ChangedSinceScan(path_b_, changed));
+  changed.inode = changed.inode + 1;
+  EXPECT_TRUE(snapshot.ChangedSinceScan(path_b_, changed));
+
+  // Removed directories are no longer in the snapshot.
+  snapshot.Remove(path_a_);
+  changed = entry;
+  changed.inode = entry.inode + 1;
+  EXPECT_FALSE(snapshot.ChangedSinceScan(path_a_, changed));
+
+}
+
+TEST_F(CollectionSnapshotTest, SavePrunesDirectoriesNotScanned) {
+
+  {
+    CollectionSnapshot snapshot(filename_);
+    snapshot.Update(path_a_);
+    snapshot.Update(path_b_);
+    ASSERT_TRUE(snapshot.Save());
+  }
+
+  // Nothing was scanned, so all entries are kept.
+  {
+    CollectionSnapshot snapshot(filename_);
+    ASSERT_TRUE(snapshot.Load());
+    ASSERT_TRUE(snapshot.Save());
+  }
+
+  // Only "a" is scanned, "b" vanished outside the watcher.
+  {
+    CollectionSnapshot snapshot(filename_);
+    ASSERT_TRUE(snapshot.Load());
+    EXPECT_FALSE(snapshot.ChangedSinceScan(path_a_, OnDisk(path_a_)));
+    ASSERT_TRUE(snapshot.Save());
+  }
+
+  CollectionSnapshot snapshot(filename_);
+  ASSERT_TRUE(snapshot.Load());
+
+  CollectionSnapshot::Entry changed = OnDisk(path_a_);
+  changed.inode = changed.inode + 1;
+  EXPECT_TRUE(snapshot.ChangedSinceScan(path_a_, changed));
+
+  changed = OnDisk(path_b_);
+  changed.inode = changed.inode + 1;
+  EXPECT_FALSE(snapshot.ChangedSinceScan(path_b_, changed));
+
+}
+
+}  // namespace
@@ -0,0 +1,140 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <QDir>
+#include <QTemporaryDir>
+
+#include "core/song.h"
+#include "core/database.h"
+#include "core/taskmanager.h"
+#include "collection/collection.h"
+#include "collection/collectionbackend.h"
+#include "collection/collectiondirectory.h"
+#include "collection/collectionwatcher.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+class CollectionWatcherTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.isValid());
+    root_ = temp_dir_.filePath("music");
+    // Enough subdirectories to be split over the scan threads, with deeper ones found while scanning.
+    for (int artist = 0; artist < 6; ++artist) {
+      for (int album = 0; album < 3; ++album) {
+        ASSERT_TRUE(QDir().mkpath(QString("%1/Artist %2/Album %3/CD 1").arg(root_).arg(artist).arg(album)));
+      }
+    }
+  }
+
+  struct ScanResult {
+    QStringList deleted_songs;
+    QStringList discovered_subdirs;
+  };
+
+  // Scans the directory as a new directory, with songs in the database whose files are gone.
+  ScanResult Scan(const int thread_count) {
+
+    ScanResult result;
+
+    std::unique_ptr<Database> database = std::make_unique<Database>(nullptr, nullptr, temp_dir_.filePath(QString("collection%1.db").arg(thread_count)));
+    std::unique_ptr<CollectionBackend> backend = std::make_unique<CollectionBackend>();
+    backend->Init(database.get(), nullptr, Song::Source::Collection, SCollection::kSongsTable, SCollection::kFtsTable, SCollection::kDirsTable, SCollection::kSubdirsTable);
+    backend->AddDirectory(root_);
+
+    SongList songs;
+    const QStringList subdirs = QStringList() << QString() << "/Artist 0" << "/Artist 2/Album 1" << "/Artist 3/Album 0/CD 1" << "/Artist 5/Album 2";
+    for (const QString &subdir : subdirs) {
+      for (int i = 0; i < 2; ++i) {
+        Song song;
+        song.set_directory_id(1);
+        song.set_url(QUrl::fromLocalFile(QString("%1%2/song%3.flac").arg(root_, subdir).arg(i)));
+        song.set_mtime(1);
+        song.set_ctime(1);
+        song.set_filesize(1);
+        songs << song;
+      }
+    }
+    backend->AddOrUpdateSongs(songs);
+
+    TaskManager task_manager;
+    CollectionWatcher watcher(Song::Source::Device);
+    watcher.set_backend(backend.get());
+    watcher.set_task_manager(&task_manager);
+    watcher.set_scan_thread_count(thread_count);
+
+    QObject::connect(&watcher, &CollectionWatcher::SongsDeleted, &watcher, [&result](const SongList &deleted_songs) {
+      for (const Song &song : deleted_songs) result.deleted_songs << song.url().toLocalFile();
+    });
+    QObject::connect(&watcher, &CollectionWatcher::SubdirsDiscovered, &watcher, [&result](const CollectionSubdirectoryList &discovered_subdirs) {
+      for (const CollectionSubdirectory &subdir : discovered_subdirs) result.discovered_subdirs << subdir.path;
+    });
+
+    CollectionDirectory dir;
+    dir.id = 1;
+    dir.path = root_;
+    watcher.AddDirectory(dir, CollectionSubdirectoryList());
+
+    backend->Close();
+
+    return result;
+
+  }
+
+  QTemporaryDir temp_dir_;
+  QString root_;
+};
+
+TEST_F(CollectionWatcherTest, ParallelScanMatchesSerialScan) {
+
+  const ScanResult serial = Scan(1);
+  ASSERT_EQ(10, serial.deleted_songs.count());
+  ASSERT_EQ(1 + 6 + 6 * 3 + 6 * 3, serial.discovered_subdirs.count());
+
+  // Every subdirectory comes right after its parent, as found when recursing into them.
+  EXPECT_EQ(root_, serial.discovered_subdirs.first());
+  for (int i = 1; i < serial.discovered_subdirs.count(); ++i) {
+    const QString &subdir = serial.discovered_subdirs[i];
+    const QString parent = subdir.section('/', 0, -2);
+    EXPECT_TRUE(serial.discovered_subdirs.mid(0, i).contains(parent)) << subdir.toStdString();
+    if (subdir.endsWith("/CD 1")) {
+      EXPECT_EQ(parent, serial.discovered_subdirs[i - 1]);
+    }
+  }
+
+  for (const int thread_count : {2, 4, 8}) {
+    const ScanResult parallel = Scan(thread_count);
+    EXPECT_EQ(serial.deleted_songs, parallel.deleted_songs) << thread_count << " threads";
+    EXPECT_EQ(serial.discovered_subdirs, parallel.discovered_subdirs) << thread_count << " threads";
+  }
+
+}
+
+}  // namespace
@@ -0,0 +1,111 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include <QtGlobal>
+#include <QtMath>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+
+#include "core/logging.h"
+#include "analyzer/fht.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+std::vector<float> RandomSamples(const int count) {
+
+  QRandomGenerator generator(42);
+  std::vector<float> samples(static_cast<size_t>(count));
+  for (float &sample : samples) sample = static_cast<float>(generator.bounded(2.0) - 1.0);
+  return samples;
+
+}
+
+TEST(FHTTest, MatchesDiscreteHartleyTransform) {
+
+  for (uint exponent = 3; exponent <= 10; ++exponent) {
+    const int n = 1 << exponent;
+    const std::vector<float> samples = RandomSamples(n);
+
+    std::vector<float> result = samples;
+    FHT fht(exponent);
+    fht.transform(result.data());
+
+    for (int k = 0; k < n; ++k) {
+      double expected = 0.0;
+      for (int i = 0; i < n; ++i) {
+        const double t = 2.0 * M_PI * static_cast<double>(i) * static_cast<double>(k) / static_cast<double>(n);
+        expected += static_cast<double>(samples[static_cast<size_t>(i)]) * (cos(t) + sin(t));
+      }
+      ASSERT_NEAR(result[static_cast<size_t>(k)], expected, 1e-3) << "Size" << n << "bin" << k;
+    }
+  }
+
+}
+
+TEST(FHTTest, PowerOfSine) {
+
+  // A sine at bin 16 should put (almost) all the power in that bin.
+  constexpr uint kExponent = 9;
+  constexpr int kSize = 1 << kExponent;
+  std::vector<float> samples(kSize);
+  for (int i = 0; i < kSize; ++i) samples[static_cast<size_t>(i)] = static_cast<float>(sin(2.0 * M_PI * 16.0 * i / kSize));
+
+  FHT fht(kExponent);
+  fht.power(samples.data());
+
+  for (int i = 0; i < kSize / 2; ++i) {
+    if (i == 16) {
+      EXPECT_NEAR(samples[static_cast<size_t>(i)], kSize * kSize / 4, 1.0);
+    }
+    else {
+      EXPECT_NEAR(samples[static_cast<size_t>(i)], 0.0, 1e-3);
+    }
+  }
+
+}
+
+TEST(FHTTest, DISABLED_Benchmark) {
+
+  constexpr int kIterations = 20000;
+
+  for (uint exponent = 9; exponent <= 13; ++exponent) {
+    const int n = 1 << exponent;
+    const std::vector<float> samples = RandomSamples(n);
+    std::vector<float> buffer(static_cast<size_t>(n));
+    FHT fht(exponent);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < kIterations; ++i) {
+      std::copy(samples.begin(), samples.end(), buffer.begin());
+      fht.power2(buffer.data());
+    }
+    qLog(Info) << "Size" << n << "power spectrum:" << static_cast<double>(timer.nsecsElapsed()) / kIterations / 1000.0 << "us";
+  }
+
+}
+
+}  // namespace
@@ -0,0 +1,173 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include <gst/gst.h>
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+#include <QTemporaryDir>
+#include <QUrl>
+#include <QVariant>
+#include <QElapsedTimer>
+
+#include "core/logging.h"
+#include "engine/gstaudiobinpool.h"
+#include "engine/gstenginepipeline.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+GstAudioBin NewAudioBin() {
+
+  GstAudioBin audiobin;
+  audiobin.bin = gst_bin_new(nullptr);
+  gst_object_ref_sink(audiobin.bin);
+  return audiobin;
+
+}
+
+class GstAudioBinPoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    gst_init(nullptr, nullptr);
+  }
+};
+
+TEST_F(GstAudioBinPoolTest, TakesBinForKey) {
+
+  GstAudioBinPool pool;
+  const GstAudioBin audiobin = NewAudioBin();
+  pool.Return("pulsesink", audiobin);
+
+  GstAudioBin taken;
+  EXPECT_FALSE(pool.Take("alsasink", &taken));
+  ASSERT_TRUE(pool.Take("pulsesink", &taken));
+  EXPECT_EQ(taken.bin, audiobin.bin);
+  EXPECT_FALSE(pool.Take("pulsesink", &taken));
+  EXPECT_EQ(pool.hits(), 1);
+  EXPECT_EQ(pool.misses(), 2);
+
+  gst_object_unref(taken.bin);
+
+}
+
+TEST_F(GstAudioBinPoolTest, DropsOldestWhenFull) {
+
+  GstAudioBinPool pool(2);
+  const GstAudioBin first = NewAudioBin();
+  const GstAudioBin second = NewAudioBin();
+  const GstAudioBin third = NewAudioBin();
+  pool.Return("a", first);
+  pool.Return("b", second);
+  pool.Return("c", third);
+  EXPECT_EQ(pool.size(), 2);
+
+  GstAudioBin taken;
+  EXPECT_FALSE(pool.Take("a", &taken));
+  ASSERT_TRUE(pool.Take("c", &taken));
+  EXPECT_EQ(taken.bin, third.bin);
+  gst_object_unref(taken.bin);
+
+}
+
+// A second of silence as 16 bit stereo WAV.
+bool WriteSilence(const QString &filename) {
+
+  constexpr quint32 kRate = 44100;
+  constexpr quint16 kChannels = 2;
+  constexpr quint16 kBitsPerSample = 16;
+  constexpr quint32 kDataSize = kRate * kChannels * kBitsPerSample / 8;
+
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly)) return false;
+  QDataStream s(&file);
+  s.setByteOrder(QDataStream::LittleEndian);
+  s.writeRawData("RIFF", 4);
+  s << static_cast<quint32>(36 + kDataSize);
+  s.writeRawData("WAVEfmt ", 8);
+  s << static_cast<quint32>(16) << static_cast<quint16>(1) << kChannels << kRate << static_cast<quint32>(kRate * kChannels * kBitsPerSample / 8) << static_cast<quint16>(kChannels * kBitsPerSample / 8) << kBitsPerSample;
+  s.writeRawData("data", 4);
+  s << kDataSize;
+  s.writeRawData(QByteArray(static_cast<int>(kDataSize), 0).constData(), static_cast<int>(kDataSize));
+  return true;
+
+}
+
+// Creates a pipeline for the track and waits until it prerolled, the way GstEngine does it on a track change.
+qint64 ChangeTrack(std::shared_ptr<GstEnginePipeline> &pipeline, const QByteArray &url, std::shared_ptr<GstAudioBinPool> audiobin_pool) {
+
+  QElapsedTimer timer;
+  timer.start();
+
+  std::shared_ptr<GstEnginePipeline> next = std::make_shared<GstEnginePipeline>();
+  next->set_output_device("fakesink", QVariant());
+  next->set_equalizer_enabled(true);
+  next->set_stereo_balancer_enabled(true);
+  next->set_fading_enabled(true);
+  if (audiobin_pool) next->set_audiobin_pool(audiobin_pool);
+
+  QString error;
+  if (!next->InitFromUrl(url, QUrl(QString::fromUtf8(url)), 0, error)) {
+    qLog(Error) << error;
+    return -1;
+  }
+  next->SetState(GST_STATE_PAUSED).waitForFinished();
+  while (next->state() != GST_STATE_PAUSED && timer.elapsed() < 5000) {}
+
+  pipeline = next;
+
+  return timer.nsecsElapsed();
+
+}
+
+TEST_F(GstAudioBinPoolTest, DISABLED_BenchmarkTrackChange) {
+
+  constexpr int kIterations = 100;
+
+  QTemporaryDir temp_dir;
+  ASSERT_TRUE(temp_dir.isValid());
+  const QString filename = temp_dir.path() + "/silence.wav";
+  ASSERT_TRUE(WriteSilence(filename));
+  const QByteArray url = QUrl::fromLocalFile(filename).toEncoded();
+
+  for (const bool use_pool : { false, true }) {
+    std::shared_ptr<GstAudioBinPool> audiobin_pool = use_pool ? std::make_shared<GstAudioBinPool>() : nullptr;
+    std::shared_ptr<GstEnginePipeline> pipeline;
+    qint64 total_nanosec = 0;
+    for (int i = 0; i < kIterations; ++i) {
+      const qint64 nanosec = ChangeTrack(pipeline, url, audiobin_pool);
+      ASSERT_GE(nanosec, 0);
+      total_nanosec += nanosec;
+    }
+    pipeline.reset();
+    qLog(Info) << (use_pool ? "With" : "Without") << "audiobin pool, track change:" << static_cast<double>(total_nanosec) / kIterations / 1000.0 << "us"
+               << "pool hits:" << (audiobin_pool ? audiobin_pool->hits() : 0);
+  }
+
+}
+
+}  // namespace
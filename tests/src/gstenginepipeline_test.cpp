@@ -0,0 +1,77 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <gst/gst.h>
+
+#include <QtGlobal>
+
+#include "engine/gstenginepipeline.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+// 48 kHz stereo S16, buffers of 960 frames (20 ms) starting at 1 second.
+constexpr int kRate = 48000;
+constexpr int kBytesPerFrame = 4;
+constexpr gsize kBufferSize = 960 * kBytesPerFrame;
+constexpr quint64 kStartTime = GST_SECOND;
+
+TEST(GstEnginePipelineTest, BufferBeforeEndOffset) {
+
+  EXPECT_EQ(kBufferSize, GstEnginePipeline::BufferSizeAtEndOffset(kStartTime, 2 * GST_SECOND, kRate, kBytesPerFrame, kBufferSize));
+
+  // Ending exactly at the end offset.
+  EXPECT_EQ(kBufferSize, GstEnginePipeline::BufferSizeAtEndOffset(kStartTime, kStartTime + 20 * GST_MSECOND, kRate, kBytesPerFrame, kBufferSize));
+
+}
+
+TEST(GstEnginePipelineTest, BufferAcrossEndOffset) {
+
+  // 10 ms are 480 frames.
+  EXPECT_EQ(480U * kBytesPerFrame, GstEnginePipeline::BufferSizeAtEndOffset(kStartTime, kStartTime + 10 * GST_MSECOND, kRate, kBytesPerFrame, kBufferSize));
+
+  // Only whole frames are kept.
+  EXPECT_EQ(480U * kBytesPerFrame, GstEnginePipeline::BufferSizeAtEndOffset(kStartTime, kStartTime + 10 * GST_MSECOND + 20 * GST_USECOND, kRate, kBytesPerFrame, kBufferSize));
+  EXPECT_EQ(static_cast<gsize>(kBytesPerFrame), GstEnginePipeline::BufferSizeAtEndOffset(kStartTime, kStartTime + GST_SECOND / kRate + 1, kRate, kBytesPerFrame, kBufferSize));
+
+  // Less than one frame.
+  EXPECT_EQ(0U, GstEnginePipeline::BufferSizeAtEndOffset(kStartTime, kStartTime + 1, kRate, kBytesPerFrame, kBufferSize));
+
+}
+
+TEST(GstEnginePipelineTest, BufferAfterEndOffset) {
+
+  EXPECT_EQ(0U, GstEnginePipeline::BufferSizeAtEndOffset(kStartTime, kStartTime, kRate, kBytesPerFrame, kBufferSize));
+  EXPECT_EQ(0U, GstEnginePipeline::BufferSizeAtEndOffset(kStartTime, kStartTime - 10 * GST_MSECOND, kRate, kBytesPerFrame, kBufferSize));
+  EXPECT_EQ(0U, GstEnginePipeline::BufferSizeAtEndOffset(2 * kStartTime, 0, kRate, kBytesPerFrame, kBufferSize));
+
+}
+
+TEST(GstEnginePipelineTest, BufferWithoutCaps) {
+
+  // Without the caps the buffer can't be clipped, so it is dropped.
+  EXPECT_EQ(0U, GstEnginePipeline::BufferSizeAtEndOffset(kStartTime, 2 * GST_SECOND, 0, kBytesPerFrame, kBufferSize));
+  EXPECT_EQ(0U, GstEnginePipeline::BufferSizeAtEndOffset(kStartTime, 2 * GST_SECOND, kRate, 0, kBufferSize));
+
+}
+
+}  // namespace
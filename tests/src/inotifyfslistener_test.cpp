@@ -0,0 +1,152 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <sys/time.h>
+#include <cerrno>
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QObject>
+#include <QMetaObject>
+#include <QSet>
+#include <QString>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+
+#include "core/inotifyfslistener.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+// Fails to add watches for some paths, as when the inotify watch limit is reached.
+class FailingInotifyFSListener : public InotifyFSListener {
+ public:
+  QSet<QString> failing_paths_;
+  int error_ = ENOSPC;
+
+ protected:
+  int AddWatch(const QString &path) override {
+    if (failing_paths_.contains(path)) return error_;
+    return InotifyFSListener::AddWatch(path);
+  }
+};
+
+class InotifyFSListenerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(temp_dir_.isValid());
+    watched_path_ = temp_dir_.filePath("watched");
+    polled_path_ = temp_dir_.filePath("polled");
+    ASSERT_TRUE(QDir().mkpath(watched_path_));
+    ASSERT_TRUE(QDir().mkpath(polled_path_));
+    listener_.Init();
+  }
+
+  // Moves the mtime of the directory forward, so polling finds it changed.
+  static bool Touch(const QString &path, const int seconds) {
+    struct timeval times[2] {};
+    ::gettimeofday(&times[0], nullptr);
+    times[0].tv_sec += seconds;
+    times[1] = times[0];
+    return ::utimes(QFile::encodeName(path).constData(), times) == 0;
+  }
+
+  void PollPaths() {
+    QMetaObject::invokeMethod(&listener_, "PollPaths", Qt::DirectConnection);
+  }
+
+  QTemporaryDir temp_dir_;
+  QString watched_path_;
+  QString polled_path_;
+  FailingInotifyFSListener listener_;
+};
+
+TEST_F(InotifyFSListenerTest, WatchLimitFallsBackToPolling) {
+
+  listener_.failing_paths_ << polled_path_;
+  listener_.AddPath(watched_path_);
+  listener_.AddPath(polled_path_);
+
+  QSignalSpy spy(&listener_, &FileSystemWatcherInterface::PathChanged);
+
+  // The watched path is reported by inotify.
+  QFile file(watched_path_ + "/song.flac");
+  ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+  file.close();
+  ASSERT_TRUE(spy.wait(5000));
+  ASSERT_EQ(1, spy.count());
+  EXPECT_EQ(watched_path_, spy.takeFirst().at(0).toString());
+
+  // The polled path is only reported when it was polled.
+  ASSERT_TRUE(Touch(polled_path_, 10));
+  EXPECT_FALSE(spy.wait(1000));
+  PollPaths();
+  ASSERT_TRUE(spy.wait(5000));
+  ASSERT_EQ(1, spy.count());
+  EXPECT_EQ(polled_path_, spy.takeFirst().at(0).toString());
+
+  // Nothing changed since it was last polled.
+  PollPaths();
+  EXPECT_FALSE(spy.wait(1000));
+
+  // Once watches are available again, the path is watched instead of polled.
+  listener_.failing_paths_.clear();
+  PollPaths();
+  QFile polled_file(polled_path_ + "/song.flac");
+  ASSERT_TRUE(polled_file.open(QIODevice::WriteOnly));
+  polled_file.close();
+  ASSERT_TRUE(spy.wait(5000));
+  ASSERT_EQ(1, spy.count());
+  EXPECT_EQ(polled_path_, spy.takeFirst().at(0).toString());
+
+}
+
+TEST_F(InotifyFSListenerTest, OtherErrorsAreNotPolled) {
+
+  listener_.failing_paths_ << polled_path_;
+  listener_.error_ = EACCES;
+  listener_.AddPath(polled_path_);
+
+  QSignalSpy spy(&listener_, &FileSystemWatcherInterface::PathChanged);
+
+  ASSERT_TRUE(Touch(polled_path_, 10));
+  PollPaths();
+  EXPECT_FALSE(spy.wait(1000));
+
+}
+
+TEST_F(InotifyFSListenerTest, RemovePolledPath) {
+
+  listener_.failing_paths_ << polled_path_;
+  listener_.AddPath(polled_path_);
+  listener_.RemovePath(polled_path_);
+
+  QSignalSpy spy(&listener_, &FileSystemWatcherInterface::PathChanged);
+
+  ASSERT_TRUE(Touch(polled_path_, 10));
+  PollPaths();
+  EXPECT_FALSE(spy.wait(1000));
+
+}
+
+}  // namespace
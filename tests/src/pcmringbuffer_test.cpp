@@ -0,0 +1,164 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+#include <QtGlobal>
+#include <QFuture>
+#include <QtConcurrentRun>
+
+#include "utilities/timeconstants.h"
+#include "engine/sampleconverter.h"
+#include "engine/pcmringbuffer.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+using SampleConverter::Format;
+
+namespace {
+
+constexpr int kChannels = 2;
+constexpr int kRate = 44100;
+
+// Stereo S16 samples counting up from first.
+std::vector<qint16> Counting(const int first, const int count) {
+
+  std::vector<qint16> samples(static_cast<size_t>(count));
+  for (int i = 0; i < count; ++i) samples[static_cast<size_t>(i)] = static_cast<qint16>(first + i);
+  return samples;
+
+}
+
+bool IsCounting(const std::vector<qint16> &samples) {
+
+  for (size_t i = 1; i < samples.size(); ++i) {
+    if (static_cast<qint16>(samples[i - 1] + 1) != samples[i]) return false;
+  }
+  return true;
+
+}
+
+TEST(PcmRingBufferTest, InactiveUntilRead) {
+
+  PcmRingBuffer ring;
+  EXPECT_FALSE(ring.active(0));
+
+  std::vector<qint16> window(64);
+  EXPECT_FALSE(ring.ReadWindow(0, window.data(), window.size()));
+  EXPECT_TRUE(ring.active(0));
+  EXPECT_TRUE(ring.active(PcmRingBuffer::kActiveTimeoutNanosec - 1));
+  EXPECT_FALSE(ring.active(PcmRingBuffer::kActiveTimeoutNanosec));
+
+}
+
+TEST(PcmRingBufferTest, ReadsWindowByTime) {
+
+  PcmRingBuffer ring(12);
+
+  // 2048 stereo frames starting at time 0.
+  const std::vector<qint16> samples = Counting(0, 4096);
+  ring.Write(Format::S16LE, samples.data(), samples.size() * sizeof(qint16), kChannels, kRate, 0);
+
+  std::vector<qint16> window(256);
+  int channels = 0;
+
+  // 1000 frames after the start of the block the window ends at sample 2000.
+  ASSERT_TRUE(ring.ReadWindow(1000 * kNsecPerSec / kRate + 1, window.data(), window.size(), &channels));
+  EXPECT_EQ(channels, kChannels);
+  EXPECT_EQ(window.front(), 2000 - 256);
+  EXPECT_EQ(window.back(), 1999);
+
+  // Past the end of the block the window stops at the last sample written.
+  ASSERT_TRUE(ring.ReadWindow(10 * kNsecPerSec, window.data(), window.size()));
+  EXPECT_EQ(window.back(), 4095);
+
+  // Before enough samples were written there is no window.
+  EXPECT_FALSE(ring.ReadWindow(10 * kNsecPerSec / kRate, window.data(), window.size()));
+
+}
+
+TEST(PcmRingBufferTest, WrapsAround) {
+
+  PcmRingBuffer ring(10);
+
+  int next = 0;
+  for (int i = 0; i < 10; ++i) {
+    const std::vector<qint16> samples = Counting(next, 300);
+    ring.Write(Format::S16LE, samples.data(), samples.size() * sizeof(qint16), kChannels, kRate, 0);
+    next += 300;
+  }
+
+  std::vector<qint16> window(512);
+  ASSERT_TRUE(ring.ReadWindow(kNsecPerSec, window.data(), window.size()));
+  EXPECT_TRUE(IsCounting(window));
+  EXPECT_EQ(window.back(), static_cast<qint16>(next - 1));
+
+}
+
+TEST(PcmRingBufferTest, ConvertsOnWrite) {
+
+  PcmRingBuffer ring(10);
+
+  const std::vector<float> samples(256, 0.5F);
+  ring.Write(Format::F32LE, samples.data(), samples.size() * sizeof(float), kChannels, kRate, 0);
+
+  std::vector<qint16> window(128);
+  ASSERT_TRUE(ring.ReadWindow(kNsecPerSec, window.data(), window.size()));
+  for (const qint16 sample : window) {
+    EXPECT_EQ(sample, 16384);
+  }
+
+}
+
+TEST(PcmRingBufferTest, ConcurrentReadsAreConsistent) {
+
+  PcmRingBuffer ring(12);
+  std::atomic<bool> writing(true);
+
+  // Write blocks as fast as possible so the reader regularly races the writer around the ring.
+  QFuture<void> writer = QtConcurrent::run([&ring, &writing]() {
+    int next = 0;
+    for (int i = 0; i < 20000; ++i) {
+      const std::vector<qint16> samples = Counting(next, 1024);
+      ring.Write(Format::S16LE, samples.data(), samples.size() * sizeof(qint16), kChannels, kRate, 0);
+      next += 1024;
+    }
+    writing = false;
+  });
+
+  int reads = 0;
+  int inconsistent = 0;
+  std::vector<qint16> window(1024);
+  while (writing) {
+    if (ring.ReadWindow(kNsecPerSec, window.data(), window.size())) {
+      ++reads;
+      if (!IsCounting(window)) ++inconsistent;
+    }
+  }
+  writer.waitForFinished();
+
+  EXPECT_EQ(inconsistent, 0);
+  EXPECT_GT(reads, 0);
+
+}
+
+}  // namespace
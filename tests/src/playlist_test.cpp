@@ -27,6 +27,7 @@
 
 #include "collection/collectionplaylistitem.h"
 #include "playlist/playlist.h"
+#include "playlist/songplaylistitem.h"
 #include "mock_settingsprovider.h"
 #include "mock_playlistitem.h"
 
@@ -543,5 +544,33 @@ TEST_F(PlaylistTest, CollectionIdMapMulti) {
 
 }
 
+TEST_F(PlaylistTest, UpdateItemsByUrl) {
+
+  auto make_song = [](const QString &title, const QString &url) {
+    Song song;
+    song.Init(title, "artist", "album", 123);
+    song.set_url(QUrl(url));
+    song.set_filetype(Song::FileType::Stream);
+    return song;
+  };
+
+  playlist_.InsertItems(PlaylistItemPtrList() << std::make_shared<SongPlaylistItem>(make_song("One", "http://a"))
+                                              << std::make_shared<SongPlaylistItem>(make_song("Two", "http://b"))
+                                              << std::make_shared<SongPlaylistItem>(make_song("Three", "http://a")));
+
+  // Moving rows invalidates the URL index.
+  playlist_.MoveItemWithoutUndo(0, 2);
+  ASSERT_EQ("Two", playlist_.data(playlist_.index(0, Playlist::Column_Title)));
+  ASSERT_EQ("Three", playlist_.data(playlist_.index(1, Playlist::Column_Title)));
+  ASSERT_EQ("One", playlist_.data(playlist_.index(2, Playlist::Column_Title)));
+
+  // Every song updates the first item with the URL that wasn't updated yet.
+  playlist_.UpdateItems(SongList() << make_song("New A", "http://a") << make_song("New B", "http://b") << make_song("Newer A", "http://a"));
+
+  EXPECT_EQ("New B", playlist_.data(playlist_.index(0, Playlist::Column_Title)));
+  EXPECT_EQ("New A", playlist_.data(playlist_.index(1, Playlist::Column_Title)));
+  EXPECT_EQ("Newer A", playlist_.data(playlist_.index(2, Playlist::Column_Title)));
+
+}
 
 }  // namespace
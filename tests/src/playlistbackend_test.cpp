@@ -0,0 +1,292 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include <QtGlobal>
+#include <QMetaType>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <QRegularExpression>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThreadPool>
+#include <QFile>
+#include <QIODevice>
+#include <QUndoStack>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "core/sqlrow.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistitem.h"
+#include "playlist/playlistbackend.h"
+#include "playlist/playlistchanges.h"
+#include "smartplaylists/playlistgenerator.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+// A file whose tags can be changed, like the edit tag dialog does.
+class EditableItem : public PlaylistItem {
+ public:
+  explicit EditableItem(const Song &song) : PlaylistItem(Song::Source::LocalFile), song_(song), file_title_(song.title()) {}
+
+  bool InitFromQuery(const SqlRow&) override { return false; }
+  void Reload() override { song_.set_title(file_title_); }
+
+  Song Metadata() const override { return song_; }
+  Song OriginalMetadata() const override { return song_; }
+  QUrl Url() const override { return song_.url(); }
+  void SetArtManual(const QUrl&) override {}
+
+  void set_title(const QString &title) { song_.set_title(title); }
+  void set_file_title(const QString &title) { file_title_ = title; }
+
+ protected:
+  Song DatabaseSongMetadata() const override { return song_; }
+
+ private:
+  Song song_;
+  QString file_title_;
+};
+
+class PlaylistBackendTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    qRegisterMetaType<PlaylistBackend::Changes>("PlaylistBackend::Changes");
+    qRegisterMetaType<PlaylistGeneratorPtr>("PlaylistGeneratorPtr");
+
+    ASSERT_TRUE(temp_dir_.isValid());
+    OpenDatabase();
+  }
+
+  // Restoring a playlist runs in a background thread, which can't see an in-memory database.
+  void OpenDatabase() {
+    backend_.reset();
+    database_.reset();
+    database_ = std::make_unique<Database>(nullptr, nullptr, temp_dir_.filePath("strawberry.db"));
+    backend_ = std::make_unique<PlaylistBackend>(nullptr);
+    backend_->set_database(database_.get());
+  }
+
+  std::shared_ptr<EditableItem> NewItem(const int i) {
+    Song song(Song::Source::LocalFile);
+    song.Init(QStringLiteral("Title %1").arg(i), QStringLiteral("Artist"), QStringLiteral("Album"), 123);
+    song.set_url(QUrl::fromLocalFile(temp_dir_.filePath(QStringLiteral("%1.flac").arg(i))));
+    return std::make_shared<EditableItem>(song);
+  }
+
+  // Restored items of files that don't exist are grayed out and reloaded, which needs the tag reader.
+  static bool CreateFile(const PlaylistItemPtr &item) {
+    QFile file(item->Url().toLocalFile());
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.close();
+    return true;
+  }
+
+  // Waits for the playlist to be restored, and for the check for deleted files that runs after it.
+  static bool WaitForRestore(Playlist *playlist) {
+    QSignalSpy restore_spy(playlist, &Playlist::RestoreFinished);
+    const bool restored = restore_spy.wait();
+    QThreadPool::globalInstance()->waitForDone();
+    return restored;
+  }
+
+  static QStringList Titles(const PlaylistItemPtrList &items) {
+    QStringList titles;
+    for (const PlaylistItemPtr &item : items) titles << item->Metadata().title();
+    return titles;
+  }
+
+  QStringList SavedTitles(const int playlist, PlaylistBackend::SavedItemList *saved_items = nullptr) {
+    return Titles(backend_->GetPlaylistItems(playlist, saved_items));
+  }
+
+  bool WaitForSavedTitles(const int playlist, const QStringList &titles) {
+    for (int i = 0; i < 100 && SavedTitles(playlist) != titles; ++i) {
+      QTest::qWait(50);
+    }
+    return SavedTitles(playlist) == titles;
+  }
+
+  void Save(const int playlist, PlaylistChanges *changes, const PlaylistItemPtrList &items) {
+    PlaylistBackend *backend = backend_.get();
+    backend_->SavePlaylist(playlist, changes->Take(items, [backend](const int count) { return backend->AllocateItemIds(count); }), -1, PlaylistGeneratorPtr());
+  }
+
+  QTemporaryDir temp_dir_;
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<PlaylistBackend> backend_;
+};
+
+TEST_F(PlaylistBackendTest, SavesOnlyChanges) {
+
+  const int id = backend_->CreatePlaylist("Test", QString());
+  ASSERT_NE(-1, id);
+
+  PlaylistBackend::SavedItemList saved_items;
+  ASSERT_TRUE(backend_->GetPlaylistItems(id, &saved_items).isEmpty());
+
+  QList<std::shared_ptr<EditableItem>> editable_items;
+  PlaylistItemPtrList items;
+  for (int i = 0; i < 5; ++i) {
+    editable_items << NewItem(i);
+    items << editable_items.last();
+  }
+
+  PlaylistChanges changes;
+  Save(id, &changes, items);
+  ASSERT_EQ(Titles(items), SavedTitles(id, &saved_items));
+  ASSERT_EQ(5, saved_items.count());
+
+  // Move the last item first, remove one, insert a new one and change the tags of another.
+  items.move(4, 0);
+  items.removeAt(2);
+  items.insert(1, NewItem(5));
+  editable_items[3]->set_title("Edited");
+  changes.ItemChanged(editable_items[3]);
+
+  PlaylistBackend *backend = backend_.get();
+  const PlaylistBackend::Changes delta = changes.Take(items, [backend](const int count) { return backend->AllocateItemIds(count); });
+  EXPECT_FALSE(delta.replace_all);
+  EXPECT_EQ(1, delta.inserted.count());
+  EXPECT_EQ(1, delta.removed.count());
+  EXPECT_EQ(1, delta.moved.count());
+  EXPECT_EQ(1, delta.updated.count());
+  backend_->SavePlaylist(id, delta, -1, PlaylistGeneratorPtr());
+
+  PlaylistBackend::SavedItemList restored_saved_items;
+  EXPECT_EQ(QStringList() << "Title 4" << "Title 5" << "Title 0" << "Title 2" << "Edited", SavedTitles(id, &restored_saved_items));
+  ASSERT_EQ(5, restored_saved_items.count());
+
+  // The rows that were only moved or updated keep their ROWID.
+  EXPECT_EQ(saved_items[4].id, restored_saved_items[0].id);
+  EXPECT_EQ(saved_items[0].id, restored_saved_items[2].id);
+  EXPECT_EQ(saved_items[2].id, restored_saved_items[3].id);
+  EXPECT_EQ(saved_items[3].id, restored_saved_items[4].id);
+  EXPECT_GT(restored_saved_items[1].id, saved_items[4].id);
+
+}
+
+TEST_F(PlaylistBackendTest, UpgradeToSchema17) {
+
+  int id = -1;
+  {
+    // Turn the new database back into schema 16, where playlist items are ordered by ROWID and have no position.
+    QSqlDatabase db(database_->Connect());
+    QSqlQuery q(db);
+    ASSERT_TRUE(q.exec("SELECT sql FROM sqlite_master WHERE type = 'table' AND name = 'playlist_items'"));
+    ASSERT_TRUE(q.next());
+    const QString create_table = q.value(0).toString().remove(QRegularExpression("position REAL,"));
+    ASSERT_TRUE(q.exec("DROP INDEX idx_playlist_items_position"));
+    ASSERT_TRUE(q.exec("DROP TABLE playlist_items"));
+    ASSERT_TRUE(q.exec(create_table));
+    ASSERT_TRUE(q.exec("UPDATE schema_version SET version = 16"));
+
+    ASSERT_TRUE(q.exec("INSERT INTO playlists (name) VALUES ('Old')"));
+    id = q.lastInsertId().toInt();
+    for (int i = 0; i < 5; ++i) {
+      ASSERT_TRUE(q.exec(QString("INSERT INTO playlist_items (playlist, type, title) VALUES (%1, %2, 'Title %3')").arg(id).arg(static_cast<int>(Song::Source::LocalFile)).arg(i)));
+    }
+  }
+
+  OpenDatabase();
+
+  PlaylistBackend::SavedItemList saved_items;
+  EXPECT_EQ(QStringList() << "Title 0" << "Title 1" << "Title 2" << "Title 3" << "Title 4", SavedTitles(id, &saved_items));
+  ASSERT_EQ(5, saved_items.count());
+  for (const PlaylistBackend::SavedItem &saved_item : saved_items) {
+    EXPECT_EQ(static_cast<double>(saved_item.id), saved_item.position);
+  }
+
+  // The upgraded playlist can be saved incrementally.
+  PlaylistItemPtrList items = backend_->GetPlaylistItems(id);
+  PlaylistChanges changes;
+  changes.Restored(items, saved_items);
+  items.move(0, 4);
+  Save(id, &changes, items);
+  EXPECT_EQ(QStringList() << "Title 1" << "Title 2" << "Title 3" << "Title 4" << "Title 0", SavedTitles(id));
+
+}
+
+TEST_F(PlaylistBackendTest, RestoresInPages) {
+
+  const int id = backend_->CreatePlaylist("Test", QString());
+  ASSERT_TRUE(backend_->GetPlaylistItems(id).isEmpty());
+
+  const int count = Playlist::kRestoreFirstPageSize + Playlist::kUndoItemLimit + 100;
+  PlaylistItemPtrList items;
+  QStringList titles;
+  for (int i = 0; i < count; ++i) {
+    items << NewItem(i);
+    ASSERT_TRUE(CreateFile(items.last()));
+    titles << items.last()->Metadata().title();
+  }
+  PlaylistChanges changes;
+  Save(id, &changes, items);
+
+  Playlist playlist(backend_.get(), nullptr, nullptr, id);
+  // Added before the first page is in, so it goes after all the restored items.
+  playlist.InsertItems(PlaylistItemPtrList() << NewItem(count), -1);
+  titles << QStringLiteral("Title %1").arg(count);
+  ASSERT_TRUE(WaitForRestore(&playlist));
+
+  EXPECT_EQ(titles, Titles(playlist.GetAllItems()));
+  // Only the item added by the user can be undone.
+  EXPECT_EQ(1, playlist.undo_stack()->count());
+
+}
+
+TEST_F(PlaylistBackendTest, EditedTagsAreSaved) {
+
+  const int id = backend_->CreatePlaylist("Test", QString());
+
+  {
+    Playlist playlist(backend_.get(), nullptr, nullptr, id);
+    ASSERT_TRUE(WaitForRestore(&playlist));
+
+    std::shared_ptr<EditableItem> item = NewItem(0);
+    ASSERT_TRUE(CreateFile(item));
+
+    playlist.InsertItems(PlaylistItemPtrList() << item, -1);
+    ASSERT_TRUE(WaitForSavedTitles(id, QStringList() << "Title 0"));
+
+    // The edit tag dialog wrote the file, the playlist reloads the item.
+    item->set_file_title("Edited");
+    playlist.ReloadItems(PlaylistItemPtrList() << item);
+    EXPECT_EQ("Edited", playlist.item_at(0)->Metadata().title());
+    ASSERT_TRUE(WaitForSavedTitles(id, QStringList() << "Edited"));
+  }
+
+  Playlist playlist(backend_.get(), nullptr, nullptr, id);
+  ASSERT_TRUE(WaitForRestore(&playlist));
+  ASSERT_EQ(1, playlist.rowCount());
+  EXPECT_EQ("Edited", playlist.item_at(0)->Metadata().title());
+
+}
+
+}  // namespace
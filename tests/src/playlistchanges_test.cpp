@@ -0,0 +1,219 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include <QtGlobal>
+#include <QString>
+#include <QUrl>
+
+#include "core/song.h"
+#include "playlist/playlistitem.h"
+#include "playlist/playlistbackend.h"
+#include "playlist/playlistchanges.h"
+#include "playlist/songplaylistitem.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+class PlaylistChangesTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    next_id_ = 1;
+    for (int i = 0; i < 5; ++i) items_ << NewItem(i);
+  }
+
+  static PlaylistItemPtr NewItem(const int i) {
+    Song song(Song::Source::LocalFile);
+    song.Init(QStringLiteral("Title %1").arg(i), QStringLiteral("Artist"), QStringLiteral("Album"), 123);
+    song.set_url(QUrl::fromLocalFile(QStringLiteral("/music/%1.flac").arg(i)));
+    return std::make_shared<SongPlaylistItem>(song);
+  }
+
+  PlaylistBackend::Changes Take(const PlaylistItemPtrList &items) {
+    return changes_.Take(items, [this](const int count) {
+      const qint64 id = next_id_;
+      next_id_ += count;
+      return id;
+    });
+  }
+
+  double Position(const PlaylistBackend::Changes &changes, const qint64 id) {
+    for (const PlaylistBackend::SavedItem &saved_item : changes.moved) {
+      if (saved_item.id == id) return saved_item.position;
+    }
+    for (const QPair<PlaylistBackend::SavedItem, PlaylistItemPtr> &inserted : changes.inserted) {
+      if (inserted.first.id == id) return inserted.first.position;
+    }
+    return -1;
+  }
+
+  PlaylistChanges changes_;
+  PlaylistItemPtrList items_;
+  qint64 next_id_;
+};
+
+TEST_F(PlaylistChangesTest, FirstSaveReplacesAll) {
+
+  const PlaylistBackend::Changes changes = Take(items_);
+
+  EXPECT_TRUE(changes.replace_all);
+  ASSERT_EQ(5, changes.inserted.count());
+  EXPECT_TRUE(changes.removed.isEmpty());
+  EXPECT_TRUE(changes.moved.isEmpty());
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(items_[i], changes.inserted[i].second);
+    EXPECT_EQ(i + 1, changes.inserted[i].first.id);
+    if (i > 0) {
+      EXPECT_LT(changes.inserted[i - 1].first.position, changes.inserted[i].first.position);
+    }
+  }
+  EXPECT_TRUE(changes_.valid());
+
+}
+
+TEST_F(PlaylistChangesTest, NothingChanged) {
+
+  Take(items_);
+  const PlaylistBackend::Changes changes = Take(items_);
+
+  EXPECT_FALSE(changes.replace_all);
+  EXPECT_TRUE(changes.inserted.isEmpty());
+  EXPECT_TRUE(changes.removed.isEmpty());
+  EXPECT_TRUE(changes.moved.isEmpty());
+  EXPECT_TRUE(changes.updated.isEmpty());
+
+}
+
+TEST_F(PlaylistChangesTest, MetadataChanged) {
+
+  Take(items_);
+  changes_.ItemChanged(items_[2]);
+  const PlaylistBackend::Changes changes = Take(items_);
+
+  ASSERT_EQ(1, changes.updated.count());
+  EXPECT_EQ(3, changes.updated[0].first);
+  EXPECT_EQ(items_[2], changes.updated[0].second);
+  EXPECT_TRUE(changes.moved.isEmpty());
+
+}
+
+TEST_F(PlaylistChangesTest, MoveOneItem) {
+
+  Take(items_);
+  items_.move(0, 3);
+  const PlaylistBackend::Changes changes = Take(items_);
+
+  EXPECT_FALSE(changes.replace_all);
+  EXPECT_TRUE(changes.inserted.isEmpty());
+  EXPECT_TRUE(changes.removed.isEmpty());
+  ASSERT_EQ(1, changes.moved.count());
+  EXPECT_EQ(1, changes.moved[0].id);
+  // Now between the items that were saved as the fourth and fifth.
+  EXPECT_GT(changes.moved[0].position, 4);
+  EXPECT_LT(changes.moved[0].position, 5);
+
+}
+
+TEST_F(PlaylistChangesTest, InsertAndRemove) {
+
+  Take(items_);
+  items_.removeAt(4);
+  items_.insert(2, NewItem(5));
+  const PlaylistBackend::Changes changes = Take(items_);
+
+  ASSERT_EQ(1, changes.removed.count());
+  EXPECT_EQ(5, changes.removed[0]);
+  ASSERT_EQ(1, changes.inserted.count());
+  EXPECT_EQ(6, changes.inserted[0].first.id);
+  EXPECT_EQ(items_[2], changes.inserted[0].second);
+  EXPECT_GT(changes.inserted[0].first.position, 2);
+  EXPECT_LT(changes.inserted[0].first.position, 3);
+  EXPECT_TRUE(changes.moved.isEmpty());
+
+}
+
+TEST_F(PlaylistChangesTest, SameItemTwice) {
+
+  Take(items_);
+  items_ << items_[0];
+  const PlaylistBackend::Changes changes = Take(items_);
+
+  ASSERT_EQ(1, changes.inserted.count());
+  EXPECT_EQ(items_[0], changes.inserted[0].second);
+  EXPECT_GT(changes.inserted[0].first.position, 5);
+  EXPECT_TRUE(changes.moved.isEmpty());
+
+}
+
+TEST_F(PlaylistChangesTest, RenumbersWhenThereIsNoRoomLeft) {
+
+  Take(items_);
+
+  // Keep inserting between the first two items until there is no room between them.
+  bool renumbered = false;
+  for (int i = 0; i < 100 && !renumbered; ++i) {
+    items_.insert(1, NewItem(10 + i));
+    const PlaylistBackend::Changes changes = Take(items_);
+    renumbered = !changes.moved.isEmpty();
+    if (renumbered) {
+      // Every row gets its row number as position.
+      EXPECT_EQ(2, Position(changes, changes.inserted[0].first.id));
+      EXPECT_EQ(items_.count(), Position(changes, 5));
+    }
+  }
+  EXPECT_TRUE(renumbered);
+
+  const PlaylistBackend::Changes changes = Take(items_);
+  EXPECT_TRUE(changes.moved.isEmpty());
+
+}
+
+TEST_F(PlaylistChangesTest, RestoredFromDatabase) {
+
+  PlaylistBackend::SavedItemList saved_items;
+  for (int i = 0; i < items_.count(); ++i) saved_items << PlaylistBackend::SavedItem(100 + i, i * 10);
+  changes_.Restored(items_, saved_items);
+  ASSERT_TRUE(changes_.valid());
+
+  items_.removeFirst();
+  const PlaylistBackend::Changes changes = Take(items_);
+
+  EXPECT_FALSE(changes.replace_all);
+  ASSERT_EQ(1, changes.removed.count());
+  EXPECT_EQ(100, changes.removed[0]);
+
+}
+
+TEST_F(PlaylistChangesTest, AllocationFailed) {
+
+  Take(items_);
+  items_ << NewItem(5);
+  const PlaylistBackend::Changes failed = changes_.Take(items_, [](const int) { return -1; });
+
+  EXPECT_TRUE(failed.inserted.isEmpty());
+  EXPECT_FALSE(changes_.valid());
+  EXPECT_TRUE(Take(items_).replace_all);
+
+}
+
+}  // namespace
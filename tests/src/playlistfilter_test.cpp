@@ -0,0 +1,184 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QModelIndex>
+#include <QStandardItemModel>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+
+#include "core/logging.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistfilter.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+class PlaylistFilterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    model_.setColumnCount(Playlist::ColumnCount);
+    filter_.setSourceModel(&model_);
+  }
+
+  void AddRows(const int count) {
+
+    static const char *kWords[] = { "Beatles", "beach", "Bear", "Abbey Road", "road", "Help", "Yellow", "Submarine", "rock", "pop" };
+    QRandomGenerator generator(42);
+    for (int i = 0; i < count; ++i) {
+      QList<QStandardItem*> row;
+      for (int column = 0; column < Playlist::ColumnCount; ++column) row << new QStandardItem;
+      row[Playlist::Column_Title]->setData(QString::fromLatin1(kWords[generator.bounded(10)]) + QLatin1Char(' ') + QString::fromLatin1(kWords[generator.bounded(10)]), Qt::DisplayRole);
+      row[Playlist::Column_Artist]->setData(QString::fromLatin1(kWords[generator.bounded(10)]), Qt::DisplayRole);
+      row[Playlist::Column_Album]->setData(QString::fromLatin1(kWords[generator.bounded(10)]), Qt::DisplayRole);
+      row[Playlist::Column_Genre]->setData(QString::fromLatin1(kWords[generator.bounded(10)]), Qt::DisplayRole);
+      row[Playlist::Column_Year]->setData(1960 + generator.bounded(60), Qt::DisplayRole);
+      row[Playlist::Column_Track]->setData(generator.bounded(20), Qt::DisplayRole);
+      row[Playlist::Column_Length]->setData(generator.bounded(600) * 1000000000LL, Qt::DisplayRole);
+      model_.appendRow(row);
+    }
+
+  }
+
+  QList<int> AcceptedRows(const PlaylistFilter &filter) const {
+
+    QList<int> rows;
+    for (int row = 0; row < model_.rowCount(); ++row) {
+      if (filter.filterAcceptsRow(row, QModelIndex())) rows << row;
+    }
+    return rows;
+
+  }
+
+  QList<int> AcceptedRows() const { return AcceptedRows(filter_); }
+
+  // The rows the filter tree accepts, going through the model.
+  QList<int> TreeAcceptedRows() {
+
+    emit model_.layoutAboutToBeChanged();
+    emit model_.layoutChanged();
+    return AcceptedRows();
+
+  }
+
+  // The rows a new filter accepts, filtering all rows.
+  QList<int> NewFilterAcceptedRows(const QString &query) const {
+
+    PlaylistFilter filter;
+    filter.setSourceModel(const_cast<QStandardItemModel*>(&model_));
+    filter.SetFilterText(query);
+    return AcceptedRows(filter);
+
+  }
+
+  QStandardItemModel model_;
+  PlaylistFilter filter_;
+};
+
+TEST_F(PlaylistFilterTest, MatchesFilterTree) {
+
+  AddRows(1000);
+
+  const QStringList queries = QStringList() << QStringLiteral("")
+                                            << QStringLiteral("bea")
+                                            << QStringLiteral("artist:beatles")
+                                            << QStringLiteral("artist:=road")
+                                            << QStringLiteral("-rock")
+                                            << QStringLiteral("beach OR help")
+                                            << QStringLiteral("(pop OR rock) -artist:bear")
+                                            << QStringLiteral("year:>1990")
+                                            << QStringLiteral("year:<=1970 track:>=10")
+                                            << QStringLiteral("length:>5:00")
+                                            << QStringLiteral("length:<30")
+                                            << QStringLiteral("title:\"abbey road\"")
+                                            << QStringLiteral("album:!=help")
+                                            << QStringLiteral("genre:<c");
+
+  for (const QString &query : queries) {
+    filter_.SetFilterText(query);
+    const QList<int> accepted = AcceptedRows();
+    EXPECT_EQ(TreeAcceptedRows(), accepted) << query.toStdString();
+  }
+
+}
+
+TEST_F(PlaylistFilterTest, NarrowedQuery) {
+
+  AddRows(1000);
+
+  const QStringList queries = QStringList() << QStringLiteral("b")
+                                            << QStringLiteral("be")
+                                            << QStringLiteral("bea")
+                                            << QStringLiteral("beat")
+                                            << QStringLiteral("beat r")
+                                            << QStringLiteral("beat ro")
+                                            << QStringLiteral("beat ro -")
+                                            << QStringLiteral("beat ro -h")
+                                            << QStringLiteral("beat ro")
+                                            << QStringLiteral("beat ro O")
+                                            << QStringLiteral("beat ro OR")
+                                            << QStringLiteral("beat ro OR help");
+
+  for (const QString &query : queries) {
+    filter_.SetFilterText(query);
+    EXPECT_EQ(NewFilterAcceptedRows(query), AcceptedRows()) << query.toStdString();
+  }
+
+}
+
+TEST_F(PlaylistFilterTest, ChangedRow) {
+
+  AddRows(10);
+  model_.item(3, Playlist::Column_Artist)->setData(QStringLiteral("Nobody"), Qt::DisplayRole);
+
+  filter_.SetFilterText(QStringLiteral("artist:nobody"));
+  EXPECT_EQ(QList<int>() << 3, AcceptedRows());
+
+  model_.item(3, Playlist::Column_Artist)->setData(QStringLiteral("Somebody"), Qt::DisplayRole);
+  model_.item(5, Playlist::Column_Artist)->setData(QStringLiteral("Nobody"), Qt::DisplayRole);
+  EXPECT_EQ(QList<int>() << 5, AcceptedRows());
+
+  filter_.SetFilterText(QStringLiteral("artist:nobod"));
+  EXPECT_EQ(QList<int>() << 5, AcceptedRows());
+
+}
+
+TEST_F(PlaylistFilterTest, DISABLED_Benchmark) {
+
+  AddRows(100000);
+
+  for (const QString &query : QStringList() << QStringLiteral("b") << QStringLiteral("be") << QStringLiteral("bea") << QStringLiteral("beat")) {
+    QElapsedTimer timer;
+    timer.start();
+    filter_.SetFilterText(query);
+    const qint64 msec = timer.elapsed();
+    TreeAcceptedRows();
+    const qint64 tree_msec = timer.restart() - msec;
+    qLog(Info) << "Filtering 100000 rows for" << query << "took" << msec << "ms, the filter tree" << tree_msec << "ms";
+  }
+
+}
+
+}  // namespace
@@ -0,0 +1,141 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QtGlobal>
+#include <QString>
+#include <QUrl>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+
+#include "core/logging.h"
+#include "core/song.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistitem.h"
+#include "playlist/playlistsorter.h"
+#include "playlist/songplaylistitem.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+QString RandomWord(QRandomGenerator &generator, const int choices) {
+  static const char *kWords[] = { "alpha", "Bravo", "charlie", "Delta", "echo", "foxtrot", "Golf", "hotel", "india", "Juliett" };
+  return QString::fromLatin1(kWords[generator.bounded(qMin(choices, 10))]);
+}
+
+// Few distinct values, so there are plenty of ties for the stable sort to keep in order.
+PlaylistItemPtrList RandomItems(const int count) {
+
+  QRandomGenerator generator(42);
+  PlaylistItemPtrList items;
+  items.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    Song song(Song::Source::LocalFile);
+    song.Init(RandomWord(generator, 10) + QString::number(generator.bounded(100)), RandomWord(generator, 10), RandomWord(generator, 6), generator.bounded(1000) * 1000000LL);
+    song.set_track(generator.bounded(20));
+    song.set_disc(generator.bounded(3));
+    song.set_year(1960 + generator.bounded(60));
+    const QString filename = RandomWord(generator, 10) + QStringLiteral(".flac");
+    QString path = QStringLiteral("/music");
+    for (int depth = generator.bounded(3); depth >= 0; --depth) path += QLatin1Char('/') + RandomWord(generator, 4);
+    song.set_url(QUrl::fromLocalFile(path + QLatin1Char('/') + filename));
+    song.set_basefilename(filename);
+    items << std::make_shared<SongPlaylistItem>(song);
+  }
+
+  return items;
+
+}
+
+// The way Playlist::sort used to sort with Playlist::CompareItems.
+PlaylistItemPtrList CompareItemsSort(PlaylistItemPtrList items, const int begin, const int column, const Qt::SortOrder order) {
+
+  PlaylistItemPtrList::iterator first = items.begin() + begin;
+  if (column == Playlist::Column_Album) {
+    std::stable_sort(first, items.end(), std::bind(&Playlist::CompareItems, Playlist::Column_Track, order, std::placeholders::_1, std::placeholders::_2));
+    std::stable_sort(first, items.end(), std::bind(&Playlist::CompareItems, Playlist::Column_Disc, order, std::placeholders::_1, std::placeholders::_2));
+    std::stable_sort(first, items.end(), std::bind(&Playlist::CompareItems, Playlist::Column_Album, order, std::placeholders::_1, std::placeholders::_2));
+  }
+  else if (column == Playlist::Column_Filename) {
+    std::stable_sort(first, items.end(), std::bind(&Playlist::CompareItems, Playlist::Column_Filename, order, std::placeholders::_1, std::placeholders::_2));
+    std::stable_sort(first, items.end(), std::bind(&Playlist::ComparePathDepths, order, std::placeholders::_1, std::placeholders::_2));
+  }
+  else {
+    std::stable_sort(first, items.end(), std::bind(&Playlist::CompareItems, column, order, std::placeholders::_1, std::placeholders::_2));
+  }
+
+  return items;
+
+}
+
+TEST(PlaylistSorterTest, MatchesCompareItems) {
+
+  // Enough items to be split over several threads.
+  const PlaylistItemPtrList items = RandomItems(PlaylistSorter::kMinItemsPerThread * 3 + 7);
+
+  for (const int column : { Playlist::Column_Title, Playlist::Column_Artist, Playlist::Column_Album, Playlist::Column_Length, Playlist::Column_Year, Playlist::Column_Filename, Playlist::Column_BaseFilename }) {
+    for (const Qt::SortOrder order : { Qt::AscendingOrder, Qt::DescendingOrder }) {
+      PlaylistSorter sorter(items, 0, column, order);
+      EXPECT_TRUE(sorter.Apply(items, sorter.Sort()) == CompareItemsSort(items, 0, column, order)) << "Column" << column << "order" << order;
+    }
+  }
+
+}
+
+TEST(PlaylistSorterTest, KeepsItemsBeforeBegin) {
+
+  const PlaylistItemPtrList items = RandomItems(100);
+
+  PlaylistSorter sorter(items, 40, Playlist::Column_Artist, Qt::AscendingOrder);
+  const PlaylistItemPtrList sorted = sorter.Apply(items, sorter.Sort());
+
+  ASSERT_EQ(sorted.count(), items.count());
+  EXPECT_TRUE(sorted.mid(0, 40) == items.mid(0, 40));
+  EXPECT_TRUE(sorted == CompareItemsSort(items, 40, Playlist::Column_Artist, Qt::AscendingOrder));
+
+}
+
+TEST(PlaylistSorterTest, DISABLED_Benchmark) {
+
+  for (const int count : { 10000, 100000, 1000000 }) {
+    const PlaylistItemPtrList items = RandomItems(count);
+
+    QElapsedTimer timer;
+    timer.start();
+    PlaylistSorter sorter(items, 0, Playlist::Column_Artist, Qt::AscendingOrder);
+    const qint64 prepare_msec = timer.restart();
+    const PlaylistItemPtrList sorted = sorter.Apply(items, sorter.Sort());
+    const qint64 sort_msec = timer.restart();
+    const PlaylistItemPtrList expected = CompareItemsSort(items, 0, Playlist::Column_Artist, Qt::AscendingOrder);
+    const qint64 compare_items_msec = timer.elapsed();
+
+    EXPECT_TRUE(sorted == expected);
+    qLog(Info) << count << "items by artist:" << prepare_msec << "ms on the GUI thread," << sort_msec << "ms in the background, CompareItems" << compare_items_msec << "ms";
+  }
+
+}
+
+}  // namespace
@@ -0,0 +1,162 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+#include <limits>
+
+#include <QtGlobal>
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+
+#include "core/logging.h"
+#include "engine/sampleconverter.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+using SampleConverter::Format;
+
+namespace {
+
+// Random source data for the given format, sized for samples samples.
+QByteArray RandomSamples(const Format format, const int samples) {
+
+  QByteArray data(samples * SampleConverter::BytesPerSample(format), Qt::Uninitialized);
+  QRandomGenerator generator(42);
+  if (format == Format::F32LE) {
+    float *f = reinterpret_cast<float*>(data.data());
+    for (int i = 0; i < samples; ++i) {
+      // Include some values outside of [-1.0, 1.0] to exercise the clamping.
+      f[i] = static_cast<float>(generator.bounded(2.4) - 1.2);
+    }
+  }
+  else {
+    for (int i = 0; i < data.size(); ++i) {
+      data[i] = static_cast<char>(generator.bounded(256));
+    }
+  }
+
+  return data;
+
+}
+
+std::vector<qint16> Convert(const Format format, const QByteArray &data, const int samples, const bool allow_simd) {
+
+  std::vector<qint16> result(static_cast<size_t>(samples));
+  SampleConverter::ConvertToS16(format, data.constData(), result.data(), result.size(), allow_simd);
+  return result;
+
+}
+
+TEST(SampleConverterTest, FormatFromString) {
+
+  EXPECT_EQ(SampleConverter::FormatFromString("S16LE"), Format::S16LE);
+  EXPECT_EQ(SampleConverter::FormatFromString("S32LE"), Format::S32LE);
+  EXPECT_EQ(SampleConverter::FormatFromString("F32LE"), Format::F32LE);
+  EXPECT_EQ(SampleConverter::FormatFromString("S24LE"), Format::S24LE);
+  EXPECT_EQ(SampleConverter::FormatFromString("S24_32LE"), Format::S24_32LE);
+  EXPECT_EQ(SampleConverter::FormatFromString("U8"), Format::Unknown);
+  EXPECT_EQ(SampleConverter::FormatFromString(""), Format::Unknown);
+
+}
+
+TEST(SampleConverterTest, ConvertsKnownValues) {
+
+  const qint32 s32[] = { 0x7FFFFFFF, static_cast<qint32>(0x80000000), 0x00010000, -0x00010000 };
+  qint16 result[4];
+  SampleConverter::ConvertToS16(Format::S32LE, s32, result, 4);
+  EXPECT_EQ(result[0], 32767);
+  EXPECT_EQ(result[1], -32768);
+  EXPECT_EQ(result[2], 1);
+  EXPECT_EQ(result[3], -1);
+
+  const float f32[] = { 1.0F, -1.0F, 0.5F, std::numeric_limits<float>::infinity() };
+  SampleConverter::ConvertToS16(Format::F32LE, f32, result, 4);
+  EXPECT_EQ(result[0], 32767);
+  EXPECT_EQ(result[1], -32768);
+  EXPECT_EQ(result[2], 16384);
+  EXPECT_EQ(result[3], 32767);
+
+  const qint32 s24_32[] = { 0x007FFFFF, static_cast<qint32>(0xFF800000), 0x00000100, 0 };
+  SampleConverter::ConvertToS16(Format::S24_32LE, s24_32, result, 4);
+  EXPECT_EQ(result[0], 32767);
+  EXPECT_EQ(result[1], -32768);
+  EXPECT_EQ(result[2], 1);
+  EXPECT_EQ(result[3], 0);
+
+  const quint8 s24[] = { 0xFF, 0xFF, 0x7F, 0x00, 0x00, 0x80, 0x00, 0x01, 0x00 };
+  SampleConverter::ConvertToS16(Format::S24LE, s24, result, 3);
+  EXPECT_EQ(result[0], 32767);
+  EXPECT_EQ(result[1], -32768);
+  EXPECT_EQ(result[2], 1);
+
+}
+
+TEST(SampleConverterTest, SimdMatchesScalar) {
+
+  // Odd sizes so the scalar tail of the vectorized kernels is used too.
+  for (const int samples : { 1, 7, 8, 17, 33, 4099 }) {
+    for (const Format format : { Format::S16LE, Format::S32LE, Format::F32LE, Format::S24LE, Format::S24_32LE }) {
+      const QByteArray data = RandomSamples(format, samples);
+      EXPECT_EQ(Convert(format, data, samples, true), Convert(format, data, samples, false)) << "Format" << static_cast<int>(format) << "samples" << samples;
+    }
+  }
+
+}
+
+void RunBenchmark(const Format format) {
+
+  constexpr int kSamples = 4096;
+  constexpr int kIterations = 100000;
+
+  const QByteArray data = RandomSamples(format, kSamples);
+  std::vector<qint16> result(kSamples);
+
+  for (const bool allow_simd : { false, true }) {
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < kIterations; ++i) {
+      SampleConverter::ConvertToS16(format, data.constData(), result.data(), result.size(), allow_simd);
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    qLog(Info) << SampleConverter::BytesPerSample(format) << "byte format" << static_cast<int>(format) << (allow_simd ? "vectorized:" : "scalar:") << static_cast<double>(elapsed) / static_cast<double>(kIterations * static_cast<qint64>(kSamples)) << "ns per sample";
+  }
+
+}
+
+TEST(SampleConverterTest, DISABLED_BenchmarkS32LE) {
+  RunBenchmark(Format::S32LE);
+}
+
+TEST(SampleConverterTest, DISABLED_BenchmarkF32LE) {
+  RunBenchmark(Format::F32LE);
+}
+
+TEST(SampleConverterTest, DISABLED_BenchmarkS24LE) {
+  RunBenchmark(Format::S24LE);
+}
+
+TEST(SampleConverterTest, DISABLED_BenchmarkS24_32LE) {
+  RunBenchmark(Format::S24_32LE);
+}
+
+}  // namespace
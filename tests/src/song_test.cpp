@@ -0,0 +1,137 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QList>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QUrl>
+#include <QElapsedTimer>
+
+#include "core/logging.h"
+#include "core/song.h"
+#include "core/stringpool.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+// Resident set size in bytes, or -1 where it can't be read.
+qint64 ResidentMemory() {
+
+#ifdef Q_OS_LINUX
+  QFile file("/proc/self/statm");
+  if (!file.open(QIODevice::ReadOnly)) return -1;
+  const QList<QByteArray> fields = file.readAll().split(' ');
+  if (fields.count() < 2) return -1;
+  return fields[1].toLongLong() * 4096;
+#else
+  return -1;
+#endif
+
+}
+
+TEST(SongTest, InternedFieldsShareData) {
+
+  Song song1;
+  Song song2;
+  // Build the strings at runtime so they don't share data to begin with.
+  song1.set_artist(QString("Artist %1").arg(1));
+  song2.set_artist(QString("Artist %1").arg(1));
+  song1.set_genre(QString("Genre %1").arg(1));
+  song2.set_genre(QString("Genre %1").arg(1));
+
+  EXPECT_EQ(song1.artist(), song2.artist());
+  EXPECT_EQ(song1.artist().constData(), song2.artist().constData());
+  EXPECT_EQ(song1.artist_sortable().constData(), song2.artist_sortable().constData());
+  EXPECT_EQ(song1.genre().constData(), song2.genre().constData());
+
+}
+
+TEST(SongTest, ExtensionFields) {
+
+  Song song1;
+  EXPECT_TRUE(song1.comment().isEmpty());
+  EXPECT_TRUE(song1.lyrics().isEmpty());
+  EXPECT_TRUE(song1.acoustid_fingerprint().isEmpty());
+
+  song1.set_comment("Comment");
+  Song song2 = song1;
+  song2.set_lyrics("Lyrics");
+  song2.set_comment("Other comment");
+
+  EXPECT_EQ(song1.comment(), "Comment");
+  EXPECT_TRUE(song1.lyrics().isEmpty());
+  EXPECT_EQ(song2.comment(), "Other comment");
+  EXPECT_EQ(song2.lyrics(), "Lyrics");
+
+  song2.set_comment(QString());
+  EXPECT_TRUE(song2.comment().isEmpty());
+  EXPECT_EQ(song2.lyrics(), "Lyrics");
+
+}
+
+// Builds a synthetic collection of one million songs and reports the memory used.
+// Run with --gtest_also_run_disabled_tests --gtest_filter=SongTest.*MemoryBenchmark
+TEST(SongTest, DISABLED_MemoryBenchmark) {
+
+  constexpr int kSongCount = 1000000;
+  constexpr int kArtistCount = 10000;
+  constexpr int kTracksPerAlbum = 12;
+
+  const qint64 memory_before = ResidentMemory();
+  QElapsedTimer timer;
+  timer.start();
+
+  SongList songs;
+  songs.reserve(kSongCount);
+  for (int i = 0; i < kSongCount; ++i) {
+    const int album = i / kTracksPerAlbum;
+    const int artist = album % kArtistCount;
+    Song song(Song::Source::Collection);
+    song.set_id(i + 1);
+    song.set_title(QString("Title %1").arg(i));
+    song.set_artist(QString("Artist %1").arg(artist));
+    song.set_albumartist(QString("Artist %1").arg(artist));
+    song.set_album(QString("Album %1").arg(album));
+    song.set_genre(QString("Genre %1").arg(artist % 50));
+    song.set_composer(QString("Composer %1").arg(artist % 1000));
+    song.set_musicbrainz_artist_id(QString("%1-0000-0000-0000-000000000000").arg(artist, 8, 10, QChar('0')));
+    song.set_musicbrainz_album_id(QString("%1-0000-0000-0000-000000000000").arg(album, 8, 10, QChar('0')));
+    song.set_track(i % kTracksPerAlbum + 1);
+    song.set_year(1950 + artist % 70);
+    song.set_url(QUrl::fromLocalFile(QString("/music/Artist %1/Album %2/%3.flac").arg(artist).arg(album).arg(i)));
+    songs << song;
+  }
+
+  const qint64 elapsed = timer.elapsed();
+  const qint64 memory_after = ResidentMemory();
+
+  ASSERT_EQ(songs.count(), kSongCount);
+  qLog(Info) << "Created" << kSongCount << "songs in" << elapsed << "ms," << StringPool::size() << "strings in the pool";
+  if (memory_before != -1 && memory_after != -1) {
+    qLog(Info) << "Memory used:" << (memory_after - memory_before) / 1048576 << "MB," << (memory_after - memory_before) / kSongCount << "bytes per song";
+  }
+
+}
+
+}  // namespace
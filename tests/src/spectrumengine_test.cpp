@@ -0,0 +1,141 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <QtGlobal>
+#include <QtMath>
+
+#include "analyzer/fht.h"
+#include "analyzer/spectrumengine.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+constexpr int kFrames = 1 << 13;
+
+// Interleaved stereo with the same sine in both channels, the period is a power of two so every window holds whole periods.
+std::vector<int16_t> SineScope(const int period) {
+
+  std::vector<int16_t> scope(static_cast<size_t>(kFrames) * 2);
+  for (int i = 0; i < kFrames; ++i) {
+    const int16_t sample = static_cast<int16_t>(16384.0 * sin(2.0 * M_PI * i / period));
+    scope[static_cast<size_t>(i) * 2] = sample;
+    scope[static_cast<size_t>(i) * 2 + 1] = sample;
+  }
+  return scope;
+
+}
+
+TEST(SpectrumEngineTest, FFTSizeIsPowerOfTwo) {
+
+  SpectrumEngine spectrum_engine;
+  EXPECT_EQ(0, spectrum_engine.fft_size());
+
+  spectrum_engine.set_fft_size(1000);
+  EXPECT_EQ(1024, spectrum_engine.fft_size());
+
+  spectrum_engine.set_fft_size(100000);
+  EXPECT_EQ(1 << SpectrumEngine::kMaxExponent, spectrum_engine.fft_size());
+
+  spectrum_engine.set_fft_size(0);
+  EXPECT_EQ(0, spectrum_engine.fft_size());
+
+}
+
+TEST(SpectrumEngineTest, Power2MatchesFHT) {
+
+  constexpr int kSize = 512;
+
+  SpectrumEngine spectrum_engine;
+  spectrum_engine.SetScope(SineScope(32));
+
+  std::vector<float> samples(kSize);
+  spectrum_engine.Samples(kSize, samples.data());
+  EXPECT_NEAR(0.5, *std::max_element(samples.begin(), samples.end()), 1e-3);
+
+  FHT fht(9);
+  fht.power2(samples.data());
+
+  std::vector<float> power(kSize / 2);
+  spectrum_engine.Power2(kSize, power.data());
+  const float peak = *std::max_element(power.begin(), power.end());
+  for (int i = 0; i < kSize / 2; ++i) {
+    EXPECT_NEAR(samples[static_cast<size_t>(i)], power[static_cast<size_t>(i)], peak * 1e-5) << "bin" << i;
+  }
+
+}
+
+TEST(SpectrumEngineTest, LargerFFTSizeKeepsBinsAndScale) {
+
+  constexpr int kSize = 512;
+  constexpr int kBin = kSize / 32;
+
+  SpectrumEngine spectrum_engine;
+  spectrum_engine.SetScope(SineScope(32));
+
+  std::vector<float> expected(kSize / 2);
+  spectrum_engine.Spectrum(kSize, expected.data());
+
+  for (int fft_size = kSize * 2; fft_size <= kFrames; fft_size *= 2) {
+    spectrum_engine.set_fft_size(fft_size);
+    std::vector<float> spectrum(kSize / 2);
+    spectrum_engine.Spectrum(kSize, spectrum.data());
+
+    // The sine still lands in the same bin with the same magnitude.
+    EXPECT_EQ(kBin, std::max_element(spectrum.begin(), spectrum.end()) - spectrum.begin()) << "FFT size" << fft_size;
+    EXPECT_NEAR(1.0, spectrum[kBin] / expected[kBin], 0.01) << "FFT size" << fft_size;
+    for (int i = 0; i < kSize / 2; ++i) {
+      if (i != kBin) EXPECT_NEAR(0.0, spectrum[static_cast<size_t>(i)] / expected[kBin], 0.01) << "FFT size" << fft_size << "bin" << i;
+    }
+  }
+
+}
+
+TEST(SpectrumEngineTest, LogBandsPeakAtSineFrequency) {
+
+  constexpr int kSize = 2048;
+  constexpr int kBands = 32;
+
+  SpectrumEngine spectrum_engine;
+  std::vector<float> low(kBands);
+  std::vector<float> high(kBands);
+
+  spectrum_engine.SetScope(SineScope(256));
+  spectrum_engine.LogBands(kSize, kBands, low.data());
+  spectrum_engine.SetScope(SineScope(8));
+  spectrum_engine.LogBands(kSize, kBands, high.data());
+
+  const auto low_peak = std::max_element(low.begin(), low.end()) - low.begin();
+  const auto high_peak = std::max_element(high.begin(), high.end()) - high.begin();
+  EXPECT_LT(low_peak, high_peak);
+
+  // Bin 8 and bin 256 of 1024 bins are log spaced at 0.3 and 0.8 of the bands.
+  EXPECT_NEAR(0.3 * kBands, low_peak, 1.5);
+  EXPECT_NEAR(0.8 * kBands, high_peak, 1.5);
+
+}
+
+}  // namespace
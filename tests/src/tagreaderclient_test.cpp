@@ -0,0 +1,119 @@
+/*
+ * Strawberry Music Player
+ * Copyright 2023, Jonas Kvinge <jonas@jkvinge.net>
+ *
+ * Strawberry is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Strawberry is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Strawberry.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <QtGlobal>
+#include <QDir>
+#include <QThread>
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <QTemporaryDir>
+
+#include "core/song.h"
+#include "core/tagreaderclient.h"
+
+// clazy:excludeall=non-pod-global-static,returning-void-expression
+
+namespace {
+
+class TagReaderClientTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    // Use the worker from the build directory.
+    qputenv("PATH", QByteArray(TAGREADER_WORKER_DIR) + QDir::listSeparator().toLatin1() + qgetenv("PATH"));
+    thread_ = new QThread;
+    thread_->start();
+    // The blocking functions can only be called from another thread than the client's.
+    client_ = new TagReaderClient;
+    client_->moveToThread(thread_);
+    client_->Start();
+  }
+
+  static void TearDownTestCase() {
+    thread_->quit();
+    thread_->wait();
+    delete client_;
+    client_ = nullptr;
+    delete thread_;
+    thread_ = nullptr;
+  }
+
+  static TagReaderClient *client_;
+  static QThread *thread_;
+};
+
+TagReaderClient *TagReaderClientTest::client_ = nullptr;
+QThread *TagReaderClientTest::thread_ = nullptr;
+
+TEST_F(TagReaderClientTest, ReadFilesBatchBlocking) {
+
+  QTemporaryDir temp_dir;
+  ASSERT_TRUE(temp_dir.isValid());
+
+  // More than two batches, with one file that can't be read in the middle of the second batch.
+  const QStringList formats = QStringList() << "flac" << "mp3" << "ogg";
+  const int unreadable = TagReaderClient::kReadFilesBatchSize + 8;
+  QStringList filenames;
+  for (int i = 0; i < TagReaderClient::kReadFilesBatchSize * 2 + 6; ++i) {
+    const QString format = formats[i % formats.count()];
+    const QString filename = temp_dir.filePath(QString("song%1.%2").arg(i).arg(format));
+    if (i == unreadable) {
+      QFile file(filename);
+      ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+      ASSERT_GT(file.write("not a music file"), 0);
+      file.close();
+    }
+    else {
+      ASSERT_TRUE(QFile::copy(":/audio/strawberry." + format, filename));
+    }
+    filenames << filename;
+  }
+
+  SongList songs;
+  client_->ReadFilesBatchBlocking(filenames, &songs);
+
+  ASSERT_EQ(filenames.count(), songs.count());
+  for (int i = 0; i < filenames.count(); ++i) {
+    const Song &song = songs[i];
+    EXPECT_EQ(QUrl::fromLocalFile(filenames[i]), song.url()) << "File " << i;
+    if (i == unreadable) {
+      EXPECT_FALSE(song.is_valid());
+      continue;
+    }
+    EXPECT_TRUE(song.is_valid()) << "File " << i;
+    switch (i % formats.count()) {
+      case 0:
+        EXPECT_EQ(Song::FileType::FLAC, song.filetype()) << "File " << i;
+        break;
+      case 1:
+        EXPECT_EQ(Song::FileType::MPEG, song.filetype()) << "File " << i;
+        break;
+      default:
+        EXPECT_EQ(Song::FileType::OggVorbis, song.filetype()) << "File " << i;
+        break;
+    }
+  }
+
+}
+
+}  // namespace
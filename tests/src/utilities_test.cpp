@@ -24,6 +24,14 @@
 #include <QByteArray>
 #include <QString>
 #include <QDateTime>
+#include <QSize>
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QLinearGradient>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QFile>
 #include <QtDebug>
 
 #include "test_utils.h"
@@ -34,6 +42,8 @@
 #include "utilities/cryptutils.h"
 #include "utilities/colorutils.h"
 #include "utilities/transliterate.h"
+#include "utilities/imageutils.h"
+#include "utilities/fileutils.h"
 #include "core/logging.h"
 
 TEST(UtilitiesTest, PrettyTimeDelta) {
@@ -244,3 +254,92 @@ TEST(UtilitiesTest, ReplaceMessage) {
   ASSERT_EQ(Utilities::ReplaceMessage("%title% - %artist%", song, ""), song.title() + " - " + song.artist());
 
 }
+
+namespace {
+
+QByteArray JpegData(const QSize size) {
+
+  QImage image(size, QImage::Format_RGB32);
+  QPainter p(&image);
+  QLinearGradient gradient(0, 0, size.width(), size.height());
+  gradient.setColorAt(0, Qt::darkBlue);
+  gradient.setColorAt(1, Qt::yellow);
+  p.fillRect(image.rect(), gradient);
+  p.end();
+
+  return ImageUtils::SaveImageToJpegData(image);
+
+}
+
+}  // namespace
+
+TEST(UtilitiesTest, DecodeSize) {
+
+  ASSERT_EQ(ImageUtils::DecodeSize(QSize(2000, 1500), QSize(120, 120)), QSize(120, 90));
+  ASSERT_EQ(ImageUtils::DecodeSize(QSize(1500, 2000), QSize(120, 120)), QSize(90, 120));
+  ASSERT_EQ(ImageUtils::DecodeSize(QSize(1000, 999), QSize(100, 100)), QSize(100, 100));
+  ASSERT_EQ(ImageUtils::DecodeSize(QSize(100, 100), QSize(120, 120)), QSize(100, 100));
+  ASSERT_EQ(ImageUtils::DecodeSize(QSize(2000, 1500), QSize()), QSize(2000, 1500));
+
+}
+
+TEST(UtilitiesTest, ReadImage) {
+
+  const QByteArray image_data = JpegData(QSize(2000, 1500));
+
+  ASSERT_EQ(ImageUtils::ReadImage(image_data).size(), QSize(2000, 1500));
+  ASSERT_EQ(ImageUtils::ReadImage(image_data, QSize(120, 120)).size(), QSize(120, 90));
+  ASSERT_EQ(ImageUtils::ReadImage(image_data, QSize(4000, 4000)).size(), QSize(2000, 1500));
+  ASSERT_TRUE(ImageUtils::ReadImage(QByteArray("not an image")).isNull());
+
+}
+
+TEST(UtilitiesTest, CopyFileFast) {
+
+  QTemporaryDir temp_dir;
+  ASSERT_TRUE(temp_dir.isValid());
+
+  // Bigger than the copy buffer, so the copy takes more than one round.
+  QByteArray data;
+  for (int i = 0; i < 3 * 1024 * 1024 + 17; ++i) data.append(static_cast<char>(i % 251));
+  const QString source = temp_dir.filePath(QStringLiteral("source.flac"));
+  QFile source_file(source);
+  ASSERT_TRUE(source_file.open(QIODevice::WriteOnly));
+  ASSERT_EQ(data.size(), source_file.write(data));
+  source_file.close();
+
+  const QString destination = temp_dir.filePath(QStringLiteral("destination.flac"));
+  ASSERT_TRUE(Utilities::CopyFileFast(source, destination));
+  EXPECT_EQ(data, Utilities::ReadDataFromFile(destination));
+
+  // An existing file is left alone.
+  EXPECT_FALSE(Utilities::CopyFileFast(source, destination));
+
+  const QString empty_source = temp_dir.filePath(QStringLiteral("empty.flac"));
+  QFile empty_file(empty_source);
+  ASSERT_TRUE(empty_file.open(QIODevice::WriteOnly));
+  empty_file.close();
+  EXPECT_TRUE(Utilities::CopyFileFast(empty_source, temp_dir.filePath(QStringLiteral("empty_copy.flac"))));
+
+}
+
+TEST(UtilitiesTest, DISABLED_ReadImageBenchmark) {
+
+  for (const QSize &size : { QSize(600, 600), QSize(1500, 1500), QSize(3000, 3000) }) {
+    const QByteArray image_data = JpegData(size);
+
+    QElapsedTimer timer;
+    timer.start();
+    QImage image;
+    image.loadFromData(image_data);
+    const QImage image_scaled = ImageUtils::ScaleAndPad(image, true, true, 120);
+    const qint64 full_msec = timer.restart();
+    const QImage image_reduced = ImageUtils::ReadImage(image_data, QSize(120, 120));
+    const QImage image_reduced_scaled = ImageUtils::ScaleAndPad(image_reduced, true, true, 120);
+    const qint64 reduced_msec = timer.elapsed();
+
+    ASSERT_EQ(image_scaled.size(), image_reduced_scaled.size());
+    qLog(Info) << size << "JPEG scaled to 120:" << full_msec << "ms decoding" << image.sizeInBytes() << "bytes," << reduced_msec << "ms decoding" << image_reduced.sizeInBytes() << "bytes at a reduced size";
+  }
+
+}